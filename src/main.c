@@ -1,22 +1,38 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "simulation.h"
 
 int main(int argc, char* argv[])
 {
-    Simulation sim;
+    Simulation sim = {0};
 
-    if (argc > 2)
-    {
-        printf("USAGE: %s <config_path>", argv[0]);
-        return 1;
-    }
+    const char* usage = "USAGE: %s [config_path] [-t <threads>]\n";
 
     char* configPath = "../configs/default.json";
-    if (argc == 2)
+    unsigned int parsedPath = 0;
+    for (int i = 1; i < argc; i++)
     {
-        configPath = argv[1];
+        if (!strcmp(argv[i], "-t") || !strcmp(argv[i], "--threads"))
+        {
+            if (i + 1 >= argc || atoi(argv[i + 1]) < 1)
+            {
+                printf(usage, argv[0]);
+                return 1;
+            }
+            sim.threadOverride = atoi(argv[++i]);
+        }
+        else if (!parsedPath)
+        {
+            configPath = argv[i];
+            parsedPath = 1;
+        }
+        else
+        {
+            printf(usage, argv[0]);
+            return 1;
+        }
     }
 
     if (simulationInit(&sim, configPath))
@@ -26,4 +42,3 @@ int main(int argc, char* argv[])
 
     simulationStart(&sim);
 }
-
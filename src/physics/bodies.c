@@ -0,0 +1,401 @@
+#include "bodies.h"
+
+#include <cglm/cglm.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HOT_STREAMS 21  // position, lastPosition, linearAcceleration,
+                        // orientation, angularVelocity, angularAcceleration,
+                        // sleeping, stillSteps
+#define COLD_STREAMS (BODIES_STREAMS - HOT_STREAMS)  // size, mass, color,
+                                                     // staticPhysics, slot
+
+// rounds a body count up to the next multiple of BODIES_LANES
+unsigned int bodiesPad(unsigned int capacity)
+{
+    return (capacity + BODIES_LANES - 1) / BODIES_LANES * BODIES_LANES;
+}
+
+// points each stream into its backing allocation
+void bodiesAssign(Bodies* b)
+{
+    float* hot = b->hot;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        b->position[axis] = hot + axis * b->capacity;
+        b->lastPosition[axis] = hot + (3 + axis) * b->capacity;
+        b->linearAcceleration[axis] = hot + (6 + axis) * b->capacity;
+        b->angularVelocity[axis] = hot + (13 + axis) * b->capacity;
+        b->angularAcceleration[axis] = hot + (16 + axis) * b->capacity;
+    }
+    for (int axis = 0; axis < 4; axis++)
+    {
+        b->orientation[axis] = hot + (9 + axis) * b->capacity;
+    }
+    b->sleeping = (int*)(hot + 19 * b->capacity);
+    b->stillSteps = (unsigned int*)(hot + 20 * b->capacity);
+
+    float* cold = b->cold;
+    b->size = cold;
+    b->mass = cold + b->capacity;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        b->color[axis] = cold + (2 + axis) * b->capacity;
+    }
+    b->staticPhysics = (int*)(cold + 5 * b->capacity);
+    b->slot = (unsigned int*)(cold + 6 * b->capacity);
+}
+
+void bodiesInit(Bodies* b, ObjectType type, unsigned int capacity)
+{
+    b->type = type;
+    b->count = 0;
+    b->capacity = 0;
+    b->staticCount = 0;
+    b->staticVersion = 0;
+    b->hot = NULL;
+    b->cold = NULL;
+    b->slotCount = 0;
+    b->slotCapacity = 0;
+    b->slotIndices = NULL;
+    b->slotGenerations = NULL;
+    b->freeSlot = BODIES_NONE;
+    bodiesReserve(b, capacity);
+}
+
+void bodiesFree(Bodies* b)
+{
+    free(b->hot);
+    free(b->cold);
+    free(b->slotIndices);
+    free(b->slotGenerations);
+    b->hot = NULL;
+    b->cold = NULL;
+    b->slotIndices = NULL;
+    b->slotGenerations = NULL;
+    b->count = 0;
+    b->capacity = 0;
+    b->staticCount = 0;
+    b->slotCount = 0;
+    b->slotCapacity = 0;
+    b->freeSlot = BODIES_NONE;
+}
+
+void bodiesReserve(Bodies* b, unsigned int capacity)
+{
+    capacity = bodiesPad(capacity > 0 ? capacity : 1);
+    if (capacity <= b->capacity)
+    {
+        return;
+    }
+
+    // sizes are multiples of BODIES_ALIGNMENT since capacity is padded
+    void* hot = aligned_alloc(BODIES_ALIGNMENT,
+                              HOT_STREAMS * capacity * sizeof(float));
+    void* cold = aligned_alloc(BODIES_ALIGNMENT,
+                               COLD_STREAMS * capacity * sizeof(float));
+    memset(hot, 0, HOT_STREAMS * capacity * sizeof(float));
+    memset(cold, 0, COLD_STREAMS * capacity * sizeof(float));
+
+    // copy each existing stream into its new location
+    for (int stream = 0; stream < HOT_STREAMS && b->hot; stream++)
+    {
+        memcpy((float*)hot + stream * capacity,
+               (float*)b->hot + stream * b->capacity,
+               b->count * sizeof(float));
+    }
+    for (int stream = 0; stream < COLD_STREAMS && b->cold; stream++)
+    {
+        memcpy((float*)cold + stream * capacity,
+               (float*)b->cold + stream * b->capacity,
+               b->count * sizeof(float));
+    }
+
+    free(b->hot);
+    free(b->cold);
+    b->hot = hot;
+    b->cold = cold;
+    b->capacity = capacity;
+    bodiesAssign(b);
+}
+
+// moves every field of a body to another index, leaving its slot pointing at
+// the new index
+void bodiesMove(Bodies* b, unsigned int from, unsigned int to)
+{
+    for (int stream = 0; stream < HOT_STREAMS; stream++)
+    {
+        float* data = (float*)b->hot + stream * b->capacity;
+        memcpy(data + to, data + from, sizeof(float));
+    }
+    for (int stream = 0; stream < COLD_STREAMS; stream++)
+    {
+        float* data = (float*)b->cold + stream * b->capacity;
+        memcpy(data + to, data + from, sizeof(float));
+    }
+    b->slotIndices[b->slot[to]] = to;
+}
+
+unsigned int bodiesAdd(Bodies* b, Object* o)
+{
+    if (b->count == b->capacity)
+    {
+        bodiesReserve(b, b->capacity * 2);
+    }
+
+    // static bodies stay ahead of every dynamic one
+    unsigned int i = b->count++;
+    if (o->staticPhysics)
+    {
+        if (i > b->staticCount)
+        {
+            bodiesMove(b, b->staticCount, i);
+        }
+        i = b->staticCount++;
+        b->staticVersion++;
+    }
+    bodiesSet(b, i, o);
+
+    // take a freed slot if there is one
+    unsigned int slot = b->freeSlot;
+    if (slot != BODIES_NONE)
+    {
+        b->freeSlot = b->slotIndices[slot];
+    }
+    else
+    {
+        if (b->slotCount == b->slotCapacity)
+        {
+            b->slotCapacity = b->slotCapacity ? 2 * b->slotCapacity : 64;
+            b->slotIndices = realloc(b->slotIndices,
+                                     b->slotCapacity * sizeof(unsigned int));
+            b->slotGenerations =
+                realloc(b->slotGenerations,
+                        b->slotCapacity * sizeof(unsigned int));
+        }
+        slot = b->slotCount++;
+        b->slotGenerations[slot] = 0;
+    }
+    b->slotIndices[slot] = i;
+    b->slot[i] = slot;
+    return i;
+}
+
+void bodiesRemove(Bodies* b, unsigned int i)
+{
+    unsigned int slot = b->slot[i];
+    b->slotGenerations[slot]++;
+    b->slotIndices[slot] = b->freeSlot;
+    b->freeSlot = slot;
+
+    // the last static body fills the gap and the last body fills its place
+    if (i < b->staticCount)
+    {
+        unsigned int lastStatic = --b->staticCount;
+        b->staticVersion++;
+        if (i != lastStatic)
+        {
+            bodiesMove(b, lastStatic, i);
+        }
+        i = lastStatic;
+    }
+
+    unsigned int last = --b->count;
+    if (i != last)
+    {
+        bodiesMove(b, last, i);
+    }
+}
+
+// returns the start of a hot or cold stream, counting hot streams first
+float* bodiesStream(Bodies* b, unsigned int stream)
+{
+    if (stream < HOT_STREAMS)
+    {
+        return (float*)b->hot + stream * b->capacity;
+    }
+    return (float*)b->cold + (stream - HOT_STREAMS) * b->capacity;
+}
+
+void bodiesGather(Bodies* b, unsigned int* order, unsigned int first,
+                  unsigned int last, float* scratch)
+{
+    for (unsigned int stream = 0; stream < BODIES_STREAMS; stream++)
+    {
+        float* data = bodiesStream(b, stream);
+        float* gathered = scratch + stream * b->count;
+        for (unsigned int k = first; k < last; k++)
+        {
+            gathered[k] = data[order[k]];
+        }
+    }
+}
+
+void bodiesScatter(Bodies* b, unsigned int first, unsigned int last,
+                   float* scratch)
+{
+    for (unsigned int stream = 0; stream < BODIES_STREAMS; stream++)
+    {
+        memcpy(bodiesStream(b, stream) + first,
+               scratch + stream * b->count + first,
+               (last - first) * sizeof(float));
+    }
+}
+
+void bodiesRelink(Bodies* b)
+{
+    for (unsigned int i = 0; i < b->count; i++)
+    {
+        b->slotIndices[b->slot[i]] = i;
+    }
+}
+
+BodiesHandle bodiesHandle(Bodies* b, unsigned int i)
+{
+    BodiesHandle handle;
+    handle.type = b->type;
+    handle.slot = b->slot[i];
+    handle.generation = b->slotGenerations[handle.slot];
+    return handle;
+}
+
+unsigned int bodiesFind(Bodies* b, BodiesHandle handle)
+{
+    if (handle.type != b->type || handle.slot >= b->slotCount ||
+        b->slotGenerations[handle.slot] != handle.generation)
+    {
+        return BODIES_NONE;
+    }
+    return b->slotIndices[handle.slot];
+}
+
+void bodiesGet(Bodies* b, unsigned int i, Object* o)
+{
+    o->type = b->type;
+    o->size = b->size[i];
+    o->mass = b->mass[i];
+    o->staticPhysics = b->staticPhysics[i];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        o->color[axis] = b->color[axis][i];
+        o->lastPosition[axis] = b->lastPosition[axis][i];
+        o->position[axis] = b->position[axis][i];
+        o->linearAcceleration[axis] = b->linearAcceleration[axis][i];
+        o->angularVelocity[axis] = b->angularVelocity[axis][i];
+        o->angularAcceleration[axis] = b->angularAcceleration[axis][i];
+    }
+    bodiesOrientation(b, i, o->orientation);
+}
+
+void bodiesSet(Bodies* b, unsigned int i, Object* o)
+{
+    b->size[i] = o->size;
+    b->mass[i] = o->mass;
+    b->staticPhysics[i] = o->staticPhysics;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        b->color[axis][i] = o->color[axis];
+        b->lastPosition[axis][i] = o->lastPosition[axis];
+        b->position[axis][i] = o->position[axis];
+        b->linearAcceleration[axis][i] = o->linearAcceleration[axis];
+        b->angularVelocity[axis][i] = o->angularVelocity[axis];
+        b->angularAcceleration[axis][i] = o->angularAcceleration[axis];
+    }
+    bodiesSetOrientation(b, i, o->orientation);
+}
+
+void bodiesWake(Bodies* b, unsigned int i)
+{
+    // copies of static bodies are kept until they change
+    if (i < b->staticCount)
+    {
+        b->staticVersion++;
+    }
+    b->sleeping[i] = 0;
+    b->stillSteps[i] = 0;
+}
+
+void bodiesPosition(Bodies* b, unsigned int i, vec3 position)
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        position[axis] = b->position[axis][i];
+    }
+}
+
+void bodiesSetPosition(Bodies* b, unsigned int i, vec3 position)
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        b->position[axis][i] = position[axis];
+    }
+    bodiesWake(b, i);
+}
+
+void bodiesOrientation(Bodies* b, unsigned int i, versor orientation)
+{
+    for (int axis = 0; axis < 4; axis++)
+    {
+        orientation[axis] = b->orientation[axis][i];
+    }
+}
+
+void bodiesSetOrientation(Bodies* b, unsigned int i, versor orientation)
+{
+    for (int axis = 0; axis < 4; axis++)
+    {
+        b->orientation[axis][i] = orientation[axis];
+    }
+    bodiesWake(b, i);
+}
+
+void bodiesRotation(Bodies* b, unsigned int i, float r[3][3])
+{
+    float x = b->orientation[0][i], y = b->orientation[1][i],
+          z = b->orientation[2][i], w = b->orientation[3][i];
+
+    r[0][0] = 1.0f - 2.0f * (y * y + z * z);
+    r[0][1] = 2.0f * (x * y - z * w);
+    r[0][2] = 2.0f * (x * z + y * w);
+    r[1][0] = 2.0f * (x * y + z * w);
+    r[1][1] = 1.0f - 2.0f * (x * x + z * z);
+    r[1][2] = 2.0f * (y * z - x * w);
+    r[2][0] = 2.0f * (x * z - y * w);
+    r[2][1] = 2.0f * (y * z + x * w);
+    r[2][2] = 1.0f - 2.0f * (x * x + y * y);
+}
+
+void bodiesFloor(Bodies* floors, unsigned int f, BodiesFloor* floor)
+{
+    float r[3][3];
+    bodiesRotation(floors, f, r);
+    bodiesPosition(floors, f, floor->position);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        for (int row = 0; row < 3; row++)
+        {
+            floor->axes[axis][row] = r[row][axis];
+        }
+    }
+    floor->half = floors->size[f];
+}
+
+void bodiesColor(Bodies* b, unsigned int i, vec3 color)
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        color[axis] = b->color[axis][i];
+    }
+}
+
+void bodiesVertices(Bodies* b, unsigned int i, float* vertices)
+{
+    vec3 position;
+    versor orientation;
+    vec3 color;
+    bodiesPosition(b, i, position);
+    bodiesOrientation(b, i, orientation);
+    bodiesColor(b, i, color);
+
+    objectVertices(position, orientation, b->size[i], color, vertices);
+}
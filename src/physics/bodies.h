@@ -0,0 +1,166 @@
+/*
+ * bodies.h
+ *
+ * Structure-of-arrays storage for every body of a single object type
+ *
+ * Fields read and written on every physics step (hot) and fields only needed
+ * for loading, saving, and rendering (cold) live in separate contiguous
+ * allocations, and every stream starts on a BODIES_ALIGNMENT byte boundary so
+ * the integrator only pulls the memory it needs into cache
+ *
+ * Physics code indexes the streams directly while everything else goes through
+ * the accessor methods below
+ *
+ * Bodies stay densely packed, so removing one moves the last body into its
+ * place. Code which must refer to a body across removals holds a handle
+ * instead, naming a slot which follows the body wherever it moves, along with
+ * the generation the slot had when it was handed out. Freed slots are reused
+ * with a new generation, so handles to removed bodies are recognised as stale
+ *
+ * Static bodies are kept at the front of the store, so physics loops over
+ * moving bodies start at staticCount and never test the flag. Adding or
+ * removing a static body moves a dynamic one to keep the two apart, and
+ * staticVersion changes whenever the static bodies do so copies of them can be
+ * kept until then
+ */
+
+#ifndef BODIES_H
+#define BODIES_H
+
+#include <cglm/cglm.h>
+
+#include "object.h"
+
+#define BODIES_ALIGNMENT 32  // byte alignment of every stream
+#define BODIES_LANES 8  // stream capacities are padded to a multiple of this
+#define BODIES_NONE 0xffffffffu  // index of no body
+#define BODIES_STREAMS 28        // hot and cold streams of four bytes each
+
+// refers to a body regardless of where it is stored
+typedef struct BodiesHandle
+{
+    ObjectType type;
+    unsigned int slot;        // entry in the slot table of its store
+    unsigned int generation;  // generation of the slot when handed out
+} BodiesHandle;
+
+typedef struct Bodies
+{
+    ObjectType type;
+    unsigned int count;     // number of bodies currently stored
+    unsigned int capacity;  // number of bodies each stream can hold
+    unsigned int staticCount;    // static bodies, stored before all others
+    unsigned int staticVersion;  // bumped whenever a static body changes
+
+    /* HOT STREAMS */
+    float* position[3];
+    float* lastPosition[3];  // prior position for Verlet integration
+    float* linearAcceleration[3];
+    float* orientation[4];  // quaternion stored as x, y, z, w streams
+    float* angularVelocity[3];
+    float* angularAcceleration[3];
+    int* sleeping;  // id of the set sleeping in while at rest, 0 while awake
+    unsigned int* stillSteps;  // steps in a row spent below the sleep limits
+
+    /* COLD STREAMS */
+    float* size;
+    float* mass;
+    float* color[3];
+    int* staticPhysics;  // flag indicating whether to ignore physics for body,
+                         // set exactly for the first staticCount bodies
+    unsigned int* slot;  // slot of the handles referring to each body
+
+    /* SLOTS */
+    unsigned int slotCount;
+    unsigned int slotCapacity;
+    unsigned int* slotIndices;      // body of each slot in use, or the next
+                                    // free slot
+    unsigned int* slotGenerations;  // bumped every time a slot is freed
+    unsigned int freeSlot;          // first free slot, BODIES_NONE if none
+
+    void* hot;   // single allocation backing all of the hot streams
+    void* cold;  // single allocation backing all of the cold streams
+} Bodies;
+
+// world space frame of a single floor
+typedef struct BodiesFloor
+{
+    vec3 position;
+    vec3 axes[3];  // local axes in world space, with y along the normal
+    float half;    // half side length of the square
+} BodiesFloor;
+
+// initializes an empty store with room for the given number of bodies
+void bodiesInit(Bodies* b, ObjectType type, unsigned int capacity);
+
+// releases all streams
+void bodiesFree(Bodies* b);
+
+// grows every stream to hold at least the given number of bodies
+void bodiesReserve(Bodies* b, unsigned int capacity);
+
+// appends a body and returns its index
+// a static body goes after the other static bodies instead, moving the first
+// dynamic body to the end
+unsigned int bodiesAdd(Bodies* b, Object* o);
+
+// removes a body by moving the last body into its place
+// a static body is replaced by the last static body instead, whose place is
+// then taken by the last body
+void bodiesRemove(Bodies* b, unsigned int i);
+
+// copies every stream of the bodies at order[first] to order[last - 1] into
+// places first to last - 1 of a scratch store, which holds count values per
+// stream for BODIES_STREAMS streams
+void bodiesGather(Bodies* b, unsigned int* order, unsigned int first,
+                  unsigned int last, float* scratch);
+
+// copies places first to last - 1 of every stream back from a scratch store
+// filled by bodiesGather
+void bodiesScatter(Bodies* b, unsigned int first, unsigned int last,
+                   float* scratch);
+
+// points every slot in use at the body now holding it after bodies have been
+// moved around
+void bodiesRelink(Bodies* b);
+
+// returns a handle referring to a body until it is removed
+BodiesHandle bodiesHandle(Bodies* b, unsigned int i);
+
+// returns the index of the body a handle refers to, BODIES_NONE if the body
+// has been removed
+unsigned int bodiesFind(Bodies* b, BodiesHandle handle);
+
+// gathers all fields of a body into an object
+void bodiesGet(Bodies* b, unsigned int i, Object* o);
+
+// scatters all fields of an object into a body
+// whether the body is static is fixed when it is added, so the object's flag
+// must match it
+void bodiesSet(Bodies* b, unsigned int i, Object* o);
+
+// marks a body as awake, which every setter does since a body changed from
+// outside of physics may no longer be at rest
+void bodiesWake(Bodies* b, unsigned int i);
+
+void bodiesPosition(Bodies* b, unsigned int i, vec3 position);
+
+void bodiesSetPosition(Bodies* b, unsigned int i, vec3 position);
+
+void bodiesOrientation(Bodies* b, unsigned int i, versor orientation);
+
+void bodiesSetOrientation(Bodies* b, unsigned int i, versor orientation);
+
+// finds the rotation matrix of a body's orientation, indexed by row then
+// column
+void bodiesRotation(Bodies* b, unsigned int i, float r[3][3]);
+
+// finds the frame of the floor stored at f
+void bodiesFloor(Bodies* floors, unsigned int f, BodiesFloor* floor);
+
+void bodiesColor(Bodies* b, unsigned int i, vec3 color);
+
+// generates and stores model matrix and color data for a single body
+void bodiesVertices(Bodies* b, unsigned int i, float* vertices);
+
+#endif
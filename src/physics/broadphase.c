@@ -0,0 +1,960 @@
+#include "broadphase.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "objects/tetrahedron.h"
+#include "utils/sort.h"
+
+#define BROADPHASE_CHUNK 1024  // bodies handed to a worker at a time
+#define BROADPHASE_ENTRY_CHUNK 16384  // sorted entries gathered by a worker
+#define BROADPHASE_RUN_CHUNK 4096  // sorted entries scanned by each grid job
+#define BROADPHASE_CELL_SCALE 2.0f  // cell edge relative to the mean box edge
+#define BROADPHASE_SPAN 4  // most cells a body in the grid spans on an axis
+#define BROADPHASE_COORDINATE 1048576  // cell coordinates are clamped to
+                                       // 21 bits per axis for packing
+
+// shared state for the per-chunk phases of a broadphase update
+typedef struct BroadphaseTask
+{
+    Broadphase* bp;
+    Bodies* bodies;
+    Pool* pool;
+    unsigned int source;  // sort buffer holding the hashes in order
+    unsigned int* hashes[2];  // hash of each entry in both sort buffers
+    unsigned int* order[2];   // entry at each place in both sort buffers
+} BroadphaseTask;
+
+const char* BROADPHASE_NAMES[] = {"grid", "sap", "bvh"};
+
+void broadphaseInit(Broadphase* bp, BroadphaseMode mode, float cellSize,
+                    int sah)
+{
+    memset(bp, 0, sizeof(Broadphase));
+    bp->mode = mode;
+    bp->cellSize = cellSize;
+    bp->sah = sah;
+    sapInit(&bp->sap);
+    bvhInit(&bp->bvh);
+    bvhInit(&bp->statics);
+
+    for (int a = 0; a < OBJECT_TYPES; a++)
+    {
+        for (int b = a; b < OBJECT_TYPES; b++)
+        {
+            unsigned int group = broadphaseGroup(a, b);
+            bp->groupTypes[group][0] = a;
+            bp->groupTypes[group][1] = b;
+        }
+    }
+}
+
+void broadphaseFree(Broadphase* bp)
+{
+    free(bp->boxes);
+    free(bp->cells);
+    free(bp->resting);
+    free(bp->chunkEntries);
+    for (int i = 0; i < 2; i++)
+    {
+        free(bp->keys[i]);
+        free(bp->entries[i]);
+    }
+    free(bp->oversized);
+    sapFree(&bp->sap);
+    bvhFree(&bp->bvh);
+    free(bp->staticBoxes);
+    bvhFree(&bp->statics);
+    free(bp->jobs);
+    free(bp->pairs);
+    memset(bp, 0, sizeof(Broadphase));
+}
+
+unsigned int broadphaseGroup(ObjectType a, ObjectType b)
+{
+    if (a > b)
+    {
+        ObjectType temp = a;
+        a = b;
+        b = temp;
+    }
+
+    // groups are laid out row by row over the upper triangle of type pairs
+    return a * OBJECT_TYPES - a * (a - 1) / 2 + (b - a);
+}
+
+// returns the capacity an array must grow to for the given number of
+// elements, or 0 if it is already large enough
+unsigned int broadphaseGrow(unsigned int capacity, unsigned int count)
+{
+    if (count <= capacity && capacity > 0)
+    {
+        return 0;
+    }
+
+    unsigned int grown = capacity * 2 > count ? capacity * 2 : count;
+    return grown > 0 ? grown : 1;
+}
+
+// returns the cell coordinate containing a single coordinate of a point
+int broadphaseCoordinate(float x, float inverseCell)
+{
+    float cell = floorf(x * inverseCell);
+    if (cell < -BROADPHASE_COORDINATE + 1)
+    {
+        return -BROADPHASE_COORDINATE + 1;
+    }
+    if (cell > BROADPHASE_COORDINATE - 1)
+    {
+        return BROADPHASE_COORDINATE - 1;
+    }
+    return (int)cell;
+}
+
+// packs cell coordinates into a single unique key
+unsigned long long broadphaseKey(int x, int y, int z)
+{
+    return ((unsigned long long)(x + BROADPHASE_COORDINATE) << 42) |
+           ((unsigned long long)(y + BROADPHASE_COORDINATE) << 21) |
+           (unsigned long long)(z + BROADPHASE_COORDINATE);
+}
+
+// finds the bounds of a body's box relative to its position
+void broadphaseBounds(Bodies* b, unsigned int i, float tetrahedron[4][3],
+                      vec3 low, vec3 high)
+{
+    float size = b->size[i];
+    if (b->type == SPHERE)
+    {
+        glm_vec3_fill(low, -size);
+        glm_vec3_fill(high, size);
+        return;
+    }
+
+    float r[3][3];
+    bodiesRotation(b, i, r);
+
+    if (b->type == TETRAHEDRON)
+    {
+        glm_vec3_fill(low, INFINITY);
+        glm_vec3_fill(high, -INFINITY);
+        for (int v = 0; v < 4; v++)
+        {
+            for (int row = 0; row < 3; row++)
+            {
+                float coord = size * (r[row][0] * tetrahedron[v][0] +
+                                      r[row][1] * tetrahedron[v][1] +
+                                      r[row][2] * tetrahedron[v][2]);
+                low[row] = fminf(low[row], coord);
+                high[row] = fmaxf(high[row], coord);
+            }
+        }
+        return;
+    }
+
+    // cubes and floors are symmetric so only the half extents are needed
+    // cube corners lie on a sphere of radius size and floors are flat squares
+    // with half side length size in the local xz plane
+    vec3 half;
+    if (b->type == CUBE)
+    {
+        glm_vec3_fill(half, size / 1.73205081f);
+    }
+    else
+    {
+        half[0] = size;
+        half[1] = 0.0f;
+        half[2] = size;
+    }
+
+    for (int row = 0; row < 3; row++)
+    {
+        high[row] = fabsf(r[row][0]) * half[0] + fabsf(r[row][1]) * half[1] +
+                    fabsf(r[row][2]) * half[2];
+        low[row] = -high[row];
+    }
+}
+
+// returns the hash of a cell, which decides the bucket its entries sort into
+unsigned int broadphaseHash(Broadphase* bp, unsigned long long key)
+{
+    return (unsigned int)((key * 0x9E3779B97F4A7C15ull) >> (64 - bp->bits));
+}
+
+// finds the range of cells touched by a body's box
+void broadphaseCells(Broadphase* bp, unsigned int i, float inverseCell,
+                     int low[3], int high[3])
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        low[axis] = broadphaseCoordinate(bp->boxes[i].min[axis], inverseCell);
+        high[axis] = broadphaseCoordinate(bp->boxes[i].max[axis], inverseCell);
+    }
+}
+
+// finds the box of a body
+void broadphaseBox(Bodies* b, unsigned int i, float tetrahedron[4][3],
+                   BroadphaseBox* box)
+{
+    vec3 low, high;
+    broadphaseBounds(b, i, tetrahedron, low, high);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        box->min[axis] = b->position[axis][i] + low[axis];
+        box->max[axis] = b->position[axis][i] + high[axis];
+    }
+}
+
+// computes boxes and cell counts for a chunk of bodies
+void broadphaseBoxes(void* data, unsigned int first, unsigned int last,
+                     unsigned int worker)
+{
+    BroadphaseTask* task = data;
+    Broadphase* bp = task->bp;
+    float inverseCell = 1.0f / bp->cell;
+
+    float tetrahedron[4][3];
+    tetrahedronVertices(tetrahedron);
+
+    ObjectType type = 0;
+    for (unsigned int flat = first; flat < last; flat++)
+    {
+        // ranges may span several chunks when the pool runs them inline
+        if (flat % BROADPHASE_CHUNK == 0)
+        {
+            bp->chunkEntries[flat / BROADPHASE_CHUNK] = 0;
+        }
+
+        while (flat >= bp->offsets[type + 1])
+        {
+            type++;
+        }
+        Bodies* b = &task->bodies[type];
+        unsigned int i = flat - bp->offsets[type] + bp->firsts[type];
+
+        // bodies spanning too many cells on any axis are cheaper to test
+        // against everything than to bin
+        BroadphaseBox* box = bp->boxes + flat;
+        broadphaseBox(b, i, tetrahedron, box);
+        unsigned int cells = 1;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            int span = broadphaseCoordinate(box->max[axis], inverseCell) -
+                       broadphaseCoordinate(box->min[axis], inverseCell);
+            cells = span >= BROADPHASE_SPAN ? 0 : cells * (span + 1);
+        }
+        // floors are swept as planes, so they reserve no entries
+        bp->cells[flat] = type == FLOOR ? 0 : cells;
+        bp->resting[flat] = b->sleeping[i] != 0;
+        bp->chunkEntries[flat / BROADPHASE_CHUNK] += bp->cells[flat];
+    }
+}
+
+// writes an entry for every cell touched by each body in a chunk
+void broadphaseFill(void* data, unsigned int first, unsigned int last,
+                    unsigned int worker)
+{
+    BroadphaseTask* task = data;
+    Broadphase* bp = task->bp;
+    float inverseCell = 1.0f / bp->cell;
+
+    unsigned int entry = 0;
+    for (unsigned int i = first; i < last; i++)
+    {
+        if (i % BROADPHASE_CHUNK == 0)
+        {
+            entry = bp->chunkEntries[i / BROADPHASE_CHUNK];
+        }
+
+        if (!bp->cells[i])
+        {
+            continue;
+        }
+
+        int low[3], high[3];
+        broadphaseCells(bp, i, inverseCell, low, high);
+        for (int x = low[0]; x <= high[0]; x++)
+        {
+            for (int y = low[1]; y <= high[1]; y++)
+            {
+                for (int z = low[2]; z <= high[2]; z++)
+                {
+                    unsigned long long key = broadphaseKey(x, y, z);
+                    bp->keys[0][entry] = key;
+                    bp->entries[0][entry] = i;
+                    task->hashes[0][entry] = broadphaseHash(bp, key);
+                    task->order[0][entry] = entry;
+                    entry++;
+                }
+            }
+        }
+    }
+}
+
+// copies a chunk of entries to their places in the order of their hashes
+void broadphaseGather(void* data, unsigned int first, unsigned int last,
+                      unsigned int worker)
+{
+    BroadphaseTask* task = data;
+    Broadphase* bp = task->bp;
+    unsigned int* order = task->order[task->source];
+
+    for (unsigned int e = first; e < last; e++)
+    {
+        bp->keys[1][e] = bp->keys[0][order[e]];
+        bp->entries[1][e] = bp->entries[0][order[e]];
+    }
+}
+
+int broadphaseOverlap(BroadphaseBox* a, BroadphaseBox* b)
+{
+    return a->min[0] <= b->max[0] && b->min[0] <= a->max[0] &&
+           a->min[1] <= b->max[1] && b->min[1] <= a->max[1] &&
+           a->min[2] <= b->max[2] && b->min[2] <= a->max[2];
+}
+
+// records a pair of bodies given by their stores, where body a belongs to the
+// group's first type and comes first when both types match
+void broadphaseRecord(BroadphaseJob* job, ObjectType typeA, unsigned int a,
+                      ObjectType typeB, unsigned int b)
+{
+    unsigned int group = broadphaseGroup(typeA, typeB);
+    if (job->count == job->capacity)
+    {
+        unsigned int capacity = job->capacity ? job->capacity * 2 : 64;
+        job->candidates = arenaResize(
+            job->arena, job->candidates,
+            3 * job->capacity * sizeof(unsigned int),
+            3 * capacity * sizeof(unsigned int));
+        job->capacity = capacity;
+    }
+
+    unsigned int* candidate = job->candidates + 3 * job->count++;
+    candidate[0] = a;
+    candidate[1] = b;
+    candidate[2] = group;
+    job->counts[group]++;
+}
+
+// records a pair of dynamic bodies found by a job
+void broadphaseEmit(Broadphase* bp, BroadphaseJob* job, unsigned int i,
+                    unsigned int j)
+{
+    // bodies which do not move this step never need to be resolved against
+    // each other, and a sleeping body is woken by whichever body touches it
+    if (bp->resting[i] && bp->resting[j])
+    {
+        return;
+    }
+
+    // flat indices are ordered by type and then by index, so the lower one
+    // belongs to the group's first type
+    if (i > j)
+    {
+        unsigned int temp = i;
+        i = j;
+        j = temp;
+    }
+
+    ObjectType typeA = 0;
+    while (i >= bp->offsets[typeA + 1])
+    {
+        typeA++;
+    }
+    ObjectType typeB = typeA;
+    while (j >= bp->offsets[typeB + 1])
+    {
+        typeB++;
+    }
+    broadphaseRecord(job, typeA, i - bp->offsets[typeA] + bp->firsts[typeA],
+                     typeB, j - bp->offsets[typeB] + bp->firsts[typeB]);
+}
+
+// finds pairs within the cells starting in a range of sorted entries
+void broadphaseGridJob(BroadphaseTask* task, BroadphaseJob* job,
+                       unsigned int index)
+{
+    Broadphase* bp = task->bp;
+    float inverseCell = 1.0f / bp->cell;
+    unsigned long long* keys = bp->keys[1];
+    unsigned int* entries = bp->entries[1];
+    unsigned int* hashes = task->hashes[task->source];
+
+    unsigned int start = index * BROADPHASE_RUN_CHUNK;
+    unsigned int end = start + BROADPHASE_RUN_CHUNK;
+    if (end > bp->entryCount)
+    {
+        end = bp->entryCount;
+    }
+
+    // a bucket belongs to the job holding its first entry
+    unsigned int p = start;
+    while (p > 0 && p < end && hashes[p] == hashes[p - 1])
+    {
+        p++;
+    }
+
+    while (p < end)
+    {
+        unsigned int bucketEnd = p + 1;
+        while (bucketEnd < bp->entryCount && hashes[bucketEnd] == hashes[p])
+        {
+            bucketEnd++;
+        }
+
+        for (; p < bucketEnd; p++)
+        {
+            unsigned int i = entries[p];
+            BroadphaseBox* a = bp->boxes + i;
+            for (unsigned int q = p + 1; q < bucketEnd; q++)
+            {
+                // different cells can share a bucket
+                unsigned int j = entries[q];
+                BroadphaseBox* b = bp->boxes + j;
+                if (keys[p] != keys[q] || !broadphaseOverlap(a, b))
+                {
+                    continue;
+                }
+
+                // only the cell holding the minimum corner of the overlap
+                // reports the pair
+                int corner[3];
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    corner[axis] = broadphaseCoordinate(
+                        fmaxf(a->min[axis], b->min[axis]), inverseCell);
+                }
+                if (broadphaseKey(corner[0], corner[1], corner[2]) == keys[p])
+                {
+                    broadphaseEmit(bp, job, i, j);
+                }
+            }
+        }
+    }
+}
+
+// finds pairs between a range of bodies and the oversized bodies
+void broadphaseOversizedJob(Broadphase* bp, BroadphaseJob* job,
+                            unsigned int index)
+{
+    unsigned int start = index * BROADPHASE_CHUNK;
+    unsigned int end = start + BROADPHASE_CHUNK;
+    if (end > bp->offsets[OBJECT_TYPES])
+    {
+        end = bp->offsets[OBJECT_TYPES];
+    }
+    if (start < bp->offsets[FLOOR + 1])
+    {
+        start = bp->offsets[FLOOR + 1];
+    }
+
+    for (unsigned int i = start; i < end; i++)
+    {
+        for (unsigned int k = 0; k < bp->oversizedCount; k++)
+        {
+            // pairs of oversized bodies are found once, from the later body
+            unsigned int o = bp->oversized[k];
+            if ((bp->cells[i] || o < i) &&
+                broadphaseOverlap(bp->boxes + i, bp->boxes + o))
+            {
+                broadphaseEmit(bp, job, i, o);
+            }
+        }
+    }
+}
+
+// state of a tree query made for a single body
+typedef struct BroadphaseQuery
+{
+    Broadphase* bp;
+    BroadphaseJob* job;
+    unsigned int body;
+} BroadphaseQuery;
+
+// records a pair with a body reached by a tree query
+int broadphaseVisit(void* data, unsigned int body)
+{
+    BroadphaseQuery* query = data;
+    Broadphase* bp = query->bp;
+
+    // each pair is reported by the query of its lower body
+    if (body > query->body &&
+        broadphaseOverlap(bp->boxes + query->body, bp->boxes + body))
+    {
+        broadphaseEmit(bp, query->job, query->body, body);
+    }
+    return 1;
+}
+
+// finds pairs by querying the tree with each body in a range
+void broadphaseTreeJob(Broadphase* bp, BroadphaseJob* job, unsigned int index)
+{
+    unsigned int start = index * BROADPHASE_CHUNK;
+    unsigned int end = start + BROADPHASE_CHUNK;
+    if (end > bp->offsets[OBJECT_TYPES])
+    {
+        end = bp->offsets[OBJECT_TYPES];
+    }
+    if (start < bp->offsets[FLOOR + 1])
+    {
+        start = bp->offsets[FLOOR + 1];
+    }
+
+    BroadphaseQuery query = {bp, job, 0};
+    for (unsigned int i = start; i < end; i++)
+    {
+        query.body = i;
+        bvhQuery(&bp->bvh, bp->boxes[i].min, bp->boxes[i].max,
+                 broadphaseVisit, &query);
+    }
+}
+
+// records a pair with a static body reached by a query of the static tree
+int broadphaseVisitStatic(void* data, unsigned int body)
+{
+    BroadphaseQuery* query = data;
+    Broadphase* bp = query->bp;
+
+    // leaves hold exact boxes, so reaching one means the boxes overlap
+    ObjectType typeA = FLOOR + 1;
+    while (body >= bp->staticOffsets[typeA + 1])
+    {
+        typeA++;
+    }
+    ObjectType typeB = FLOOR + 1;
+    while (query->body >= bp->offsets[typeB + 1])
+    {
+        typeB++;
+    }
+    unsigned int a = body - bp->staticOffsets[typeA];
+    unsigned int b = query->body - bp->offsets[typeB] + bp->firsts[typeB];
+
+    // static bodies come before the dynamic ones of their type
+    if (typeA <= typeB)
+    {
+        broadphaseRecord(query->job, typeA, a, typeB, b);
+    }
+    else
+    {
+        broadphaseRecord(query->job, typeB, b, typeA, a);
+    }
+    return 1;
+}
+
+// finds pairs with static bodies by querying the static tree with each awake
+// body in a range
+void broadphaseStaticJob(Broadphase* bp, BroadphaseJob* job,
+                         unsigned int index)
+{
+    unsigned int start = index * BROADPHASE_CHUNK;
+    unsigned int end = start + BROADPHASE_CHUNK;
+    if (end > bp->offsets[OBJECT_TYPES])
+    {
+        end = bp->offsets[OBJECT_TYPES];
+    }
+    if (start < bp->offsets[FLOOR + 1])
+    {
+        start = bp->offsets[FLOOR + 1];
+    }
+
+    BroadphaseQuery query = {bp, job, 0};
+    for (unsigned int i = start; i < end; i++)
+    {
+        if (bp->resting[i])
+        {
+            continue;
+        }
+        query.body = i;
+        bvhQuery(&bp->statics, bp->boxes[i].min, bp->boxes[i].max,
+                 broadphaseVisitStatic, &query);
+    }
+}
+
+// empties a job whose candidates are allocated from the given arena
+void broadphaseStart(BroadphaseJob* job, Arena* arena)
+{
+    job->count = 0;
+    job->capacity = 0;
+    job->candidates = NULL;
+    job->arena = arena;
+    memset(job->counts, 0, sizeof(job->counts));
+}
+
+// hands the pairs kept by sweep and prune to a single job
+void broadphaseSapJob(Broadphase* bp, BroadphaseJob* job, Arena* frame)
+{
+    broadphaseStart(job, frame);
+
+    for (unsigned int p = 0; p < bp->sap.pairCount; p++)
+    {
+        unsigned long long pair = bp->sap.pairs[p];
+        broadphaseEmit(bp, job, (unsigned int)(pair >> 32),
+                       (unsigned int)pair);
+    }
+}
+
+// runs a range of pair jobs
+void broadphasePairs(void* data, unsigned int first, unsigned int last,
+                     unsigned int worker)
+{
+    BroadphaseTask* task = data;
+    Broadphase* bp = task->bp;
+
+    for (unsigned int index = first; index < last; index++)
+    {
+        BroadphaseJob* job = bp->jobs + index;
+        broadphaseStart(job, task->pool->arenas + worker);
+
+        if (bp->mode == BROADPHASE_BVH)
+        {
+            broadphaseTreeJob(bp, job, index);
+        }
+        else if (index < bp->gridJobs)
+        {
+            broadphaseGridJob(task, job, index);
+        }
+        else
+        {
+            broadphaseOversizedJob(bp, job, index - bp->gridJobs);
+        }
+    }
+}
+
+// runs a range of static jobs
+void broadphaseStaticPairs(void* data, unsigned int first, unsigned int last,
+                           unsigned int worker)
+{
+    BroadphaseTask* task = data;
+    Broadphase* bp = task->bp;
+
+    for (unsigned int index = first; index < last; index++)
+    {
+        BroadphaseJob* job = bp->jobs + bp->jobCount - bp->staticJobs + index;
+        broadphaseStart(job, task->pool->arenas + worker);
+        broadphaseStaticJob(bp, job, index);
+    }
+}
+
+// copies the pairs of a range of jobs into their groups
+void broadphaseMerge(void* data, unsigned int first, unsigned int last,
+                     unsigned int worker)
+{
+    Broadphase* bp = ((BroadphaseTask*)data)->bp;
+
+    for (unsigned int index = first; index < last; index++)
+    {
+        BroadphaseJob* job = bp->jobs + index;
+        for (unsigned int c = 0; c < job->count; c++)
+        {
+            unsigned int* candidate = job->candidates + 3 * c;
+            unsigned int group = candidate[2];
+            BroadphasePair* pair = bp->pairs + job->counts[group]++;
+            pair->a = candidate[0];
+            pair->b = candidate[1];
+        }
+    }
+}
+
+void broadphaseCell(Broadphase* bp, Bodies* bodies)
+{
+    if (bp->cellSize > 0.0f)
+    {
+        bp->cell = bp->cellSize;
+        return;
+    }
+
+    // body sizes are fixed, so the derived size holds until bodies are added,
+    // removed or moved
+    if (bp->cell > 0.0f)
+    {
+        return;
+    }
+
+    // every shape fits inside a sphere of radius size, and floors and static
+    // bodies are left out since they never enter the grid
+    double total = 0.0;
+    unsigned int count = 0;
+    for (int type = FLOOR + 1; type < OBJECT_TYPES; type++)
+    {
+        for (unsigned int i = bodies[type].staticCount; i < bodies[type].count;
+             i++)
+        {
+            total += 2.0 * bodies[type].size[i];
+        }
+        count += bodies[type].count - bodies[type].staticCount;
+    }
+    bp->cell = count > 0 ? BROADPHASE_CELL_SCALE * total / count : 1.0f;
+    if (!(bp->cell > 0.0f))
+    {
+        bp->cell = 1.0f;
+    }
+}
+
+// grows the per body arrays to hold the given number of bodies
+void broadphaseReserveBodies(Broadphase* bp, unsigned int count)
+{
+    unsigned int grown = broadphaseGrow(bp->capacity, count);
+    if (grown)
+    {
+        free(bp->boxes);
+        free(bp->cells);
+        free(bp->resting);
+        bp->boxes = malloc(grown * sizeof(BroadphaseBox));
+        bp->cells = malloc(grown);
+        bp->resting = malloc(grown);
+        bp->capacity = grown;
+    }
+
+    unsigned int chunks = (count + BROADPHASE_CHUNK - 1) / BROADPHASE_CHUNK;
+    grown = broadphaseGrow(bp->chunkCapacity, chunks);
+    if (grown)
+    {
+        free(bp->chunkEntries);
+        bp->chunkEntries = malloc(grown * sizeof(unsigned int));
+        bp->chunkCapacity = grown;
+    }
+}
+
+// grows both entry buffers to hold the given number of entries
+void broadphaseReserveEntries(Broadphase* bp, unsigned int count)
+{
+    unsigned int grown = broadphaseGrow(bp->entryCapacity, count);
+    if (grown)
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            free(bp->keys[i]);
+            free(bp->entries[i]);
+            bp->keys[i] = malloc(grown * sizeof(unsigned long long));
+            bp->entries[i] = malloc(grown * sizeof(unsigned int));
+        }
+        bp->entryCapacity = grown;
+    }
+}
+
+// grows the job list
+void broadphaseReserveJobs(Broadphase* bp, unsigned int count)
+{
+    unsigned int grown = broadphaseGrow(bp->jobCapacity, count);
+    if (grown)
+    {
+        bp->jobs = realloc(bp->jobs, grown * sizeof(BroadphaseJob));
+        memset(bp->jobs + bp->jobCapacity, 0,
+               (grown - bp->jobCapacity) * sizeof(BroadphaseJob));
+        bp->jobCapacity = grown;
+    }
+}
+
+// bins the boxes into the grid and finds pairs from its cells
+void broadphaseGrid(Broadphase* bp, BroadphaseTask* task, Pool* pool,
+                    Arena* frame)
+{
+    unsigned int count = bp->offsets[OBJECT_TYPES];
+    unsigned int chunks = (count + BROADPHASE_CHUNK - 1) / BROADPHASE_CHUNK;
+
+    // each chunk of bodies writes its entries after those of earlier chunks
+    bp->entryCount = 0;
+    for (unsigned int chunk = 0; chunk < chunks; chunk++)
+    {
+        unsigned int entries = bp->chunkEntries[chunk];
+        bp->chunkEntries[chunk] = bp->entryCount;
+        bp->entryCount += entries;
+    }
+
+    // bodies too large for the grid are tested against everything
+    bp->oversizedCount = 0;
+    for (unsigned int i = bp->offsets[FLOOR + 1]; i < count; i++)
+    {
+        if (bp->cells[i])
+        {
+            continue;
+        }
+
+        if (bp->oversizedCount == bp->oversizedCapacity)
+        {
+            bp->oversizedCapacity =
+                bp->oversizedCapacity ? bp->oversizedCapacity * 2 : 16;
+            bp->oversized = realloc(bp->oversized, bp->oversizedCapacity *
+                                                       sizeof(unsigned int));
+        }
+        bp->oversized[bp->oversizedCount++] = i;
+    }
+
+    // about two buckets per entry keeps different cells from sharing a bucket
+    bp->bits = 6;
+    while ((1u << bp->bits) < 2 * bp->entryCount && bp->bits < 30)
+    {
+        bp->bits++;
+    }
+
+    broadphaseReserveEntries(bp, bp->entryCount);
+    for (int buffer = 0; buffer < 2; buffer++)
+    {
+        task->hashes[buffer] =
+            arenaAlloc(frame, bp->entryCount * sizeof(unsigned int));
+        task->order[buffer] =
+            arenaAlloc(frame, bp->entryCount * sizeof(unsigned int));
+    }
+    poolFor(pool, count, BROADPHASE_CHUNK, broadphaseFill, task);
+
+    // radix sort of the entries by hash, then the cells and bodies follow
+    task->source = sortPairs(task->hashes, task->order, bp->entryCount,
+                             bp->bits, pool, frame);
+    poolFor(pool, bp->entryCount, BROADPHASE_ENTRY_CHUNK, broadphaseGather,
+            task);
+
+    // pair jobs
+    bp->gridJobs =
+        (bp->entryCount + BROADPHASE_RUN_CHUNK - 1) / BROADPHASE_RUN_CHUNK;
+    bp->jobCount = bp->gridJobs;
+    if (bp->oversizedCount > 0)
+    {
+        bp->jobCount += chunks;
+    }
+    broadphaseReserveJobs(bp, bp->jobCount);
+    poolFor(pool, bp->jobCount, 1, broadphasePairs, task);
+}
+
+void broadphaseInvalidate(Broadphase* bp)
+{
+    // neither matches the number of bodies, so both are built from scratch
+    bp->sap.count = BODIES_NONE;
+    bp->bvh.count = BODIES_NONE;
+
+    // the mix of sizes may have changed too
+    bp->cell = 0.0f;
+}
+
+// rebuilds the boxes and tree of the static bodies if any have changed
+void broadphaseStatics(Broadphase* bp, Bodies* bodies, Arena* frame)
+{
+    // floors never enter the broadphase
+    int changed = 0;
+    bp->staticOffsets[0] = 0;
+    bp->staticOffsets[FLOOR + 1] = 0;
+    for (int type = FLOOR + 1; type < OBJECT_TYPES; type++)
+    {
+        Bodies* b = &bodies[type];
+        changed |= bp->staticVersions[type] != b->staticVersion;
+        bp->staticVersions[type] = b->staticVersion;
+        bp->staticOffsets[type + 1] = bp->staticOffsets[type] + b->staticCount;
+    }
+    unsigned int count = bp->staticOffsets[OBJECT_TYPES];
+    if (!changed && bp->statics.count == count)
+    {
+        return;
+    }
+
+    // adding or removing a static body also moves a dynamic one
+    broadphaseInvalidate(bp);
+
+    unsigned int grown = broadphaseGrow(bp->staticCapacity, count);
+    if (grown)
+    {
+        free(bp->staticBoxes);
+        bp->staticBoxes = malloc(grown * sizeof(BroadphaseBox));
+        bp->staticCapacity = grown;
+    }
+
+    float tetrahedron[4][3];
+    tetrahedronVertices(tetrahedron);
+    for (int type = FLOOR + 1; type < OBJECT_TYPES; type++)
+    {
+        for (unsigned int i = 0; i < bodies[type].staticCount; i++)
+        {
+            broadphaseBox(&bodies[type], i, tetrahedron,
+                          bp->staticBoxes + bp->staticOffsets[type] + i);
+        }
+    }
+    bvhBuildStatic(&bp->statics, bp, frame);
+}
+
+// queries the static tree with every awake body in parallel
+void broadphaseStaticQueries(Broadphase* bp, BroadphaseTask* task, Pool* pool)
+{
+    unsigned int count = bp->offsets[OBJECT_TYPES];
+    bp->staticJobs = bp->statics.root == BVH_NULL
+                         ? 0
+                         : (count + BROADPHASE_CHUNK - 1) / BROADPHASE_CHUNK;
+    bp->jobCount += bp->staticJobs;
+    broadphaseReserveJobs(bp, bp->jobCount);
+    poolFor(pool, bp->staticJobs, 1, broadphaseStaticPairs, task);
+}
+
+
+void broadphaseUpdate(Broadphase* bp, Bodies* bodies, Pool* pool,
+                      Arena* frame)
+{
+    BroadphaseTask task = {bp, bodies, pool};
+
+    /* STATIC TREE */
+    broadphaseStatics(bp, bodies, frame);
+
+    /* BOXES */
+    bp->offsets[0] = 0;
+    for (int type = 0; type < OBJECT_TYPES; type++)
+    {
+        Bodies* b = &bodies[type];
+        bp->firsts[type] = b->staticCount;
+        bp->offsets[type + 1] = bp->offsets[type] + b->count - b->staticCount;
+    }
+    unsigned int count = bp->offsets[OBJECT_TYPES];
+    broadphaseReserveBodies(bp, count);
+
+    poolFor(pool, count, BROADPHASE_CHUNK, broadphaseBoxes, &task);
+
+    if (bp->mode == BROADPHASE_SAP)
+    {
+        // the sweep updates its pairs in place, so only collecting them is
+        // left and a single job suffices
+        sapUpdate(&bp->sap, bp, frame);
+        bp->gridJobs = 0;
+        bp->jobCount = 1;
+        broadphaseReserveJobs(bp, bp->jobCount);
+        broadphaseSapJob(bp, bp->jobs, frame);
+    }
+    else if (bp->mode == BROADPHASE_BVH)
+    {
+        // few bodies escape their fat boxes each step so the tree is updated
+        // on one thread, then queried from every body in parallel
+        bvhUpdate(&bp->bvh, bp, bodies);
+        bp->gridJobs = 0;
+        bp->jobCount = (count + BROADPHASE_CHUNK - 1) / BROADPHASE_CHUNK;
+        broadphaseReserveJobs(bp, bp->jobCount);
+        poolFor(pool, bp->jobCount, 1, broadphasePairs, &task);
+    }
+    else
+    {
+        /* GRID */
+        broadphaseGrid(bp, &task, pool, frame);
+    }
+    broadphaseStaticQueries(bp, &task, pool);
+
+    /* PAIRS */
+    // every job writes each group's pairs after those of earlier jobs
+    unsigned int pairs = 0;
+    for (unsigned int group = 0; group < BROADPHASE_GROUPS; group++)
+    {
+        bp->groupStarts[group] = pairs;
+        for (unsigned int index = 0; index < bp->jobCount; index++)
+        {
+            BroadphaseJob* job = bp->jobs + index;
+            unsigned int jobPairs = job->counts[group];
+            job->counts[group] = pairs;
+            pairs += jobPairs;
+        }
+    }
+    bp->groupStarts[BROADPHASE_GROUPS] = pairs;
+    bp->pairCount = pairs;
+
+    unsigned int grown = broadphaseGrow(bp->pairCapacity, pairs);
+    if (grown)
+    {
+        free(bp->pairs);
+        bp->pairs = malloc(grown * sizeof(BroadphasePair));
+        bp->pairCapacity = grown;
+    }
+
+    poolFor(pool, bp->jobCount, 1, broadphaseMerge, &task);
+}
@@ -0,0 +1,187 @@
+/*
+ * broadphase.h
+ *
+ * Uniform grid spatial hash which finds every pair of bodies whose axis
+ * aligned bounding boxes overlap
+ *
+ * Bodies of all types share one grid. Each body emits an entry for every cell
+ * its box touches, and the entries are binned by a hash of their cell with a
+ * parallel radix (counting) sort. A pair is only reported from the cell holding
+ * the minimum corner of the overlap of both boxes so it is found exactly once.
+ * Bodies too large for a cell are kept out of the grid and tested against
+ * every other body
+ *
+ * Floors overlap nearly every box, so they never enter any of the modes and
+ * are swept against the other bodies as planes instead (see planes.h)
+ *
+ * Static bodies never enter the modes either. Their boxes go into a separate
+ * tree built top down, splitting by surface area or at the median, which is
+ * only rebuilt when the static bodies change, and every awake body queries it
+ * for its pairs with static ones
+ *
+ * Scenes can instead use an incremental sweep and prune (see sap.h), which
+ * suits scenes where bodies are packed unevenly or barely move, or a dynamic
+ * tree (see bvh.h), which suits bodies of very different sizes
+ *
+ * Pairs are grouped by (typeA, typeB) with typeA <= typeB so each group can be
+ * dispatched as a single batch through the collision table, and the output is
+ * identical regardless of how many threads built it
+ */
+
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include "bodies.h"
+#include "bvh.h"
+#include "sap.h"
+#include "utils/arena.h"
+#include "utils/pool.h"
+
+// number of unordered pairs of object types
+#define BROADPHASE_GROUPS (OBJECT_TYPES * (OBJECT_TYPES + 1) / 2)
+
+#define BROADPHASE_MODES 3
+#define BROADPHASE_SAH 1  // default for splitting the static tree by surface
+                          // area
+
+extern const char* BROADPHASE_NAMES[BROADPHASE_MODES];
+
+// algorithm which finds the overlapping pairs
+typedef enum
+{
+    BROADPHASE_GRID,
+    BROADPHASE_SAP,
+    BROADPHASE_BVH
+} BroadphaseMode;
+
+// candidate pair of bodies whose boxes overlap
+// a indexes the body store of the group's first type and b the second, with
+// a < b when both types match
+typedef struct BroadphasePair
+{
+    unsigned int a;
+    unsigned int b;
+} BroadphasePair;
+
+// axis aligned bounding box
+// boxes are read at random while pairs are tested, so each is kept in a
+// single cache line rather than split across streams
+typedef struct BroadphaseBox
+{
+    vec3 min;
+    vec3 max;
+} BroadphaseBox;
+
+// pairs found by a single job before they are merged into groups
+typedef struct BroadphaseJob
+{
+    unsigned int count;
+    unsigned int capacity;
+    unsigned int* candidates;  // index of both bodies in their stores then
+                               // the group
+    Arena* arena;              // arena of the thread running the job
+    unsigned int counts[BROADPHASE_GROUPS];  // pairs found in each group, then
+                                             // where the job's pairs go
+} BroadphaseJob;
+
+typedef struct Broadphase
+{
+    BroadphaseMode mode;
+    float cellSize;  // edge length of a cell from the config, 0 to derive it
+                     // from the sizes of the bodies
+    int sah;  // whether the static tree is split by surface area rather than
+              // at the median
+
+    /* BOUNDING BOXES */
+    // every dynamic body is addressed by a flat index with the dynamic bodies
+    // of each type stored contiguously starting at offsets[type], and the
+    // body at offsets[type] is firsts[type] in its store
+    unsigned int offsets[OBJECT_TYPES + 1];
+    unsigned int firsts[OBJECT_TYPES];
+    unsigned int capacity;  // number of bodies the arrays can hold
+    BroadphaseBox* boxes;
+    unsigned char* cells;    // cells touched by each body, 0 if oversized
+    unsigned char* resting;  // whether each body is asleep
+
+    /* GRID */
+    float cell;         // edge length of a cell, 0 until it is next derived
+    unsigned int bits;  // number of bits in a cell's hash
+    unsigned int chunkCapacity;
+    unsigned int* chunkEntries;  // first entry of each chunk of bodies
+    unsigned int entryCount;
+    unsigned int entryCapacity;
+    unsigned long long* keys[2];  // packed cell coordinates of each entry,
+                                  // gathered into the second buffer in order
+                                  // of hash
+    unsigned int* entries[2];     // flat index of the body for each entry
+    unsigned int oversizedCount;
+    unsigned int oversizedCapacity;
+    unsigned int* oversized;  // flat indices of bodies kept out of the grid
+
+    /* SWEEP AND PRUNE */
+    Sap sap;  // endpoints and pairs kept between updates
+
+    /* TREE */
+    Bvh bvh;  // fat boxes of every body, also used for queries
+
+    /* STATIC TREE */
+    // static bodies are addressed by their own flat index, starting from
+    // staticOffsets[type] for each type but floors
+    unsigned int staticOffsets[OBJECT_TYPES + 1];
+    unsigned int staticVersions[OBJECT_TYPES];  // versions of the static
+                                                // bodies the tree holds
+    unsigned int staticCapacity;
+    BroadphaseBox* staticBoxes;
+    Bvh statics;  // exact boxes of the static bodies
+
+    /* PAIR JOBS */
+    // grid jobs scan the cells starting in a range of sorted entries and
+    // oversized jobs scan a range of bodies, tree jobs query the tree with a
+    // range of bodies, and sweep and prune hands all of its pairs to one job
+    // static jobs come after the others and query the static tree with a
+    // range of bodies
+    unsigned int gridJobs;
+    unsigned int staticJobs;
+    unsigned int jobCount;
+    unsigned int jobCapacity;
+    BroadphaseJob* jobs;
+
+    /* PAIRS */
+    unsigned int pairCount;
+    unsigned int pairCapacity;
+    BroadphasePair* pairs;
+    unsigned int groupStarts[BROADPHASE_GROUPS + 1];  // first pair per group
+    ObjectType groupTypes[BROADPHASE_GROUPS][2];  // types of each group
+} Broadphase;
+
+// initializes an empty broadphase
+void broadphaseInit(Broadphase* bp, BroadphaseMode mode, float cellSize,
+                    int sah);
+
+void broadphaseFree(Broadphase* bp);
+
+// returns the group of pairs between two object types in either order
+unsigned int broadphaseGroup(ObjectType a, ObjectType b);
+
+// returns whether the boxes of two bodies overlap
+int broadphaseOverlap(BroadphaseBox* a, BroadphaseBox* b);
+
+// picks the cell size of the grid from the config, or derives it from the
+// sizes of the dynamic bodies the first time after each invalidation
+// sizes must not include the growth of fast bodies, so this runs before they
+// are grown for a step
+void broadphaseCell(Broadphase* bp, Bodies* bodies);
+
+// drops the sweep, the tree and the derived cell size, which depend on the
+// bodies at each index, after bodies have been added, removed or moved
+void broadphaseInvalidate(Broadphase* bp);
+
+// rebuilds boxes, the grid or sweep, and the grouped pair list from the
+// current state of the bodies, splitting each phase across the pool
+// the static tree is rebuilt first if the static bodies have changed
+// the candidates of each job live in the arenas of the pool and the frame until
+// they are reset
+void broadphaseUpdate(Broadphase* bp, Bodies* bodies, Pool* pool,
+                      Arena* frame);
+
+#endif
@@ -0,0 +1,702 @@
+#include "bvh.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "broadphase.h"
+
+#define BVH_MARGIN 0.1f  // fat box margin relative to the longest box edge
+#define BVH_PREDICT 2.0f  // steps of displacement the fat box is grown by
+#define BVH_SHRINK 4.0f  // largest fat box area relative to a fresh one
+#define BVH_IMBALANCE 8  // largest height difference kept between siblings
+#define BVH_STACK 1024  // traversal stack kept on the call stack
+#define BVH_BINS 16     // bins each axis is split into when building top down
+#define BVH_DEPTH 64    // deepest split found by surface area before building
+                        // the rest of the tree at the median
+
+void bvhInit(Bvh* t)
+{
+    memset(t, 0, sizeof(Bvh));
+    t->root = BVH_NULL;
+    t->freeList = BVH_NULL;
+}
+
+void bvhFree(Bvh* t)
+{
+    free(t->nodes);
+    free(t->leaves);
+    bvhInit(t);
+}
+
+// returns whether a node is a leaf
+int bvhLeaf(BvhNode* node) { return node->children[0] == BVH_NULL; }
+
+// returns the surface area of a box
+float bvhArea(vec3 min, vec3 max)
+{
+    float x = max[0] - min[0], y = max[1] - min[1], z = max[2] - min[2];
+    return 2.0f * (x * y + y * z + z * x);
+}
+
+// returns the surface area of the box enclosing two boxes
+float bvhUnionArea(BvhNode* a, BvhNode* b)
+{
+    vec3 min, max;
+    glm_vec3_minv(a->min, b->min, min);
+    glm_vec3_maxv(a->max, b->max, max);
+    return bvhArea(min, max);
+}
+
+// fits an internal node's box and height to its children
+void bvhRefit(Bvh* t, unsigned int node)
+{
+    BvhNode* n = t->nodes + node;
+    BvhNode* a = t->nodes + n->children[0];
+    BvhNode* b = t->nodes + n->children[1];
+    glm_vec3_minv(a->min, b->min, n->min);
+    glm_vec3_maxv(a->max, b->max, n->max);
+    n->height = 1 + (a->height > b->height ? a->height : b->height);
+}
+
+// takes a node from the free list, growing the node array when it is empty
+unsigned int bvhAllocate(Bvh* t)
+{
+    if (t->freeList == BVH_NULL)
+    {
+        unsigned int old = t->nodeCapacity;
+        t->nodeCapacity = old ? old * 2 : 16;
+        t->nodes = realloc(t->nodes, t->nodeCapacity * sizeof(BvhNode));
+        for (unsigned int node = old; node < t->nodeCapacity; node++)
+        {
+            t->nodes[node].parent = node + 1;
+            t->nodes[node].height = -1;
+        }
+        t->nodes[t->nodeCapacity - 1].parent = BVH_NULL;
+        t->freeList = old;
+    }
+
+    unsigned int node = t->freeList;
+    BvhNode* n = t->nodes + node;
+    t->freeList = n->parent;
+    n->parent = BVH_NULL;
+    n->children[0] = BVH_NULL;
+    n->children[1] = BVH_NULL;
+    n->height = 0;
+    t->nodeCount++;
+    return node;
+}
+
+// returns a node to the free list
+void bvhRelease(Bvh* t, unsigned int node)
+{
+    t->nodes[node].parent = t->freeList;
+    t->nodes[node].height = -1;
+    t->freeList = node;
+    t->nodeCount--;
+}
+
+// lifts one child of a node above it and hands the child's shorter child
+// down in its place, returning the node now at the top
+unsigned int bvhRotate(Bvh* t, unsigned int node, int side)
+{
+    BvhNode* nodes = t->nodes;
+    unsigned int child = nodes[node].children[side];
+    unsigned int taller = nodes[child].children[0];
+    unsigned int shorter = nodes[child].children[1];
+    if (nodes[taller].height < nodes[shorter].height)
+    {
+        unsigned int temp = taller;
+        taller = shorter;
+        shorter = temp;
+    }
+
+    unsigned int parent = nodes[node].parent;
+    nodes[child].parent = parent;
+    if (parent == BVH_NULL)
+    {
+        t->root = child;
+    }
+    else
+    {
+        nodes[parent].children[nodes[parent].children[1] == node] = child;
+    }
+
+    nodes[child].children[0] = node;
+    nodes[child].children[1] = taller;
+    nodes[node].parent = child;
+    nodes[node].children[side] = shorter;
+    nodes[shorter].parent = node;
+
+    bvhRefit(t, node);
+    bvhRefit(t, child);
+    return child;
+}
+
+// swaps a child of a node with a child of the node's other child
+void bvhSwap(Bvh* t, unsigned int node, int side, int grandSide)
+{
+    BvhNode* nodes = t->nodes;
+    unsigned int child = nodes[node].children[side];
+    unsigned int other = nodes[node].children[!side];
+    unsigned int grandchild = nodes[other].children[grandSide];
+
+    nodes[node].children[side] = grandchild;
+    nodes[grandchild].parent = node;
+    nodes[other].children[grandSide] = child;
+    nodes[child].parent = other;
+    bvhRefit(t, other);
+}
+
+// restructures a node whose children were just refit, returning the node now
+// at its place
+// subtrees far out of balance are rotated by height, otherwise a child is
+// swapped with a grandchild when that shrinks the surface area most
+unsigned int bvhBalance(Bvh* t, unsigned int node)
+{
+    BvhNode* nodes = t->nodes;
+    BvhNode* n = nodes + node;
+    if (bvhLeaf(n) || n->height < 2)
+    {
+        return node;
+    }
+
+    int balance =
+        nodes[n->children[1]].height - nodes[n->children[0]].height;
+    if (balance > BVH_IMBALANCE)
+    {
+        return bvhRotate(t, node, 1);
+    }
+    if (balance < -BVH_IMBALANCE)
+    {
+        return bvhRotate(t, node, 0);
+    }
+
+    float best = 0.0f;
+    int bestSide = -1, bestGrandSide = 0;
+    for (int side = 0; side < 2; side++)
+    {
+        BvhNode* child = nodes + n->children[side];
+        BvhNode* other = nodes + n->children[!side];
+        if (bvhLeaf(other))
+        {
+            continue;
+        }
+
+        float area = bvhArea(other->min, other->max);
+        for (int grandSide = 0; grandSide < 2; grandSide++)
+        {
+            // the grandchild moves up and the child takes its place
+            BvhNode* kept = nodes + other->children[!grandSide];
+            float gain = area - bvhUnionArea(child, kept);
+            if (gain > best)
+            {
+                best = gain;
+                bestSide = side;
+                bestGrandSide = grandSide;
+            }
+        }
+    }
+
+    if (bestSide >= 0)
+    {
+        bvhSwap(t, node, bestSide, bestGrandSide);
+    }
+    return node;
+}
+
+// balances and refits every ancestor of a node
+void bvhAscend(Bvh* t, unsigned int node)
+{
+    while (node != BVH_NULL)
+    {
+        node = bvhBalance(t, node);
+        bvhRefit(t, node);
+        node = t->nodes[node].parent;
+    }
+}
+
+// adds a leaf next to the sibling which grows the tree's surface area least
+void bvhInsert(Bvh* t, unsigned int leaf)
+{
+    if (t->root == BVH_NULL)
+    {
+        t->root = leaf;
+        t->nodes[leaf].parent = BVH_NULL;
+        return;
+    }
+
+    BvhNode* nodes = t->nodes;
+    BvhNode* l = nodes + leaf;
+    unsigned int sibling = t->root;
+    while (!bvhLeaf(nodes + sibling))
+    {
+        BvhNode* s = nodes + sibling;
+        float area = bvhArea(s->min, s->max);
+        float combined = bvhUnionArea(s, l);
+
+        // pairing with this node creates a parent enclosing both, while
+        // descending grows this node and every child below it
+        float cost = 2.0f * combined;
+        float inherited = 2.0f * (combined - area);
+        float costs[2];
+        for (int side = 0; side < 2; side++)
+        {
+            BvhNode* c = nodes + s->children[side];
+            costs[side] = bvhUnionArea(c, l) + inherited;
+            if (!bvhLeaf(c))
+            {
+                costs[side] -= bvhArea(c->min, c->max);
+            }
+        }
+
+        if (cost < costs[0] && cost < costs[1])
+        {
+            break;
+        }
+        sibling = s->children[costs[1] < costs[0]];
+    }
+
+    unsigned int parent = bvhAllocate(t);
+    nodes = t->nodes;
+    unsigned int grandparent = nodes[sibling].parent;
+    nodes[parent].parent = grandparent;
+    nodes[parent].children[0] = sibling;
+    nodes[parent].children[1] = leaf;
+    nodes[sibling].parent = parent;
+    nodes[leaf].parent = parent;
+    if (grandparent == BVH_NULL)
+    {
+        t->root = parent;
+    }
+    else
+    {
+        nodes[grandparent].children[nodes[grandparent].children[1] ==
+                                    sibling] = parent;
+    }
+
+    bvhAscend(t, parent);
+}
+
+// detaches a leaf from the tree, releasing its parent
+void bvhRemove(Bvh* t, unsigned int leaf)
+{
+    BvhNode* nodes = t->nodes;
+    if (leaf == t->root)
+    {
+        t->root = BVH_NULL;
+        return;
+    }
+
+    unsigned int parent = nodes[leaf].parent;
+    unsigned int grandparent = nodes[parent].parent;
+    unsigned int sibling =
+        nodes[parent].children[nodes[parent].children[0] == leaf];
+    bvhRelease(t, parent);
+
+    nodes[sibling].parent = grandparent;
+    if (grandparent == BVH_NULL)
+    {
+        t->root = sibling;
+        return;
+    }
+
+    nodes[grandparent].children[nodes[grandparent].children[1] == parent] =
+        sibling;
+    bvhAscend(t, grandparent);
+}
+
+// grows a body's box by the margin and its predicted displacement
+void bvhFatten(Broadphase* bp, Bodies* bodies, unsigned int flat,
+               BvhNode* leaf)
+{
+    BroadphaseBox* box = bp->boxes + flat;
+    float edge = 0.0f;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        edge = fmaxf(edge, box->max[axis] - box->min[axis]);
+    }
+
+    ObjectType type = 0;
+    while (flat >= bp->offsets[type + 1])
+    {
+        type++;
+    }
+    Bodies* b = &bodies[type];
+    unsigned int i = flat - bp->offsets[type] + bp->firsts[type];
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float displacement =
+            BVH_PREDICT * (b->position[axis][i] - b->lastPosition[axis][i]);
+        leaf->min[axis] = box->min[axis] - BVH_MARGIN * edge;
+        leaf->max[axis] = box->max[axis] + BVH_MARGIN * edge;
+        if (displacement < 0.0f)
+        {
+            leaf->min[axis] += displacement;
+        }
+        else
+        {
+            leaf->max[axis] += displacement;
+        }
+    }
+}
+
+// returns whether a leaf's fat box still holds its body's box
+int bvhContains(BvhNode* leaf, BroadphaseBox* box)
+{
+    return leaf->min[0] <= box->min[0] && leaf->min[1] <= box->min[1] &&
+           leaf->min[2] <= box->min[2] && box->max[0] <= leaf->max[0] &&
+           box->max[1] <= leaf->max[1] && box->max[2] <= leaf->max[2];
+}
+
+// chains every existing node back into the free list
+void bvhClear(Bvh* t)
+{
+    t->root = BVH_NULL;
+    t->nodeCount = 0;
+    t->freeList = t->nodeCapacity ? 0 : BVH_NULL;
+    for (unsigned int node = 0; node < t->nodeCapacity; node++)
+    {
+        t->nodes[node].parent =
+            node + 1 < t->nodeCapacity ? node + 1 : BVH_NULL;
+        t->nodes[node].height = -1;
+    }
+}
+
+// discards every node and inserts every body again
+void bvhBuild(Bvh* t, Broadphase* bp, Bodies* bodies)
+{
+    unsigned int count = bp->offsets[OBJECT_TYPES];
+    t->count = count;
+    memcpy(t->offsets, bp->offsets, sizeof(t->offsets));
+    bvhClear(t);
+
+    if (count > t->leafCapacity)
+    {
+        free(t->leaves);
+        t->leaves = malloc(count * sizeof(unsigned int));
+        t->leafCapacity = count;
+    }
+
+    // floors never enter the broadphase, so they have no leaves
+    for (unsigned int flat = bp->offsets[FLOOR + 1]; flat < count; flat++)
+    {
+        unsigned int leaf = bvhAllocate(t);
+        t->nodes[leaf].body = flat;
+        bvhFatten(bp, bodies, flat, t->nodes + leaf);
+        bvhInsert(t, leaf);
+        t->leaves[flat] = leaf;
+    }
+}
+
+void bvhUpdate(Bvh* t, Broadphase* bp, Bodies* bodies)
+{
+    if (t->count != bp->offsets[OBJECT_TYPES] ||
+        memcmp(t->offsets, bp->offsets, sizeof(t->offsets)))
+    {
+        bvhBuild(t, bp, bodies);
+        return;
+    }
+
+    // ancestors already enclose a fat box which still holds its body, so
+    // only escaped bodies move in the tree, along with bodies whose fat box
+    // was grown for motion which has since stopped
+    BvhNode fat;
+    for (unsigned int flat = t->offsets[FLOOR + 1]; flat < t->count; flat++)
+    {
+        BvhNode* leaf = t->nodes + t->leaves[flat];
+        bvhFatten(bp, bodies, flat, &fat);
+        if (bvhContains(leaf, bp->boxes + flat) &&
+            bvhArea(leaf->min, leaf->max) <=
+                BVH_SHRINK * bvhArea(fat.min, fat.max))
+        {
+            continue;
+        }
+
+        bvhRemove(t, t->leaves[flat]);
+        leaf = t->nodes + t->leaves[flat];
+        glm_vec3_copy(fat.min, leaf->min);
+        glm_vec3_copy(fat.max, leaf->max);
+        bvhInsert(t, t->leaves[flat]);
+    }
+}
+
+// state of a top down build
+typedef struct BvhSplit
+{
+    Bvh* t;
+    BroadphaseBox* boxes;
+    vec3* centers;          // center of each box
+    unsigned int* indices;  // boxes in the order they are split
+    int sah;
+} BvhSplit;
+
+// moves the boxes of a range whose centers lie below the middle one on an
+// axis before it and the rest after it
+void bvhMedian(BvhSplit* split, unsigned int first, unsigned int last,
+               unsigned int middle, int axis)
+{
+    unsigned int* indices = split->indices;
+    while (last - first > 1)
+    {
+        // three way partition around the center of the middle box, so runs
+        // of equal centers, which grids of bodies are full of, stay linear
+        float pivot = split->centers[indices[middle]][axis];
+        unsigned int below = first, above = last, k = first;
+        while (k < above)
+        {
+            float center = split->centers[indices[k]][axis];
+            unsigned int other = center < pivot   ? below++
+                                 : center > pivot ? --above
+                                                  : k;
+            unsigned int temp = indices[k];
+            indices[k] = indices[other];
+            indices[other] = temp;
+            k += center <= pivot;
+        }
+
+        if (middle < below)
+        {
+            last = below;
+        }
+        else if (middle >= above)
+        {
+            first = above;
+        }
+        else
+        {
+            return;
+        }
+    }
+}
+
+// returns the bin a center falls in along an axis
+unsigned int bvhBin(vec3 center, vec3 low, float scale, int axis)
+{
+    unsigned int bin = (unsigned int)((center[axis] - low[axis]) * scale);
+    return bin < BVH_BINS ? bin : BVH_BINS - 1;
+}
+
+// finds the bin boundary on any axis which the surface area heuristic prefers
+// and sorts the boxes of a range to either side, returning where the second
+// half starts or 0 if every center lies in the same bin
+unsigned int bvhBins(BvhSplit* split, unsigned int first, unsigned int last,
+                     vec3 low, vec3 high)
+{
+    float best = INFINITY;
+    int bestAxis = -1;
+    unsigned int bestBin = 0;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float extent = high[axis] - low[axis];
+        if (!(extent > 0.0f))
+        {
+            continue;
+        }
+        float scale = BVH_BINS / extent;
+
+        BvhNode bins[BVH_BINS];
+        unsigned int counts[BVH_BINS] = {0};
+        for (unsigned int bin = 0; bin < BVH_BINS; bin++)
+        {
+            glm_vec3_fill(bins[bin].min, INFINITY);
+            glm_vec3_fill(bins[bin].max, -INFINITY);
+        }
+        for (unsigned int k = first; k < last; k++)
+        {
+            unsigned int index = split->indices[k];
+            BroadphaseBox* box = split->boxes + index;
+            BvhNode* bin =
+                bins + bvhBin(split->centers[index], low, scale, axis);
+            glm_vec3_minv(bin->min, box->min, bin->min);
+            glm_vec3_maxv(bin->max, box->max, bin->max);
+            counts[bin - bins]++;
+        }
+
+        // areas and counts of every bin from each boundary up
+        float upperAreas[BVH_BINS];
+        unsigned int upperCounts[BVH_BINS];
+        BvhNode upper = bins[BVH_BINS - 1];
+        unsigned int count = 0;
+        for (unsigned int bin = BVH_BINS - 1; bin > 0; bin--)
+        {
+            glm_vec3_minv(upper.min, bins[bin].min, upper.min);
+            glm_vec3_maxv(upper.max, bins[bin].max, upper.max);
+            count += counts[bin];
+            upperAreas[bin] = bvhArea(upper.min, upper.max);
+            upperCounts[bin] = count;
+        }
+
+        BvhNode lower = bins[0];
+        count = 0;
+        for (unsigned int bin = 1; bin < BVH_BINS; bin++)
+        {
+            glm_vec3_minv(lower.min, bins[bin - 1].min, lower.min);
+            glm_vec3_maxv(lower.max, bins[bin - 1].max, lower.max);
+            count += counts[bin - 1];
+            if (!count || !upperCounts[bin])
+            {
+                continue;
+            }
+
+            float cost = bvhArea(lower.min, lower.max) * count +
+                         upperAreas[bin] * upperCounts[bin];
+            if (cost < best)
+            {
+                best = cost;
+                bestAxis = axis;
+                bestBin = bin;
+            }
+        }
+    }
+
+    if (bestAxis < 0)
+    {
+        return 0;
+    }
+
+    float scale = BVH_BINS / (high[bestAxis] - low[bestAxis]);
+    unsigned int* indices = split->indices;
+    unsigned int middle = first;
+    for (unsigned int k = first; k < last; k++)
+    {
+        if (bvhBin(split->centers[indices[k]], low, scale, bestAxis) <
+            bestBin)
+        {
+            unsigned int temp = indices[k];
+            indices[k] = indices[middle];
+            indices[middle++] = temp;
+        }
+    }
+    return middle;
+}
+
+// builds the subtree of a range of boxes and returns its root
+unsigned int bvhSplit(BvhSplit* split, unsigned int first, unsigned int last,
+                      unsigned int depth)
+{
+    Bvh* t = split->t;
+    if (last - first == 1)
+    {
+        unsigned int leaf = bvhAllocate(t);
+        BroadphaseBox* box = split->boxes + split->indices[first];
+        t->nodes[leaf].body = split->indices[first];
+        glm_vec3_copy(box->min, t->nodes[leaf].min);
+        glm_vec3_copy(box->max, t->nodes[leaf].max);
+        return leaf;
+    }
+
+    vec3 low, high;
+    glm_vec3_copy(split->centers[split->indices[first]], low);
+    glm_vec3_copy(low, high);
+    for (unsigned int k = first + 1; k < last; k++)
+    {
+        glm_vec3_minv(low, split->centers[split->indices[k]], low);
+        glm_vec3_maxv(high, split->centers[split->indices[k]], high);
+    }
+
+    // deep splits fall back to the median, which bounds the height of the
+    // tree well within the traversal stack
+    unsigned int middle = 0;
+    if (split->sah && depth < BVH_DEPTH)
+    {
+        middle = bvhBins(split, first, last, low, high);
+    }
+    if (!middle)
+    {
+        int axis = 0;
+        for (int other = 1; other < 3; other++)
+        {
+            if (high[other] - low[other] > high[axis] - low[axis])
+            {
+                axis = other;
+            }
+        }
+        middle = first + (last - first) / 2;
+        bvhMedian(split, first, last, middle, axis);
+    }
+
+    unsigned int children[2];
+    children[0] = bvhSplit(split, first, middle, depth + 1);
+    children[1] = bvhSplit(split, middle, last, depth + 1);
+    unsigned int node = bvhAllocate(t);
+    for (int side = 0; side < 2; side++)
+    {
+        t->nodes[node].children[side] = children[side];
+        t->nodes[children[side]].parent = node;
+    }
+    bvhRefit(t, node);
+    return node;
+}
+
+void bvhBuildStatic(Bvh* t, Broadphase* bp, Arena* frame)
+{
+    unsigned int count = bp->staticOffsets[OBJECT_TYPES];
+    t->count = count;
+    memcpy(t->offsets, bp->staticOffsets, sizeof(t->offsets));
+    bvhClear(t);
+    if (!count)
+    {
+        return;
+    }
+
+    BvhSplit split = {t, bp->staticBoxes};
+    split.centers = arenaAlloc(frame, count * sizeof(vec3));
+    split.indices = arenaAlloc(frame, count * sizeof(unsigned int));
+    split.sah = bp->sah;
+    for (unsigned int k = 0; k < count; k++)
+    {
+        BroadphaseBox* box = bp->staticBoxes + k;
+        glm_vec3_add(box->min, box->max, split.centers[k]);
+        glm_vec3_scale(split.centers[k], 0.5f, split.centers[k]);
+        split.indices[k] = k;
+    }
+    t->root = bvhSplit(&split, 0, count, 0);
+}
+
+void bvhQuery(Bvh* t, vec3 min, vec3 max, BvhVisit visit, void* data)
+{
+    if (t->root == BVH_NULL)
+    {
+        return;
+    }
+
+    // each level below the root leaves at most one sibling waiting, so only a
+    // tree too tall for the usual stack needs one from the heap
+    unsigned int local[BVH_STACK];
+    unsigned int* stack = local;
+    unsigned int size = t->nodes[t->root].height + 1;
+    if (size > BVH_STACK)
+    {
+        stack = malloc(size * sizeof(unsigned int));
+    }
+
+    unsigned int depth = 0;
+    stack[depth++] = t->root;
+    while (depth > 0)
+    {
+        BvhNode* n = t->nodes + stack[--depth];
+        if (n->min[0] > max[0] || min[0] > n->max[0] || n->min[1] > max[1] ||
+            min[1] > n->max[1] || n->min[2] > max[2] || min[2] > n->max[2])
+        {
+            continue;
+        }
+
+        if (bvhLeaf(n))
+        {
+            if (!visit(data, n->body))
+            {
+                break;
+            }
+            continue;
+        }
+        stack[depth++] = n->children[1];
+        stack[depth++] = n->children[0];
+    }
+
+    if (stack != local)
+    {
+        free(stack);
+    }
+}
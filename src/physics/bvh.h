@@ -0,0 +1,79 @@
+/*
+ * bvh.h
+ *
+ * Dynamic bounding volume hierarchy over the boxes of every body
+ *
+ * Each leaf holds a fat box which is the body's box grown by a margin and by
+ * its displacement over the last step, so a body only has to be reinserted
+ * once it escapes its fat box and bodies of any size share one tree.
+ * Insertion picks the sibling which adds the least surface area, and every
+ * ancestor on the way back up is rotated when that shrinks its surface area
+ * or when its subtrees grow too far apart in height
+ *
+ * Nodes live in one flat array and freed nodes are reused through a free list.
+ * Queries only read the tree, so any number of threads may run them at once
+ *
+ * Bodies which never move are instead built into a tree of their exact boxes
+ * all at once, top down. Each range of boxes is split at the boundary between
+ * bins of their centers which the surface area heuristic prefers, or at the
+ * median center along the longest axis
+ */
+
+#ifndef BVH_H
+#define BVH_H
+
+#include <cglm/cglm.h>
+
+#include "bodies.h"
+#include "utils/arena.h"
+
+#define BVH_NULL 0xFFFFFFFFu  // index of a missing node
+
+typedef struct Broadphase Broadphase;
+
+typedef struct BvhNode
+{
+    vec3 min;
+    vec3 max;
+    unsigned int parent;  // next free node while the node is free
+    unsigned int children[2];  // BVH_NULL for leaves
+    int height;         // 0 for leaves, -1 while the node is free
+    unsigned int body;  // flat index of the body held by a leaf
+} BvhNode;
+
+typedef struct Bvh
+{
+    unsigned int root;
+    unsigned int nodeCount;
+    unsigned int nodeCapacity;
+    BvhNode* nodes;
+    unsigned int freeList;  // first free node
+
+    /* LEAVES */
+    unsigned int count;  // number of bodies the tree was built for
+    unsigned int offsets[OBJECT_TYPES + 1];  // type offsets at the last build
+    unsigned int leafCapacity;
+    unsigned int* leaves;  // leaf node of each body by flat index
+} Bvh;
+
+// called for every leaf whose box a query reaches
+// returns 0 to stop the query early
+typedef int (*BvhVisit)(void* data, unsigned int body);
+
+void bvhInit(Bvh* t);
+
+void bvhFree(Bvh* t);
+
+// reinserts every body which escaped its fat box
+// rebuilds from scratch when bodies have been added or removed
+void bvhUpdate(Bvh* t, Broadphase* bp, Bodies* bodies);
+
+// discards every node and builds a tree of the exact boxes of the static
+// bodies, splitting by surface area if the broadphase asks for it
+// leaves hold the static flat index of their body
+void bvhBuildStatic(Bvh* t, Broadphase* bp, Arena* frame);
+
+// visits every body whose fat box overlaps a box
+void bvhQuery(Bvh* t, vec3 min, vec3 max, BvhVisit visit, void* data);
+
+#endif
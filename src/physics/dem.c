@@ -0,0 +1,708 @@
+#include "dem.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "simd.h"
+
+// number of spheres handed to a worker at a time
+// a multiple of every SIMD width so only the final chunk has a partial packet
+#define DEM_CHUNK 4096
+#define DEM_COORDINATE (1 << 20)  // largest cell coordinate on any axis
+#define DEM_EPSILON 1e-12f  // squared distance below which spheres coincide
+
+// sphere in a bucket of the grid, copied out so searching a bucket reads
+// contiguous memory
+typedef struct DemEntry
+{
+    vec3 position;
+    float radius;
+    unsigned long long key;  // packed coordinates of the cell
+    unsigned int index;      // place in the sphere store
+} DemEntry;
+
+// neighbors found for a chunk of dynamic spheres, from the arena of the
+// worker which searched it
+typedef struct DemList
+{
+    unsigned int count;
+    unsigned int capacity;
+    unsigned int* neighbors;
+} DemList;
+
+// shared state for the per-chunk phases of building lists and evaluating
+// contacts
+typedef struct DemTask
+{
+    Dem* d;
+    Bodies* b;  // spheres
+    unsigned int first;  // first dynamic sphere, since static ones lead
+    float inverseDT;
+    float* moved;   // farthest any sphere of each chunk has moved, squared
+    float* bounds;  // lowest and highest position and largest radius of the
+                    // spheres of each chunk
+
+    /* GRID */
+    float inverseCell;
+    int low[3];             // lowest cell of the bounds
+    unsigned int span[2];   // cells across the bounds along x and y
+    unsigned int bits;      // bits of a bucket
+    unsigned long long* keys;    // cell of each sphere
+    unsigned int* buckets;       // bucket of each sphere
+    unsigned int* bucketStarts;  // first entry of each bucket
+    DemEntry* entries;           // every sphere ordered by bucket
+    DemList* lists;              // neighbors of each chunk
+    Pool* pool;
+
+    /* FLOORS */
+    unsigned int floorCount;
+    BodiesFloor* floors;
+} DemTask;
+
+void demInit(Dem* d, float skin, float stiffness, float damping,
+             float friction, int infinite)
+{
+    memset(d, 0, sizeof(Dem));
+    d->skin = skin;
+    d->stiffness = stiffness;
+    d->damping = damping;
+    d->friction = friction;
+    d->infinite = infinite;
+    d->count = BODIES_NONE;
+}
+
+void demFree(Dem* d)
+{
+    free(d->starts);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        free(d->anchors[axis]);
+    }
+    free(d->neighbors);
+    memset(d, 0, sizeof(Dem));
+}
+
+void demInvalidate(Dem* d) { d->count = BODIES_NONE; }
+
+// finds how far the spheres of a chunk have moved since the lists were built
+void demMoved(void* data, unsigned int first, unsigned int last,
+              unsigned int worker)
+{
+    DemTask* task = data;
+    Bodies* b = task->b;
+
+    for (unsigned int k = first; k < last; k++)
+    {
+        // ranges may span several chunks when the pool runs them inline
+        float* moved = task->moved + k / DEM_CHUNK;
+        if (k % DEM_CHUNK == 0)
+        {
+            *moved = 0.0f;
+        }
+
+        float distance = 0.0f;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float offset =
+                b->position[axis][task->first + k] - task->d->anchors[axis][k];
+            distance += offset * offset;
+        }
+        *moved = distance > *moved ? distance : *moved;
+    }
+}
+
+// finds the bounds of the positions and the largest radius in a chunk of
+// spheres
+void demBounds(void* data, unsigned int first, unsigned int last,
+               unsigned int worker)
+{
+    DemTask* task = data;
+    Bodies* b = task->b;
+
+    for (unsigned int i = first; i < last; i++)
+    {
+        float* bounds = task->bounds + 7 * (i / DEM_CHUNK);
+        int start = i % DEM_CHUNK == 0;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float x = b->position[axis][i];
+            bounds[axis] = start || x < bounds[axis] ? x : bounds[axis];
+            bounds[3 + axis] =
+                start || x > bounds[3 + axis] ? x : bounds[3 + axis];
+        }
+        bounds[6] = start || b->size[i] > bounds[6] ? b->size[i] : bounds[6];
+    }
+}
+
+// returns the cell coordinate containing a single coordinate of a point,
+// leaving room for the cells on either side of it
+int demCoordinate(float x, float inverseCell)
+{
+    float cell = floorf(x * inverseCell);
+    if (cell < -DEM_COORDINATE + 2)
+    {
+        return -DEM_COORDINATE + 2;
+    }
+    if (cell > DEM_COORDINATE - 2)
+    {
+        return DEM_COORDINATE - 2;
+    }
+    return (int)cell;
+}
+
+// finds the cell of a sphere
+void demCell(DemTask* task, unsigned int i, int cell[3])
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        cell[axis] =
+            demCoordinate(task->b->position[axis][i], task->inverseCell);
+    }
+}
+
+// packs the coordinates of a cell into a key, with x in the lowest bits
+unsigned long long demKey(int x, int y, int z)
+{
+    return ((unsigned long long)(z + DEM_COORDINATE) << 42) |
+           ((unsigned long long)(y + DEM_COORDINATE) << 21) |
+           (unsigned long long)(x + DEM_COORDINATE);
+}
+
+// returns the bucket of a cell
+// cells are numbered across the bounds of the spheres with x varying fastest,
+// then y, and wrapped around the buckets, so cells near each other share
+// memory while those far outside the bounds only share buckets
+unsigned int demBucket(DemTask* task, int x, int y, int z)
+{
+    unsigned int cell =
+        (unsigned int)(x - task->low[0]) +
+        task->span[0] * ((unsigned int)(y - task->low[1]) +
+                         task->span[1] * (unsigned int)(z - task->low[2]));
+    return cell & ((1u << task->bits) - 1);
+}
+
+// finds the cell and bucket of each sphere in a chunk
+void demKeys(void* data, unsigned int first, unsigned int last,
+             unsigned int worker)
+{
+    DemTask* task = data;
+
+    for (unsigned int i = first; i < last; i++)
+    {
+        int cell[3];
+        demCell(task, i, cell);
+        task->keys[i] = demKey(cell[0], cell[1], cell[2]);
+        task->buckets[i] = demBucket(task, cell[0], cell[1], cell[2]);
+    }
+}
+
+// appends the spheres within the skin of a sphere to the list of its chunk
+// and returns how many there are
+// spheres of other cells which share a bucket are skipped, so each sphere is
+// only found from its own cell
+unsigned int demSearch(DemTask* task, unsigned int i, DemList* list,
+                       Arena* arena)
+{
+    Bodies* b = task->b;
+    float reach = b->size[i] + task->d->skin;
+    vec3 position = {b->position[0][i], b->position[1][i], b->position[2][i]};
+
+    // every sphere in the surrounding buckets bounds how many are found
+    int cell[3];
+    demCell(task, i, cell);
+    unsigned long long rows[9];
+    unsigned int buckets[9];
+    unsigned int table = 1u << task->bits;
+    unsigned int candidates = 0;
+    for (int row = 0; row < 9; row++)
+    {
+        int y = cell[1] + row % 3 - 1, z = cell[2] + row / 3 - 1;
+        rows[row] = demKey(cell[0] - 1, y, z);
+        buckets[row] = demBucket(task, cell[0] - 1, y, z);
+        for (unsigned int near = 0; near < 3; near++)
+        {
+            unsigned int bucket = (buckets[row] + near) & (table - 1);
+            candidates += task->bucketStarts[bucket + 1] -
+                          task->bucketStarts[bucket];
+        }
+    }
+    if (list->count + candidates > list->capacity)
+    {
+        unsigned int capacity = 2 * list->capacity > list->count + candidates
+                                    ? 2 * list->capacity
+                                    : list->count + candidates;
+        list->neighbors = arenaResize(arena, list->neighbors,
+                                      list->capacity * sizeof(unsigned int),
+                                      capacity * sizeof(unsigned int));
+        list->capacity = capacity;
+    }
+
+    unsigned int found = 0;
+    for (int row = 0; row < 9; row++)
+    {
+        for (unsigned int near = 0; near < 3; near++)
+        {
+            unsigned int bucket = (buckets[row] + near) & (table - 1);
+            for (unsigned int k = task->bucketStarts[bucket];
+                 k < task->bucketStarts[bucket + 1]; k++)
+            {
+                DemEntry* e = task->entries + k;
+                float distance = 0.0f;
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    float offset = e->position[axis] - position[axis];
+                    distance += offset * offset;
+                }
+                float limit = reach + e->radius;
+                if (e->key - rows[row] != near || distance >= limit * limit ||
+                    e->index == i)
+                {
+                    continue;
+                }
+                list->neighbors[list->count + found++] = e->index;
+            }
+        }
+    }
+    list->count += found;
+
+    return found;
+}
+
+// finds the neighbors of a chunk of dynamic spheres, counting them in place of
+// where their lists start, and keeps where the spheres are
+void demFind(void* data, unsigned int first, unsigned int last,
+             unsigned int worker)
+{
+    DemTask* task = data;
+    Dem* d = task->d;
+    Arena* arena = &task->pool->arenas[worker];
+
+    for (unsigned int k = first; k < last; k++)
+    {
+        // ranges may span several chunks when the pool runs them inline
+        DemList* list = task->lists + k / DEM_CHUNK;
+        if (k % DEM_CHUNK == 0)
+        {
+            memset(list, 0, sizeof(DemList));
+        }
+
+        unsigned int i = task->first + k;
+        d->starts[k] = demSearch(task, i, list, arena);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            d->anchors[axis][k] = task->b->position[axis][i];
+        }
+    }
+}
+
+// copies the neighbors of a chunk into their places in the lists
+void demPack(void* data, unsigned int first, unsigned int last,
+             unsigned int worker)
+{
+    DemTask* task = data;
+    Dem* d = task->d;
+
+    for (unsigned int k = first; k < last; k += DEM_CHUNK)
+    {
+        DemList* list = task->lists + k / DEM_CHUNK;
+        memcpy(d->neighbors + d->starts[k], list->neighbors,
+               list->count * sizeof(unsigned int));
+    }
+}
+
+// grows the lists to hold every dynamic sphere
+void demReserve(Dem* d, unsigned int count)
+{
+    if (count + 1 <= d->listCapacity)
+    {
+        return;
+    }
+
+    free(d->starts);
+    d->listCapacity =
+        count + 1 > 2 * d->listCapacity ? count + 1 : 2 * d->listCapacity;
+    d->starts = malloc(d->listCapacity * sizeof(unsigned int));
+    for (int axis = 0; axis < 3; axis++)
+    {
+        free(d->anchors[axis]);
+        d->anchors[axis] = malloc(d->listCapacity * sizeof(float));
+    }
+}
+
+// builds the lists of every dynamic sphere from a grid of every sphere
+void demBuild(Dem* d, DemTask* task, Pool* pool, Arena* frame)
+{
+    Bodies* b = task->b;
+    unsigned int dynamic = b->count - b->staticCount;
+    demReserve(d, dynamic);
+
+    // cells are wide enough that every neighbor lies in an adjacent one
+    unsigned int chunks = (b->count + DEM_CHUNK - 1) / DEM_CHUNK;
+    task->bounds = arenaAlloc(frame, 7 * chunks * sizeof(float));
+    poolFor(pool, b->count, DEM_CHUNK, demBounds, task);
+    float* bounds = task->bounds;
+    for (unsigned int chunk = 1; chunk < chunks; chunk++)
+    {
+        float* other = task->bounds + 7 * chunk;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            bounds[axis] = fminf(bounds[axis], other[axis]);
+            bounds[3 + axis] = fmaxf(bounds[3 + axis], other[3 + axis]);
+        }
+        bounds[6] = fmaxf(bounds[6], other[6]);
+    }
+    task->inverseCell = 1.0f / (2.0f * bounds[6] + d->skin);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        task->low[axis] = demCoordinate(bounds[axis], task->inverseCell);
+    }
+    for (int axis = 0; axis < 2; axis++)
+    {
+        task->span[axis] =
+            demCoordinate(bounds[3 + axis], task->inverseCell) -
+            task->low[axis] + 1;
+    }
+
+    // buckets outnumber the spheres so few cells share one
+    task->bits = 1;
+    while ((1u << task->bits) < 2 * b->count)
+    {
+        task->bits++;
+    }
+    unsigned int table = 1u << task->bits;
+    task->keys = arenaAlloc(frame, b->count * sizeof(unsigned long long));
+    task->buckets = arenaAlloc(frame, b->count * sizeof(unsigned int));
+    task->bucketStarts = arenaAlloc(frame, (table + 1) * sizeof(unsigned int));
+    task->entries = arenaAlloc(frame, b->count * sizeof(DemEntry));
+    poolFor(pool, b->count, DEM_CHUNK, demKeys, task);
+
+    // a single counting sort of the spheres by bucket, which is cheap next to
+    // searching for their neighbors
+    memset(task->bucketStarts, 0, (table + 1) * sizeof(unsigned int));
+    for (unsigned int i = 0; i < b->count; i++)
+    {
+        task->bucketStarts[task->buckets[i] + 1]++;
+    }
+    for (unsigned int bucket = 0; bucket < table; bucket++)
+    {
+        task->bucketStarts[bucket + 1] += task->bucketStarts[bucket];
+    }
+    for (unsigned int i = 0; i < b->count; i++)
+    {
+        DemEntry* e = task->entries + task->bucketStarts[task->buckets[i]]++;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            e->position[axis] = b->position[axis][i];
+        }
+        e->radius = b->size[i];
+        e->key = task->keys[i];
+        e->index = i;
+    }
+    for (unsigned int bucket = table; bucket > 0; bucket--)
+    {
+        task->bucketStarts[bucket] = task->bucketStarts[bucket - 1];
+    }
+    task->bucketStarts[0] = 0;
+
+    // chunks are searched into scratch and then packed after each other
+    task->pool = pool;
+    task->lists = arenaAlloc(
+        frame, (dynamic + DEM_CHUNK - 1) / DEM_CHUNK * sizeof(DemList));
+    poolFor(pool, dynamic, DEM_CHUNK, demFind, task);
+    unsigned int start = 0;
+    for (unsigned int k = 0; k < dynamic; k++)
+    {
+        unsigned int count = d->starts[k];
+        d->starts[k] = start;
+        start += count;
+    }
+    d->starts[dynamic] = start;
+    d->neighborCount = start;
+    if (start > d->neighborCapacity)
+    {
+        free(d->neighbors);
+        d->neighborCapacity =
+            start > 2 * d->neighborCapacity ? start : 2 * d->neighborCapacity;
+        d->neighbors = malloc(d->neighborCapacity * sizeof(unsigned int));
+    }
+    poolFor(pool, dynamic, DEM_CHUNK, demPack, task);
+
+    d->count = b->count;
+    d->staticVersion = b->staticVersion;
+    d->rebuilds++;
+}
+
+// adds the force of a contact to a packet of spheres in the touching lanes
+// the normal points from each sphere towards what it touches, and slip is the
+// velocity of the sphere relative to it
+// the normal force grows with the overlap to the power of 3/2 and is damped
+// by the closing speed, though it never pulls, while friction resists the
+// slip across the normal as a viscous force capped by the Coulomb limit
+void demContact(Dem* d, simdm touching, simdf normal[3], simdf slip[3],
+                simdf overlap, simdf curvature, simdf force[3])
+{
+    const simdf zero = simdSet(0.0f);
+
+    simdf closing = zero;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        closing = simdMulAdd(slip[axis], normal[axis], closing);
+    }
+    simdf width = simdSqrt(simdMul(curvature, simdMax(overlap, zero)));
+    simdf push = simdMul(
+        width, simdMulAdd(simdSet(4.0f / 3.0f * d->stiffness), overlap,
+                          simdMul(simdSet(d->damping), closing)));
+    push = simdSelect(touching, simdMax(push, zero), zero);
+
+    simdf tangent[3];
+    simdf sliding = simdSet(DEM_EPSILON);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        tangent[axis] = simdSub(slip[axis], simdMul(closing, normal[axis]));
+        sliding = simdMulAdd(tangent[axis], tangent[axis], sliding);
+    }
+    simdf grip = simdMin(simdMul(simdSet(d->damping), width),
+                         simdDiv(simdMul(simdSet(d->friction), push),
+                                 simdSqrt(sliding)));
+    grip = simdSelect(touching, grip, zero);
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        force[axis] = simdSub(
+            force[axis], simdMulAdd(normal[axis], push,
+                                    simdMul(tangent[axis], grip)));
+    }
+}
+
+// adds the force of every neighbor of a packet of spheres to theirs
+// lanes which have run out of neighbors pair with themselves and are masked
+void demNeighbors(DemTask* task, unsigned int i, unsigned int lanes,
+                  simdf position[3], simdf velocity[3], simdf radius,
+                  simdf force[3])
+{
+    Dem* d = task->d;
+    Bodies* b = task->b;
+    const simdf zero = simdSet(0.0f);
+
+    unsigned int longest = 0;
+    for (unsigned int lane = 0; lane < lanes; lane++)
+    {
+        unsigned int k = i + lane - task->first;
+        unsigned int count = d->starts[k + 1] - d->starts[k];
+        longest = count > longest ? count : longest;
+    }
+
+    float gathered[8][SIMD_WIDTH];
+    for (unsigned int n = 0; n < longest; n++)
+    {
+        for (unsigned int lane = 0; lane < SIMD_WIDTH; lane++)
+        {
+            unsigned int k = i + lane - task->first;
+            unsigned int j = i;
+            int valid = lane < lanes && d->starts[k] + n < d->starts[k + 1];
+            if (valid)
+            {
+                j = d->neighbors[d->starts[k] + n];
+            }
+            for (int axis = 0; axis < 3; axis++)
+            {
+                gathered[axis][lane] = b->position[axis][j];
+                gathered[3 + axis][lane] = b->lastPosition[axis][j];
+            }
+            gathered[6][lane] = b->size[j];
+            gathered[7][lane] = valid ? 1.0f : 0.0f;
+        }
+
+        simdf normal[3];
+        simdf distance = zero;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            normal[axis] = simdSub(simdLoad(gathered[axis]), position[axis]);
+            distance = simdMulAdd(normal[axis], normal[axis], distance);
+        }
+        simdm apart = simdGt(distance, simdSet(DEM_EPSILON));
+        distance = simdSqrt(simdSelect(apart, distance, simdSet(1.0f)));
+
+        simdf other = simdLoad(gathered[6]);
+        simdf overlap = simdSub(simdAdd(radius, other), distance);
+        simdm touching =
+            simdAnd(simdAnd(apart, simdGt(overlap, zero)),
+                    simdGt(simdLoad(gathered[7]), zero));
+        if (!simdAny(touching))
+        {
+            continue;
+        }
+
+        simdf slip[3];
+        simdf inverse = simdDiv(simdSet(1.0f), distance);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            normal[axis] = simdMul(normal[axis], inverse);
+            simdf speed = simdMul(simdSub(simdLoad(gathered[axis]),
+                                          simdLoad(gathered[3 + axis])),
+                                  simdSet(task->inverseDT));
+            slip[axis] = simdSub(velocity[axis], speed);
+        }
+        simdf curvature =
+            simdDiv(simdMul(radius, other), simdAdd(radius, other));
+        demContact(d, touching, normal, slip, overlap, curvature, force);
+    }
+}
+
+// adds the force of every floor under a packet of spheres to theirs
+void demFloors(DemTask* task, simdf position[3], simdf velocity[3],
+               simdf radius, simdf force[3])
+{
+    const simdf zero = simdSet(0.0f);
+
+    for (unsigned int f = 0; f < task->floorCount; f++)
+    {
+        BodiesFloor* floor = task->floors + f;
+        simdf offset[3], local[3];
+        for (int row = 0; row < 3; row++)
+        {
+            offset[row] = simdSub(position[row], simdSet(floor->position[row]));
+        }
+        for (int axis = 0; axis < 3; axis++)
+        {
+            local[axis] = simdDot(floor->axes[axis], offset[0], offset[1],
+                                  offset[2]);
+        }
+
+        // spheres whose centers have sunk below the plane have fallen through
+        // it, and pushing them back out would launch them
+        simdf overlap = simdSub(radius, local[1]);
+        simdm touching =
+            simdAnd(simdGt(overlap, zero), simdGt(local[1], zero));
+        if (!task->d->infinite)
+        {
+            simdf half = simdSet(floor->half);
+            for (int axis = 0; axis < 3; axis += 2)
+            {
+                simdf across = simdMax(local[axis], simdNeg(local[axis]));
+                touching = simdAnd(touching, simdGt(half, across));
+            }
+        }
+        if (!simdAny(touching))
+        {
+            continue;
+        }
+
+        // a floor is a sphere of unbounded radius, so the radius of curvature
+        // is the sphere's own
+        simdf normal[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            normal[axis] = simdSet(-floor->axes[1][axis]);
+        }
+        demContact(task->d, touching, normal, velocity, overlap, radius,
+                   force);
+    }
+}
+
+// adds the acceleration of every contact to a chunk of dynamic spheres,
+// SIMD_WIDTH at a time
+void demContacts(void* data, unsigned int first, unsigned int last,
+                 unsigned int worker)
+{
+    DemTask* task = data;
+    Bodies* b = task->b;
+    first += task->first;
+    last += task->first;
+
+    for (unsigned int i = first; i < last; i += SIMD_WIDTH)
+    {
+        // the final packet of a range may run past its last sphere
+        unsigned int lanes = last - i < SIMD_WIDTH ? last - i : SIMD_WIDTH;
+        float own[7][SIMD_WIDTH];
+        for (unsigned int lane = 0; lane < SIMD_WIDTH; lane++)
+        {
+            unsigned int j = lane < lanes ? i + lane : i;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                own[axis][lane] = b->position[axis][j];
+                own[3 + axis][lane] = b->lastPosition[axis][j];
+            }
+            own[6][lane] = b->size[j];
+        }
+
+        simdf position[3], velocity[3], force[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            position[axis] = simdLoad(own[axis]);
+            velocity[axis] =
+                simdMul(simdSub(position[axis], simdLoad(own[3 + axis])),
+                        simdSet(task->inverseDT));
+            force[axis] = simdSet(0.0f);
+        }
+        simdf radius = simdLoad(own[6]);
+
+        demNeighbors(task, i, lanes, position, velocity, radius, force);
+        demFloors(task, position, velocity, radius, force);
+
+        // spheres without mass are left alone, as the solvers do
+        float forces[3][SIMD_WIDTH];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            simdStore(forces[axis], force[axis]);
+        }
+        for (unsigned int lane = 0; lane < lanes; lane++)
+        {
+            float mass = b->mass[i + lane];
+            if (mass <= 0.0f)
+            {
+                continue;
+            }
+            for (int axis = 0; axis < 3; axis++)
+            {
+                b->linearAcceleration[axis][i + lane] +=
+                    forces[axis][lane] / mass;
+            }
+        }
+    }
+}
+
+void demUpdate(Dem* d, Bodies* bodies, float dt, Pool* pool, Arena* frame)
+{
+    Bodies* b = &bodies[SPHERE];
+    unsigned int dynamic = b->count - b->staticCount;
+    if (!dynamic)
+    {
+        return;
+    }
+
+    DemTask task;
+    memset(&task, 0, sizeof(DemTask));
+    task.d = d;
+    task.b = b;
+    task.first = b->staticCount;
+    task.inverseDT = 1.0f / dt;
+    unsigned int chunks = (dynamic + DEM_CHUNK - 1) / DEM_CHUNK;
+    task.moved = arenaAlloc(frame, chunks * sizeof(float));
+
+    int rebuild = d->count != b->count || d->staticVersion != b->staticVersion;
+    if (!rebuild)
+    {
+        poolFor(pool, dynamic, DEM_CHUNK, demMoved, &task);
+        float limit = 0.25f * d->skin * d->skin;
+        for (unsigned int chunk = 0; chunk < chunks; chunk++)
+        {
+            rebuild |= task.moved[chunk] > limit;
+        }
+    }
+    if (rebuild)
+    {
+        demBuild(d, &task, pool, frame);
+    }
+
+    Bodies* floors = &bodies[FLOOR];
+    task.floorCount = floors->count;
+    task.floors = arenaAlloc(frame, floors->count * sizeof(BodiesFloor));
+    for (unsigned int f = 0; f < floors->count; f++)
+    {
+        bodiesFloor(floors, f, task.floors + f);
+    }
+
+    poolFor(pool, dynamic, DEM_CHUNK, demContacts, &task);
+}
@@ -0,0 +1,84 @@
+/*
+ * dem.h
+ *
+ * Discrete element dynamics for piles of spheres held apart by soft Hertzian
+ * contacts, an alternative to resolving contacts found by the broadphase
+ *
+ * Every dynamic sphere keeps a list of the spheres within the sum of their
+ * radii plus a skin, stored as compressed sparse rows: the neighbors of all
+ * spheres in one array, and where each sphere's neighbors start in another.
+ * Lists are built from a grid of cells as wide as the largest pair of radii
+ * plus the skin, numbered across the bounds of the spheres and wrapped around
+ * a table of buckets, and are kept until some sphere has moved more than half
+ * the skin since, as no two spheres can have closed the whole skin between
+ * them before then. Each list holds every neighbor of its sphere, so
+ * contacts are evaluated once from either side and no two workers write to
+ * the same sphere
+ *
+ * Overlapping spheres push each other apart with a force growing with the
+ * overlap to the power of 3/2, damped in proportion to their closing speed,
+ * and are pushed off floors the same way. Friction resists their sliding past
+ * each other up to the usual friction coefficient, though it does not spin
+ * them. Contacts only act through the linear accelerations, SIMD_WIDTH
+ * spheres at a time, so the integrator moves the spheres on and nothing is
+ * solved
+ *
+ * Contacts are soft, so steps must be short next to how long two spheres
+ * touch, and stiffer contacts need a higher physics rate. Other types of
+ * bodies are integrated but collide with nothing, and no body falls asleep.
+ * Spheres only rest on a floor while their centers are over it
+ */
+
+#ifndef DEM_H
+#define DEM_H
+
+#include <cglm/cglm.h>
+
+#include "bodies.h"
+#include "utils/arena.h"
+#include "utils/pool.h"
+
+#define DEM_SKIN 0.05f         // default distance spheres may close unseen
+#define DEM_STIFFNESS 1.0e4f   // default effective elastic modulus
+#define DEM_DAMPING 1.0e2f     // default damping of the closing speed
+
+typedef struct Dem
+{
+    float skin;
+    float stiffness;  // effective elastic modulus of every contact
+    float damping;    // force per unit of closing speed and contact width
+    float friction;   // most sliding force per unit of pushing force
+    int infinite;     // whether floors extend past their edges
+
+    /* LISTS */
+    // built over the dynamic spheres, so the list of sphere i is entry
+    // i - staticCount
+    unsigned int count;  // spheres the lists were built for, BODIES_NONE
+                         // when they must be rebuilt
+    unsigned int staticVersion;  // static spheres the lists were built for
+    unsigned int listCapacity;
+    unsigned int* starts;  // first neighbor of each list, then the end
+    float* anchors[3];     // position of each sphere when the lists were built
+    unsigned int neighborCount;
+    unsigned int neighborCapacity;
+    unsigned int* neighbors;  // every neighbor by index in the sphere store
+
+    /* METRICS */
+    unsigned long long rebuilds;  // lists built since initialization
+} Dem;
+
+void demInit(Dem* d, float skin, float stiffness, float damping,
+             float friction, int infinite);
+
+void demFree(Dem* d);
+
+// drops the lists, which refer to spheres by index, after bodies have moved
+// between indices
+void demInvalidate(Dem* d);
+
+// rebuilds the lists once any sphere has moved more than half the skin, then
+// adds the acceleration of every contact to the dynamic spheres
+// must follow the clearing of the linear accelerations within the same step
+void demUpdate(Dem* d, Bodies* bodies, float dt, Pool* pool, Arena* frame);
+
+#endif
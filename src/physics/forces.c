@@ -0,0 +1,464 @@
+#include "forces.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "simd.h"
+
+// number of bodies handed to a worker at a time
+// a multiple of every SIMD width so only the final chunk has a scalar tail
+#define FORCES_CHUNK 4096
+
+const char* FORCE_NAMES[] = {"drag", "attractor", "spring", "wind",
+                             "gravitation"};
+
+// shared state for evaluating the generators over chunks of a single store
+typedef struct ForcesTask
+{
+    Forces* f;
+    Bodies* b;
+    unsigned int first;  // first dynamic body, since static ones lead
+    float dt;
+} ForcesTask;
+
+void forcesInit(Forces* f) { memset(f, 0, sizeof(Forces)); }
+
+void forcesFree(Forces* f)
+{
+    for (unsigned int k = 0; k < f->count; k++)
+    {
+        if (f->forces[k].type == FORCE_WIND)
+        {
+            free(f->forces[k].wind.samples);
+        }
+    }
+    free(f->forces);
+    memset(f, 0, sizeof(Forces));
+}
+
+void forcesAdd(Forces* f, Force* force)
+{
+    if (f->count == f->capacity)
+    {
+        f->capacity = f->capacity ? 2 * f->capacity : 8;
+        f->forces = realloc(f->forces, f->capacity * sizeof(Force));
+    }
+    f->forces[f->count++] = *force;
+}
+
+// finds the velocity of a body from its last position
+void forcesVelocity(Bodies* b, unsigned int i, float inverseDT, vec3 velocity)
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        velocity[axis] =
+            (b->position[axis][i] - b->lastPosition[axis][i]) * inverseDT;
+    }
+}
+
+// drag on a single body, used for the tail of each range
+void forcesDragBody(ForceDrag* d, Bodies* b, float inverseDT, unsigned int i)
+{
+    if (b->mass[i] <= 0.0f)
+    {
+        return;
+    }
+
+    vec3 velocity;
+    forcesVelocity(b, i, inverseDT, velocity);
+    float speed = glm_vec3_norm(velocity);
+    float scale = (d->linear + d->quadratic * speed) / b->mass[i];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        b->linearAcceleration[axis][i] -= velocity[axis] * scale;
+    }
+}
+
+void forcesDrag(ForceDrag* d, Bodies* b, float dt, unsigned int first,
+                unsigned int last)
+{
+    const float inverseDT = 1.0f / dt;
+    const simdf inverseDTs = simdSet(inverseDT);
+    const simdf linear = simdSet(d->linear);
+    const simdf quadratic = simdSet(d->quadratic);
+    const simdf zero = simdSet(0.0f);
+
+    unsigned int i = first;
+    for (; i + SIMD_WIDTH <= last; i += SIMD_WIDTH)
+    {
+        simdf velocity[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            velocity[axis] =
+                simdMul(simdSub(simdLoad(b->position[axis] + i),
+                                simdLoad(b->lastPosition[axis] + i)),
+                        inverseDTs);
+        }
+        simdf speed = simdSqrt(simdMulAdd(
+            velocity[0], velocity[0],
+            simdMulAdd(velocity[1], velocity[1],
+                       simdMul(velocity[2], velocity[2]))));
+
+        // bodies without mass are left alone, as the solvers do
+        simdf mass = simdLoad(b->mass + i);
+        simdf scale = simdSelect(
+            simdGt(mass, zero),
+            simdDiv(simdMulAdd(quadratic, speed, linear), mass), zero);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            simdf acceleration = simdLoad(b->linearAcceleration[axis] + i);
+            simdStore(b->linearAcceleration[axis] + i,
+                      simdSub(acceleration, simdMul(velocity[axis], scale)));
+        }
+    }
+
+    for (; i < last; i++)
+    {
+        forcesDragBody(d, b, inverseDT, i);
+    }
+}
+
+// pull of an attractor on a single body, used for the tail of each range
+void forcesAttractorBody(ForceAttractor* a, Bodies* b, unsigned int i)
+{
+    vec3 offset;
+    float distance = a->radius * a->radius;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        offset[axis] = a->position[axis] - b->position[axis][i];
+        distance += offset[axis] * offset[axis];
+    }
+
+    float scale = a->strength / (distance * sqrtf(distance));
+    for (int axis = 0; axis < 3; axis++)
+    {
+        b->linearAcceleration[axis][i] += offset[axis] * scale;
+    }
+}
+
+void forcesAttractor(ForceAttractor* a, Bodies* b, unsigned int first,
+                     unsigned int last)
+{
+    const simdf strength = simdSet(a->strength);
+    const simdf radius = simdSet(a->radius * a->radius);
+
+    unsigned int i = first;
+    for (; i + SIMD_WIDTH <= last; i += SIMD_WIDTH)
+    {
+        simdf offset[3];
+        simdf distance = radius;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            offset[axis] = simdSub(simdSet(a->position[axis]),
+                                   simdLoad(b->position[axis] + i));
+            distance = simdMulAdd(offset[axis], offset[axis], distance);
+        }
+
+        simdf scale =
+            simdDiv(strength, simdMul(distance, simdSqrt(distance)));
+        for (int axis = 0; axis < 3; axis++)
+        {
+            simdf acceleration = simdLoad(b->linearAcceleration[axis] + i);
+            simdStore(b->linearAcceleration[axis] + i,
+                      simdMulAdd(offset[axis], scale, acceleration));
+        }
+    }
+
+    for (; i < last; i++)
+    {
+        forcesAttractorBody(a, b, i);
+    }
+}
+
+void forcesWind(ForceWind* w, vec3 point, vec3 velocity)
+{
+    // cell holding the point and how far across it the point lies
+    unsigned int cell[3];
+    float across[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        unsigned int cells = w->resolution[axis] - 1;
+        float x = (point[axis] - w->low[axis]) /
+                  (w->high[axis] - w->low[axis]) * cells;
+        x = x > 0.0f ? (x < cells ? x : cells) : 0.0f;
+        cell[axis] = (unsigned int)x < cells ? (unsigned int)x : cells - 1;
+        across[axis] = x - cell[axis];
+    }
+
+    glm_vec3_zero(velocity);
+    unsigned int row = w->resolution[0];
+    unsigned int layer = w->resolution[0] * w->resolution[1];
+    for (unsigned int corner = 0; corner < 8; corner++)
+    {
+        float weight = 1.0f;
+        unsigned int sample = 0;
+        unsigned int strides[3] = {1, row, layer};
+        for (int axis = 0; axis < 3; axis++)
+        {
+            unsigned int far = (corner >> axis) & 1;
+            weight *= far ? across[axis] : 1.0f - across[axis];
+            sample += (cell[axis] + far) * strides[axis];
+        }
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            velocity[axis] += weight * w->samples[3 * sample + axis];
+        }
+    }
+}
+
+// samples are looked up per body, so wind has no vector form
+void forcesWindField(ForceWind* w, Bodies* b, float dt, unsigned int first,
+                     unsigned int last)
+{
+    float inverseDT = 1.0f / dt;
+    for (unsigned int i = first; i < last; i++)
+    {
+        if (b->mass[i] <= 0.0f)
+        {
+            continue;
+        }
+
+        vec3 point, air, velocity;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            point[axis] = b->position[axis][i];
+        }
+        forcesWind(w, point, air);
+        forcesVelocity(b, i, inverseDT, velocity);
+
+        float scale = w->drag / b->mass[i];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            b->linearAcceleration[axis][i] +=
+                (air[axis] - velocity[axis]) * scale;
+        }
+    }
+}
+
+// clears and accumulates the accelerations of a chunk of bodies
+void forcesApply(void* data, unsigned int first, unsigned int last,
+                 unsigned int worker)
+{
+    ForcesTask* task = data;
+    Bodies* b = task->b;
+    first += task->first;
+    last += task->first;
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        memset(b->linearAcceleration[axis] + first, 0,
+               (last - first) * sizeof(float));
+    }
+
+    for (unsigned int k = 0; k < task->f->count; k++)
+    {
+        Force* force = task->f->forces + k;
+        switch (force->type)
+        {
+            case FORCE_DRAG:
+                forcesDrag(&force->drag, b, task->dt, first, last);
+                break;
+            case FORCE_ATTRACTOR:
+                forcesAttractor(&force->attractor, b, first, last);
+                break;
+            case FORCE_WIND:
+                forcesWindField(&force->wind, b, task->dt, first, last);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// whether a body is pushed around by forces
+int forcesDynamic(Bodies* b, unsigned int i)
+{
+    return i >= b->staticCount && b->mass[i] > 0.0f;
+}
+
+// pulls the two ends of a spring towards its length at rest
+void forcesSpring(ForceSpring* spring, Bodies* bodies, Sleep* s, float dt)
+{
+    Bodies* a = bodies + spring->a.type;
+    Bodies* b = bodies + spring->b.type;
+    unsigned int i = bodiesFind(a, spring->a);
+    unsigned int j = bodiesFind(b, spring->b);
+    if (i == BODIES_NONE || j == BODIES_NONE)
+    {
+        return;
+    }
+
+    vec3 offset;
+    vec3 velocityA, velocityB;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        offset[axis] = b->position[axis][j] - a->position[axis][i];
+    }
+    float length = glm_vec3_norm(offset);
+    if (length <= 0.0f)
+    {
+        return;
+    }
+    glm_vec3_scale(offset, 1.0f / length, offset);
+    forcesVelocity(a, i, 1.0f / dt, velocityA);
+    forcesVelocity(b, j, 1.0f / dt, velocityB);
+
+    // positive tension pulls the ends together
+    vec3 relative;
+    glm_vec3_sub(velocityB, velocityA, relative);
+    float tension = spring->stiffness * (length - spring->length) +
+                    spring->damping * glm_vec3_dot(relative, offset);
+
+    int dynamicA = forcesDynamic(a, i);
+    int dynamicB = forcesDynamic(b, j);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (dynamicA)
+        {
+            a->linearAcceleration[axis][i] += tension * offset[axis] /
+                                              a->mass[i];
+        }
+        if (dynamicB)
+        {
+            b->linearAcceleration[axis][j] -= tension * offset[axis] /
+                                              b->mass[j];
+        }
+    }
+
+    // a body at rest is woken once the body pulling on it moves, while one
+    // still body does not keep waking the other
+    if (dynamicA && dynamicB)
+    {
+        if (a->sleeping[i] && !b->sleeping[j] && !b->stillSteps[j])
+        {
+            sleepWakeBody(s, bodies, spring->a.type, i);
+        }
+        else if (b->sleeping[j] && !a->sleeping[i] && !a->stillSteps[i])
+        {
+            sleepWakeBody(s, bodies, spring->b.type, j);
+        }
+    }
+}
+
+void forcesUpdate(Forces* f, Bodies* bodies, Sleep* s, float dt, Pool* pool,
+                  Arena* frame)
+{
+    ForcesTask tasks[OBJECT_TYPES];
+    for (int type = 0; type < OBJECT_TYPES; type++)
+    {
+        Bodies* b = bodies + type;
+        tasks[type].f = f;
+        tasks[type].b = b;
+        tasks[type].first = b->staticCount;
+        tasks[type].dt = dt;
+        poolFor(pool, b->count - b->staticCount, FORCES_CHUNK, forcesApply,
+                tasks + type);
+    }
+
+    // springs share bodies, so adding them in parallel would race
+    int gravitation = 0;
+    for (unsigned int k = 0; k < f->count; k++)
+    {
+        if (f->forces[k].type == FORCE_SPRING)
+        {
+            forcesSpring(&f->forces[k].spring, bodies, s, dt);
+        }
+        gravitation |= f->forces[k].type == FORCE_GRAVITATION;
+    }
+
+    f->nbody.interactions = 0;
+    f->nbody.seconds = 0.0;
+    if (!gravitation)
+    {
+        return;
+    }
+    nbodyBuild(&f->nbody, bodies, pool, frame);
+    for (unsigned int k = 0; k < f->count; k++)
+    {
+        if (f->forces[k].type == FORCE_GRAVITATION)
+        {
+            ForceGravitation* g = &f->forces[k].gravitation;
+            nbodyApply(&f->nbody, bodies, g->constant, g->theta, g->radius,
+                       pool, frame);
+        }
+    }
+}
+
+cJSON* forcesToJSON(Force* force, unsigned int a, unsigned int b)
+{
+    cJSON* configForce = cJSON_CreateObject();
+    cJSON_AddStringToObject(configForce, "type", FORCE_NAMES[force->type]);
+
+    switch (force->type)
+    {
+        case FORCE_DRAG:
+            cJSON_AddNumberToObject(configForce, "linear", force->drag.linear);
+            cJSON_AddNumberToObject(configForce, "quadratic",
+                                    force->drag.quadratic);
+            break;
+        case FORCE_ATTRACTOR:
+        {
+            ForceAttractor* attractor = &force->attractor;
+            cJSON* configPosition =
+                cJSON_CreateFloatArray(attractor->position, 3);
+            cJSON_AddItemReferenceToObject(configForce, "position",
+                                           configPosition);
+            cJSON_AddNumberToObject(configForce, "strength",
+                                    attractor->strength);
+            cJSON_AddNumberToObject(configForce, "radius", attractor->radius);
+            break;
+        }
+        case FORCE_SPRING:
+            cJSON_AddNumberToObject(configForce, "a", a);
+            cJSON_AddNumberToObject(configForce, "b", b);
+            cJSON_AddNumberToObject(configForce, "stiffness",
+                                    force->spring.stiffness);
+            cJSON_AddNumberToObject(configForce, "damping",
+                                    force->spring.damping);
+            cJSON_AddNumberToObject(configForce, "length",
+                                    force->spring.length);
+            break;
+        case FORCE_WIND:
+        {
+            ForceWind* w = &force->wind;
+            cJSON* configLow = cJSON_CreateFloatArray(w->low, 3);
+            cJSON_AddItemReferenceToObject(configForce, "low", configLow);
+            cJSON* configHigh = cJSON_CreateFloatArray(w->high, 3);
+            cJSON_AddItemReferenceToObject(configForce, "high", configHigh);
+            int resolution[3];
+            for (int axis = 0; axis < 3; axis++)
+            {
+                resolution[axis] = w->resolution[axis];
+            }
+            cJSON* configResolution = cJSON_CreateIntArray(resolution, 3);
+            cJSON_AddItemReferenceToObject(configForce, "resolution",
+                                           configResolution);
+
+            cJSON* configSamples = cJSON_CreateArray();
+            unsigned int samples =
+                w->resolution[0] * w->resolution[1] * w->resolution[2];
+            for (unsigned int sample = 0; sample < samples; sample++)
+            {
+                cJSON_AddItemToArray(
+                    configSamples,
+                    cJSON_CreateFloatArray(w->samples + 3 * sample, 3));
+            }
+            cJSON_AddItemReferenceToObject(configForce, "samples",
+                                           configSamples);
+            cJSON_AddNumberToObject(configForce, "drag", w->drag);
+            break;
+        }
+        case FORCE_GRAVITATION:
+            cJSON_AddNumberToObject(configForce, "constant",
+                                    force->gravitation.constant);
+            cJSON_AddNumberToObject(configForce, "theta",
+                                    force->gravitation.theta);
+            cJSON_AddNumberToObject(configForce, "radius",
+                                    force->gravitation.radius);
+            break;
+    }
+
+    return configForce;
+}
@@ -0,0 +1,140 @@
+/*
+ * forces.h
+ *
+ * Force generators declared in the config which accelerate bodies every step
+ *
+ * Every step the linear accelerations of the dynamic bodies are cleared and
+ * each generator adds its own into them. Generators acting on every body,
+ * drag, point attractors, and wind fields, run as batched kernels over chunks
+ * of the body streams, one chunk after another through all of them so the
+ * streams of a chunk are only pulled into cache once. Springs act on two
+ * bodies each and are added afterwards on a single thread, and gravitation
+ * between the bodies themselves walks a Barnes-Hut tree (see nbody.h) built
+ * once per step for every such generator
+ *
+ * Uniform gravity is not a generator, since it is the same for every body. It
+ * stays a constant the integrators add along the y axis, so neither a stream
+ * nor a pass over the bodies is spent on it
+ *
+ * Velocities are read from the last positions, which hold the velocity the
+ * next step carries in either dynamics mode. Springs refer to their bodies by
+ * handle, so they follow them through reorders and fall slack once either
+ * body is removed
+ */
+
+#ifndef FORCES_H
+#define FORCES_H
+
+#include <cglm/cglm.h>
+
+#include "bodies.h"
+#include "cJSON.h"
+#include "nbody.h"
+#include "sleep.h"
+#include "utils/arena.h"
+#include "utils/pool.h"
+
+#define FORCE_TYPES 5
+#define FORCES_RADIUS 0.1f  // default softening radius of attractors
+
+extern const char* FORCE_NAMES[FORCE_TYPES];
+
+typedef enum
+{
+    FORCE_DRAG,       // slows bodies down in proportion to their speed
+    FORCE_ATTRACTOR,  // pulls bodies towards a point
+    FORCE_SPRING,     // damped spring between two bodies
+    FORCE_WIND,       // drags bodies along with air sampled on a grid
+    FORCE_GRAVITATION  // pulls every pair of bodies together by their masses
+} ForceType;
+
+typedef struct ForceDrag
+{
+    float linear;     // force per unit of speed
+    float quadratic;  // force per unit of speed squared
+} ForceDrag;
+
+// acceleration of strength / distance squared, softened within the radius so
+// it stays bounded at the point
+typedef struct ForceAttractor
+{
+    vec3 position;
+    float strength;
+    float radius;
+} ForceAttractor;
+
+typedef struct ForceSpring
+{
+    BodiesHandle a;
+    BodiesHandle b;
+    float stiffness;  // force per unit of stretch
+    float damping;    // force per unit of speed along the spring
+    float length;     // length at rest
+} ForceSpring;
+
+// air velocities sampled at the corners of a grid of cells over a box, and
+// clamped to the box outside of it
+typedef struct ForceWind
+{
+    vec3 low;                    // lowest corner of the box
+    vec3 high;                   // highest corner of the box
+    unsigned int resolution[3];  // samples along each axis, at least 2
+    float* samples;  // three floats per sample with x varying fastest, then y
+    float drag;      // force per unit of speed relative to the air
+} ForceWind;
+
+// acceleration of constant * mass / distance squared towards every other
+// body, softened within the radius, where nodes of the tree smaller than
+// theta times their distance pull as a single mass
+typedef struct ForceGravitation
+{
+    float constant;
+    float theta;
+    float radius;
+} ForceGravitation;
+
+typedef struct Force
+{
+    ForceType type;
+    union
+    {
+        ForceDrag drag;
+        ForceAttractor attractor;
+        ForceSpring spring;
+        ForceWind wind;
+        ForceGravitation gravitation;
+    };
+} Force;
+
+typedef struct Forces
+{
+    unsigned int count;
+    unsigned int capacity;
+    Force* forces;
+    Nbody nbody;  // tree shared by every gravitation generator
+} Forces;
+
+void forcesInit(Forces* f);
+
+// releases every generator along with the samples of wind fields
+void forcesFree(Forces* f);
+
+// appends a generator, taking ownership of the samples of a wind field
+void forcesAdd(Forces* f, Force* force);
+
+// samples the air velocity of a wind field at a point by trilinear
+// interpolation
+void forcesWind(ForceWind* w, vec3 point, vec3 velocity);
+
+// clears the linear acceleration of every dynamic body and adds that of every
+// generator
+// a spring wakes the set of a sleeping body while the body at its other end
+// moves
+void forcesUpdate(Forces* f, Bodies* bodies, Sleep* s, float dt, Pool* pool,
+                  Arena* frame);
+
+// writes a generator in the format of the config
+// a and b are the places of a spring's bodies in the saved objects
+cJSON* forcesToJSON(Force* force, unsigned int a, unsigned int b);
+
+#endif
@@ -0,0 +1,700 @@
+#include "gjk.h"
+
+#include <math.h>
+#include <string.h>
+
+#define GJK_ITERATIONS 32  // most support points added by a distance query
+#define GJK_TOLERANCE 1e-4f  // relative progress below which a search stops
+#define GJK_EPSILON 1e-10f  // squared distance relative to the squared size of
+                            // the shapes below which they touch
+#define GJK_SPAN 1e-8f  // relative measure below which a simplex is flat
+#define GJK_EPA_ITERATIONS 32  // most support points added by EPA
+#define GJK_EPA_VERTICES (GJK_EPA_ITERATIONS + 4)
+#define GJK_EPA_FACES 128
+#define GJK_EPA_TOLERANCE 1e-4f  // growth relative to the size of the shapes
+                                 // below which EPA stops
+
+// point of the difference between two shapes
+typedef struct GjkVertex
+{
+    vec3 a;  // vertex of shape a
+    vec3 b;  // vertex of shape b
+    vec3 w;  // a minus b
+    unsigned char indexA;
+    unsigned char indexB;
+} GjkVertex;
+
+// triangle on the boundary of the polytope EPA expands
+typedef struct GjkFace
+{
+    unsigned int vertices[3];  // counterclockwise seen from outside
+    vec3 normal;
+    float distance;  // distance of the face's plane from the origin
+} GjkFace;
+
+void gjkShape(Bodies* b, unsigned int i, float tetrahedron[4][3],
+              GjkShape* shape)
+{
+    bodiesPosition(b, i, shape->position);
+    bodiesRotation(b, i, shape->rotation);
+    float size = b->size[i];
+
+    if (b->type == CUBE)
+    {
+        // corners lie on a sphere of radius size, and bit k of a corner's
+        // index gives its side along axis k
+        float half = size / 1.73205081f;
+        shape->count = 8;
+        for (unsigned int v = 0; v < 8; v++)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                shape->vertices[v][axis] = (v >> axis) & 1 ? half : -half;
+            }
+        }
+        return;
+    }
+
+    if (b->type == TETRAHEDRON)
+    {
+        shape->count = 4;
+        for (int v = 0; v < 4; v++)
+        {
+            glm_vec3_scale(tetrahedron[v], size, shape->vertices[v]);
+        }
+        return;
+    }
+
+    // floors are squares of half side length size in the local xz plane
+    const float signs[4][2] = {
+        {-1.0f, -1.0f}, {1.0f, -1.0f}, {1.0f, 1.0f}, {-1.0f, 1.0f}};
+    shape->count = 4;
+    for (int v = 0; v < 4; v++)
+    {
+        shape->vertices[v][0] = size * signs[v][0];
+        shape->vertices[v][1] = 0.0f;
+        shape->vertices[v][2] = size * signs[v][1];
+    }
+}
+
+// returns the vertex of a shape which lies furthest along a world direction
+unsigned int gjkSupport(GjkShape* shape, vec3 direction)
+{
+    vec3 local;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        local[axis] = shape->rotation[0][axis] * direction[0] +
+                      shape->rotation[1][axis] * direction[1] +
+                      shape->rotation[2][axis] * direction[2];
+    }
+
+    unsigned int best = 0;
+    float furthest = glm_vec3_dot(shape->vertices[0], local);
+    for (unsigned int v = 1; v < shape->count; v++)
+    {
+        float extent = glm_vec3_dot(shape->vertices[v], local);
+        if (extent > furthest)
+        {
+            furthest = extent;
+            best = v;
+        }
+    }
+    return best;
+}
+
+// finds the world position of a vertex of a shape
+void gjkPoint(GjkShape* shape, unsigned int index, vec3 point)
+{
+    float* v = shape->vertices[index];
+    for (int row = 0; row < 3; row++)
+    {
+        point[row] = shape->position[row] + shape->rotation[row][0] * v[0] +
+                     shape->rotation[row][1] * v[1] +
+                     shape->rotation[row][2] * v[2];
+    }
+}
+
+void gjkVertex(GjkShape* a, GjkShape* b, unsigned int indexA,
+               unsigned int indexB, GjkVertex* v)
+{
+    gjkPoint(a, indexA, v->a);
+    gjkPoint(b, indexB, v->b);
+    glm_vec3_sub(v->a, v->b, v->w);
+    v->indexA = indexA;
+    v->indexB = indexB;
+}
+
+// returns the squared radius of the larger shape, which tolerances scale with
+float gjkScale(GjkShape* a, GjkShape* b)
+{
+    float scale = 0.0f;
+    for (unsigned int v = 0; v < a->count; v++)
+    {
+        scale = fmaxf(scale, glm_vec3_norm2(a->vertices[v]));
+    }
+    for (unsigned int v = 0; v < b->count; v++)
+    {
+        scale = fmaxf(scale, glm_vec3_norm2(b->vertices[v]));
+    }
+    return scale;
+}
+
+// reduces a segment to the feature closest to the origin, returning the number
+// of vertices kept and writing their weights
+unsigned int gjkSegment(GjkVertex* s, float* weights)
+{
+    vec3 ab;
+    glm_vec3_sub(s[1].w, s[0].w, ab);
+    float t = -glm_vec3_dot(s[0].w, ab);
+    float length = glm_vec3_norm2(ab);
+    if (t <= 0.0f || length <= 0.0f)
+    {
+        weights[0] = 1.0f;
+        return 1;
+    }
+    if (t >= length)
+    {
+        s[0] = s[1];
+        weights[0] = 1.0f;
+        return 1;
+    }
+
+    weights[0] = 1.0f - t / length;
+    weights[1] = t / length;
+    return 2;
+}
+
+// reduces a triangle to the feature closest to the origin by testing its
+// voronoi regions
+unsigned int gjkTriangle(GjkVertex* s, float* weights)
+{
+    vec3 ab, ac;
+    glm_vec3_sub(s[1].w, s[0].w, ab);
+    glm_vec3_sub(s[2].w, s[0].w, ac);
+
+    float d1 = -glm_vec3_dot(ab, s[0].w);
+    float d2 = -glm_vec3_dot(ac, s[0].w);
+    if (d1 <= 0.0f && d2 <= 0.0f)
+    {
+        weights[0] = 1.0f;
+        return 1;
+    }
+
+    float d3 = -glm_vec3_dot(ab, s[1].w);
+    float d4 = -glm_vec3_dot(ac, s[1].w);
+    if (d3 >= 0.0f && d4 <= d3)
+    {
+        s[0] = s[1];
+        weights[0] = 1.0f;
+        return 1;
+    }
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+    {
+        float t = d1 - d3 > 0.0f ? d1 / (d1 - d3) : 0.0f;
+        weights[0] = 1.0f - t;
+        weights[1] = t;
+        return 2;
+    }
+
+    float d5 = -glm_vec3_dot(ab, s[2].w);
+    float d6 = -glm_vec3_dot(ac, s[2].w);
+    if (d6 >= 0.0f && d5 <= d6)
+    {
+        s[0] = s[2];
+        weights[0] = 1.0f;
+        return 1;
+    }
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+    {
+        float t = d2 - d6 > 0.0f ? d2 / (d2 - d6) : 0.0f;
+        s[1] = s[2];
+        weights[0] = 1.0f - t;
+        weights[1] = t;
+        return 2;
+    }
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+    {
+        float total = (d4 - d3) + (d5 - d6);
+        float t = total > 0.0f ? (d4 - d3) / total : 0.0f;
+        s[0] = s[1];
+        s[1] = s[2];
+        weights[0] = 1.0f - t;
+        weights[1] = t;
+        return 2;
+    }
+
+    // a flat triangle has no inside, so fall back on one of its edges
+    float total = va + vb + vc;
+    if (total <= 0.0f)
+    {
+        return gjkSegment(s, weights);
+    }
+
+    weights[0] = va / total;
+    weights[1] = vb / total;
+    weights[2] = vc / total;
+    return 3;
+}
+
+// reduces a tetrahedron to the closest feature of the faces the origin lies
+// outside of, keeping all four vertices if it lies inside every face
+unsigned int gjkTetrahedron(GjkVertex* s, float* weights)
+{
+    // three vertices of each face followed by the vertex opposite it
+    const unsigned int faces[4][4] = {
+        {0, 1, 2, 3}, {0, 3, 1, 2}, {0, 2, 3, 1}, {1, 3, 2, 0}};
+
+    // the sides of a flat tetrahedron's faces mean nothing, so every face is
+    // tested
+    vec3 e1, e2, e3, normal;
+    glm_vec3_sub(s[1].w, s[0].w, e1);
+    glm_vec3_sub(s[2].w, s[0].w, e2);
+    glm_vec3_sub(s[3].w, s[0].w, e3);
+    glm_vec3_cross(e1, e2, normal);
+    float volume = glm_vec3_dot(normal, e3);
+    int flat = volume * volume <= GJK_SPAN * glm_vec3_norm2(e1) *
+                                      glm_vec3_norm2(e2) * glm_vec3_norm2(e3);
+
+    float best = INFINITY;
+    GjkVertex kept[3];
+    float keptWeights[3];
+    unsigned int keptCount = 0;
+    for (int face = 0; face < 4; face++)
+    {
+        vec3 opposite;
+        glm_vec3_sub(s[faces[face][1]].w, s[faces[face][0]].w, e1);
+        glm_vec3_sub(s[faces[face][2]].w, s[faces[face][0]].w, e2);
+        glm_vec3_cross(e1, e2, normal);
+        glm_vec3_sub(s[faces[face][3]].w, s[faces[face][0]].w, opposite);
+        if (!flat && -glm_vec3_dot(normal, s[faces[face][0]].w) *
+                             glm_vec3_dot(normal, opposite) >
+                         0.0f)
+        {
+            continue;
+        }
+
+        GjkVertex triangle[3] = {s[faces[face][0]], s[faces[face][1]],
+                                 s[faces[face][2]]};
+        float triangleWeights[3];
+        unsigned int count = gjkTriangle(triangle, triangleWeights);
+        vec3 closest = {0.0f, 0.0f, 0.0f};
+        for (unsigned int k = 0; k < count; k++)
+        {
+            glm_vec3_muladds(triangle[k].w, triangleWeights[k], closest);
+        }
+
+        float distance = glm_vec3_norm2(closest);
+        if (distance < best)
+        {
+            best = distance;
+            keptCount = count;
+            memcpy(kept, triangle, count * sizeof(GjkVertex));
+            memcpy(keptWeights, triangleWeights, count * sizeof(float));
+        }
+    }
+
+    if (keptCount == 0)
+    {
+        return 4;
+    }
+
+    memcpy(s, kept, keptCount * sizeof(GjkVertex));
+    memcpy(weights, keptWeights, keptCount * sizeof(float));
+    return keptCount;
+}
+
+// reduces a simplex to the smallest one holding its closest point to the
+// origin, returning the number of vertices kept
+unsigned int gjkReduce(GjkVertex* s, unsigned int count, float* weights)
+{
+    if (count == 4)
+    {
+        return gjkTetrahedron(s, weights);
+    }
+    if (count == 3)
+    {
+        return gjkTriangle(s, weights);
+    }
+    if (count == 2)
+    {
+        return gjkSegment(s, weights);
+    }
+    weights[0] = 1.0f;
+    return 1;
+}
+
+// blends the vertices of a simplex by their weights
+void gjkClosest(GjkVertex* s, unsigned int count, float* weights,
+                vec3 closest, vec3 pointA, vec3 pointB)
+{
+    glm_vec3_zero(closest);
+    glm_vec3_zero(pointA);
+    glm_vec3_zero(pointB);
+    for (unsigned int k = 0; k < count; k++)
+    {
+        glm_vec3_muladds(s[k].w, weights[k], closest);
+        glm_vec3_muladds(s[k].a, weights[k], pointA);
+        glm_vec3_muladds(s[k].b, weights[k], pointB);
+    }
+}
+
+float gjkDistance(GjkShape* a, GjkShape* b, GjkSimplex* simplex, vec3 pointA,
+                  vec3 pointB)
+{
+    GjkVertex s[4];
+    unsigned int count = simplex->count;
+    for (unsigned int k = 0; k < count; k++)
+    {
+        gjkVertex(a, b, simplex->a[k], simplex->b[k], s + k);
+    }
+
+    // without a cached simplex, start from the vertices which lie furthest
+    // towards the other shape's center
+    if (count == 0)
+    {
+        vec3 direction, reversed;
+        glm_vec3_sub(b->position, a->position, direction);
+        glm_vec3_negate_to(direction, reversed);
+        gjkVertex(a, b, gjkSupport(a, direction), gjkSupport(b, reversed), s);
+        count = 1;
+    }
+
+    float scale = gjkScale(a, b);
+    float weights[4];
+    vec3 closest;
+    float distance = INFINITY;
+    int overlap = 0;
+    for (unsigned int iteration = 0; iteration < GJK_ITERATIONS; iteration++)
+    {
+        count = gjkReduce(s, count, weights);
+        if (count == 4)
+        {
+            overlap = 1;
+            break;
+        }
+
+        float last = distance;
+        gjkClosest(s, count, weights, closest, pointA, pointB);
+        distance = glm_vec3_norm2(closest);
+        if (distance <= GJK_EPSILON * scale)
+        {
+            overlap = 1;
+            break;
+        }
+
+        // only rounding keeps the closest point from approaching the origin
+        if (distance >= last)
+        {
+            break;
+        }
+
+        vec3 direction;
+        glm_vec3_negate_to(closest, direction);
+        GjkVertex* next = s + count;
+        gjkVertex(a, b, gjkSupport(a, direction), gjkSupport(b, closest),
+                  next);
+
+        // stop once the new vertex is already part of the simplex or brings
+        // it no closer to the origin
+        int repeated = 0;
+        for (unsigned int k = 0; k < count; k++)
+        {
+            repeated |= s[k].indexA == next->indexA &&
+                        s[k].indexB == next->indexB;
+        }
+        if (repeated ||
+            distance - glm_vec3_dot(closest, next->w) <=
+                GJK_TOLERANCE * distance)
+        {
+            break;
+        }
+        count++;
+    }
+
+    simplex->count = count;
+    for (unsigned int k = 0; k < count; k++)
+    {
+        simplex->a[k] = s[k].indexA;
+        simplex->b[k] = s[k].indexB;
+    }
+    return overlap ? 0.0f : sqrtf(distance);
+}
+
+// grows a simplex into a tetrahedron by adding support points along directions
+// it does not span yet, returning 0 if the shapes are too flat to enclose
+// any volume
+int gjkExpand(GjkShape* a, GjkShape* b, GjkVertex* s, unsigned int* count,
+              float scale)
+{
+    while (*count < 4)
+    {
+        vec3 directions[6];
+        unsigned int directionCount = 0;
+        vec3 e1, e2;
+        if (*count == 1)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                glm_vec3_zero(directions[2 * axis]);
+                directions[2 * axis][axis] = 1.0f;
+                glm_vec3_negate_to(directions[2 * axis],
+                                   directions[2 * axis + 1]);
+            }
+            directionCount = 6;
+        }
+        else if (*count == 2)
+        {
+            // directions perpendicular to the segment
+            glm_vec3_sub(s[1].w, s[0].w, e1);
+            int least = 0;
+            for (int axis = 1; axis < 3; axis++)
+            {
+                if (fabsf(e1[axis]) < fabsf(e1[least]))
+                {
+                    least = axis;
+                }
+            }
+            vec3 unit = {0.0f, 0.0f, 0.0f};
+            unit[least] = 1.0f;
+            glm_vec3_cross(e1, unit, directions[0]);
+            glm_vec3_cross(e1, directions[0], directions[2]);
+            glm_vec3_negate_to(directions[0], directions[1]);
+            glm_vec3_negate_to(directions[2], directions[3]);
+            directionCount = 4;
+        }
+        else
+        {
+            glm_vec3_sub(s[1].w, s[0].w, e1);
+            glm_vec3_sub(s[2].w, s[0].w, e2);
+            glm_vec3_cross(e1, e2, directions[0]);
+            glm_vec3_negate_to(directions[0], directions[1]);
+            directionCount = 2;
+        }
+
+        int added = 0;
+        for (unsigned int d = 0; d < directionCount && !added; d++)
+        {
+            vec3 reversed;
+            glm_vec3_negate_to(directions[d], reversed);
+            GjkVertex* next = s + *count;
+            gjkVertex(a, b, gjkSupport(a, directions[d]),
+                      gjkSupport(b, reversed), next);
+
+            // the new vertex must leave the span of the simplex
+            vec3 e3, cross;
+            glm_vec3_sub(next->w, s[0].w, e3);
+            if (*count == 1)
+            {
+                added = glm_vec3_norm2(e3) > GJK_SPAN * scale;
+            }
+            else if (*count == 2)
+            {
+                glm_vec3_cross(e1, e3, cross);
+                added = glm_vec3_norm2(cross) > GJK_SPAN * scale * scale;
+            }
+            else
+            {
+                float volume = glm_vec3_dot(directions[0], e3);
+                added = volume * volume > GJK_SPAN * scale * scale * scale;
+            }
+        }
+
+        if (!added)
+        {
+            return 0;
+        }
+        (*count)++;
+    }
+    return 1;
+}
+
+void gjkFace(GjkVertex* vertices, unsigned int i, unsigned int j,
+             unsigned int k, GjkFace* face)
+{
+    face->vertices[0] = i;
+    face->vertices[1] = j;
+    face->vertices[2] = k;
+
+    vec3 e1, e2;
+    glm_vec3_sub(vertices[j].w, vertices[i].w, e1);
+    glm_vec3_sub(vertices[k].w, vertices[i].w, e2);
+    glm_vec3_cross(e1, e2, face->normal);
+    float length = glm_vec3_norm(face->normal);
+
+    // a face without area is never expanded
+    if (length <= 0.0f)
+    {
+        face->distance = INFINITY;
+        return;
+    }
+    glm_vec3_scale(face->normal, 1.0f / length, face->normal);
+    face->distance = glm_vec3_dot(face->normal, vertices[i].w);
+}
+
+// adds an edge around the hole left by removed faces, or drops it if the face
+// on its other side was removed too
+void gjkEdge(unsigned int edges[][2], unsigned int* edgeCount, unsigned int i,
+             unsigned int j)
+{
+    for (unsigned int e = 0; e < *edgeCount; e++)
+    {
+        if (edges[e][0] == j && edges[e][1] == i)
+        {
+            (*edgeCount)--;
+            edges[e][0] = edges[*edgeCount][0];
+            edges[e][1] = edges[*edgeCount][1];
+            return;
+        }
+    }
+    edges[*edgeCount][0] = i;
+    edges[*edgeCount][1] = j;
+    (*edgeCount)++;
+}
+
+int gjkPenetration(GjkShape* a, GjkShape* b, GjkSimplex* simplex, vec3 normal,
+                   float* depth, vec3 pointA, vec3 pointB)
+{
+    float scale = gjkScale(a, b);
+    GjkVertex vertices[GJK_EPA_VERTICES];
+    unsigned int vertexCount = simplex->count;
+    for (unsigned int k = 0; k < vertexCount; k++)
+    {
+        gjkVertex(a, b, simplex->a[k], simplex->b[k], vertices + k);
+    }
+    if (vertexCount == 0 ||
+        !gjkExpand(a, b, vertices, &vertexCount, scale))
+    {
+        return 0;
+    }
+
+    // order the tetrahedron so its first face points away from the last
+    // vertex, which makes every face below point outwards
+    vec3 e1, e2, e3, cross;
+    glm_vec3_sub(vertices[1].w, vertices[0].w, e1);
+    glm_vec3_sub(vertices[2].w, vertices[0].w, e2);
+    glm_vec3_sub(vertices[3].w, vertices[0].w, e3);
+    glm_vec3_cross(e1, e2, cross);
+    if (glm_vec3_dot(cross, e3) > 0.0f)
+    {
+        GjkVertex temp = vertices[1];
+        vertices[1] = vertices[2];
+        vertices[2] = temp;
+    }
+
+    GjkFace faces[GJK_EPA_FACES];
+    const unsigned int start[4][3] = {{0, 1, 2}, {0, 3, 1}, {1, 3, 2},
+                                      {0, 2, 3}};
+    unsigned int faceCount = 4;
+    for (int face = 0; face < 4; face++)
+    {
+        gjkFace(vertices, start[face][0], start[face][1], start[face][2],
+                faces + face);
+    }
+
+    // push the face closest to the origin outwards until the boundary of the
+    // difference is reached
+    GjkFace best = faces[0];
+    float tolerance = GJK_EPA_TOLERANCE * sqrtf(scale);
+    for (unsigned int iteration = 0; iteration < GJK_EPA_ITERATIONS;
+         iteration++)
+    {
+        best = faces[0];
+        for (unsigned int face = 1; face < faceCount; face++)
+        {
+            if (faces[face].distance < best.distance)
+            {
+                best = faces[face];
+            }
+        }
+
+        vec3 reversed;
+        glm_vec3_negate_to(best.normal, reversed);
+        GjkVertex* next = vertices + vertexCount;
+        gjkVertex(a, b, gjkSupport(a, best.normal), gjkSupport(b, reversed),
+                  next);
+        if (glm_vec3_dot(next->w, best.normal) - best.distance <= tolerance)
+        {
+            break;
+        }
+
+        // remove every face the new vertex sees, keeping the edges around
+        // the hole they leave
+        unsigned int edges[3 * GJK_EPA_FACES][2];
+        unsigned int edgeCount = 0;
+        for (unsigned int face = 0; face < faceCount;)
+        {
+            vec3 offset;
+            glm_vec3_sub(next->w, vertices[faces[face].vertices[0]].w, offset);
+            if (glm_vec3_dot(faces[face].normal, offset) <= 0.0f)
+            {
+                face++;
+                continue;
+            }
+
+            for (int e = 0; e < 3; e++)
+            {
+                gjkEdge(edges, &edgeCount, faces[face].vertices[e],
+                        faces[face].vertices[(e + 1) % 3]);
+            }
+            faces[face] = faces[--faceCount];
+        }
+
+        // close the hole with faces fanning out from the new vertex
+        if (faceCount + edgeCount > GJK_EPA_FACES)
+        {
+            break;
+        }
+        for (unsigned int e = 0; e < edgeCount; e++)
+        {
+            gjkFace(vertices, edges[e][0], edges[e][1], vertexCount,
+                    faces + faceCount++);
+        }
+        vertexCount++;
+    }
+
+    if (best.distance == INFINITY)
+    {
+        return 0;
+    }
+
+    // the deepest points blend the face's vertices by the barycentric
+    // coordinates of the origin's projection onto it
+    GjkVertex* u = vertices + best.vertices[0];
+    GjkVertex* v = vertices + best.vertices[1];
+    GjkVertex* w = vertices + best.vertices[2];
+    vec3 projection, offset;
+    glm_vec3_scale(best.normal, best.distance, projection);
+    glm_vec3_sub(v->w, u->w, e1);
+    glm_vec3_sub(w->w, u->w, e2);
+    glm_vec3_sub(projection, u->w, offset);
+    float d00 = glm_vec3_dot(e1, e1), d01 = glm_vec3_dot(e1, e2),
+          d11 = glm_vec3_dot(e2, e2), d20 = glm_vec3_dot(offset, e1),
+          d21 = glm_vec3_dot(offset, e2);
+    float denominator = d00 * d11 - d01 * d01;
+    float weights[3] = {1.0f, 0.0f, 0.0f};
+    if (denominator > 0.0f)
+    {
+        weights[1] = (d11 * d20 - d01 * d21) / denominator;
+        weights[2] = (d00 * d21 - d01 * d20) / denominator;
+        weights[0] = 1.0f - weights[1] - weights[2];
+    }
+
+    glm_vec3_zero(pointA);
+    glm_vec3_zero(pointB);
+    GjkVertex* corners[3] = {u, v, w};
+    for (int k = 0; k < 3; k++)
+    {
+        glm_vec3_muladds(corners[k]->a, weights[k], pointA);
+        glm_vec3_muladds(corners[k]->b, weights[k], pointB);
+    }
+
+    glm_vec3_copy(best.normal, normal);
+    *depth = fmaxf(best.distance, 0.0f);
+    return 1;
+}
@@ -0,0 +1,55 @@
+/*
+ * gjk.h
+ *
+ * GJK distance and intersection tests with EPA penetration depth for convex
+ * bodies described by their vertices
+ *
+ * Support points come from the same local vertex sets the meshes are built
+ * from, so collisions follow the rendered shapes exactly. The simplex a query
+ * ends with is kept as pairs of vertex indices, which can be handed back on
+ * the next step to start from last step's answer, so resting pairs usually
+ * finish within a couple of iterations
+ */
+
+#ifndef GJK_H
+#define GJK_H
+
+#include <cglm/cglm.h>
+
+#include "bodies.h"
+
+// convex body given by its vertices in the body's local frame
+typedef struct GjkShape
+{
+    vec3 position;
+    float rotation[3][3];  // rotation matrix indexed by row then column
+    unsigned int count;
+    vec3 vertices[8];
+} GjkShape;
+
+// vertices of a simplex as indices into the vertices of both shapes
+typedef struct GjkSimplex
+{
+    unsigned char count;  // 0 when there is nothing to start from
+    unsigned char a[4];
+    unsigned char b[4];
+} GjkSimplex;
+
+// builds the shape of a floor, cube, or tetrahedron
+// tetrahedron holds the corners of a tetrahedron of size 1
+void gjkShape(Bodies* b, unsigned int i, float tetrahedron[4][3],
+              GjkShape* shape);
+
+// returns the distance between two shapes, or 0 when they overlap, starting
+// from a simplex which is replaced by the one the search ends with
+// writes the closest point of each shape when they are apart
+float gjkDistance(GjkShape* a, GjkShape* b, GjkSimplex* simplex, vec3 pointA,
+                  vec3 pointB);
+
+// finds how far two overlapping shapes must move apart along a normal pointing
+// from a towards b, starting from the simplex gjkDistance ended with
+// writes the deepest point of each shape and returns 0 if no depth was found
+int gjkPenetration(GjkShape* a, GjkShape* b, GjkSimplex* simplex, vec3 normal,
+                   float* depth, vec3 pointA, vec3 pointB);
+
+#endif
@@ -0,0 +1,195 @@
+#include "integrate.h"
+
+#include <math.h>
+
+#include "simd.h"
+
+// set in the lanes of bodies which are awake
+simdm integrateAwake(Bodies* b, unsigned int i)
+{
+    return simdZeroFlags(b->sleeping + i);
+}
+
+// Verlet step for a single body, used for the tail of each range
+void integrateLinearBody(Bodies* b, float gravity, float dt2, unsigned int i)
+{
+    if (b->sleeping[i])
+    {
+        return;
+    }
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float acceleration = b->linearAcceleration[axis][i];
+        if (axis == 1)
+        {
+            acceleration += gravity;
+        }
+
+        float position = b->position[axis][i];
+        float deltaPosition = position - b->lastPosition[axis][i];
+        b->lastPosition[axis][i] = position;
+        b->position[axis][i] = position + (deltaPosition + acceleration * dt2);
+    }
+}
+
+void integrateLinear(Bodies* b, float gravity, float dt, unsigned int first,
+                     unsigned int last)
+{
+    const float dt2 = dt * dt;
+    const simdf dt2s = simdSet(dt2);
+    const simdf gravitys = simdSet(gravity);
+
+    unsigned int i = first;
+    for (; i + SIMD_WIDTH <= last; i += SIMD_WIDTH)
+    {
+        simdm dynamic = integrateAwake(b, i);
+        if (!simdAny(dynamic))
+        {
+            continue;
+        }
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            simdf position = simdLoad(b->position[axis] + i);
+            simdf lastPosition = simdLoad(b->lastPosition[axis] + i);
+            simdf acceleration = simdLoad(b->linearAcceleration[axis] + i);
+            if (axis == 1)
+            {
+                acceleration = simdAdd(acceleration, gravitys);
+            }
+
+            simdf deltaPosition = simdSub(position, lastPosition);
+            simdf next = simdAdd(
+                position, simdAdd(deltaPosition, simdMul(acceleration, dt2s)));
+
+            simdStore(b->lastPosition[axis] + i,
+                      simdSelect(dynamic, position, lastPosition));
+            simdStore(b->position[axis] + i,
+                      simdSelect(dynamic, next, position));
+        }
+    }
+
+    for (; i < last; i++)
+    {
+        integrateLinearBody(b, gravity, dt2, i);
+    }
+}
+
+// angular step for a single body, used for the tail of each range
+void integrateAngularBody(Bodies* b, float dt, unsigned int i)
+{
+    if (b->sleeping[i])
+    {
+        return;
+    }
+
+    float w[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        b->angularVelocity[axis][i] += b->angularAcceleration[axis][i] * dt;
+        w[axis] = b->angularVelocity[axis][i];
+    }
+
+    // rotation by |w| * dt about w expressed as a quaternion
+    float speed = sqrtf(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+    float halfAngle = 0.5f * speed * dt;
+    float scale = speed > 0.0f ? sinf(halfAngle) / speed : 0.0f;
+    float dx = w[0] * scale;
+    float dy = w[1] * scale;
+    float dz = w[2] * scale;
+    float dw = cosf(halfAngle);
+
+    float qx = b->orientation[0][i];
+    float qy = b->orientation[1][i];
+    float qz = b->orientation[2][i];
+    float qw = b->orientation[3][i];
+
+    float x = dw * qx + dx * qw + dy * qz - dz * qy;
+    float y = dw * qy - dx * qz + dy * qw + dz * qx;
+    float z = dw * qz + dx * qy - dy * qx + dz * qw;
+    float r = dw * qw - dx * qx - dy * qy - dz * qz;
+
+    float norm = sqrtf(x * x + y * y + z * z + r * r);
+    b->orientation[0][i] = x / norm;
+    b->orientation[1][i] = y / norm;
+    b->orientation[2][i] = z / norm;
+    b->orientation[3][i] = r / norm;
+}
+
+void integrateAngular(Bodies* b, float dt, unsigned int first,
+                      unsigned int last)
+{
+    const simdf dts = simdSet(dt);
+    const simdf halfDts = simdSet(0.5f * dt);
+    const simdf zero = simdSet(0.0f);
+
+    unsigned int i = first;
+    for (; i + SIMD_WIDTH <= last; i += SIMD_WIDTH)
+    {
+        simdm dynamic = integrateAwake(b, i);
+        if (!simdAny(dynamic))
+        {
+            continue;
+        }
+
+        simdf w[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            simdf velocity = simdLoad(b->angularVelocity[axis] + i);
+            simdf acceleration = simdLoad(b->angularAcceleration[axis] + i);
+            w[axis] = simdSelect(
+                dynamic, simdMulAdd(acceleration, dts, velocity), velocity);
+            simdStore(b->angularVelocity[axis] + i, w[axis]);
+        }
+
+        // rotation by |w| * dt about w expressed as a quaternion
+        simdf speed = simdSqrt(simdMulAdd(
+            w[0], w[0], simdMulAdd(w[1], w[1], simdMul(w[2], w[2]))));
+        simdf sinHalf, cosHalf;
+        simdSinCos(simdMul(speed, halfDts), &sinHalf, &cosHalf);
+        simdf scale = simdSelect(simdGt(speed, zero),
+                                 simdDiv(sinHalf, speed), zero);
+        simdf dx = simdMul(w[0], scale);
+        simdf dy = simdMul(w[1], scale);
+        simdf dz = simdMul(w[2], scale);
+        simdf dw = cosHalf;
+
+        simdf qx = simdLoad(b->orientation[0] + i);
+        simdf qy = simdLoad(b->orientation[1] + i);
+        simdf qz = simdLoad(b->orientation[2] + i);
+        simdf qw = simdLoad(b->orientation[3] + i);
+
+        // Hamilton product of the rotation with the current orientation
+        simdf q[4];
+        q[0] = simdSub(simdAdd(simdAdd(simdMul(dw, qx), simdMul(dx, qw)),
+                               simdMul(dy, qz)),
+                       simdMul(dz, qy));
+        q[1] = simdAdd(simdAdd(simdSub(simdMul(dw, qy), simdMul(dx, qz)),
+                               simdMul(dy, qw)),
+                       simdMul(dz, qx));
+        q[2] = simdAdd(simdSub(simdAdd(simdMul(dw, qz), simdMul(dx, qy)),
+                               simdMul(dy, qx)),
+                       simdMul(dz, qw));
+        q[3] = simdSub(simdSub(simdSub(simdMul(dw, qw), simdMul(dx, qx)),
+                               simdMul(dy, qy)),
+                       simdMul(dz, qz));
+
+        simdf norm = simdSqrt(simdMulAdd(
+            q[0], q[0],
+            simdMulAdd(q[1], q[1],
+                       simdMulAdd(q[2], q[2], simdMul(q[3], q[3])))));
+
+        simdf old[4] = {qx, qy, qz, qw};
+        for (int axis = 0; axis < 4; axis++)
+        {
+            simdStore(b->orientation[axis] + i,
+                      simdSelect(dynamic, simdDiv(q[axis], norm), old[axis]));
+        }
+    }
+
+    for (; i < last; i++)
+    {
+        integrateAngularBody(b, dt, i);
+    }
+}
@@ -0,0 +1,27 @@
+/*
+ * integrate.h
+ *
+ * Batched integration kernels which advance SIMD_WIDTH bodies per instruction
+ * over the body store's streams, finishing any remainder with a scalar tail
+ *
+ * Both kernels skip sleeping bodies with lane masks and work on the half-open
+ * range [first, last) so callers can split a store into chunks. Static bodies
+ * lead every store, so callers leave them out of the range instead
+ */
+
+#ifndef INTEGRATE_H
+#define INTEGRATE_H
+
+#include "bodies.h"
+
+// advances positions with position Verlet using each body's linear
+// acceleration plus uniform gravity along the y axis
+void integrateLinear(Bodies* b, float gravity, float dt, unsigned int first,
+                     unsigned int last);
+
+// advances angular velocities with symplectic Euler then rotates orientations
+// by the resulting angular velocities
+void integrateAngular(Bodies* b, float dt, unsigned int first,
+                      unsigned int last);
+
+#endif
@@ -0,0 +1,202 @@
+#include "islands.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ISLANDS_CHUNK 4096  // bodies or links handed to a worker at a time
+
+void islandsInit(Islands* is)
+{
+    memset(is, 0, sizeof(Islands));
+}
+
+void islandsFree(Islands* is)
+{
+    free(is->parents);
+    free(is->labels);
+    free(is->links);
+    free(is->owner);
+    free(is->order);
+    free(is->ranks);
+    free(is->starts);
+    free(is->offsets);
+    memset(is, 0, sizeof(Islands));
+}
+
+void islandsReserve(Islands* is, unsigned int bodyCount,
+                    unsigned int contactCount)
+{
+    is->bodyCount = bodyCount;
+    if (bodyCount > is->bodyCapacity)
+    {
+        free(is->parents);
+        free(is->labels);
+        is->bodyCapacity = bodyCount > 2 * is->bodyCapacity
+                               ? bodyCount
+                               : 2 * is->bodyCapacity;
+        is->parents = malloc(is->bodyCapacity * sizeof(atomic_uint));
+        is->labels = malloc(is->bodyCapacity * sizeof(unsigned int));
+    }
+
+    // there are never more islands than contacts, and offsets always hold at
+    // least the end of the last island
+    is->contactCount = contactCount;
+    if (contactCount > is->contactCapacity || !is->offsets)
+    {
+        free(is->links);
+        free(is->owner);
+        free(is->order);
+        free(is->ranks);
+        free(is->starts);
+        free(is->offsets);
+        is->contactCapacity = contactCount > 2 * is->contactCapacity
+                                  ? contactCount
+                                  : 2 * is->contactCapacity;
+        is->links = malloc(is->contactCapacity * sizeof(IslandsLink));
+        is->owner = malloc(is->contactCapacity * sizeof(unsigned int));
+        is->order = malloc(is->contactCapacity * sizeof(unsigned int));
+        is->ranks = malloc(is->contactCapacity * sizeof(unsigned long long));
+        is->starts = malloc(is->contactCapacity * sizeof(unsigned int));
+        is->offsets = malloc((is->contactCapacity + 1) * sizeof(unsigned int));
+    }
+}
+
+unsigned int islandsFind(Islands* is, unsigned int body)
+{
+    while (1)
+    {
+        unsigned int parent = atomic_load(is->parents + body);
+        if (parent == body)
+        {
+            return body;
+        }
+
+        // path halving, where losing the race to another thread is harmless
+        // since any ancestor is a valid parent
+        unsigned int grandparent = atomic_load(is->parents + parent);
+        if (grandparent != parent)
+        {
+            atomic_compare_exchange_weak(is->parents + body, &parent,
+                                         grandparent);
+        }
+        body = grandparent;
+    }
+}
+
+void islandsJoin(Islands* is, unsigned int a, unsigned int b)
+{
+    while (1)
+    {
+        a = islandsFind(is, a);
+        b = islandsFind(is, b);
+        if (a == b)
+        {
+            return;
+        }
+
+        // the higher root goes under the lower one, which fails if another
+        // thread has linked it in the meantime
+        if (a < b)
+        {
+            unsigned int swap = a;
+            a = b;
+            b = swap;
+        }
+        unsigned int expected = a;
+        if (atomic_compare_exchange_strong(is->parents + a, &expected, b))
+        {
+            return;
+        }
+    }
+}
+
+// makes every body in a chunk an island of its own
+void islandsClear(void* data, unsigned int first, unsigned int last,
+                  unsigned int worker)
+{
+    Islands* is = data;
+    for (unsigned int body = first; body < last; body++)
+    {
+        atomic_init(is->parents + body, body);
+        is->labels[body] = ISLANDS_NONE;
+    }
+}
+
+// joins the bodies of a chunk of links
+void islandsLink(void* data, unsigned int first, unsigned int last,
+                 unsigned int worker)
+{
+    Islands* is = data;
+    for (unsigned int index = first; index < last; index++)
+    {
+        IslandsLink* link = is->links + index;
+        if (link->a != ISLANDS_NONE && link->b != ISLANDS_NONE)
+        {
+            islandsJoin(is, link->a, link->b);
+        }
+    }
+}
+
+int islandsCompare(const void* a, const void* b)
+{
+    unsigned long long rankA = *(unsigned long long*)a;
+    unsigned long long rankB = *(unsigned long long*)b;
+    return (rankA > rankB) - (rankA < rankB);
+}
+
+void islandsUpdate(Islands* is, Pool* pool)
+{
+    poolFor(pool, is->bodyCount, ISLANDS_CHUNK, islandsClear, is);
+    poolFor(pool, is->contactCount, ISLANDS_CHUNK, islandsLink, is);
+
+    // label islands in the order of their first contact and count theirs
+    is->count = 0;
+    for (unsigned int index = 0; index < is->contactCount; index++)
+    {
+        IslandsLink* link = is->links + index;
+        unsigned int body = link->a != ISLANDS_NONE ? link->a : link->b;
+        if (body == ISLANDS_NONE)
+        {
+            is->owner[index] = ISLANDS_NONE;
+            continue;
+        }
+
+        unsigned int root = islandsFind(is, body);
+        if (is->labels[root] == ISLANDS_NONE)
+        {
+            is->labels[root] = is->count;
+            is->starts[is->count++] = 0;
+        }
+        is->owner[index] = is->labels[root];
+        is->starts[is->labels[root]]++;
+    }
+
+    // largest first, with the complement of the size in the high bits and the
+    // label breaking ties in the low bits
+    for (unsigned int island = 0; island < is->count; island++)
+    {
+        is->ranks[island] =
+            ((unsigned long long)(0xFFFFFFFFu - is->starts[island]) << 32) |
+            island;
+    }
+    qsort(is->ranks, is->count, sizeof(unsigned long long), islandsCompare);
+
+    unsigned int offset = 0;
+    for (unsigned int rank = 0; rank < is->count; rank++)
+    {
+        unsigned int island = (unsigned int)is->ranks[rank];
+        unsigned int size = is->starts[island];
+        is->starts[island] = offset;
+        is->offsets[rank] = offset;
+        offset += size;
+    }
+    is->offsets[is->count] = offset;
+
+    for (unsigned int index = 0; index < is->contactCount; index++)
+    {
+        if (is->owner[index] != ISLANDS_NONE)
+        {
+            is->order[is->starts[is->owner[index]]++] = index;
+        }
+    }
+}
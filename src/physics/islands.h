@@ -0,0 +1,77 @@
+/*
+ * islands.h
+ *
+ * Groups of bodies joined by contacts, which can be solved independently of
+ * each other
+ *
+ * Every contact between two bodies which can move joins them in a lock-free
+ * union-find forest over flat body indices. Roots are only ever linked under
+ * roots with a lower index, so each island ends up rooted at its lowest body
+ * no matter which thread linked what. Static bodies are never joined, so a
+ * floor shared by many piles does not merge them into one island
+ *
+ * Contacts are then grouped by island with the largest island first, keeping
+ * their original order within each, so solving islands on separate threads
+ * gives the same result as solving every contact in order on one
+ */
+
+#ifndef ISLANDS_H
+#define ISLANDS_H
+
+#include <stdatomic.h>
+
+#include "utils/pool.h"
+
+#define ISLANDS_NONE 0xFFFFFFFFu  // body a contact cannot move
+
+// bodies joined by a contact, by flat index
+typedef struct IslandsLink
+{
+    unsigned int a;  // ISLANDS_NONE if the contact cannot move body a
+    unsigned int b;
+} IslandsLink;
+
+typedef struct Islands
+{
+    /* BODIES */
+    unsigned int bodyCount;
+    unsigned int bodyCapacity;
+    atomic_uint* parents;  // union-find forest, never above the body's index
+    unsigned int* labels;  // island of each root, ISLANDS_NONE until found
+
+    /* CONTACTS */
+    unsigned int contactCount;
+    unsigned int contactCapacity;
+    IslandsLink* links;   // filled in by the caller before each update
+    unsigned int* owner;  // island of each contact, ISLANDS_NONE for none
+    unsigned int* order;  // contacts grouped by island
+
+    /* ISLANDS */
+    unsigned int count;
+    unsigned long long* ranks;  // labels sorted by size, then first contact
+    unsigned int* starts;       // contacts, then next entry in order, by label
+    unsigned int* offsets;      // first entry in order of each sorted island
+} Islands;
+
+void islandsInit(Islands* is);
+
+void islandsFree(Islands* is);
+
+// grows the arrays to cover a number of bodies and contacts, after which the
+// caller fills in the link of every contact
+void islandsReserve(Islands* is, unsigned int bodyCount,
+                    unsigned int contactCount);
+
+// returns the root of the island a body belongs to
+// safe to call while other threads join islands
+unsigned int islandsFind(Islands* is, unsigned int body);
+
+// merges the islands of two bodies
+// safe to call from any number of threads at once
+void islandsJoin(Islands* is, unsigned int a, unsigned int b);
+
+// joins the bodies of every link, then groups the contacts by island with the
+// largest island first
+void islandsUpdate(Islands* is, Pool* pool);
+
+#endif
@@ -0,0 +1,1494 @@
+#include "narrowphase.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "objects/tetrahedron.h"
+
+#define NARROWPHASE_CHUNK 256  // pairs handed to a worker at a time
+#define NARROWPHASE_EDGE_BIAS 0.95f  // edge axes must beat face axes by this
+                                     // factor to be chosen
+#define NARROWPHASE_CLIP 16  // most vertices of a clipped face
+#define NARROWPHASE_ALIGNED 0.99f  // normals closer than this to a face's
+                                   // normal touch along the face
+
+// convex hull of a body in world space
+typedef struct NarrowphaseHull
+{
+    unsigned int vertexCount;
+    vec3 vertices[8];
+    unsigned int faceCount;
+    unsigned int faceSizes[6];
+    unsigned int faces[6][4];  // vertex indices of each face in winding order
+    vec3 normals[6];           // outward normal of each face
+    unsigned int edgeCount;
+    unsigned int edges[12][2];  // vertex indices of each edge
+    unsigned int edgeDirections[12];  // direction of each edge
+    unsigned int directionCount;
+    vec3 directions[6];  // unit direction shared by parallel edges
+} NarrowphaseHull;
+
+// shared state for running kernels over chunks of pairs
+typedef struct NarrowphaseTask
+{
+    Narrowphase* np;
+    NarrowphaseKernel (*table)[OBJECT_TYPES];
+    Planes* planes;
+    Broadphase* bp;
+    Bodies* bodies;
+} NarrowphaseTask;
+
+void narrowphaseInit(Narrowphase* np) { memset(np, 0, sizeof(Narrowphase)); }
+
+void narrowphaseFree(Narrowphase* np)
+{
+    free(np->cacheKeys);
+    free(np->cacheSimplices);
+    free(np->contacts);
+    memset(np, 0, sizeof(Narrowphase));
+}
+
+// records a contact between the bodies of a pair
+void narrowphaseWrite(Contact* c, Bodies* a, Bodies* b, BroadphasePair* pair,
+                      vec3 normal, float depth, vec3 point)
+{
+    glm_vec3_copy(normal, c->normal);
+    c->depth = depth;
+    glm_vec3_copy(point, c->point);
+    c->a = pair->a;
+    c->b = pair->b;
+    c->typeA = a->type;
+    c->typeB = b->type;
+}
+
+// finds the point of a triangle closest to a point
+void narrowphaseTriangle(vec3 p, vec3 a, vec3 b, vec3 c, vec3 closest)
+{
+    vec3 ab, ac, ap, bp, cp;
+    glm_vec3_sub(b, a, ab);
+    glm_vec3_sub(c, a, ac);
+    glm_vec3_sub(p, a, ap);
+
+    // the point lies beyond a vertex, an edge, or over the face, found from
+    // its barycentric coordinates
+    float d1 = glm_vec3_dot(ab, ap), d2 = glm_vec3_dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f)
+    {
+        glm_vec3_copy(a, closest);
+        return;
+    }
+
+    glm_vec3_sub(p, b, bp);
+    float d3 = glm_vec3_dot(ab, bp), d4 = glm_vec3_dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3)
+    {
+        glm_vec3_copy(b, closest);
+        return;
+    }
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+    {
+        glm_vec3_copy(a, closest);
+        glm_vec3_muladds(ab, d1 / (d1 - d3), closest);
+        return;
+    }
+
+    glm_vec3_sub(p, c, cp);
+    float d5 = glm_vec3_dot(ab, cp), d6 = glm_vec3_dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6)
+    {
+        glm_vec3_copy(c, closest);
+        return;
+    }
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+    {
+        glm_vec3_copy(a, closest);
+        glm_vec3_muladds(ac, d2 / (d2 - d6), closest);
+        return;
+    }
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+    {
+        vec3 bc;
+        glm_vec3_sub(c, b, bc);
+        glm_vec3_copy(b, closest);
+        glm_vec3_muladds(bc, (d4 - d3) / ((d4 - d3) + (d5 - d6)), closest);
+        return;
+    }
+
+    float denominator = 1.0f / (va + vb + vc);
+    glm_vec3_copy(a, closest);
+    glm_vec3_muladds(ab, vb * denominator, closest);
+    glm_vec3_muladds(ac, vc * denominator, closest);
+}
+
+// finds the closest points between two segments
+void narrowphaseSegments(vec3 p1, vec3 q1, vec3 p2, vec3 q2, vec3 c1, vec3 c2)
+{
+    vec3 d1, d2, r;
+    glm_vec3_sub(q1, p1, d1);
+    glm_vec3_sub(q2, p2, d2);
+    glm_vec3_sub(p1, p2, r);
+    float a = glm_vec3_dot(d1, d1), e = glm_vec3_dot(d2, d2);
+    float f = glm_vec3_dot(d2, r);
+    float c = glm_vec3_dot(d1, r), b = glm_vec3_dot(d1, d2);
+
+    // parameters along each segment, clamped to the segments
+    float s = 0.0f, t = 0.0f;
+    float denominator = a * e - b * b;
+    if (denominator > 1e-12f)
+    {
+        s = glm_clamp((b * f - c * e) / denominator, 0.0f, 1.0f);
+    }
+    t = e > 1e-12f ? (b * s + f) / e : 0.0f;
+    if (t < 0.0f)
+    {
+        t = 0.0f;
+        s = a > 1e-12f ? glm_clamp(-c / a, 0.0f, 1.0f) : 0.0f;
+    }
+    else if (t > 1.0f)
+    {
+        t = 1.0f;
+        s = a > 1e-12f ? glm_clamp((b - c) / a, 0.0f, 1.0f) : 0.0f;
+    }
+
+    glm_vec3_copy(p1, c1);
+    glm_vec3_muladds(d1, s, c1);
+    glm_vec3_copy(p2, c2);
+    glm_vec3_muladds(d2, t, c2);
+}
+
+// builds the world space hull of a floor, cube, or tetrahedron
+void narrowphaseHull(Bodies* b, unsigned int i, float tetrahedron[4][3],
+                     NarrowphaseHull* hull)
+{
+    float r[3][3];
+    bodiesRotation(b, i, r);
+    vec3 position;
+    bodiesPosition(b, i, position);
+    float size = b->size[i];
+
+    // local axes of the body in world space
+    vec3 axes[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        for (int row = 0; row < 3; row++)
+        {
+            axes[axis][row] = r[row][axis];
+        }
+    }
+
+    if (b->type == CUBE)
+    {
+        // corners lie on a sphere of radius size
+        float half = size / 1.73205081f;
+        hull->vertexCount = 8;
+        for (unsigned int v = 0; v < 8; v++)
+        {
+            glm_vec3_copy(position, hull->vertices[v]);
+            for (int axis = 0; axis < 3; axis++)
+            {
+                glm_vec3_muladds(axes[axis], (v >> axis) & 1 ? half : -half,
+                                 hull->vertices[v]);
+            }
+        }
+
+        // each face fixes one bit of its corners' indices
+        const unsigned int corners[4][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+        hull->faceCount = 6;
+        hull->edgeCount = 0;
+        hull->directionCount = 3;
+        for (unsigned int axis = 0; axis < 3; axis++)
+        {
+            unsigned int u = (axis + 1) % 3, w = (axis + 2) % 3;
+            for (unsigned int side = 0; side < 2; side++)
+            {
+                unsigned int face = 2 * axis + side;
+                hull->faceSizes[face] = 4;
+                for (int corner = 0; corner < 4; corner++)
+                {
+                    hull->faces[face][corner] = side << axis |
+                                                corners[corner][0] << u |
+                                                corners[corner][1] << w;
+                }
+                glm_vec3_scale(axes[axis], side ? 1.0f : -1.0f,
+                               hull->normals[face]);
+            }
+
+            glm_vec3_copy(axes[axis], hull->directions[axis]);
+            for (unsigned int v = 0; v < 8; v++)
+            {
+                if (!((v >> axis) & 1))
+                {
+                    hull->edges[hull->edgeCount][0] = v;
+                    hull->edges[hull->edgeCount][1] = v | 1 << axis;
+                    hull->edgeDirections[hull->edgeCount++] = axis;
+                }
+            }
+        }
+        return;
+    }
+
+    if (b->type == TETRAHEDRON)
+    {
+        hull->vertexCount = 4;
+        for (int v = 0; v < 4; v++)
+        {
+            glm_vec3_copy(position, hull->vertices[v]);
+            for (int axis = 0; axis < 3; axis++)
+            {
+                glm_vec3_muladds(axes[axis], size * tetrahedron[v][axis],
+                                 hull->vertices[v]);
+            }
+        }
+
+        // each face lies opposite the vertex it leaves out
+        const unsigned int faces[4][3] = {
+            {0, 1, 2}, {3, 0, 1}, {3, 1, 2}, {3, 2, 0}};
+        const unsigned int opposite[4] = {3, 2, 0, 1};
+        hull->faceCount = 4;
+        for (int face = 0; face < 4; face++)
+        {
+            hull->faceSizes[face] = 3;
+            memcpy(hull->faces[face], faces[face], sizeof(faces[face]));
+
+            vec3 e1, e2, away;
+            glm_vec3_sub(hull->vertices[faces[face][1]],
+                         hull->vertices[faces[face][0]], e1);
+            glm_vec3_sub(hull->vertices[faces[face][2]],
+                         hull->vertices[faces[face][0]], e2);
+            glm_vec3_crossn(e1, e2, hull->normals[face]);
+            glm_vec3_sub(hull->vertices[opposite[face]],
+                         hull->vertices[faces[face][0]], away);
+            if (glm_vec3_dot(hull->normals[face], away) > 0.0f)
+            {
+                glm_vec3_negate(hull->normals[face]);
+            }
+        }
+
+        const unsigned int edges[6][2] = {{0, 1}, {1, 2}, {2, 0},
+                                          {0, 3}, {1, 3}, {2, 3}};
+        hull->edgeCount = 6;
+        hull->directionCount = 6;
+        for (int edge = 0; edge < 6; edge++)
+        {
+            hull->edges[edge][0] = edges[edge][0];
+            hull->edges[edge][1] = edges[edge][1];
+            hull->edgeDirections[edge] = edge;
+            glm_vec3_sub(hull->vertices[edges[edge][1]],
+                         hull->vertices[edges[edge][0]],
+                         hull->directions[edge]);
+            glm_vec3_normalize(hull->directions[edge]);
+        }
+        return;
+    }
+
+    // floors are squares of half side length size in the local xz plane with
+    // a face on either side
+    const float signs[4][2] = {
+        {-1.0f, -1.0f}, {1.0f, -1.0f}, {1.0f, 1.0f}, {-1.0f, 1.0f}};
+    hull->vertexCount = 4;
+    for (int v = 0; v < 4; v++)
+    {
+        glm_vec3_copy(position, hull->vertices[v]);
+        glm_vec3_muladds(axes[0], size * signs[v][0], hull->vertices[v]);
+        glm_vec3_muladds(axes[2], size * signs[v][1], hull->vertices[v]);
+    }
+
+    hull->faceCount = 2;
+    for (int face = 0; face < 2; face++)
+    {
+        hull->faceSizes[face] = 4;
+        for (int corner = 0; corner < 4; corner++)
+        {
+            hull->faces[face][corner] = face ? 3 - corner : corner;
+        }
+        glm_vec3_scale(axes[1], face ? -1.0f : 1.0f, hull->normals[face]);
+    }
+
+    hull->edgeCount = 4;
+    hull->directionCount = 2;
+    glm_vec3_copy(axes[0], hull->directions[0]);
+    glm_vec3_copy(axes[2], hull->directions[1]);
+    for (unsigned int edge = 0; edge < 4; edge++)
+    {
+        hull->edges[edge][0] = edge;
+        hull->edges[edge][1] = (edge + 1) % 4;
+        hull->edgeDirections[edge] = edge % 2;
+    }
+}
+
+// finds the interval a hull covers along an axis
+void narrowphaseProject(NarrowphaseHull* hull, vec3 axis, float* min,
+                        float* max)
+{
+    *min = INFINITY;
+    *max = -INFINITY;
+    for (unsigned int v = 0; v < hull->vertexCount; v++)
+    {
+        float projection = glm_vec3_dot(hull->vertices[v], axis);
+        *min = fminf(*min, projection);
+        *max = fmaxf(*max, projection);
+    }
+}
+
+// returns how far two hulls overlap along an axis, negative if it separates
+// them, and sets normal to the axis pointing from a towards b
+float narrowphaseAxis(NarrowphaseHull* a, NarrowphaseHull* b, vec3 axis,
+                      vec3 normal)
+{
+    float minA, maxA, minB, maxB;
+    narrowphaseProject(a, axis, &minA, &maxA);
+    narrowphaseProject(b, axis, &minB, &maxB);
+
+    // b is pushed out whichever way is shorter
+    float forward = maxA - minB;
+    float backward = maxB - minA;
+    if (forward <= backward)
+    {
+        glm_vec3_copy(axis, normal);
+        return forward;
+    }
+    glm_vec3_negate_to(axis, normal);
+    return backward;
+}
+
+// returns the face of a hull whose normal points furthest along a direction
+unsigned int narrowphaseFace(NarrowphaseHull* hull, vec3 direction)
+{
+    unsigned int best = 0;
+    for (unsigned int face = 1; face < hull->faceCount; face++)
+    {
+        if (glm_vec3_dot(hull->normals[face], direction) >
+            glm_vec3_dot(hull->normals[best], direction))
+        {
+            best = face;
+        }
+    }
+    return best;
+}
+
+// keeps the part of a polygon behind a plane
+unsigned int narrowphaseClipPlane(vec3* polygon, unsigned int count,
+                                  vec3 normal, vec3 origin, vec3* clipped)
+{
+    unsigned int kept = 0;
+    for (unsigned int v = 0; v < count; v++)
+    {
+        float* current = polygon[v];
+        float* next = polygon[(v + 1) % count];
+        vec3 offset;
+        glm_vec3_sub(current, origin, offset);
+        float d1 = glm_vec3_dot(offset, normal);
+        glm_vec3_sub(next, origin, offset);
+        float d2 = glm_vec3_dot(offset, normal);
+
+        if (d1 <= 0.0f)
+        {
+            glm_vec3_copy(current, clipped[kept++]);
+        }
+        if ((d1 <= 0.0f) != (d2 <= 0.0f))
+        {
+            glm_vec3_lerp(current, next, d1 / (d1 - d2), clipped[kept++]);
+        }
+    }
+    return kept;
+}
+
+// writes contacts from the incident face of one hull clipped against the
+// reference face of the other
+unsigned int narrowphaseClip(NarrowphaseHull* a, NarrowphaseHull* b,
+                             vec3 normal, float depth, Contact* contacts)
+{
+    // the reference face is whichever face lines up best with the normal
+    vec3 reversed;
+    glm_vec3_negate_to(normal, reversed);
+    unsigned int faceA = narrowphaseFace(a, normal);
+    unsigned int faceB = narrowphaseFace(b, reversed);
+    int flip = glm_vec3_dot(b->normals[faceB], reversed) >
+               glm_vec3_dot(a->normals[faceA], normal);
+    NarrowphaseHull* reference = flip ? b : a;
+    NarrowphaseHull* incident = flip ? a : b;
+    unsigned int face = flip ? faceB : faceA;
+    float* referenceNormal = reference->normals[face];
+
+    vec3 towards;
+    glm_vec3_negate_to(referenceNormal, towards);
+    unsigned int incidentFace = narrowphaseFace(incident, towards);
+
+    vec3 buffers[2][NARROWPHASE_CLIP];
+    unsigned int count = incident->faceSizes[incidentFace];
+    for (unsigned int v = 0; v < count; v++)
+    {
+        glm_vec3_copy(incident->vertices[incident->faces[incidentFace][v]],
+                      buffers[0][v]);
+    }
+
+    // clip against the plane through each edge of the reference face
+    unsigned int sides = reference->faceSizes[face];
+    vec3 centroid = {0.0f, 0.0f, 0.0f};
+    for (unsigned int v = 0; v < sides; v++)
+    {
+        glm_vec3_muladds(reference->vertices[reference->faces[face][v]],
+                         1.0f / sides, centroid);
+    }
+    unsigned int source = 0;
+    for (unsigned int v = 0; v < sides && count > 0; v++)
+    {
+        float* start = reference->vertices[reference->faces[face][v]];
+        float* end = reference->vertices[reference->faces[face][(v + 1) %
+                                                                  sides]];
+        vec3 edge, side, inward;
+        glm_vec3_sub(end, start, edge);
+        glm_vec3_cross(edge, referenceNormal, side);
+        glm_vec3_sub(centroid, start, inward);
+        if (glm_vec3_dot(side, inward) > 0.0f)
+        {
+            glm_vec3_negate(side);
+        }
+
+        count = narrowphaseClipPlane(buffers[source], count, side, start,
+                                     buffers[!source]);
+        source = !source;
+    }
+
+    // keep clipped points below the reference face
+    vec3 contactNormal;
+    glm_vec3_scale(referenceNormal, flip ? -1.0f : 1.0f, contactNormal);
+    float* origin = reference->vertices[reference->faces[face][0]];
+    vec3 points[NARROWPHASE_CLIP];
+    float depths[NARROWPHASE_CLIP];
+    unsigned int found = 0;
+    for (unsigned int v = 0; v < count; v++)
+    {
+        vec3 offset;
+        glm_vec3_sub(buffers[source][v], origin, offset);
+        float separation = glm_vec3_dot(offset, referenceNormal);
+        if (separation > 0.0f)
+        {
+            continue;
+        }
+
+        // midway between the incident point and the reference face
+        glm_vec3_copy(buffers[source][v], points[found]);
+        glm_vec3_muladds(referenceNormal, -0.5f * separation, points[found]);
+        depths[found++] = -separation;
+    }
+
+    // fall back on the deepest incident vertex if clipping lost every point
+    if (found == 0)
+    {
+        unsigned int deepest = 0;
+        for (unsigned int v = 1; v < incident->vertexCount; v++)
+        {
+            if (glm_vec3_dot(incident->vertices[v], referenceNormal) <
+                glm_vec3_dot(incident->vertices[deepest], referenceNormal))
+            {
+                deepest = v;
+            }
+        }
+        glm_vec3_copy(incident->vertices[deepest], points[0]);
+        glm_vec3_muladds(referenceNormal, 0.5f * depth, points[0]);
+        depths[0] = depth;
+        found = 1;
+    }
+
+    // keep the deepest point, the point furthest from it, and the points
+    // spanning the most area on either side of the line between them
+    unsigned int chosen[NARROWPHASE_POINTS] = {0};
+    unsigned int chosenCount = found;
+    if (found > NARROWPHASE_POINTS)
+    {
+        for (unsigned int p = 1; p < found; p++)
+        {
+            if (depths[p] > depths[chosen[0]])
+            {
+                chosen[0] = p;
+            }
+        }
+
+        float furthest = -1.0f;
+        for (unsigned int p = 0; p < found; p++)
+        {
+            float distance = glm_vec3_distance2(points[p], points[chosen[0]]);
+            if (distance > furthest)
+            {
+                furthest = distance;
+                chosen[1] = p;
+            }
+        }
+
+        vec3 line;
+        glm_vec3_sub(points[chosen[1]], points[chosen[0]], line);
+        float most = -INFINITY, least = INFINITY;
+        for (unsigned int p = 0; p < found; p++)
+        {
+            vec3 offset, cross;
+            glm_vec3_sub(points[p], points[chosen[0]], offset);
+            glm_vec3_cross(line, offset, cross);
+            float area = glm_vec3_dot(cross, referenceNormal);
+            if (area > most)
+            {
+                most = area;
+                chosen[2] = p;
+            }
+            if (area < least)
+            {
+                least = area;
+                chosen[3] = p;
+            }
+        }
+        chosenCount = chosen[3] == chosen[2] ? 3 : 4;
+    }
+    else
+    {
+        for (unsigned int p = 0; p < found; p++)
+        {
+            chosen[p] = p;
+        }
+    }
+
+    for (unsigned int c = 0; c < chosenCount; c++)
+    {
+        glm_vec3_copy(contactNormal, contacts[c].normal);
+        contacts[c].depth = depths[chosen[c]];
+        glm_vec3_copy(points[chosen[c]], contacts[c].point);
+    }
+    return chosenCount;
+}
+
+// returns the edge of a hull along a direction which lies furthest along an
+// axis
+unsigned int narrowphaseEdge(NarrowphaseHull* hull, unsigned int direction,
+                             vec3 axis)
+{
+    unsigned int best = 0;
+    float furthest = -INFINITY;
+    for (unsigned int edge = 0; edge < hull->edgeCount; edge++)
+    {
+        if (hull->edgeDirections[edge] != direction)
+        {
+            continue;
+        }
+
+        float extent =
+            glm_vec3_dot(hull->vertices[hull->edges[edge][0]], axis) +
+            glm_vec3_dot(hull->vertices[hull->edges[edge][1]], axis);
+        if (extent > furthest)
+        {
+            furthest = extent;
+            best = edge;
+        }
+    }
+    return best;
+}
+
+// writes contacts between two convex hulls, returning how many were written
+unsigned int narrowphaseCollide(NarrowphaseHull* a, NarrowphaseHull* b,
+                                Contact* contacts)
+{
+    // find the axis of least penetration, where any separating axis means
+    // the hulls do not touch
+    float best = INFINITY;
+    vec3 bestNormal, normal;
+    NarrowphaseHull* hulls[2] = {a, b};
+    for (int h = 0; h < 2; h++)
+    {
+        for (unsigned int face = 0; face < hulls[h]->faceCount; face++)
+        {
+            float depth =
+                narrowphaseAxis(a, b, hulls[h]->normals[face], normal);
+            if (depth < 0.0f)
+            {
+                return 0;
+            }
+            if (depth < best)
+            {
+                best = depth;
+                glm_vec3_copy(normal, bestNormal);
+            }
+        }
+    }
+
+    // edge pairs only win when clearly shallower than every face, which keeps
+    // resting contacts from flickering between face and edge manifolds
+    int edges = 0;
+    unsigned int directionA = 0, directionB = 0;
+    float faceBest = best;
+    for (unsigned int i = 0; i < a->directionCount; i++)
+    {
+        for (unsigned int j = 0; j < b->directionCount; j++)
+        {
+            vec3 axis;
+            glm_vec3_cross(a->directions[i], b->directions[j], axis);
+            float length = glm_vec3_norm2(axis);
+            if (length < 1e-6f)
+            {
+                continue;
+            }
+            glm_vec3_scale(axis, 1.0f / sqrtf(length), axis);
+
+            float depth = narrowphaseAxis(a, b, axis, normal);
+            if (depth < 0.0f)
+            {
+                return 0;
+            }
+            if (depth < best && depth < NARROWPHASE_EDGE_BIAS * faceBest)
+            {
+                best = depth;
+                glm_vec3_copy(normal, bestNormal);
+                edges = 1;
+                directionA = i;
+                directionB = j;
+            }
+        }
+    }
+
+    if (!edges)
+    {
+        return narrowphaseClip(a, b, bestNormal, best, contacts);
+    }
+
+    // the supporting edges of both hulls along the normal touch at a single
+    // point
+    vec3 reversed;
+    glm_vec3_negate_to(bestNormal, reversed);
+    unsigned int edgeA = narrowphaseEdge(a, directionA, bestNormal);
+    unsigned int edgeB = narrowphaseEdge(b, directionB, reversed);
+    vec3 closestA, closestB;
+    narrowphaseSegments(a->vertices[a->edges[edgeA][0]],
+                        a->vertices[a->edges[edgeA][1]],
+                        b->vertices[b->edges[edgeB][0]],
+                        b->vertices[b->edges[edgeB][1]], closestA, closestB);
+
+    glm_vec3_copy(bestNormal, contacts[0].normal);
+    contacts[0].depth = best;
+    glm_vec3_lerp(closestA, closestB, 0.5f, contacts[0].point);
+    return 1;
+}
+
+// floors against cubes and tetrahedra
+unsigned int narrowphaseHulls(Bodies* a, Bodies* b, BroadphasePair* pairs,
+                              GjkSimplex* simplices, unsigned int count,
+                              Contact* contacts)
+{
+    float tetrahedron[4][3];
+    tetrahedronVertices(tetrahedron);
+
+    unsigned int written = 0;
+    for (unsigned int p = 0; p < count; p++)
+    {
+        NarrowphaseHull hullA, hullB;
+        narrowphaseHull(a, pairs[p].a, tetrahedron, &hullA);
+        narrowphaseHull(b, pairs[p].b, tetrahedron, &hullB);
+
+        Contact* c = contacts + written;
+        unsigned int found = narrowphaseCollide(&hullA, &hullB, c);
+        for (unsigned int k = 0; k < found; k++)
+        {
+            narrowphaseWrite(c + k, a, b, pairs + p, c[k].normal, c[k].depth,
+                             c[k].point);
+        }
+        written += found;
+    }
+    return written;
+}
+
+// cubes and tetrahedra against each other
+unsigned int narrowphaseConvex(Bodies* a, Bodies* b, BroadphasePair* pairs,
+                               GjkSimplex* simplices, unsigned int count,
+                               Contact* contacts)
+{
+    float tetrahedron[4][3];
+    tetrahedronVertices(tetrahedron);
+
+    unsigned int written = 0;
+    for (unsigned int p = 0; p < count; p++)
+    {
+        GjkShape shapeA, shapeB;
+        gjkShape(a, pairs[p].a, tetrahedron, &shapeA);
+        gjkShape(b, pairs[p].b, tetrahedron, &shapeB);
+
+        // most candidate pairs are apart, which GJK settles without EPA
+        vec3 pointA, pointB, normal;
+        float depth;
+        if (gjkDistance(&shapeA, &shapeB, simplices + p, pointA, pointB) >
+                0.0f ||
+            !gjkPenetration(&shapeA, &shapeB, simplices + p, normal, &depth,
+                            pointA, pointB))
+        {
+            continue;
+        }
+
+        // a normal along a face of either hull gives a clipped manifold, while
+        // edges and vertices touch at a single point
+        NarrowphaseHull hullA, hullB;
+        narrowphaseHull(a, pairs[p].a, tetrahedron, &hullA);
+        narrowphaseHull(b, pairs[p].b, tetrahedron, &hullB);
+        vec3 reversed;
+        glm_vec3_negate_to(normal, reversed);
+        float alignment = fmaxf(
+            glm_vec3_dot(hullA.normals[narrowphaseFace(&hullA, normal)],
+                         normal),
+            glm_vec3_dot(hullB.normals[narrowphaseFace(&hullB, reversed)],
+                         reversed));
+
+        Contact* c = contacts + written;
+        unsigned int found = 1;
+        if (alignment > NARROWPHASE_ALIGNED)
+        {
+            found = narrowphaseClip(&hullA, &hullB, normal, depth, c);
+        }
+        else
+        {
+            glm_vec3_copy(normal, c->normal);
+            c->depth = depth;
+            glm_vec3_lerp(pointA, pointB, 0.5f, c->point);
+        }
+
+        for (unsigned int k = 0; k < found; k++)
+        {
+            narrowphaseWrite(c + k, a, b, pairs + p, c[k].normal, c[k].depth,
+                             c[k].point);
+        }
+        written += found;
+    }
+    return written;
+}
+
+// writes the contact between a sphere and the closest point of another body
+// which lies outside the sphere's center, returning whether they touch
+// the normal points from the sphere towards the body unless flipped
+int narrowphaseSphere(vec3 center, float radius, vec3 closest, int flip,
+                      vec3 normal, float* depth, vec3 point)
+{
+    vec3 delta;
+    glm_vec3_sub(closest, center, delta);
+    float distance = glm_vec3_norm2(delta);
+    if (distance >= radius * radius)
+    {
+        return 0;
+    }
+
+    distance = sqrtf(distance);
+    if (distance > 1e-6f)
+    {
+        glm_vec3_scale(delta, 1.0f / distance, normal);
+    }
+    else
+    {
+        glm_vec3_copy((vec3){0.0f, -1.0f, 0.0f}, normal);
+    }
+    *depth = radius - distance;
+
+    // midway between the closest point and the deepest point of the sphere
+    glm_vec3_copy(closest, point);
+    glm_vec3_muladds(normal, 0.5f * *depth, point);
+    if (flip)
+    {
+        glm_vec3_negate(normal);
+    }
+    return 1;
+}
+
+unsigned int narrowphaseFloorSphere(Bodies* a, Bodies* b, BroadphasePair* pairs,
+                                    GjkSimplex* simplices, unsigned int count,
+                                    Contact* contacts)
+{
+    unsigned int written = 0;
+    for (unsigned int p = 0; p < count; p++)
+    {
+        unsigned int i = pairs[p].a, j = pairs[p].b;
+        float r[3][3];
+        bodiesRotation(a, i, r);
+        vec3 floor, center, offset;
+        bodiesPosition(a, i, floor);
+        bodiesPosition(b, j, center);
+        glm_vec3_sub(center, floor, offset);
+        float half = a->size[i], radius = b->size[j];
+
+        // coordinates of the center in the floor's frame, where y is along the
+        // floor's normal
+        vec3 local, axes[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            for (int row = 0; row < 3; row++)
+            {
+                axes[axis][row] = r[row][axis];
+            }
+            local[axis] = glm_vec3_dot(axes[axis], offset);
+        }
+
+        float x = glm_clamp(local[0], -half, half);
+        float z = glm_clamp(local[2], -half, half);
+        vec3 closest;
+        glm_vec3_copy(floor, closest);
+        glm_vec3_muladds(axes[0], x, closest);
+        glm_vec3_muladds(axes[2], z, closest);
+
+        vec3 normal, point;
+        float depth;
+        if (x == local[0] && z == local[2])
+        {
+            // over the floor the sphere is always pushed out along the normal
+            if (fabsf(local[1]) >= radius)
+            {
+                continue;
+            }
+            glm_vec3_copy(axes[1], normal);
+            depth = radius - local[1];
+            glm_vec3_copy(closest, point);
+            glm_vec3_muladds(normal, -0.5f * depth, point);
+        }
+        else if (!narrowphaseSphere(center, radius, closest, 1, normal, &depth,
+                                    point))
+        {
+            continue;
+        }
+
+        narrowphaseWrite(contacts + written++, a, b, pairs + p, normal, depth,
+                         point);
+    }
+    return written;
+}
+
+// returns the height of a point above a floor's plane and sets the normal
+float narrowphasePlane(Bodies* floors, unsigned int f, vec3 point,
+                       vec3 normal)
+{
+    float r[3][3];
+    bodiesRotation(floors, f, r);
+    vec3 floor, offset;
+    bodiesPosition(floors, f, floor);
+    for (int row = 0; row < 3; row++)
+    {
+        normal[row] = r[row][1];
+    }
+    glm_vec3_sub(point, floor, offset);
+    return glm_vec3_dot(offset, normal);
+}
+
+// floors against spheres touching them clear of their edges
+unsigned int narrowphasePlaneSphere(Bodies* a, Bodies* b, BroadphasePair* pairs,
+                                    GjkSimplex* simplices, unsigned int count,
+                                    Contact* contacts)
+{
+    unsigned int written = 0;
+    for (unsigned int p = 0; p < count; p++)
+    {
+        vec3 center, normal, point;
+        bodiesPosition(b, pairs[p].b, center);
+        float height = narrowphasePlane(a, pairs[p].a, center, normal);
+        float depth = b->size[pairs[p].b] - height;
+        if (depth <= 0.0f)
+        {
+            continue;
+        }
+
+        // midway between the plane and the deepest point of the sphere
+        glm_vec3_copy(center, point);
+        glm_vec3_muladds(normal, -height - 0.5f * depth, point);
+        narrowphaseWrite(contacts + written++, a, b, pairs + p, normal, depth,
+                         point);
+    }
+    return written;
+}
+
+// floors against cubes and tetrahedra touching them clear of their edges,
+// where the deepest vertices below the plane become the contacts
+unsigned int narrowphasePlaneHull(Bodies* a, Bodies* b, BroadphasePair* pairs,
+                                  GjkSimplex* simplices, unsigned int count,
+                                  Contact* contacts)
+{
+    float tetrahedron[4][3];
+    tetrahedronVertices(tetrahedron);
+
+    unsigned int written = 0;
+    for (unsigned int p = 0; p < count; p++)
+    {
+        unsigned int j = pairs[p].b;
+        float r[3][3];
+        bodiesRotation(b, j, r);
+        vec3 position;
+        bodiesPosition(b, j, position);
+
+        // local corners of the body, scaled to its size
+        vec3 local[8];
+        unsigned int vertexCount = b->type == CUBE ? 8 : 4;
+        float half = b->size[j] / 1.73205081f;
+        for (unsigned int v = 0; v < vertexCount; v++)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                local[v][axis] = b->type == CUBE
+                                     ? ((v >> axis) & 1 ? half : -half)
+                                     : b->size[j] * tetrahedron[v][axis];
+            }
+        }
+
+        // keep the deepest vertices in order of depth
+        vec3 normal, vertices[NARROWPHASE_POINTS];
+        float depths[NARROWPHASE_POINTS];
+        unsigned int found = 0;
+        for (unsigned int v = 0; v < vertexCount; v++)
+        {
+            vec3 vertex;
+            glm_vec3_copy(position, vertex);
+            for (int row = 0; row < 3; row++)
+            {
+                vertex[row] += r[row][0] * local[v][0] +
+                               r[row][1] * local[v][1] +
+                               r[row][2] * local[v][2];
+            }
+            float depth = -narrowphasePlane(a, pairs[p].a, vertex, normal);
+            if (depth <= 0.0f ||
+                (found == NARROWPHASE_POINTS &&
+                 depth <= depths[NARROWPHASE_POINTS - 1]))
+            {
+                continue;
+            }
+
+            unsigned int k = found < NARROWPHASE_POINTS ? found++ : found - 1;
+            while (k > 0 && depths[k - 1] < depth)
+            {
+                depths[k] = depths[k - 1];
+                glm_vec3_copy(vertices[k - 1], vertices[k]);
+                k--;
+            }
+            depths[k] = depth;
+            glm_vec3_copy(vertex, vertices[k]);
+        }
+
+        for (unsigned int k = 0; k < found; k++)
+        {
+            // midway between the vertex and the plane
+            vec3 point;
+            glm_vec3_copy(vertices[k], point);
+            glm_vec3_muladds(normal, 0.5f * depths[k], point);
+            narrowphaseWrite(contacts + written++, a, b, pairs + p, normal,
+                             depths[k], point);
+        }
+    }
+    return written;
+}
+
+unsigned int narrowphaseSphereSphere(Bodies* a, Bodies* b,
+                                     BroadphasePair* pairs,
+                                     GjkSimplex* simplices, unsigned int count,
+                                     Contact* contacts)
+{
+    unsigned int written = 0;
+    for (unsigned int p = 0; p < count; p++)
+    {
+        unsigned int i = pairs[p].a, j = pairs[p].b;
+        vec3 centerA, centerB, delta;
+        bodiesPosition(a, i, centerA);
+        bodiesPosition(b, j, centerB);
+        glm_vec3_sub(centerB, centerA, delta);
+        float radii = a->size[i] + b->size[j];
+        float distance = glm_vec3_norm2(delta);
+        if (distance >= radii * radii)
+        {
+            continue;
+        }
+
+        distance = sqrtf(distance);
+        vec3 normal = {0.0f, 1.0f, 0.0f};
+        if (distance > 1e-6f)
+        {
+            glm_vec3_scale(delta, 1.0f / distance, normal);
+        }
+        float depth = radii - distance;
+
+        vec3 point;
+        glm_vec3_copy(centerA, point);
+        glm_vec3_muladds(normal, a->size[i] - 0.5f * depth, point);
+        narrowphaseWrite(contacts + written++, a, b, pairs + p, normal, depth,
+                         point);
+    }
+    return written;
+}
+
+unsigned int narrowphaseSphereCube(Bodies* a, Bodies* b, BroadphasePair* pairs,
+                                   GjkSimplex* simplices, unsigned int count,
+                                   Contact* contacts)
+{
+    unsigned int written = 0;
+    for (unsigned int p = 0; p < count; p++)
+    {
+        unsigned int i = pairs[p].a, j = pairs[p].b;
+        float r[3][3];
+        bodiesRotation(b, j, r);
+        vec3 center, cube, offset;
+        bodiesPosition(a, i, center);
+        bodiesPosition(b, j, cube);
+        glm_vec3_sub(center, cube, offset);
+        float radius = a->size[i], half = b->size[j] / 1.73205081f;
+
+        vec3 local, clamped, axes[3];
+        int inside = 1;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            for (int row = 0; row < 3; row++)
+            {
+                axes[axis][row] = r[row][axis];
+            }
+            local[axis] = glm_vec3_dot(axes[axis], offset);
+            clamped[axis] = glm_clamp(local[axis], -half, half);
+            inside = inside && clamped[axis] == local[axis];
+        }
+
+        vec3 normal, point;
+        float depth;
+        if (inside)
+        {
+            // a center inside the cube leaves through the nearest face
+            int nearest = 0;
+            for (int axis = 1; axis < 3; axis++)
+            {
+                if (half - fabsf(local[axis]) < half - fabsf(local[nearest]))
+                {
+                    nearest = axis;
+                }
+            }
+            float side = local[nearest] >= 0.0f ? 1.0f : -1.0f;
+            float inset = half - fabsf(local[nearest]);
+            glm_vec3_scale(axes[nearest], -side, normal);
+            depth = radius + inset;
+
+            glm_vec3_copy(center, point);
+            glm_vec3_muladds(axes[nearest], side * inset, point);
+            glm_vec3_muladds(normal, 0.5f * depth, point);
+        }
+        else
+        {
+            vec3 closest;
+            glm_vec3_copy(cube, closest);
+            for (int axis = 0; axis < 3; axis++)
+            {
+                glm_vec3_muladds(axes[axis], clamped[axis], closest);
+            }
+            if (!narrowphaseSphere(center, radius, closest, 0, normal, &depth,
+                                   point))
+            {
+                continue;
+            }
+        }
+
+        narrowphaseWrite(contacts + written++, a, b, pairs + p, normal, depth,
+                         point);
+    }
+    return written;
+}
+
+unsigned int narrowphaseSphereTetrahedron(Bodies* a, Bodies* b,
+                                          BroadphasePair* pairs,
+                                          GjkSimplex* simplices,
+                                          unsigned int count, Contact* contacts)
+{
+    float tetrahedron[4][3];
+    tetrahedronVertices(tetrahedron);
+
+    unsigned int written = 0;
+    for (unsigned int p = 0; p < count; p++)
+    {
+        unsigned int i = pairs[p].a;
+        NarrowphaseHull hull;
+        narrowphaseHull(b, pairs[p].b, tetrahedron, &hull);
+        vec3 center;
+        bodiesPosition(a, i, center);
+        float radius = a->size[i];
+
+        // the center is inside when it lies behind every face
+        unsigned int nearest = 0;
+        float distances[4];
+        for (unsigned int face = 0; face < 4; face++)
+        {
+            vec3 offset;
+            glm_vec3_sub(center, hull.vertices[hull.faces[face][0]], offset);
+            distances[face] = glm_vec3_dot(offset, hull.normals[face]);
+            if (distances[face] > distances[nearest])
+            {
+                nearest = face;
+            }
+        }
+
+        vec3 normal, point;
+        float depth;
+        if (distances[nearest] <= 0.0f)
+        {
+            glm_vec3_negate_to(hull.normals[nearest], normal);
+            depth = radius - distances[nearest];
+            glm_vec3_copy(center, point);
+            glm_vec3_muladds(hull.normals[nearest],
+                             -distances[nearest] - 0.5f * depth, point);
+        }
+        else
+        {
+            // outside, the closest point lies on one of the faces
+            vec3 closest, candidate;
+            float best = INFINITY;
+            for (unsigned int face = 0; face < 4; face++)
+            {
+                unsigned int* f = hull.faces[face];
+                narrowphaseTriangle(center, hull.vertices[f[0]],
+                                    hull.vertices[f[1]], hull.vertices[f[2]],
+                                    candidate);
+                float distance = glm_vec3_distance2(center, candidate);
+                if (distance < best)
+                {
+                    best = distance;
+                    glm_vec3_copy(candidate, closest);
+                }
+            }
+            if (!narrowphaseSphere(center, radius, closest, 0, normal, &depth,
+                                   point))
+            {
+                continue;
+            }
+        }
+
+        narrowphaseWrite(contacts + written++, a, b, pairs + p, normal, depth,
+                         point);
+    }
+    return written;
+}
+
+void narrowphaseTable(NarrowphaseKernel table[OBJECT_TYPES][OBJECT_TYPES])
+{
+    memset(table, 0, OBJECT_TYPES * OBJECT_TYPES * sizeof(NarrowphaseKernel));
+
+    // floors are static planes, so they never need to collide with each other
+    // these resolve the bodies which may touch a floor's edges
+    table[FLOOR][SPHERE] = narrowphaseFloorSphere;
+    table[FLOOR][CUBE] = narrowphaseHulls;
+    table[FLOOR][TETRAHEDRON] = narrowphaseHulls;
+    table[SPHERE][SPHERE] = narrowphaseSphereSphere;
+    table[SPHERE][CUBE] = narrowphaseSphereCube;
+    table[SPHERE][TETRAHEDRON] = narrowphaseSphereTetrahedron;
+    table[CUBE][CUBE] = narrowphaseConvex;
+    table[CUBE][TETRAHEDRON] = narrowphaseConvex;
+    table[TETRAHEDRON][TETRAHEDRON] = narrowphaseConvex;
+}
+
+// packs a pair and its group into a key which is never 0
+unsigned long long narrowphaseKey(unsigned int group, BroadphasePair* pair)
+{
+    return (((unsigned long long)group << 58) |
+            ((unsigned long long)pair->a << 29) | pair->b) +
+           1;
+}
+
+// returns the first cache slot to probe for a key
+unsigned int narrowphaseSlot(Narrowphase* np, unsigned long long key)
+{
+    return (unsigned int)((key * 0x9E3779B97F4A7C15ull) >> 32) &
+           (np->cacheCapacity - 1);
+}
+
+// starts each pair of a chunk from the simplex it ended the last step with
+void narrowphaseRecall(Narrowphase* np, Broadphase* bp,
+                       NarrowphaseChunk* chunk)
+{
+    GjkSimplex* simplices = np->simplices + chunk->slot;
+    memset(simplices, 0, chunk->count * sizeof(GjkSimplex));
+    if (chunk->group >= BROADPHASE_GROUPS || !np->cacheGroups[chunk->group])
+    {
+        return;
+    }
+
+    for (unsigned int p = 0; p < chunk->count; p++)
+    {
+        unsigned long long key =
+            narrowphaseKey(chunk->group, bp->pairs + chunk->first + p);
+        unsigned int slot = narrowphaseSlot(np, key);
+        while (np->cacheKeys[slot])
+        {
+            if (np->cacheKeys[slot] == key)
+            {
+                simplices[p] = np->cacheSimplices[slot];
+                break;
+            }
+            slot = (slot + 1) & (np->cacheCapacity - 1);
+        }
+    }
+}
+
+// replaces the cache with the simplices pairs ended this step with
+void narrowphaseRemember(Narrowphase* np, Broadphase* bp)
+{
+    // floor kernels never use simplices, so only the broadphase's are kept
+    unsigned int cached = 0;
+    for (unsigned int index = 0; index < np->chunkCount; index++)
+    {
+        NarrowphaseChunk* chunk = np->chunks + index;
+        for (unsigned int p = 0;
+             chunk->group < BROADPHASE_GROUPS && p < chunk->count; p++)
+        {
+            cached += np->simplices[chunk->slot + p].count > 0;
+        }
+    }
+
+    // keep the table at most half full
+    unsigned int capacity = np->cacheCapacity ? np->cacheCapacity : 64;
+    while (capacity < 2 * cached)
+    {
+        capacity *= 2;
+    }
+    if (capacity != np->cacheCapacity)
+    {
+        free(np->cacheKeys);
+        free(np->cacheSimplices);
+        np->cacheCapacity = capacity;
+        np->cacheKeys = malloc(capacity * sizeof(unsigned long long));
+        np->cacheSimplices = malloc(capacity * sizeof(GjkSimplex));
+    }
+    memset(np->cacheKeys, 0, capacity * sizeof(unsigned long long));
+    memset(np->cacheGroups, 0, sizeof(np->cacheGroups));
+
+    for (unsigned int index = 0; index < np->chunkCount; index++)
+    {
+        NarrowphaseChunk* chunk = np->chunks + index;
+        if (chunk->group >= BROADPHASE_GROUPS)
+        {
+            continue;
+        }
+
+        for (unsigned int p = chunk->first; p < chunk->first + chunk->count;
+             p++)
+        {
+            if (!np->simplices[p].count)
+            {
+                continue;
+            }
+
+            unsigned long long key =
+                narrowphaseKey(chunk->group, bp->pairs + p);
+            unsigned int slot = narrowphaseSlot(np, key);
+            while (np->cacheKeys[slot])
+            {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            np->cacheKeys[slot] = key;
+            np->cacheSimplices[slot] = np->simplices[p];
+            np->cacheGroups[chunk->group]++;
+        }
+    }
+}
+
+void narrowphaseRemap(Narrowphase* np, Broadphase* bp,
+                      unsigned int* places[OBJECT_TYPES], Arena* frame)
+{
+    unsigned int capacity = np->cacheCapacity;
+    if (!capacity)
+    {
+        return;
+    }
+
+    unsigned long long* keys =
+        arenaAlloc(frame, capacity * sizeof(unsigned long long));
+    GjkSimplex* simplices = arenaAlloc(frame, capacity * sizeof(GjkSimplex));
+    memcpy(keys, np->cacheKeys, capacity * sizeof(unsigned long long));
+    memcpy(simplices, np->cacheSimplices, capacity * sizeof(GjkSimplex));
+    memset(np->cacheKeys, 0, capacity * sizeof(unsigned long long));
+    memset(np->cacheGroups, 0, sizeof(np->cacheGroups));
+
+    unsigned int mask = (1u << 29) - 1;
+    for (unsigned int old = 0; old < capacity; old++)
+    {
+        if (!keys[old])
+        {
+            continue;
+        }
+
+        unsigned long long key = keys[old] - 1;
+        unsigned int group = (unsigned int)(key >> 58);
+        ObjectType typeA = bp->groupTypes[group][0];
+        ObjectType typeB = bp->groupTypes[group][1];
+        BroadphasePair pair = {(unsigned int)(key >> 29) & mask,
+                               (unsigned int)key & mask};
+        if (places[typeA])
+        {
+            pair.a = places[typeA][pair.a];
+        }
+        if (places[typeB])
+        {
+            pair.b = places[typeB][pair.b];
+        }
+
+        // the simplex names the vertices of each body in the pair's order,
+        // so pairs whose bodies swapped order start over, and pairs with a
+        // removed body are dropped
+        if ((typeA == typeB && pair.a > pair.b) || pair.a == BODIES_NONE ||
+            pair.b == BODIES_NONE)
+        {
+            continue;
+        }
+
+        key = narrowphaseKey(group, &pair);
+        unsigned int slot = narrowphaseSlot(np, key);
+        while (np->cacheKeys[slot])
+        {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        np->cacheKeys[slot] = key;
+        np->cacheSimplices[slot] = simplices[old];
+        np->cacheGroups[group]++;
+    }
+}
+
+// runs the kernels of a range of chunks
+void narrowphaseChunks(void* data, unsigned int first, unsigned int last,
+                       unsigned int worker)
+{
+    NarrowphaseTask* task = data;
+    Narrowphase* np = task->np;
+    Broadphase* bp = task->bp;
+
+    for (unsigned int index = first; index < last; index++)
+    {
+        NarrowphaseChunk* chunk = np->chunks + index;
+        ObjectType a, b;
+        NarrowphaseKernel kernel;
+        BroadphasePair* pairs;
+        if (chunk->group < BROADPHASE_GROUPS)
+        {
+            a = bp->groupTypes[chunk->group][0];
+            b = bp->groupTypes[chunk->group][1];
+            kernel = task->table[a][b];
+            pairs = bp->pairs + chunk->first;
+        }
+        else
+        {
+            unsigned int group = chunk->group - BROADPHASE_GROUPS;
+            a = FLOOR;
+            b = group / PLANES_KINDS;
+            kernel = task->table[a][b];
+            if (group % PLANES_KINDS == PLANES_FACE)
+            {
+                kernel = b == SPHERE ? narrowphasePlaneSphere
+                                     : narrowphasePlaneHull;
+            }
+            pairs = task->planes->pairs + chunk->first;
+        }
+
+        narrowphaseRecall(np, bp, chunk);
+        chunk->written =
+            kernel(&task->bodies[a], &task->bodies[b], pairs,
+                   np->simplices + chunk->slot, chunk->count,
+                   np->scratch + chunk->slot * NARROWPHASE_POINTS);
+    }
+}
+
+// copies the contacts of a range of chunks into the gathered list
+void narrowphaseGather(void* data, unsigned int first, unsigned int last,
+                       unsigned int worker)
+{
+    Narrowphase* np = ((NarrowphaseTask*)data)->np;
+
+    for (unsigned int index = first; index < last; index++)
+    {
+        NarrowphaseChunk* chunk = np->chunks + index;
+        memcpy(np->contacts + chunk->offset,
+               np->scratch + chunk->slot * NARROWPHASE_POINTS,
+               chunk->written * sizeof(Contact));
+    }
+}
+
+// splits a range of a group's pairs into chunks, where slot is the first
+// pair's place across both pair lists
+void narrowphaseSplit(Narrowphase* np, unsigned int group, unsigned int first,
+                      unsigned int last, unsigned int slot, Arena* frame)
+{
+    for (; first < last; first += NARROWPHASE_CHUNK, slot += NARROWPHASE_CHUNK)
+    {
+        if (np->chunkCount == np->chunkCapacity)
+        {
+            unsigned int capacity =
+                np->chunkCapacity ? np->chunkCapacity * 2 : 64;
+            np->chunks = arenaResize(
+                frame, np->chunks,
+                np->chunkCapacity * sizeof(NarrowphaseChunk),
+                capacity * sizeof(NarrowphaseChunk));
+            np->chunkCapacity = capacity;
+        }
+
+        NarrowphaseChunk* chunk = np->chunks + np->chunkCount++;
+        chunk->group = group;
+        chunk->first = first;
+        chunk->slot = slot;
+        chunk->count = last - first;
+        if (chunk->count > NARROWPHASE_CHUNK)
+        {
+            chunk->count = NARROWPHASE_CHUNK;
+        }
+    }
+}
+
+void narrowphaseUpdate(Narrowphase* np,
+                       NarrowphaseKernel table[OBJECT_TYPES][OBJECT_TYPES],
+                       Planes* planes, Broadphase* bp, Bodies* bodies,
+                       Pool* pool, Arena* frame)
+{
+    NarrowphaseTask task = {np, table, planes, bp, bodies};
+
+    // split every group with a kernel into chunks, with the floor sweep's
+    // pairs placed after the broadphase's
+    np->chunkCount = 0;
+    np->chunkCapacity = 0;
+    np->chunks = NULL;
+    for (unsigned int group = 0; group < PLANES_GROUPS; group++)
+    {
+        if (group / PLANES_KINDS == FLOOR ||
+            !table[FLOOR][group / PLANES_KINDS])
+        {
+            continue;
+        }
+        narrowphaseSplit(np, BROADPHASE_GROUPS + group,
+                         planes->groupStarts[group],
+                         planes->groupStarts[group + 1],
+                         bp->pairCount + planes->groupStarts[group], frame);
+    }
+    for (unsigned int group = 0; group < BROADPHASE_GROUPS; group++)
+    {
+        if (!table[bp->groupTypes[group][0]][bp->groupTypes[group][1]])
+        {
+            continue;
+        }
+        narrowphaseSplit(np, group, bp->groupStarts[group],
+                         bp->groupStarts[group + 1], bp->groupStarts[group],
+                         frame);
+    }
+
+    unsigned int pairs = bp->pairCount + planes->pairCount;
+    np->scratch =
+        arenaAlloc(frame, pairs * NARROWPHASE_POINTS * sizeof(Contact));
+    np->simplices = arenaAlloc(frame, pairs * sizeof(GjkSimplex));
+
+    poolFor(pool, np->chunkCount, 1, narrowphaseChunks, &task);
+    narrowphaseRemember(np, bp);
+
+    // each chunk's contacts go after those of earlier chunks
+    np->contactCount = 0;
+    for (unsigned int index = 0; index < np->chunkCount; index++)
+    {
+        np->chunks[index].offset = np->contactCount;
+        np->contactCount += np->chunks[index].written;
+    }
+
+    if (np->contactCount > np->contactCapacity)
+    {
+        free(np->contacts);
+        np->contactCapacity = np->contactCount > 2 * np->contactCapacity
+                                  ? np->contactCount
+                                  : 2 * np->contactCapacity;
+        np->contacts = malloc(np->contactCapacity * sizeof(Contact));
+    }
+
+    poolFor(pool, np->chunkCount, 1, narrowphaseGather, &task);
+}
@@ -0,0 +1,118 @@
+/*
+ * narrowphase.h
+ *
+ * Batched contact generation for the candidate pairs found by the broadphase
+ *
+ * Every pair of object types has one kernel which takes a whole group of
+ * candidate pairs at once, so a function pointer is called per batch rather
+ * than per pair. Groups are split into chunks of pairs across the pool, and
+ * each chunk writes up to NARROWPHASE_POINTS contacts per pair into its own
+ * region of a buffer sized before the kernels run, so contacts come out in the
+ * same order for any number of threads
+ *
+ * Spheres are tested analytically against every shape. Cubes and tetrahedra
+ * are tested against each other with GJK, starting from the simplex each pair
+ * ended with on the last step, and EPA finds the normal of those which
+ * overlap. Face contacts between hulls clip the incident face against the
+ * reference face
+ *
+ * Floors come from their own sweep (see planes.h) rather than the broadphase.
+ * Bodies touching a floor clear of its edges are resolved against the plane
+ * alone, with the lowest vertices of cubes and tetrahedra becoming contacts,
+ * while the rest are tested with the separating axis theorem
+ */
+
+#ifndef NARROWPHASE_H
+#define NARROWPHASE_H
+
+#include <cglm/cglm.h>
+
+#include "bodies.h"
+#include "broadphase.h"
+#include "gjk.h"
+#include "planes.h"
+#include "utils/arena.h"
+#include "utils/pool.h"
+
+#define NARROWPHASE_POINTS 4  // most contacts written for a single pair
+
+// point where two bodies touch
+typedef struct Contact
+{
+    vec3 normal;  // unit normal pointing from body a towards body b
+    float depth;  // penetration depth along the normal
+    vec3 point;   // world point midway between both surfaces
+    unsigned int a;  // index of body a in the store of its type
+    unsigned int b;
+    ObjectType typeA;  // never greater than typeB
+    ObjectType typeB;
+} Contact;
+
+// writes contacts for a batch of candidate pairs between two body stores and
+// returns the number written, which is at most NARROWPHASE_POINTS per pair
+// each pair's simplex holds the one it ended with on the last step, if any,
+// and kernels which use GJK replace it with the one it ends with now
+typedef unsigned int (*NarrowphaseKernel)(Bodies* a, Bodies* b,
+                                          BroadphasePair* pairs,
+                                          GjkSimplex* simplices,
+                                          unsigned int count,
+                                          Contact* contacts);
+
+// range of a group's pairs handed to a worker at a time
+// groups past BROADPHASE_GROUPS are those of the floor sweep
+typedef struct NarrowphaseChunk
+{
+    unsigned int group;
+    unsigned int first;    // first pair in the pair list of its group
+    unsigned int slot;     // first pair across both lists, which places the
+                           // chunk's simplices and scratch contacts
+    unsigned int count;    // number of pairs
+    unsigned int written;  // number of contacts written by the kernel
+    unsigned int offset;   // first contact in the gathered list
+} NarrowphaseChunk;
+
+typedef struct Narrowphase
+{
+    /* CHUNKS */
+    // chunks, scratch and simplices are allocated from the frame arena, so
+    // they are only valid during a step
+    unsigned int chunkCount;
+    unsigned int chunkCapacity;
+    NarrowphaseChunk* chunks;
+    Contact* scratch;  // room for NARROWPHASE_POINTS contacts per pair
+
+    /* SIMPLICES */
+    GjkSimplex* simplices;  // simplex of each candidate pair on this step
+    unsigned int cacheCapacity;     // slots in the table, a power of two
+    unsigned long long* cacheKeys;  // pair held by each slot, 0 when empty
+    GjkSimplex* cacheSimplices;     // simplex of each pair from the last step
+    unsigned int cacheGroups[BROADPHASE_GROUPS];  // pairs cached per group
+
+    /* CONTACTS */
+    unsigned int contactCount;
+    unsigned int contactCapacity;
+    Contact* contacts;  // contacts of every group in group order
+} Narrowphase;
+
+void narrowphaseInit(Narrowphase* np);
+
+void narrowphaseFree(Narrowphase* np);
+
+// fills a collision table with the kernel for each pair of types, indexed with
+// the lower type first
+void narrowphaseTable(NarrowphaseKernel table[OBJECT_TYPES][OBJECT_TYPES]);
+
+// runs the kernel of every group of candidate pairs from the floor sweep and
+// the broadphase, in that order, and gathers their contacts
+void narrowphaseUpdate(Narrowphase* np,
+                       NarrowphaseKernel table[OBJECT_TYPES][OBJECT_TYPES],
+                       Planes* planes, Broadphase* bp, Bodies* bodies,
+                       Pool* pool, Arena* frame);
+
+// moves the simplices cached for each pair to the new places of its bodies
+// places holds the new index of each body of a type, or NULL if none moved
+// pairs with a body whose place is BODIES_NONE were removed and are dropped
+void narrowphaseRemap(Narrowphase* np, Broadphase* bp,
+                      unsigned int* places[OBJECT_TYPES], Arena* frame);
+
+#endif
@@ -0,0 +1,552 @@
+#include "nbody.h"
+
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+#include "simd.h"
+#include "utils/sort.h"
+
+#define NBODY_CHUNK 4096  // points handed to a worker at a time while sorting
+#define NBODY_WALK 256    // points handed to a worker at a time while walking,
+                          // a multiple of every SIMD width
+
+// shared state for the per-chunk phases of building and walking the tree
+typedef struct NbodyTask
+{
+    Nbody* n;
+    Bodies* bodies;
+    Pool* pool;
+    unsigned int offsets[OBJECT_TYPES + 1];  // first point of each type
+    float constant;
+    float theta;   // opening angle squared
+    float radius;  // softening radius squared
+    unsigned long long* interactions;  // evaluated by each worker
+} NbodyTask;
+
+// returns the current time in seconds
+double nbodyNow()
+{
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// gathers a chunk of bodies into points and finds the bounds of their
+// positions
+void nbodyGather(void* data, unsigned int first, unsigned int last,
+                 unsigned int worker)
+{
+    NbodyTask* task = data;
+    Nbody* n = task->n;
+
+    int type = 0;
+    for (unsigned int k = first; k < last; k++)
+    {
+        while (k >= task->offsets[type + 1])
+        {
+            type++;
+        }
+        Bodies* b = task->bodies + type;
+        unsigned int i = k - task->offsets[type];
+
+        // ranges may span several chunks when the pool runs them inline
+        float* bounds = n->bounds + 6 * (k / NBODY_CHUNK);
+        NbodyPoint* p = n->unsorted + k;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float x = b->position[axis][i];
+            p->position[axis] = x;
+            if (k % NBODY_CHUNK == 0 || x < bounds[axis])
+            {
+                bounds[axis] = x;
+            }
+            if (k % NBODY_CHUNK == 0 || x > bounds[3 + axis])
+            {
+                bounds[3 + axis] = x;
+            }
+        }
+        p->mass = b->mass[i] > 0.0f ? b->mass[i] : 0.0f;
+        p->type = type;
+        p->index = i;
+    }
+}
+
+// finds the cell of each point in a chunk and counts the points of each cell
+void nbodyHistogram(void* data, unsigned int first, unsigned int last,
+                    unsigned int worker)
+{
+    NbodyTask* task = data;
+    Nbody* n = task->n;
+    unsigned int side = 1u << NBODY_TOP;
+
+    unsigned int* histogram = NULL;
+    for (unsigned int k = first; k < last; k++)
+    {
+        if (k % NBODY_CHUNK == 0)
+        {
+            histogram = n->histograms + k / NBODY_CHUNK * NBODY_CELLS;
+            memset(histogram, 0, NBODY_CELLS * sizeof(unsigned int));
+        }
+
+        unsigned int cell[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float x = (n->unsorted[k].position[axis] - n->low[axis]) /
+                      n->size * side;
+            unsigned int c = x > 0.0f ? (unsigned int)x : 0;
+            cell[axis] = c < side ? c : side - 1;
+        }
+
+        // octants of each level from the top down, with x in the lowest bit
+        // and z in the highest as the subtrees order them
+        unsigned int code = 0;
+        for (int level = NBODY_TOP - 1; level >= 0; level--)
+        {
+            code = code << 3 | ((cell[0] >> level) & 1) |
+                   ((cell[1] >> level) & 1) << 1 |
+                   ((cell[2] >> level) & 1) << 2;
+        }
+        n->codes[k] = code;
+        histogram[code]++;
+    }
+}
+
+// moves a chunk of points to their places in the order of the cells
+void nbodyScatter(void* data, unsigned int first, unsigned int last,
+                  unsigned int worker)
+{
+    NbodyTask* task = data;
+    Nbody* n = task->n;
+
+    unsigned int* histogram = NULL;
+    for (unsigned int k = first; k < last; k++)
+    {
+        if (k % NBODY_CHUNK == 0)
+        {
+            histogram = n->histograms + k / NBODY_CHUNK * NBODY_CELLS;
+        }
+        n->points[histogram[n->codes[k]]++] = n->unsorted[k];
+    }
+}
+
+// moves the points below a split along an axis before the others, returning
+// the first point above it
+unsigned int nbodyPartition(NbodyPoint* points, unsigned int first,
+                            unsigned int last, int axis, float split)
+{
+    while (first < last)
+    {
+        if (points[first].position[axis] < split)
+        {
+            first++;
+            continue;
+        }
+
+        NbodyPoint swap = points[first];
+        points[first] = points[--last];
+        points[last] = swap;
+    }
+    return first;
+}
+
+// builds the subtree over a range of points within a cube and returns the
+// index of its root within the cell
+unsigned int nbodyNode(NbodyCell* cell, Arena* arena, NbodyPoint* points,
+                       unsigned int first, unsigned int last, vec3 low,
+                       float size, unsigned int depth)
+{
+    if (cell->count == cell->capacity)
+    {
+        unsigned int capacity = cell->capacity ? 2 * cell->capacity : 64;
+        cell->nodes = arenaResize(arena, cell->nodes,
+                                  cell->capacity * sizeof(NbodyNode),
+                                  capacity * sizeof(NbodyNode));
+        cell->capacity = capacity;
+    }
+    unsigned int index = cell->count++;
+
+    NbodyNode node;
+    memset(&node, 0, sizeof(NbodyNode));
+    node.size = size;
+    if (last - first <= NBODY_LEAF || depth == NBODY_DEPTH)
+    {
+        node.first = first;
+        node.count = last - first;
+        for (unsigned int k = first; k < last; k++)
+        {
+            node.mass += points[k].mass;
+            glm_vec3_muladds(points[k].position, points[k].mass, node.center);
+        }
+    }
+    else
+    {
+        // octants are split off by z, then y, then x, so each lands in the
+        // order of its index
+        float half = 0.5f * size;
+        unsigned int splits[9];
+        splits[0] = first;
+        splits[8] = last;
+        for (int axis = 2, step = 4; axis >= 0; axis--, step /= 2)
+        {
+            for (int octant = 0; octant < 8; octant += 2 * step)
+            {
+                splits[octant + step] =
+                    nbodyPartition(points, splits[octant],
+                                   splits[octant + 2 * step], axis,
+                                   low[axis] + half);
+            }
+        }
+
+        for (int octant = 0; octant < 8; octant++)
+        {
+            if (splits[octant] == splits[octant + 1])
+            {
+                continue;
+            }
+
+            vec3 corner;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                corner[axis] = low[axis] + ((octant >> axis) & 1) * half;
+            }
+            unsigned int child =
+                nbodyNode(cell, arena, points, splits[octant],
+                          splits[octant + 1], corner, half, depth + 1);
+            NbodyNode* c = cell->nodes + child;
+            node.mass += c->mass;
+            glm_vec3_muladds(c->center, c->mass, node.center);
+        }
+    }
+
+    if (node.mass > 0.0f)
+    {
+        glm_vec3_scale(node.center, 1.0f / node.mass, node.center);
+    }
+    node.next = cell->count;
+    cell->nodes[index] = node;
+    return index;
+}
+
+// builds the subtree of each cell in a range
+void nbodyCells(void* data, unsigned int first, unsigned int last,
+                unsigned int worker)
+{
+    NbodyTask* task = data;
+    Nbody* n = task->n;
+    unsigned int side = 1u << NBODY_TOP;
+    float size = n->size / side;
+
+    for (unsigned int code = first; code < last; code++)
+    {
+        NbodyCell* cell = n->cells + code;
+        cell->count = 0;
+        cell->capacity = 0;
+        cell->nodes = NULL;
+        if (n->starts[code] == n->starts[code + 1])
+        {
+            continue;
+        }
+
+        // the octant of each level gives one bit of the cell on every axis
+        vec3 low;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            unsigned int c = 0;
+            for (int level = NBODY_TOP - 1; level >= 0; level--)
+            {
+                c = c << 1 | ((code >> (3 * level + axis)) & 1);
+            }
+            low[axis] = n->low[axis] + c * size;
+        }
+        nbodyNode(cell, task->pool->arenas + worker, n->points,
+                  n->starts[code], n->starts[code + 1], low, size,
+                  NBODY_TOP);
+    }
+}
+
+// appends the node of a group of cells at a level of the top levels after the
+// nodes built so far, followed by its subtree, and returns its index
+unsigned int nbodyJoin(Nbody* n, unsigned int level, unsigned int group,
+                       float size)
+{
+    unsigned int index = n->nodeCount;
+    if (level == NBODY_TOP)
+    {
+        NbodyCell* cell = n->cells + group;
+        memcpy(n->nodes + index, cell->nodes,
+               cell->count * sizeof(NbodyNode));
+        for (unsigned int k = 0; k < cell->count; k++)
+        {
+            n->nodes[index + k].next += index;
+        }
+        n->nodeCount += cell->count;
+        return index;
+    }
+
+    NbodyNode node;
+    memset(&node, 0, sizeof(NbodyNode));
+    node.size = size;
+    n->nodeCount++;
+
+    unsigned int cells = 1u << 3 * (NBODY_TOP - level - 1);
+    for (unsigned int octant = 0; octant < 8; octant++)
+    {
+        unsigned int child = group * 8 + octant;
+        if (n->starts[child * cells] == n->starts[(child + 1) * cells])
+        {
+            continue;
+        }
+
+        NbodyNode* c = n->nodes + nbodyJoin(n, level + 1, child, 0.5f * size);
+        node.mass += c->mass;
+        glm_vec3_muladds(c->center, c->mass, node.center);
+    }
+
+    if (node.mass > 0.0f)
+    {
+        glm_vec3_scale(node.center, 1.0f / node.mass, node.center);
+    }
+    node.next = n->nodeCount;
+    n->nodes[index] = node;
+    return index;
+}
+
+void nbodyBuild(Nbody* n, Bodies* bodies, Pool* pool, Arena* frame)
+{
+    double start = nbodyNow();
+    NbodyTask task = {n, bodies, pool};
+
+    // floors have no mass to pull with
+    task.offsets[0] = 0;
+    for (int type = 0; type < OBJECT_TYPES; type++)
+    {
+        task.offsets[type + 1] =
+            task.offsets[type] + (type == FLOOR ? 0 : bodies[type].count);
+    }
+    n->pointCount = task.offsets[OBJECT_TYPES];
+    n->nodeCount = 0;
+    n->interactions = 0;
+    n->seconds = 0.0;
+    if (!n->pointCount)
+    {
+        return;
+    }
+
+    unsigned int count = n->pointCount;
+    unsigned int chunks = (count + NBODY_CHUNK - 1) / NBODY_CHUNK;
+    n->unsorted = arenaAlloc(frame, count * sizeof(NbodyPoint));
+    n->points = arenaAlloc(frame, count * sizeof(NbodyPoint));
+    n->codes = arenaAlloc(frame, count);
+    n->histograms =
+        arenaAlloc(frame, chunks * NBODY_CELLS * sizeof(unsigned int));
+    n->bounds = arenaAlloc(frame, 6 * chunks * sizeof(float));
+
+    // the root is the smallest cube around every point, grown slightly so
+    // the points on its far faces still fall inside
+    poolFor(pool, count, NBODY_CHUNK, nbodyGather, &task);
+    vec3 high;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        n->low[axis] = n->bounds[axis];
+        high[axis] = n->bounds[3 + axis];
+        for (unsigned int chunk = 1; chunk < chunks; chunk++)
+        {
+            float* bounds = n->bounds + 6 * chunk;
+            n->low[axis] = fminf(n->low[axis], bounds[axis]);
+            high[axis] = fmaxf(high[axis], bounds[3 + axis]);
+        }
+    }
+    n->size = 0.0f;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        n->size = fmaxf(n->size, high[axis] - n->low[axis]);
+    }
+    n->size = n->size > 0.0f ? n->size * 1.0001f : 1.0f;
+
+    // counting sort of the points by cell, with each cell placed after all
+    // smaller cells and within a cell each chunk after the chunks before it
+    poolFor(pool, count, NBODY_CHUNK, nbodyHistogram, &task);
+    sortPrefix(n->histograms, chunks, NBODY_CELLS, 0, n->starts);
+    poolFor(pool, count, NBODY_CHUNK, nbodyScatter, &task);
+
+    poolFor(pool, NBODY_CELLS, 1, nbodyCells, &task);
+
+    // the top levels hold at most one node per group of cells above the cells
+    unsigned int nodes = 0;
+    for (unsigned int level = 0, groups = 1; level < NBODY_TOP;
+         level++, groups *= 8)
+    {
+        nodes += groups;
+    }
+    for (unsigned int code = 0; code < NBODY_CELLS; code++)
+    {
+        nodes += n->cells[code].count;
+    }
+    n->nodes = arenaAlloc(frame, nodes * sizeof(NbodyNode));
+    nbodyJoin(n, 0, 0, n->size);
+
+    n->seconds = nbodyNow() - start;
+}
+
+// adds the pull of a mass in every lane, softened within the radius, to an
+// acceleration
+void nbodyPull(simdf acceleration[3], simdf position[3], simdf to[3],
+               simdf mass, simdf radius)
+{
+    simdf offset[3];
+    simdf distance = radius;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        offset[axis] = simdSub(to[axis], position[axis]);
+        distance = simdMulAdd(offset[axis], offset[axis], distance);
+    }
+
+    simdf scale = simdDiv(mass, simdMul(distance, simdSqrt(distance)));
+    for (int axis = 0; axis < 3; axis++)
+    {
+        acceleration[axis] =
+            simdMulAdd(offset[axis], scale, acceleration[axis]);
+    }
+}
+
+// walks the tree from packets of SIMD_WIDTH neighbouring points in a chunk,
+// opening a node whenever any point pulled in the packet would
+// a point pulling on itself adds nothing, since the two are no distance apart
+void nbodyWalk(void* data, unsigned int first, unsigned int last,
+               unsigned int worker)
+{
+    NbodyTask* task = data;
+    Nbody* n = task->n;
+    const simdf theta = simdSet(task->theta);
+    const simdf radius = simdSet(task->radius);
+    const simdf zero = simdSet(0.0f);
+
+    unsigned long long interactions = 0;
+    for (unsigned int k = first; k < last; k += SIMD_WIDTH)
+    {
+        // lanes past the end repeat the first point and are never pulled
+        float lanes[4][SIMD_WIDTH];
+        unsigned int active = 0;
+        for (unsigned int lane = 0; lane < SIMD_WIDTH; lane++)
+        {
+            NbodyPoint* p = n->points + (k + lane < last ? k + lane : k);
+            Bodies* b = task->bodies + p->type;
+            int pulled = k + lane < last && p->index >= b->staticCount &&
+                         b->mass[p->index] > 0.0f && !b->sleeping[p->index];
+            for (int axis = 0; axis < 3; axis++)
+            {
+                lanes[axis][lane] = p->position[axis];
+            }
+            lanes[3][lane] = pulled ? 1.0f : 0.0f;
+            active += pulled;
+        }
+        if (!active)
+        {
+            continue;
+        }
+
+        simdf position[3];
+        simdf acceleration[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            position[axis] = simdLoad(lanes[axis]);
+            acceleration[axis] = zero;
+        }
+        simdm pulled = simdGt(simdLoad(lanes[3]), zero);
+
+        unsigned int node = 0;
+        while (node < n->nodeCount)
+        {
+            NbodyNode* c = n->nodes + node;
+            if (c->count)
+            {
+                for (unsigned int q = c->first; q < c->first + c->count; q++)
+                {
+                    NbodyPoint* p = n->points + q;
+                    simdf to[3] = {simdSet(p->position[0]),
+                                   simdSet(p->position[1]),
+                                   simdSet(p->position[2])};
+                    nbodyPull(acceleration, position, to, simdSet(p->mass),
+                              radius);
+                }
+                interactions += active * c->count;
+                node = c->next;
+                continue;
+            }
+
+            // a node small enough from every point pulls as a single mass
+            simdf to[3];
+            simdf distance = zero;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                to[axis] = simdSet(c->center[axis]);
+                simdf offset = simdSub(to[axis], position[axis]);
+                distance = simdMulAdd(offset, offset, distance);
+            }
+            simdm open = simdAnd(
+                simdGt(simdSet(c->size * c->size), simdMul(theta, distance)),
+                pulled);
+            if (!simdAny(open))
+            {
+                nbodyPull(acceleration, position, to, simdSet(c->mass),
+                          radius);
+                interactions += active;
+                node = c->next;
+                continue;
+            }
+            node++;
+        }
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            simdStore(lanes[axis], acceleration[axis]);
+        }
+        for (unsigned int lane = 0; lane < SIMD_WIDTH; lane++)
+        {
+            if (lanes[3][lane] == 0.0f)
+            {
+                continue;
+            }
+            NbodyPoint* p = n->points + k + lane;
+            Bodies* b = task->bodies + p->type;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                b->linearAcceleration[axis][p->index] +=
+                    task->constant * lanes[axis][lane];
+            }
+        }
+    }
+
+    task->interactions[worker] += interactions;
+}
+
+void nbodyApply(Nbody* n, Bodies* bodies, float constant, float theta,
+                float radius, Pool* pool, Arena* frame)
+{
+    if (!n->nodeCount)
+    {
+        return;
+    }
+
+    double start = nbodyNow();
+    NbodyTask task = {n, bodies, pool};
+    task.constant = constant;
+    task.theta = theta * theta;
+    task.radius = radius * radius;
+    task.interactions =
+        arenaAlloc(frame, pool->threads * sizeof(unsigned long long));
+    memset(task.interactions, 0, pool->threads * sizeof(unsigned long long));
+
+    poolFor(pool, n->pointCount, NBODY_WALK, nbodyWalk, &task);
+    for (unsigned int worker = 0; worker < pool->threads; worker++)
+    {
+        n->interactions += task.interactions[worker];
+    }
+    n->seconds += nbodyNow() - start;
+}
+
+double nbodyRate(Nbody* n)
+{
+    return n->seconds > 0.0 ? n->interactions / n->seconds : 0.0;
+}
@@ -0,0 +1,104 @@
+/*
+ * nbody.h
+ *
+ * Barnes-Hut approximation of the gravitation between every pair of bodies
+ *
+ * Every step the bodies are gathered into points and an octree is rebuilt over
+ * the cube bounding them. The top NBODY_TOP levels split the cube into
+ * NBODY_CELLS cells with a parallel counting sort of the points, then each cell
+ * builds its own subtree on a worker by partitioning its points in place, and
+ * the subtrees are joined below the top levels into a single flat array of
+ * nodes in depth first order
+ *
+ * Each node records where the nodes after its subtree start, so walking the
+ * tree needs no stack: a node which looks small enough from a point, by the
+ * opening angle, acts as a single mass at its center of mass and is skipped
+ * over, while any other node is opened by moving on to the next one. Points
+ * keep the order of the tree, so neighbouring points, which open mostly the
+ * same nodes, are walked one after another on the same worker
+ *
+ * Every body with mass pulls on the others, static ones included, and only
+ * dynamic bodies which are awake are pulled
+ */
+
+#ifndef NBODY_H
+#define NBODY_H
+
+#include <cglm/cglm.h>
+
+#include "bodies.h"
+#include "utils/arena.h"
+#include "utils/pool.h"
+
+#define NBODY_THETA 0.5f  // default opening angle
+#define NBODY_LEAF 8      // most points in a leaf above the deepest level
+#define NBODY_DEPTH 32    // deepest level, where coincident points share a leaf
+#define NBODY_TOP 2       // levels split by the counting sort
+#define NBODY_CELLS 64    // cells below the top levels, 8 per level
+
+typedef struct NbodyPoint
+{
+    vec3 position;
+    float mass;
+    ObjectType type;
+    unsigned int index;
+} NbodyPoint;
+
+typedef struct NbodyNode
+{
+    vec3 center;  // center of mass
+    float mass;
+    float size;          // edge length of the cube
+    unsigned int next;   // first node after the subtree
+    unsigned int first;  // first point of a leaf
+    unsigned int count;  // points of a leaf, 0 for inner nodes
+} NbodyNode;
+
+// subtree built below a single cell
+typedef struct NbodyCell
+{
+    unsigned int count;
+    unsigned int capacity;
+    NbodyNode* nodes;  // from the arena of the worker which built it
+} NbodyCell;
+
+typedef struct Nbody
+{
+    /* POINTS */
+    // allocated from the frame arena, so only valid until it is reset
+    unsigned int pointCount;
+    NbodyPoint* points;    // every body in the order of the tree
+    NbodyPoint* unsorted;  // every body in the order of the stores
+    unsigned char* codes;  // cell of each unsorted point
+    unsigned int* histograms;  // points of each chunk in each cell
+    float* bounds;  // lowest and highest position of each chunk
+
+    /* TREE */
+    vec3 low;    // lowest corner of the root cube
+    float size;  // edge length of the root cube
+    unsigned int starts[NBODY_CELLS + 1];  // first point of each cell
+    NbodyCell cells[NBODY_CELLS];
+    unsigned int nodeCount;
+    NbodyNode* nodes;  // from the frame arena
+
+    /* METRICS */
+    unsigned long long interactions;  // nodes and points every point was
+                                      // pulled by on the last step
+    double seconds;  // time spent building and walking on the last step
+} Nbody;
+
+// gathers the bodies and builds the tree over them
+void nbodyBuild(Nbody* n, Bodies* bodies, Pool* pool, Arena* frame);
+
+// adds the pull of every other body to the acceleration of each dynamic body,
+// opening nodes whose size over distance is at least theta, and softening the
+// pull within the radius so it stays bounded
+// must follow nbodyBuild within the same step
+void nbodyApply(Nbody* n, Bodies* bodies, float constant, float theta,
+                float radius, Pool* pool, Arena* frame);
+
+// returns how many interactions were evaluated per second on the last step,
+// 0 if there were none
+double nbodyRate(Nbody* n);
+
+#endif
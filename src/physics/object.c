@@ -32,7 +32,8 @@ void objectPrint(Object* o)
     glm_vec4_print(o->orientation, stdout);
 }
 
-void objectVertices(Object* o, float* vertices)
+void objectVertices(vec3 position, versor orientation, float size, vec3 color,
+                    float* vertices)
 {
     mat4 res;
     for (int i = 0; i < 4; i++)
@@ -41,7 +42,7 @@ void objectVertices(Object* o, float* vertices)
         {
             if (i == j)
             {
-                res[i][j] = o->size;
+                res[i][j] = size;
             }
             else
             {
@@ -53,11 +54,12 @@ void objectVertices(Object* o, float* vertices)
 
     for (int i = 0; i < 3; i++)
     {
-        res[i][3] = o->position[i];
+        res[i][3] = position[i];
     }
 
+    // res is built transposed, so the rotation must be too
     mat4 rot;
-    glm_quat_mat4(o->orientation, rot);
+    glm_quat_mat4t(orientation, rot);
     glm_mat4_mul(rot, res, res);
 
     for (int i = 0; i < 4; i++)
@@ -70,7 +72,7 @@ void objectVertices(Object* o, float* vertices)
 
     for (int i = 16; i < 19; i++)
     {
-        vertices[i] = o->color[i - 16];
+        vertices[i] = color[i - 16];
     }
 }
 
@@ -80,7 +82,7 @@ unsigned int objectVerticesSize()
     return 19;
 }
 
-cJSON* objectToJSON(Object* o)
+cJSON* objectToJSON(Object* o, float dt)
 {
     cJSON* configObject = cJSON_CreateObject();
 
@@ -90,7 +92,7 @@ cJSON* objectToJSON(Object* o)
 
     vec3 velocity;
     glm_vec3_sub(o->position, o->lastPosition, velocity);
-    glm_vec3_scale(velocity, 1.0 / PHYSICS_DT, velocity);
+    glm_vec3_scale(velocity, 1.0f / dt, velocity);
     cJSON* configVelocity = cJSON_CreateFloatArray(velocity, 3);
     cJSON_AddItemReferenceToObject(configObject, "velocity", configVelocity);
 
@@ -2,7 +2,8 @@
  * object.h
  *
  * Generic object struct for simulation
- * Stores position, color, and orientation
+ * Stores position, color, and orientation of a single body when moving it
+ * between the config and the simulation's body store (see bodies.h)
  * Can generate each object's model matrix
  *
  * Each type of object (sphere, cube, etc.) should individually support their
@@ -57,13 +58,14 @@ void objectInit(Object* o, ObjectType type, float size, float mass,
 void objectPrint(Object* o);
 
 // generates and stores model matrix and color data
-void objectVertices(Object* o, float* vertices);
+void objectVertices(vec3 position, versor orientation, float size, vec3 color,
+                    float* vertices);
 
 // returns the size of an object's per instance data
 unsigned int objectVerticesSize();
 
 // converts object data into JSON
-cJSON* objectToJSON(Object* o);
+cJSON* objectToJSON(Object* o, float dt);
 
 #endif
 
@@ -4,10 +4,8 @@
 #include <math.h>
 #include <string.h>
 
-void tetrahedronMesh(float* mesh)
+void tetrahedronVertices(float coords[4][3])
 {
-    float coords[4][3];
-
     const float defaultSize = 1.0f;
     const float angleDown = 0.339836909454f;
     coords[0][0] = defaultSize * cos(angleDown);
@@ -26,6 +24,12 @@ void tetrahedronMesh(float* mesh)
     coords[3][0] = 0.0f;
     coords[3][1] = defaultSize;
     coords[3][2] = 0.0f;
+}
+
+void tetrahedronMesh(float* mesh)
+{
+    float coords[4][3];
+    tetrahedronVertices(coords);
 
     const unsigned int floatsPerVertex = 6;
     const unsigned int floatsPerTriangle = floatsPerVertex * 3;
@@ -1,6 +1,10 @@
 #ifndef TETRAHEDRON_H
 #define TETRAHEDRON_H
 
+// fills array with the corners of a tetrahedron of size 1, with the apex
+// listed last
+void tetrahedronVertices(float coords[4][3]);
+
 // fills array with vertices assuming object is a tetrahedron
 void tetrahedronMesh(float* mesh);
 
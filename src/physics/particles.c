@@ -0,0 +1,344 @@
+#include "particles.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "simd.h"
+
+#define PARTICLES_CHUNK 4096     // particles handed to a worker at a time
+#define PARTICLES_BOUNCE 1.0f    // approach speed below which nothing bounces
+#define PARTICLES_EPSILON 1e-12f
+
+// shared state for stepping chunks of particles
+typedef struct ParticlesTask
+{
+    Particles* p;
+    const float* position[3];      // streams holding the positions to step
+    const float* lastPosition[3];  // from, which are the particles' own
+                                   // unless they were just exchanged
+    float gravity;
+    float dt;
+    float friction;
+    float restitution;
+    int infinite;
+    unsigned int floorCount;
+    BodiesFloor* floors;
+} ParticlesTask;
+
+// points each stream into the backing allocation
+void particlesAssign(Particles* p)
+{
+    float* data = p->data;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        p->position[axis] = data + axis * p->capacity;
+        p->lastPosition[axis] = data + (3 + axis) * p->capacity;
+    }
+    p->radius = data + 6 * p->capacity;
+    p->color = (unsigned int*)(data + 7 * p->capacity);
+}
+
+void particlesInit(Particles* p, unsigned int capacity)
+{
+    memset(p, 0, sizeof(Particles));
+    particlesReserve(p, capacity);
+}
+
+void particlesFree(Particles* p)
+{
+    free(p->data);
+    free(p->emitters);
+    memset(p, 0, sizeof(Particles));
+}
+
+void particlesReserve(Particles* p, unsigned int capacity)
+{
+    // padded like the bodies so the final packet of a step runs over the
+    // padding instead of needing a scalar tail
+    capacity = capacity > 0 ? capacity : 1;
+    capacity = (capacity + BODIES_LANES - 1) / BODIES_LANES * BODIES_LANES;
+    if (capacity <= p->capacity)
+    {
+        return;
+    }
+
+    void* data = aligned_alloc(BODIES_ALIGNMENT,
+                               PARTICLES_STREAMS * capacity * sizeof(float));
+    memset(data, 0, PARTICLES_STREAMS * capacity * sizeof(float));
+    for (int stream = 0; stream < PARTICLES_STREAMS && p->data; stream++)
+    {
+        memcpy((float*)data + stream * capacity,
+               (float*)p->data + stream * p->capacity,
+               p->count * sizeof(float));
+    }
+
+    free(p->data);
+    p->data = data;
+    p->capacity = capacity;
+    particlesAssign(p);
+}
+
+unsigned int particlesColor(vec3 color)
+{
+    unsigned int packed = 0xffu << 24;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float c = glm_clamp(color[axis], 0.0f, 1.0f);
+        packed |= (unsigned int)(c * 255.0f + 0.5f) << (8 * axis);
+    }
+    return packed;
+}
+
+// returns the next value of a xorshift generator between -1 and 1
+float particlesRandom(unsigned int* state)
+{
+    unsigned int x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return (float)(x >> 8) * (2.0f / (1 << 24)) - 1.0f;
+}
+
+void particlesScatter(Particles* p, unsigned int count, vec3 center,
+                      vec3 spread, vec3 velocity, float radius, vec3 color,
+                      float dt)
+{
+    particlesReserve(p, p->count + count);
+
+    unsigned int state = 2654435769u * (p->count + 1);
+    state = state ? state : 1;
+    unsigned int packed = particlesColor(color);
+    for (unsigned int k = 0; k < count; k++)
+    {
+        unsigned int i = p->count + k;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float x = center[axis] + spread[axis] * particlesRandom(&state);
+            p->position[axis][i] = x;
+            p->lastPosition[axis][i] = x - velocity[axis] * dt;
+        }
+        p->radius[i] = radius;
+        p->color[i] = packed;
+    }
+    p->count += count;
+    p->version++;
+
+    if (p->emitterCount == p->emitterCapacity)
+    {
+        p->emitterCapacity = p->emitterCapacity ? 2 * p->emitterCapacity : 4;
+        p->emitters = realloc(p->emitters,
+                              p->emitterCapacity * sizeof(ParticlesEmitter));
+    }
+    ParticlesEmitter* e = p->emitters + p->emitterCount++;
+    e->count = count;
+    glm_vec3_copy(center, e->center);
+    glm_vec3_copy(spread, e->spread);
+    glm_vec3_copy(velocity, e->velocity);
+    e->radius = radius;
+    glm_vec3_copy(color, e->color);
+}
+
+cJSON* particlesToJSON(ParticlesEmitter* e)
+{
+    cJSON* configParticle = cJSON_CreateObject();
+    cJSON_AddNumberToObject(configParticle, "count", e->count);
+    cJSON_AddNumberToObject(configParticle, "size", e->radius);
+
+    cJSON* configPosition = cJSON_CreateFloatArray(e->center, 3);
+    cJSON_AddItemReferenceToObject(configParticle, "position", configPosition);
+
+    cJSON* configSpread = cJSON_CreateFloatArray(e->spread, 3);
+    cJSON_AddItemReferenceToObject(configParticle, "spread", configSpread);
+
+    cJSON* configVelocity = cJSON_CreateFloatArray(e->velocity, 3);
+    cJSON_AddItemReferenceToObject(configParticle, "velocity", configVelocity);
+
+    cJSON* configColor = cJSON_CreateFloatArray(e->color, 3);
+    cJSON_AddItemReferenceToObject(configParticle, "color", configColor);
+
+    return configParticle;
+}
+
+void* particlesExchange(Particles* p, void* data, int stale)
+{
+    float* published = p->data;
+    p->data = data;
+    p->published = published;
+    particlesAssign(p);
+
+    // radii and colors never move, so they are only copied once per version
+    if (stale)
+    {
+        memcpy(p->radius, published + 6 * p->capacity,
+               p->count * sizeof(float));
+        memcpy(p->color, published + 7 * p->capacity,
+               p->count * sizeof(float));
+    }
+    return published;
+}
+
+// bounces a packet of particles off a floor once their centers come within
+// their radii of its plane from above
+// the particles are pushed back out along the normal, and the step they took
+// loses its approach, regained as a bounce above PARTICLES_BOUNCE, and as much
+// of its slide as friction takes for the change
+void particlesBounce(ParticlesTask* task, BodiesFloor* floor,
+                     simdf position[3], simdf last[3], simdf radius)
+{
+    const simdf zero = simdSet(0.0f);
+    const float* normal = floor->axes[1];
+
+    simdf offset[3], before[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        simdf origin = simdSet(floor->position[axis]);
+        offset[axis] = simdSub(position[axis], origin);
+        before[axis] = simdSub(last[axis], origin);
+    }
+    simdf height = simdDot(normal, offset[0], offset[1], offset[2]);
+    simdf above = simdDot(normal, before[0], before[1], before[2]);
+
+    // particles which were already below the plane have fallen past an edge
+    simdm touching = simdAnd(simdGt(radius, height), simdGt(above, zero));
+    if (!task->infinite)
+    {
+        simdf half = simdSet(floor->half);
+        for (int axis = 0; axis < 3; axis += 2)
+        {
+            simdf across = simdDot(floor->axes[axis], offset[0], offset[1],
+                                   offset[2]);
+            across = simdMax(across, simdNeg(across));
+            touching = simdAnd(touching, simdGt(half, across));
+        }
+    }
+    if (!simdAny(touching))
+    {
+        return;
+    }
+
+    simdf step[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        step[axis] = simdSub(position[axis], last[axis]);
+    }
+    simdf along = simdDot(normal, step[0], step[1], step[2]);
+    simdf approach = simdMin(along, zero);
+    simdm bounces =
+        simdGt(simdSet(-PARTICLES_BOUNCE * task->dt), approach);
+    simdf change = simdMul(
+        simdNeg(approach),
+        simdSelect(bounces, simdSet(1.0f + task->restitution),
+                   simdSet(1.0f)));
+
+    simdf slide[3];
+    simdf sliding = simdSet(PARTICLES_EPSILON);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        slide[axis] = simdSub(step[axis],
+                              simdMul(along, simdSet(normal[axis])));
+        sliding = simdMulAdd(slide[axis], slide[axis], sliding);
+    }
+    simdf kept = simdMax(
+        simdSub(simdSet(1.0f),
+                simdDiv(simdMul(simdSet(task->friction), change),
+                        simdSqrt(sliding))),
+        zero);
+
+    // the slide friction took is also taken back from the position, so
+    // particles held by friction stay put rather than creeping downhill
+    simdf push = simdSub(radius, height);
+    simdf away = simdAdd(along, change);
+    simdf lost = simdSub(simdSet(1.0f), kept);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        simdf n = simdSet(normal[axis]);
+        simdf next = simdSub(simdMulAdd(n, push, position[axis]),
+                             simdMul(slide[axis], lost));
+        simdf moved = simdMulAdd(n, away, simdMul(slide[axis], kept));
+        position[axis] = simdSelect(touching, next, position[axis]);
+        last[axis] = simdSelect(touching, simdSub(next, moved), last[axis]);
+    }
+}
+
+// advances a chunk of particles by a single time step, SIMD_WIDTH at a time
+void particlesStep(void* data, unsigned int first, unsigned int last,
+                   unsigned int worker)
+{
+    ParticlesTask* task = data;
+    Particles* p = task->p;
+    const simdf dt2 = simdSet(task->dt * task->dt);
+    const simdf gravity = simdSet(task->gravity);
+
+    for (unsigned int i = first; i < last; i += SIMD_WIDTH)
+    {
+        simdf position[3], previous[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            simdf current = simdLoad(task->position[axis] + i);
+            simdf delta =
+                simdSub(current, simdLoad(task->lastPosition[axis] + i));
+            if (axis == 1)
+            {
+                delta = simdMulAdd(gravity, dt2, delta);
+            }
+            previous[axis] = current;
+            position[axis] = simdAdd(current, delta);
+        }
+
+        simdf radius = simdLoad(p->radius + i);
+        for (unsigned int f = 0; f < task->floorCount; f++)
+        {
+            particlesBounce(task, task->floors + f, position, previous,
+                            radius);
+        }
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            simdStore(p->position[axis] + i, position[axis]);
+            simdStore(p->lastPosition[axis] + i, previous[axis]);
+        }
+    }
+}
+
+void particlesUpdate(Particles* p, Bodies* floors, float gravity, float dt,
+                     float friction, float restitution, int infinite,
+                     Pool* pool, Arena* frame)
+{
+    if (!p->count)
+    {
+        p->published = NULL;
+        return;
+    }
+
+    ParticlesTask task;
+    task.p = p;
+    task.gravity = gravity;
+    task.dt = dt;
+    task.friction = friction;
+    task.restitution = restitution;
+    task.infinite = infinite;
+
+    // the first step after an exchange reads the published positions
+    for (int axis = 0; axis < 3; axis++)
+    {
+        task.position[axis] = p->position[axis];
+        task.lastPosition[axis] = p->lastPosition[axis];
+        if (p->published)
+        {
+            task.position[axis] = p->published + axis * p->capacity;
+            task.lastPosition[axis] = p->published + (3 + axis) * p->capacity;
+        }
+    }
+
+    task.floorCount = floors->count;
+    task.floors = arenaAlloc(frame, floors->count * sizeof(BodiesFloor));
+    for (unsigned int f = 0; f < floors->count; f++)
+    {
+        bodiesFloor(floors, f, task.floors + f);
+    }
+
+    poolFor(pool, p->count, PARTICLES_CHUNK, particlesStep, &task);
+    p->published = NULL;
+}
@@ -0,0 +1,108 @@
+/*
+ * particles.h
+ *
+ * Structure-of-arrays storage and stepping for particles, point masses too
+ * numerous and too small to be worth the streams of a body
+ *
+ * A particle only has a position, its position before the last step, a
+ * radius, and a color packed into four bytes, so it takes 32 bytes where a
+ * body takes over a hundred. Particles fall under gravity and bounce off
+ * floors with the friction and restitution of every other contact, but
+ * collide with neither each other nor any body, have no orientation, are
+ * never asleep, and are not moved by force generators, so each step is a
+ * single SIMD pass over their streams split across the pool
+ *
+ * Particles are appended in bulk from the config and never removed, so their
+ * radii and colors only change when the version does and copies of them can
+ * be kept until then. They are drawn as point sprites straight from their
+ * streams rather than as instanced meshes
+ *
+ * Publishing hands the whole allocation to a snapshot in exchange for an older
+ * one instead of copying it. The next step then reads the positions from the
+ * published streams and writes them into its own, which costs no more than
+ * stepping in place
+ */
+
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <cglm/cglm.h>
+
+#include "bodies.h"
+#include "cJSON.h"
+#include "utils/arena.h"
+#include "utils/pool.h"
+
+#define PARTICLES_STREAMS 8  // streams of four bytes each
+
+// a box of particles scattered by one call to particlesScatter, kept so a
+// config can be saved without writing out every particle
+typedef struct ParticlesEmitter
+{
+    unsigned int count;
+    vec3 center;
+    vec3 spread;    // half extents of the box
+    vec3 velocity;
+    float radius;
+    vec3 color;
+} ParticlesEmitter;
+
+typedef struct Particles
+{
+    unsigned int count;
+    unsigned int capacity;  // number of particles each stream can hold
+    unsigned int version;   // bumped whenever particles are added
+
+    float* position[3];
+    float* lastPosition[3];  // prior position for Verlet integration
+    float* radius;
+    unsigned int* color;  // red, green, blue, and alpha bytes from the lowest
+
+    void* data;  // single allocation backing all of the streams
+    const float* published;  // allocation handed over by the last exchange,
+                             // which holds the positions until the next step,
+                             // or NULL if the streams do
+
+    unsigned int emitterCount;
+    unsigned int emitterCapacity;
+    ParticlesEmitter* emitters;  // every scattering, in the order it ran
+} Particles;
+
+// initializes an empty store with room for the given number of particles
+void particlesInit(Particles* p, unsigned int capacity);
+
+// releases all streams
+void particlesFree(Particles* p);
+
+// grows every stream to hold at least the given number of particles
+void particlesReserve(Particles* p, unsigned int capacity);
+
+// packs a color with components between 0 and 1 into four bytes
+unsigned int particlesColor(vec3 color);
+
+// appends count particles scattered uniformly over a box of the given half
+// extents around a center, all moving at the same velocity
+// the scattering only depends on how many particles came before, so a config
+// loads the same way every time
+void particlesScatter(Particles* p, unsigned int count, vec3 center,
+                      vec3 spread, vec3 velocity, float radius, vec3 color,
+                      float dt);
+
+// converts an emitter into the config entry which scatters the same particles
+// when loaded after the same emitters
+cJSON* particlesToJSON(ParticlesEmitter* e);
+
+// hands the streams over in exchange for an allocation of the same capacity,
+// whose radii and colors are refreshed if they are stale, and returns the
+// handed over allocation
+// the next step reads its positions from there, so it must stay unchanged
+// until then
+void* particlesExchange(Particles* p, void* data, int stale);
+
+// advances every particle by a single time step under uniform gravity along
+// the y axis, then bounces those which have reached a floor off of it
+void particlesUpdate(Particles* p, Bodies* floors, float gravity, float dt,
+                     float friction, float restitution, int infinite,
+                     Pool* pool, Arena* frame);
+
+#endif
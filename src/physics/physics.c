@@ -1,80 +1,374 @@
 #include "physics.h"
 
 #include <cglm/cglm.h>
+#include <stdio.h>
+#include <time.h>
 
 #include "../simulation.h"
-#include "object.h"
+#include "bodies.h"
+#include "broadphase.h"
+#include "dem.h"
+#include "forces.h"
+#include "integrate.h"
+#include "narrowphase.h"
+#include "particles.h"
+#include "reorder.h"
+#include "sleep.h"
+#include "snapshot.h"
+#include "solver.h"
+#include "speculative.h"
+#include "utils/arena.h"
+#include "utils/pool.h"
+#include "xpbd.h"
 
-// finds current accelerations for each object in the simulation
-void resolveForces(Simulation* sim)
+// number of bodies handed to a worker at a time
+// a multiple of every SIMD width so only the final chunk has a scalar tail
+#define PHYSICS_CHUNK 4096
+
+const char* DYNAMICS_NAMES[] = {"impulse", "xpbd", "dem"};
+
+// shared state for the per-chunk phases of a physics step
+typedef struct PhysicsTask
+{
+    Bodies* b;
+    unsigned int first;  // first dynamic body, since static ones lead
+    float gravity;
+    float dt;
+} PhysicsTask;
+
+// advances a chunk of bodies by a single time step
+void integrate(void* data, unsigned int first, unsigned int last,
+               unsigned int worker)
+{
+    PhysicsTask* task = data;
+    first += task->first;
+    last += task->first;
+    integrateLinear(task->b, task->gravity, task->dt, first, last);
+    integrateAngular(task->b, task->dt, first, last);
+}
+
+// advances every dynamic body by the time step of the tasks
+void physicsIntegrate(Simulation* sim, PhysicsTask* tasks)
 {
     for (int type = 0; type < OBJECT_TYPES; type++)
     {
-        for (int i = 0; i < sim->objectCounts[type]; i++)
-        {
-            if (sim->objects[type][i].staticPhysics)
-            {
-                continue;
-            }
+        Bodies* b = &sim->bodies[type];
+        poolFor(&sim->pool, b->count - b->staticCount, PHYSICS_CHUNK,
+                integrate, tasks + type);
+    }
+}
 
-            glm_vec3_copy((vec3){0, sim->gravity, 0},
-                          sim->objects[type][i].linearAcceleration);
-            // glm_vec3_copy((vec3) { 0, 0, 0 },
-            // sim->objects[type][i].linearAcceleration);
-        }
+// finds candidate pairs at the current positions, along with the bodies
+// touching each floor, then turns each group of pairs between two types into
+// contacts as a single batch
+// fast bodies are grown for the whole search so it also finds what they reach
+// within the step, and sleeping bodies touched by an awake one are woken
+// before any contact is resolved
+void physicsCollide(Simulation* sim, int carried)
+{
+    broadphaseCell(&sim->broadphase, sim->bodies);
+    speculativeGrow(&sim->speculative, sim->bodies, sim->gravity,
+                    sim->physicsDT, carried);
+    broadphaseUpdate(&sim->broadphase, sim->bodies, &sim->pool, &sim->frame);
+    planesUpdate(&sim->planes, sim->bodies, &sim->pool, &sim->frame);
+    narrowphaseUpdate(&sim->narrowphase, sim->collisionTable, &sim->planes,
+                      &sim->broadphase, sim->bodies, &sim->pool, &sim->frame);
+    speculativeShrink(&sim->speculative, &sim->narrowphase, sim->bodies);
+    sleepWake(&sim->sleep, &sim->narrowphase, sim->bodies);
+}
+
+// takes the step again as substeps which hold the contacts of the trial step
+// apart on positions
+void physicsSubstep(Simulation* sim, PhysicsTask* tasks)
+{
+    Xpbd* x = &sim->xpbd;
+    xpbdPrepare(x, &sim->narrowphase, sim->bodies, &sim->pool);
+
+    float h = sim->physicsDT / x->substeps;
+    for (int type = 0; type < OBJECT_TYPES; type++)
+    {
+        tasks[type].dt = h;
+    }
+
+    for (unsigned int substep = 0; substep < x->substeps; substep++)
+    {
+        xpbdPredict(x, sim->bodies, h);
+        physicsIntegrate(sim, tasks);
+        xpbdSolve(x, sim->bodies, h, &sim->pool);
     }
+    xpbdFinish(x, sim->bodies);
 }
 
-// use Verlet integration to update object positions
-void linearUpdate(Object* object)
+void physicsUpdate(Simulation* sim)
 {
-    vec3 deltaPosition;
-    glm_vec3_sub(object->position, object->lastPosition, deltaPosition);
+    // scratch from the last step is released all at once
+    arenaReset(&sim->frame);
+    poolReset(&sim->pool);
 
-    glm_vec3_scale(object->linearAcceleration, PHYSICS_DT2,
-                   object->linearAcceleration);
+    PhysicsTask tasks[OBJECT_TYPES];
+    for (int type = 0; type < OBJECT_TYPES; type++)
+    {
+        tasks[type].b = &sim->bodies[type];
+        tasks[type].first = sim->bodies[type].staticCount;
+        tasks[type].gravity = sim->gravity;
+        tasks[type].dt = sim->physicsDT;
+    }
+
+    // every phase must finish across all threads before the next one starts,
+    // which poolFor guarantees by blocking until all chunks are done
+    forcesUpdate(&sim->forces, sim->bodies, &sim->sleep, sim->physicsDT,
+                 &sim->pool, &sim->frame);
+
+    // particles only meet floors, so they step on their own whatever resolves
+    // the contacts between bodies
+    particlesUpdate(&sim->particles, &sim->bodies[FLOOR], sim->gravity,
+                    sim->physicsDT, sim->friction, sim->restitution,
+                    sim->infiniteFloors, &sim->pool, &sim->frame);
+
+    if (sim->dynamics == DYNAMICS_DEM)
+    {
+        // contacts push spheres apart through their accelerations, so the
+        // integrator resolves them and no pairs are searched for or solved
+        demUpdate(&sim->dem, sim->bodies, sim->physicsDT, &sim->pool,
+                  &sim->frame);
+        physicsIntegrate(sim, tasks);
+        return;
+    }
+
+    if (sim->dynamics == DYNAMICS_XPBD)
+    {
+        // contacts come from a trial step, so pairs which only meet partway
+        // through the step are already held apart by its substeps
+        xpbdSave(&sim->xpbd, sim->bodies);
+        physicsIntegrate(sim, tasks);
+        physicsCollide(sim, 0);
+        physicsSubstep(sim, tasks);
+        sleepUpdate(&sim->sleep, &sim->xpbd.islands, sim->bodies,
+                    sim->gravity, sim->physicsDT, 0);
+        return;
+    }
 
-    glm_vec3_copy(object->position, object->lastPosition);
-    glm_vec3_addadd(deltaPosition, object->linearAcceleration,
-                    object->position);
+    // contacts at the new positions correct the velocities the next step
+    // carries forwards
+    physicsIntegrate(sim, tasks);
+    physicsCollide(sim, 1);
+    solverUpdate(&sim->solver, &sim->narrowphase, sim->bodies, sim->gravity,
+                 sim->physicsDT, &sim->pool);
+    sleepUpdate(&sim->sleep, &sim->solver.islands, sim->bodies, sim->gravity,
+                sim->physicsDT, 1);
 }
 
-// use sympletic Euler to update angular orientation
-void angularUpdate(Object* object)
+void physicsReorder(Simulation* sim)
 {
-    // update angular velocity
-    glm_vec3_muladds(object->angularAcceleration, PHYSICS_DT,
-                     object->angularVelocity);
+    // nothing allocated by the last step is needed any more
+    arenaReset(&sim->frame);
+    poolReset(&sim->pool);
+
+    if (!reorderUpdate(&sim->reorder, sim->bodies, &sim->pool, &sim->frame))
+    {
+        return;
+    }
 
-    // calculate angle and rotation axis
-    float angle = glm_vec3_norm(object->angularVelocity);
-    vec3 axis;
-    glm_vec3_scale(object->angularVelocity, angle, axis);
-    angle *= PHYSICS_DT;
+    // state kept by index across steps follows the bodies to their new places
+    sleepRemap(&sim->sleep, sim->bodies, sim->reorder.places);
+    narrowphaseRemap(&sim->narrowphase, &sim->broadphase, sim->reorder.places,
+                     &sim->frame);
+    solverRemap(&sim->solver, sim->reorder.places, &sim->frame);
+    broadphaseInvalidate(&sim->broadphase);
+    demInvalidate(&sim->dem);
+}
 
-    versor deltaOrientation;
-    glm_quatv(deltaOrientation, angle, axis);
+// starts the places of a store's bodies where they are now, so a spawn or
+// despawn only has to fill in the bodies it moves
+unsigned int* physicsPlaces(Simulation* sim, Bodies* b)
+{
+    unsigned int* places =
+        arenaAlloc(&sim->frame, b->count * sizeof(unsigned int));
+    for (unsigned int i = 0; i < b->count; i++)
+    {
+        places[i] = i;
+    }
+    return places;
+}
 
-    glm_quat_mul(deltaOrientation, object->orientation, object->orientation);
-    glm_quat_normalize(object->orientation);
+// moves state kept by index across steps to the new places of a store's
+// bodies, or only rebuilds what depends on the count if none moved
+void physicsRemap(Simulation* sim, ObjectType type, unsigned int* moved)
+{
+    if (moved)
+    {
+        unsigned int* places[OBJECT_TYPES] = {NULL};
+        places[type] = moved;
+        narrowphaseRemap(&sim->narrowphase, &sim->broadphase, places,
+                         &sim->frame);
+        solverRemap(&sim->solver, places, &sim->frame);
+    }
+    broadphaseInvalidate(&sim->broadphase);
+    demInvalidate(&sim->dem);
 }
 
-void physicsUpdate(Simulation* sim)
+BodiesHandle physicsSpawn(Simulation* sim, Object* o)
 {
-    resolveForces(sim);
+    Bodies* b = &sim->bodies[o->type];
 
-    for (int type = 0; type < OBJECT_TYPES; type++)
+    // a static body takes the place of the first dynamic one, which moves to
+    // the end and so leaves its set
+    unsigned int* places = NULL;
+    if (o->staticPhysics && b->count > b->staticCount)
     {
-        for (int i = 0; i < sim->objectCounts[type]; i++)
+        sleepWakeBody(&sim->sleep, sim->bodies, o->type, b->staticCount);
+        places = physicsPlaces(sim, b);
+        places[b->staticCount] = b->count;
+    }
+    BodiesHandle handle = bodiesHandle(b, bodiesAdd(b, o));
+    physicsRemap(sim, o->type, places);
+    return handle;
+}
+
+unsigned int physicsDespawn(Simulation* sim, BodiesHandle handle)
+{
+    Bodies* b = &sim->bodies[handle.type];
+    unsigned int i = bodiesFind(b, handle);
+    if (i == BODIES_NONE)
+    {
+        return 1;
+    }
+
+    // sets only know their members by index, so those of the removed body
+    // and the one moved into its place wake rather than lose track of them
+    // removing a static body also moves the last static one, which never
+    // sleeps
+    sleepWakeBody(&sim->sleep, sim->bodies, handle.type, i);
+    sleepWakeBody(&sim->sleep, sim->bodies, handle.type, b->count - 1);
+
+    // the moves of bodiesRemove, so cached pairs follow the moved bodies and
+    // those of the removed one are dropped
+    unsigned int* places = physicsPlaces(sim, b);
+    unsigned int hole = i;
+    places[i] = BODIES_NONE;
+    if (i < b->staticCount && i != b->staticCount - 1)
+    {
+        hole = b->staticCount - 1;
+        places[hole] = i;
+    }
+    if (hole != b->count - 1)
+    {
+        places[b->count - 1] = hole;
+    }
+
+    bodiesRemove(b, i);
+    physicsRemap(sim, handle.type, places);
+    return 0;
+}
+
+// sleeps the calling thread for the given number of seconds
+void physicsSleep(double seconds)
+{
+    if (seconds <= 0.0)
+    {
+        return;
+    }
+
+    struct timespec duration;
+    duration.tv_sec = (time_t)seconds;
+    duration.tv_nsec = (long)((seconds - duration.tv_sec) * 1e9);
+    nanosleep(&duration, NULL);
+}
+
+// main loop of the physics thread
+// a wall clock accumulator runs as many fixed steps as have come due, so
+// simulated time advances at real speed regardless of the physics rate or how
+// long each frame takes to render
+void* physicsThread(void* arg)
+{
+    Simulation* sim = arg;
+    PhysicsThread* p = &sim->physics;
+    double dt = sim->physicsDT;
+
+    // heap allocations are reported per step from the total at each publish
+    unsigned long long allocations =
+        sim->frame.allocations + poolAllocations(&sim->pool);
+
+    p->clock = glfwGetTime();
+    while (atomic_load(&p->running))
+    {
+        double now = glfwGetTime();
+        unsigned int due = (unsigned int)((now - p->clock) / dt);
+
+        // after a stall, take a bounded number of steps and drop the rest of
+        // the backlog rather than falling further behind with every frame
+        if (due > PHYSICS_MAX_STEPS)
+        {
+            due = PHYSICS_MAX_STEPS;
+            p->clock = now - due * dt;
+        }
+
+        if (due > 0)
         {
-            if (sim->objects[type][i].staticPhysics)
+            pthread_mutex_lock(&p->mutex);
+            for (unsigned int step = 0; step < due; step++)
             {
-                continue;
-            }
+                physicsReorder(sim);
 
-            linearUpdate(sim->objects[type] + i);
-            angularUpdate(sim->objects[type] + i);
+                // the renderer interpolates from the state before the final
+                // step to the state after it, so bodies must not move between
+                // indices in between
+                if (step == due - 1)
+                {
+                    snapshotPrepare(&p->snapshots, sim->bodies);
+                }
+                physicsUpdate(sim);
+                p->steps++;
+                p->clock += dt;
+            }
+            unsigned long long total =
+                sim->frame.allocations + poolAllocations(&sim->pool);
+            snapshotPublish(&p->snapshots, sim->bodies, &sim->particles,
+                            p->steps, p->clock, dt,
+                            nbodyRate(&sim->forces.nbody),
+                            sim->frame.peak + poolPeak(&sim->pool),
+                            (double)(total - allocations) / due);
+            allocations = total;
+            pthread_mutex_unlock(&p->mutex);
         }
+
+        physicsSleep(p->clock + dt - glfwGetTime());
     }
+
+    return NULL;
 }
 
+unsigned int physicsStart(Simulation* sim)
+{
+    PhysicsThread* p = &sim->physics;
+    if (p->started)
+    {
+        return 0;
+    }
+
+    atomic_store(&p->running, 1);
+    if (pthread_create(&p->thread, NULL, physicsThread, sim))
+    {
+        printf(
+            "ERROR::PHYSICS::THREAD_CREATION_FAILED: could not start the "
+            "physics thread\n");
+        atomic_store(&p->running, 0);
+        return 1;
+    }
+    p->started = 1;
+
+    return 0;
+}
+
+void physicsStop(Simulation* sim)
+{
+    PhysicsThread* p = &sim->physics;
+    if (!p->started)
+    {
+        return;
+    }
+
+    atomic_store(&p->running, 0);
+    pthread_join(p->thread, NULL);
+    p->started = 0;
+}
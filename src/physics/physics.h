@@ -1,13 +1,64 @@
 #ifndef PHYSICS_H
 #define PHYSICS_H
 
-#define PHYSICS_DT 0.0166666666667
-#define PHYSICS_DT2 0.000277777777778
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "bodies.h"
+#include "snapshot.h"
+
+#define PHYSICS_RATE 60.0f   // default number of steps per simulated second
+#define PHYSICS_MAX_STEPS 8  // most catch-up steps before dropping time
+
+#define DYNAMICS_MODES 3
+
+extern const char* DYNAMICS_NAMES[DYNAMICS_MODES];
+
+// how contacts change the motion of the bodies they touch
+typedef enum
+{
+    DYNAMICS_IMPULSE,  // velocity impulses once per step
+    DYNAMICS_XPBD,     // position corrections over substeps
+    DYNAMICS_DEM       // soft contact forces between spheres
+} DynamicsMode;
 
 typedef struct Simulation Simulation;
 
+// background thread which steps the simulation independently of rendering
+typedef struct PhysicsThread
+{
+    pthread_t thread;
+    pthread_mutex_t mutex;  // held for the duration of every step
+    atomic_int running;     // cleared to ask the thread to exit
+    int started;            // whether the thread is currently alive
+    unsigned long long steps;  // number of steps taken since initialization
+    double clock;  // wall clock time which the current state corresponds to
+    SnapshotBuffer snapshots;  // published states read by the render thread
+} PhysicsThread;
+
 // update object positions
 void physicsUpdate(Simulation* sim);
 
-#endif
+// sorts the bodies along a Morton curve once the reorder interval has passed,
+// moving everything kept by index along with them
+// while the physics thread runs, callers must hold its mutex
+void physicsReorder(Simulation* sim);
+
+// adds a body between steps and returns a handle to it
+// bodies may move to other indices, so while the physics thread runs callers
+// must hold sim->physics.mutex for the whole call, as simulationThrow does
+BodiesHandle physicsSpawn(Simulation* sim, Object* o);
+
+// removes the body a handle refers to between steps, returning 1 if it was
+// already removed
+// bodies may move to other indices, so while the physics thread runs callers
+// must hold sim->physics.mutex for the whole call, as simulationUnthrow does
+unsigned int physicsDespawn(Simulation* sim, BodiesHandle handle);
 
+// starts stepping physics in real time on a background thread
+unsigned int physicsStart(Simulation* sim);
+
+// blocks until the physics thread has finished its current step and exited
+void physicsStop(Simulation* sim);
+
+#endif
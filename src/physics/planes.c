@@ -0,0 +1,337 @@
+#include "planes.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "objects/tetrahedron.h"
+#include "simd.h"
+
+#define PLANES_CHUNK 1024  // bodies handed to a worker at a time
+
+// streams of SIMD_WIDTH consecutive bodies
+typedef struct PlanesLoad
+{
+    const float* position[3];
+    const float* orientation[4];
+    const float* size;
+    const int* sleeping;
+} PlanesLoad;
+
+// shared state for sweeping chunks of bodies
+typedef struct PlanesTask
+{
+    Planes* p;
+    Bodies* bodies;
+} PlanesTask;
+
+void planesInit(Planes* p, int infinite)
+{
+    memset(p, 0, sizeof(Planes));
+    p->infinite = infinite;
+}
+
+void planesFree(Planes* p)
+{
+    free(p->pairs);
+    memset(p, 0, sizeof(Planes));
+}
+
+unsigned int planesGroup(ObjectType type, PlanesKind kind)
+{
+    return type * PLANES_KINDS + kind;
+}
+
+simdf planesAbs(simdf a) { return simdMax(a, simdNeg(a)); }
+
+// returns how far the lowest point of each body lies below its center along a
+// floor's normal
+simdf planesReach(BodiesFloor* floor, ObjectType type, PlanesLoad* load,
+                  float tetrahedron[4][3])
+{
+    simdf size = simdLoad(load->size);
+    if (type == SPHERE)
+    {
+        return size;
+    }
+
+    // the normal in each body's local frame, rotating by the inverse of its
+    // orientation as n - w t + u x t with t = 2 u x n
+    simdf ux = simdLoad(load->orientation[0]);
+    simdf uy = simdLoad(load->orientation[1]);
+    simdf uz = simdLoad(load->orientation[2]);
+    simdf w = simdLoad(load->orientation[3]);
+    simdf nx = simdSet(floor->axes[1][0]);
+    simdf ny = simdSet(floor->axes[1][1]);
+    simdf nz = simdSet(floor->axes[1][2]);
+    simdf two = simdSet(2.0f);
+
+    simdf tx = simdMul(two, simdSub(simdMul(uy, nz), simdMul(uz, ny)));
+    simdf ty = simdMul(two, simdSub(simdMul(uz, nx), simdMul(ux, nz)));
+    simdf tz = simdMul(two, simdSub(simdMul(ux, ny), simdMul(uy, nx)));
+    simdf mx = simdAdd(simdSub(nx, simdMul(w, tx)),
+                       simdSub(simdMul(uy, tz), simdMul(uz, ty)));
+    simdf my = simdAdd(simdSub(ny, simdMul(w, ty)),
+                       simdSub(simdMul(uz, tx), simdMul(ux, tz)));
+    simdf mz = simdAdd(simdSub(nz, simdMul(w, tz)),
+                       simdSub(simdMul(ux, ty), simdMul(uy, tx)));
+
+    if (type == CUBE)
+    {
+        // corners lie on a sphere of radius size
+        simdf extent = simdAdd(planesAbs(mx), simdAdd(planesAbs(my),
+                                                      planesAbs(mz)));
+        return simdMul(simdMul(size, simdSet(1.0f / 1.73205081f)), extent);
+    }
+
+    // the vertex furthest against the normal
+    simdf lowest = simdSet(0.0f);
+    for (int v = 0; v < 4; v++)
+    {
+        simdf along = simdMulAdd(
+            mx, simdSet(tetrahedron[v][0]),
+            simdMulAdd(my, simdSet(tetrahedron[v][1]),
+                       simdMul(mz, simdSet(tetrahedron[v][2]))));
+        lowest = v ? simdMin(lowest, along) : along;
+    }
+    return simdNeg(simdMul(size, lowest));
+}
+
+// tests SIMD_WIDTH bodies against a floor, setting touch for the awake bodies
+// reaching below the plane within its edges and face for those of them which
+// are clear of the edges
+void planesLanes(BodiesFloor* floor, ObjectType type, PlanesLoad* load,
+                 float tetrahedron[4][3], int infinite, float* touch,
+                 float* face)
+{
+    simdm awake = simdZeroFlags(load->sleeping);
+
+    simdf x = simdSub(simdLoad(load->position[0]), simdSet(floor->position[0]));
+    simdf y = simdSub(simdLoad(load->position[1]), simdSet(floor->position[1]));
+    simdf z = simdSub(simdLoad(load->position[2]), simdSet(floor->position[2]));
+    simdf height = simdDot(floor->axes[1], x, y, z);
+    simdf reach = planesReach(floor, type, load, tetrahedron);
+    simdm touching = simdAnd(awake, simdGt(reach, height));
+
+    simdm clear = touching;
+    if (!infinite)
+    {
+        // every shape fits inside a sphere of radius size, so that bounds how
+        // far past an edge or below the plane a touching body can be
+        simdf size = simdLoad(load->size);
+        simdf u = planesAbs(simdDot(floor->axes[0], x, y, z));
+        simdf v = planesAbs(simdDot(floor->axes[2], x, y, z));
+        simdf half = simdSet(floor->half);
+        simdf outer = simdAdd(half, size);
+        simdf inner = simdSub(half, size);
+
+        touching = simdAnd(touching, simdGt(height, simdNeg(size)));
+        touching = simdAnd(touching, simdAnd(simdGt(outer, u),
+                                             simdGt(outer, v)));
+
+        // a center above the plane whose sphere stays inside the square can
+        // only touch the face
+        simdm inside = simdAnd(simdGt(inner, u), simdGt(inner, v));
+        simdm above = simdOr(simdGt(height, simdSet(0.0f)),
+                             simdEq(height, simdSet(0.0f)));
+        clear = simdAnd(touching, simdAnd(inside, above));
+    }
+
+    simdStore(touch, simdSelect(touching, simdSet(1.0f), simdSet(0.0f)));
+    simdStore(face, simdSelect(clear, simdSet(1.0f), simdSet(0.0f)));
+}
+
+// points the streams at SIMD_WIDTH bodies starting from i, copying the tail of
+// a store into padded buffers whose extra lanes are asleep
+void planesLoad(Bodies* b, unsigned int i, unsigned int end,
+                PlanesLoad* load, float padded[8][SIMD_WIDTH],
+                int flags[SIMD_WIDTH])
+{
+    if (i + SIMD_WIDTH <= end)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            load->position[axis] = b->position[axis] + i;
+        }
+        for (int axis = 0; axis < 4; axis++)
+        {
+            load->orientation[axis] = b->orientation[axis] + i;
+        }
+        load->size = b->size + i;
+        load->sleeping = b->sleeping + i;
+        return;
+    }
+
+    unsigned int lanes = end - i;
+    memset(padded, 0, 8 * SIMD_WIDTH * sizeof(float));
+    for (int lane = 0; lane < SIMD_WIDTH; lane++)
+    {
+        flags[lane] = 1;
+    }
+    for (int axis = 0; axis < 3; axis++)
+    {
+        memcpy(padded[axis], b->position[axis] + i, lanes * sizeof(float));
+        load->position[axis] = padded[axis];
+    }
+    for (int axis = 0; axis < 4; axis++)
+    {
+        memcpy(padded[3 + axis], b->orientation[axis] + i,
+               lanes * sizeof(float));
+        load->orientation[axis] = padded[3 + axis];
+    }
+    memcpy(padded[7], b->size + i, lanes * sizeof(float));
+    memcpy(flags, b->sleeping + i, lanes * sizeof(int));
+    load->size = padded[7];
+    load->sleeping = flags;
+}
+
+// sweeps every floor against a range of chunks of bodies
+void planesSweep(void* data, unsigned int first, unsigned int last,
+                 unsigned int worker)
+{
+    PlanesTask* task = data;
+    Planes* p = task->p;
+    Bodies* floors = task->bodies + FLOOR;
+
+    float tetrahedron[4][3];
+    tetrahedronVertices(tetrahedron);
+
+    for (unsigned int index = first; index < last; index++)
+    {
+        PlanesChunk* chunk = p->chunks + index;
+        Bodies* b = task->bodies + chunk->type;
+        BroadphasePair* out = p->scratch + chunk->offset;
+        unsigned char* kinds = p->kinds + chunk->offset;
+        unsigned int end = chunk->first + chunk->count;
+        chunk->found = 0;
+        memset(chunk->counts, 0, sizeof(chunk->counts));
+
+        for (unsigned int f = 0; f < floors->count; f++)
+        {
+            BodiesFloor floor;
+            bodiesFloor(floors, f, &floor);
+
+            for (unsigned int i = chunk->first; i < end; i += SIMD_WIDTH)
+            {
+                PlanesLoad load;
+                float padded[8][SIMD_WIDTH];
+                int flags[SIMD_WIDTH];
+                planesLoad(b, i, end, &load, padded, flags);
+
+                float touch[SIMD_WIDTH], face[SIMD_WIDTH];
+                planesLanes(&floor, chunk->type, &load, tetrahedron,
+                            p->infinite, touch, face);
+
+                for (unsigned int lane = 0; lane < SIMD_WIDTH; lane++)
+                {
+                    if (i + lane >= end || touch[lane] == 0.0f)
+                    {
+                        continue;
+                    }
+                    PlanesKind kind =
+                        face[lane] != 0.0f ? PLANES_FACE : PLANES_EDGE;
+                    out[chunk->found].a = f;
+                    out[chunk->found].b = i + lane;
+                    kinds[chunk->found++] = kind;
+                    chunk->counts[kind]++;
+                }
+            }
+        }
+    }
+}
+
+// copies the candidates of a range of chunks into their groups
+void planesMerge(void* data, unsigned int first, unsigned int last,
+                 unsigned int worker)
+{
+    Planes* p = ((PlanesTask*)data)->p;
+
+    for (unsigned int index = first; index < last; index++)
+    {
+        PlanesChunk* chunk = p->chunks + index;
+        for (unsigned int c = 0; c < chunk->found; c++)
+        {
+            unsigned char kind = p->kinds[chunk->offset + c];
+            p->pairs[chunk->counts[kind]++] = p->scratch[chunk->offset + c];
+        }
+    }
+}
+
+void planesUpdate(Planes* p, Bodies* bodies, Pool* pool, Arena* frame)
+{
+    PlanesTask task = {p, bodies};
+    unsigned int floors = bodies[FLOOR].count;
+
+    // split the dynamic bodies of every type but floors into chunks
+    p->chunkCount = 0;
+    p->chunkCapacity = 0;
+    p->chunks = NULL;
+    unsigned int slots = 0;
+    for (int type = FLOOR + 1; type < OBJECT_TYPES && floors; type++)
+    {
+        for (unsigned int first = bodies[type].staticCount;
+             first < bodies[type].count; first += PLANES_CHUNK)
+        {
+            if (p->chunkCount == p->chunkCapacity)
+            {
+                unsigned int capacity = p->chunkCapacity ? 2 * p->chunkCapacity
+                                                         : 16;
+                p->chunks = arenaResize(frame, p->chunks,
+                                        p->chunkCapacity * sizeof(PlanesChunk),
+                                        capacity * sizeof(PlanesChunk));
+                p->chunkCapacity = capacity;
+            }
+
+            PlanesChunk* chunk = p->chunks + p->chunkCount++;
+            chunk->type = type;
+            chunk->first = first;
+            chunk->count = bodies[type].count - first;
+            if (chunk->count > PLANES_CHUNK)
+            {
+                chunk->count = PLANES_CHUNK;
+            }
+            chunk->offset = slots;
+            slots += chunk->count * floors;
+        }
+    }
+
+    p->scratch = arenaAlloc(frame, slots * sizeof(BroadphasePair));
+    p->kinds = arenaAlloc(frame, slots);
+
+    poolFor(pool, p->chunkCount, 1, planesSweep, &task);
+
+    // chunks are ordered by type, so each group takes the candidates of its
+    // kind from every chunk of its type in order
+    unsigned int pairs = 0;
+    unsigned int index = 0;
+    for (int type = 0; type < OBJECT_TYPES; type++)
+    {
+        unsigned int end = index;
+        while (end < p->chunkCount && p->chunks[end].type == type)
+        {
+            end++;
+        }
+        for (int kind = 0; kind < PLANES_KINDS; kind++)
+        {
+            p->groupStarts[planesGroup(type, kind)] = pairs;
+            for (unsigned int c = index; c < end; c++)
+            {
+                unsigned int found = p->chunks[c].counts[kind];
+                p->chunks[c].counts[kind] = pairs;
+                pairs += found;
+            }
+        }
+        index = end;
+    }
+    p->groupStarts[PLANES_GROUPS] = pairs;
+    p->pairCount = pairs;
+
+    if (pairs > p->pairCapacity)
+    {
+        free(p->pairs);
+        p->pairCapacity =
+            pairs > 2 * p->pairCapacity ? pairs : 2 * p->pairCapacity;
+        p->pairs = malloc(p->pairCapacity * sizeof(BroadphasePair));
+    }
+
+    poolFor(pool, p->chunkCount, 1, planesMerge, &task);
+}
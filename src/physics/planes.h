@@ -0,0 +1,83 @@
+/*
+ * planes.h
+ *
+ * Finds the bodies touching each floor with a dedicated SIMD sweep, keeping
+ * floors out of the broadphase
+ *
+ * A floor is a plane through its position along its local y axis, and since
+ * its box overlaps nearly every other box it would pair with everything in the
+ * broadphase. Instead each floor is swept against the dynamic bodies of every
+ * other type SIMD_WIDTH bodies at a time, finding how far below the plane the
+ * lowest point of each body reaches: the radius of a sphere, or the deepest
+ * vertex of a cube or tetrahedron found from its orientation and size
+ *
+ * Floors end at the edges of a square of half side length size unless the
+ * config makes them infinite. Bodies which touch the plane clear of the edges
+ * are candidates on the face, which the narrowphase resolves analytically,
+ * while those which may hang over an edge go through the floor's usual kernels
+ *
+ * Candidates are grouped by the type of body and then by kind, in the same
+ * order for any number of threads
+ */
+
+#ifndef PLANES_H
+#define PLANES_H
+
+#include "bodies.h"
+#include "broadphase.h"
+#include "utils/arena.h"
+#include "utils/pool.h"
+
+#define PLANES_KINDS 2
+#define PLANES_GROUPS (OBJECT_TYPES * PLANES_KINDS)
+
+// how a body touching a floor is resolved
+typedef enum
+{
+    PLANES_FACE,  // touches the plane clear of its edges
+    PLANES_EDGE   // may touch an edge or lie below the floor
+} PlanesKind;
+
+// range of bodies of a single type swept against every floor by a worker
+typedef struct PlanesChunk
+{
+    ObjectType type;
+    unsigned int first;   // first body in the store of its type
+    unsigned int count;   // number of bodies
+    unsigned int offset;  // first scratch slot, with one per body per floor
+    unsigned int found;   // candidates written from the first slot
+    unsigned int counts[PLANES_KINDS];  // candidates of each kind, then where
+                                        // the chunk's candidates go
+} PlanesChunk;
+
+typedef struct Planes
+{
+    int infinite;  // whether floors extend past their edges
+
+    /* CHUNKS */
+    // allocated from the frame arena, so only valid during a step
+    unsigned int chunkCount;
+    unsigned int chunkCapacity;
+    PlanesChunk* chunks;
+    BroadphasePair* scratch;  // candidates of each chunk in sweep order
+    unsigned char* kinds;     // kind of each candidate in the scratch
+
+    /* PAIRS */
+    unsigned int pairCount;
+    unsigned int pairCapacity;
+    BroadphasePair* pairs;  // floor as a and body as b
+    unsigned int groupStarts[PLANES_GROUPS + 1];  // first pair per group
+} Planes;
+
+void planesInit(Planes* p, int infinite);
+
+void planesFree(Planes* p);
+
+// returns the group of candidates between floors and a type of a given kind
+unsigned int planesGroup(ObjectType type, PlanesKind kind);
+
+// sweeps every floor against every awake body and groups the bodies touching
+// each floor by type and kind, taking its scratch from the frame arena
+void planesUpdate(Planes* p, Bodies* bodies, Pool* pool, Arena* frame);
+
+#endif
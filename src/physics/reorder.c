@@ -0,0 +1,240 @@
+#include "reorder.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "utils/sort.h"
+
+#define REORDER_CHUNK 16384  // bodies handed to a worker at a time
+#define REORDER_BITS 10      // bits of each axis in a Morton key
+#define REORDER_SETTLED 0.05f  // fraction out of order below which the wait
+                               // doubles
+#define REORDER_MIXING 0.25f   // fraction out of order above which the wait
+                               // halves
+
+// shared state for the per-chunk phases of sorting a single store
+typedef struct ReorderTask
+{
+    Reorder* r;
+    Bodies* b;
+    unsigned int start;  // first dynamic body, since static ones never move
+    vec3 low;      // lowest position of any body
+    vec3 scale;    // quantization steps per unit of distance on each axis
+    unsigned int source;  // buffer holding the sorted order
+    float* scratch;       // every stream in the new order
+} ReorderTask;
+
+void reorderInit(Reorder* r, unsigned int interval)
+{
+    memset(r, 0, sizeof(Reorder));
+    r->interval = interval;
+    r->wait = interval;
+}
+
+// spreads the low REORDER_BITS bits of a coordinate two bits apart
+unsigned int reorderSpread(unsigned int x)
+{
+    x = (x | (x << 16)) & 0x030000FFu;
+    x = (x | (x << 8)) & 0x0300F00Fu;
+    x = (x | (x << 4)) & 0x030C30C3u;
+    x = (x | (x << 2)) & 0x09249249u;
+    return x;
+}
+
+// finds the bounds of the positions in a chunk of bodies
+void reorderBounds(void* data, unsigned int first, unsigned int last,
+                   unsigned int worker)
+{
+    ReorderTask* task = data;
+    Bodies* b = task->b;
+
+    for (unsigned int chunk = first / REORDER_CHUNK;
+         chunk * REORDER_CHUNK < last; chunk++)
+    {
+        float* bounds = task->r->bounds + 6 * chunk;
+        unsigned int start = chunk * REORDER_CHUNK;
+        unsigned int end = start + REORDER_CHUNK < last ? start + REORDER_CHUNK
+                                                        : last;
+        start += task->start;
+        end += task->start;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float low = b->position[axis][start];
+            float high = low;
+            for (unsigned int i = start + 1; i < end; i++)
+            {
+                float x = b->position[axis][i];
+                low = x < low ? x : low;
+                high = x > high ? x : high;
+            }
+            bounds[axis] = low;
+            bounds[3 + axis] = high;
+        }
+    }
+}
+
+// computes the Morton key of a chunk of bodies
+void reorderKeys(void* data, unsigned int first, unsigned int last,
+                 unsigned int worker)
+{
+    ReorderTask* task = data;
+    Reorder* r = task->r;
+    Bodies* b = task->b;
+    unsigned int top = (1u << REORDER_BITS) - 1;
+
+    for (unsigned int i = task->start + first; i < task->start + last; i++)
+    {
+        unsigned int key = 0;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float x = (b->position[axis][i] - task->low[axis]) *
+                      task->scale[axis];
+            unsigned int cell = x > 0.0f ? (unsigned int)x : 0;
+            key |= reorderSpread(cell < top ? cell : top) << axis;
+        }
+        r->keys[0][i] = key;
+        r->order[0][i] = i;
+    }
+}
+
+// copies a chunk of bodies in their new order into the scratch store and
+// records where each one went
+void reorderGather(void* data, unsigned int first, unsigned int last,
+                   unsigned int worker)
+{
+    ReorderTask* task = data;
+    unsigned int* order = task->r->order[task->source];
+    unsigned int* places = task->r->places[task->b->type];
+
+    first += task->start;
+    last += task->start;
+    bodiesGather(task->b, order, first, last, task->scratch);
+    for (unsigned int k = first; k < last; k++)
+    {
+        places[order[k]] = k;
+    }
+}
+
+// copies a chunk of bodies back from the scratch store
+void reorderMove(void* data, unsigned int first, unsigned int last,
+                 unsigned int worker)
+{
+    ReorderTask* task = data;
+    bodiesScatter(task->b, task->start + first, task->start + last,
+                  task->scratch);
+}
+
+// sorts the dynamic bodies of a single store and returns how many are no
+// longer followed by the body which followed them before
+// keys and orders are indexed by place in the store, so places before the
+// first dynamic body are left unused
+unsigned int reorderStore(Reorder* r, Bodies* b, Pool* pool, Arena* frame)
+{
+    unsigned int start = b->staticCount;
+    unsigned int count = b->count - start;
+    unsigned int chunks = (count + REORDER_CHUNK - 1) / REORDER_CHUNK;
+    ReorderTask task = {r, b, start};
+
+    for (int buffer = 0; buffer < 2; buffer++)
+    {
+        r->keys[buffer] = arenaAlloc(frame, b->count * sizeof(unsigned int));
+        r->order[buffer] = arenaAlloc(frame, b->count * sizeof(unsigned int));
+    }
+    r->bounds = arenaAlloc(frame, 6 * chunks * sizeof(float));
+
+    // keys are quantized within the bounds of the whole store
+    poolFor(pool, count, REORDER_CHUNK, reorderBounds, &task);
+    vec3 high;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        task.low[axis] = r->bounds[axis];
+        high[axis] = r->bounds[3 + axis];
+        for (unsigned int chunk = 1; chunk < chunks; chunk++)
+        {
+            float* bounds = r->bounds + 6 * chunk;
+            task.low[axis] = fminf(task.low[axis], bounds[axis]);
+            high[axis] = fmaxf(high[axis], bounds[3 + axis]);
+        }
+
+        float extent = high[axis] - task.low[axis];
+        task.scale[axis] =
+            extent > 0.0f ? (1u << REORDER_BITS) / extent : 0.0f;
+    }
+    poolFor(pool, count, REORDER_CHUNK, reorderKeys, &task);
+
+    // radix sort of the dynamic bodies by key
+    unsigned int* keys[2] = {r->keys[0] + start, r->keys[1] + start};
+    unsigned int* orders[2] = {r->order[0] + start, r->order[1] + start};
+    task.source =
+        sortPairs(keys, orders, count, 3 * REORDER_BITS, pool, frame);
+
+    unsigned int* order = r->order[task.source];
+    unsigned int breaks = order[start] != start;
+    for (unsigned int k = start + 1; k < b->count; k++)
+    {
+        breaks += order[k] != order[k - 1] + 1;
+    }
+    if (!breaks)
+    {
+        return 0;
+    }
+
+    // every stream is gathered before any is written back, since a body's
+    // new place may hold another body which has not been gathered yet
+    r->places[b->type] = arenaAlloc(frame, b->count * sizeof(unsigned int));
+    for (unsigned int i = 0; i < start; i++)
+    {
+        r->places[b->type][i] = i;
+    }
+    task.scratch =
+        arenaAlloc(frame, BODIES_STREAMS * b->count * sizeof(float));
+    poolFor(pool, count, REORDER_CHUNK, reorderGather, &task);
+    poolFor(pool, count, REORDER_CHUNK, reorderMove, &task);
+    bodiesRelink(b);
+    return breaks;
+}
+
+unsigned int reorderUpdate(Reorder* r, Bodies* bodies, Pool* pool,
+                           Arena* frame)
+{
+    memset(r->places, 0, sizeof(r->places));
+    if (!r->interval)
+    {
+        return 0;
+    }
+    if (r->countdown)
+    {
+        r->countdown--;
+        return 0;
+    }
+
+    // floors are few and never pair with each other
+    unsigned int breaks = 0;
+    unsigned int count = 0;
+    for (int type = FLOOR + 1; type < OBJECT_TYPES; type++)
+    {
+        unsigned int dynamic = bodies[type].count - bodies[type].staticCount;
+        if (dynamic > 1)
+        {
+            breaks += reorderStore(r, bodies + type, pool, frame);
+            count += dynamic;
+        }
+    }
+
+    // bodies which kept their neighbors in order do not need moving as often
+    r->mixing = count ? (float)breaks / count : 0.0f;
+    unsigned int longest = r->interval * REORDER_RANGE;
+    unsigned int shortest =
+        r->interval > REORDER_RANGE ? r->interval / REORDER_RANGE : 1;
+    if (r->mixing < REORDER_SETTLED)
+    {
+        r->wait = 2 * r->wait < longest ? 2 * r->wait : longest;
+    }
+    else if (r->mixing > REORDER_MIXING)
+    {
+        r->wait = r->wait / 2 > shortest ? r->wait / 2 : shortest;
+    }
+    r->countdown = r->wait;
+
+    return breaks > 0;
+}
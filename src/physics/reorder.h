@@ -0,0 +1,59 @@
+/*
+ * reorder.h
+ *
+ * Periodically sorts each body store along a Morton curve so bodies which are
+ * close in space are also close in memory
+ *
+ * Bodies start in the order the config listed them, which scatters neighbors
+ * across the streams and makes every pass over pairs or contacts jump around
+ * memory. Every so often each store is sorted by the Z-order key of its bodies'
+ * positions, quantized within the bounds of the store, using a parallel least
+ * significant digit radix sort, and every stream is moved into the new order
+ *
+ * Static bodies never move, so they keep their places at the front of each
+ * store and only the dynamic bodies after them are sorted
+ *
+ * Slots follow their bodies so handles stay valid, and the new index of every
+ * body is left in places so state kept by index across steps can follow too
+ *
+ * How far the old order was from the new one measures how fast the scene is
+ * mixing: a scene which barely changed waits longer before the next reorder,
+ * and one which scrambled its order waits less, within a range around the
+ * configured interval
+ */
+
+#ifndef REORDER_H
+#define REORDER_H
+
+#include "bodies.h"
+#include "utils/arena.h"
+#include "utils/pool.h"
+
+#define REORDER_INTERVAL 60  // default steps between reorders, 0 for never
+#define REORDER_RANGE 8  // the wait adapts within this factor of the interval
+
+typedef struct Reorder
+{
+    unsigned int interval;   // steps between reorders from the config
+    unsigned int wait;       // steps between reorders after adapting
+    unsigned int countdown;  // steps left until the next reorder
+    float mixing;  // fraction of bodies out of order at the last reorder
+
+    /* SORT */
+    // allocated from the frame arena, so only valid until it is reset
+    unsigned int* keys[2];  // Morton key of each body in both sort buffers
+    unsigned int* order[2];  // body at each place in both sort buffers
+    float* bounds;             // lowest and highest position of each chunk
+    unsigned int* places[OBJECT_TYPES];  // new index of each body, NULL for
+                                         // stores which kept their order
+} Reorder;
+
+void reorderInit(Reorder* r, unsigned int interval);
+
+// counts down to the next reorder and, once it is due, sorts every store and
+// returns 1 if any body moved
+// must run between steps
+unsigned int reorderUpdate(Reorder* r, Bodies* bodies, Pool* pool,
+                           Arena* frame);
+
+#endif
@@ -0,0 +1,285 @@
+#include "sap.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "broadphase.h"
+
+void sapInit(Sap* s) { memset(s, 0, sizeof(Sap)); }
+
+void sapFree(Sap* s)
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        free(s->endpoints[axis]);
+    }
+    free(s->pairs);
+    free(s->tableKeys);
+    free(s->tableIndices);
+    memset(s, 0, sizeof(Sap));
+}
+
+// packs a pair of flat indices into a key which is never 0
+unsigned long long sapKey(unsigned int i, unsigned int j)
+{
+    if (i > j)
+    {
+        unsigned int temp = i;
+        i = j;
+        j = temp;
+    }
+    return ((unsigned long long)i << 32) | j;
+}
+
+// returns the first table slot to probe for a key
+unsigned int sapSlot(Sap* s, unsigned long long key)
+{
+    return (unsigned int)((key * 0x9E3779B97F4A7C15ull) >> 32) &
+           (s->tableCapacity - 1);
+}
+
+// inserts a key into the table, which must have room for it
+void sapTableInsert(Sap* s, unsigned long long key, unsigned int index)
+{
+    unsigned int slot = sapSlot(s, key);
+    while (s->tableKeys[slot])
+    {
+        slot = (slot + 1) & (s->tableCapacity - 1);
+    }
+    s->tableKeys[slot] = key;
+    s->tableIndices[slot] = index;
+}
+
+// returns the table slot holding a key, or the capacity if it is absent
+unsigned int sapTableFind(Sap* s, unsigned long long key)
+{
+    if (!s->tableCapacity)
+    {
+        return 0;
+    }
+
+    unsigned int slot = sapSlot(s, key);
+    while (s->tableKeys[slot])
+    {
+        if (s->tableKeys[slot] == key)
+        {
+            return slot;
+        }
+        slot = (slot + 1) & (s->tableCapacity - 1);
+    }
+    return s->tableCapacity;
+}
+
+// grows the table and dense pair array so one more pair fits while keeping the
+// table at most half full
+void sapReserve(Sap* s)
+{
+    if (s->pairCount == s->pairCapacity)
+    {
+        s->pairCapacity = s->pairCapacity ? s->pairCapacity * 2 : 64;
+        s->pairs =
+            realloc(s->pairs, s->pairCapacity * sizeof(unsigned long long));
+    }
+
+    if (2 * (s->pairCount + 1) <= s->tableCapacity)
+    {
+        return;
+    }
+
+    free(s->tableKeys);
+    free(s->tableIndices);
+    s->tableCapacity = s->tableCapacity ? s->tableCapacity * 2 : 128;
+    s->tableKeys = calloc(s->tableCapacity, sizeof(unsigned long long));
+    s->tableIndices = malloc(s->tableCapacity * sizeof(unsigned int));
+    for (unsigned int p = 0; p < s->pairCount; p++)
+    {
+        sapTableInsert(s, s->pairs[p], p);
+    }
+}
+
+// records a pair of overlapping bodies if it is not already known
+void sapAdd(Sap* s, unsigned int i, unsigned int j)
+{
+    unsigned long long key = sapKey(i, j);
+    if (sapTableFind(s, key) != s->tableCapacity)
+    {
+        return;
+    }
+
+    sapReserve(s);
+    s->pairs[s->pairCount] = key;
+    sapTableInsert(s, key, s->pairCount);
+    s->pairCount++;
+}
+
+// forgets a pair of bodies if it is known
+void sapRemove(Sap* s, unsigned int i, unsigned int j)
+{
+    unsigned int slot = sapTableFind(s, sapKey(i, j));
+    if (slot == s->tableCapacity)
+    {
+        return;
+    }
+
+    // fill the hole in the dense array with the last pair
+    unsigned int index = s->tableIndices[slot];
+    unsigned long long last = s->pairs[--s->pairCount];
+    if (index != s->pairCount)
+    {
+        s->pairs[index] = last;
+        s->tableIndices[sapTableFind(s, last)] = index;
+    }
+
+    // shift later keys of the probe sequence back so lookups never stop early
+    unsigned int mask = s->tableCapacity - 1;
+    unsigned int hole = slot;
+    unsigned int next = (hole + 1) & mask;
+    while (s->tableKeys[next])
+    {
+        unsigned int home = sapSlot(s, s->tableKeys[next]);
+        if (((next - home) & mask) >= ((next - hole) & mask))
+        {
+            s->tableKeys[hole] = s->tableKeys[next];
+            s->tableIndices[hole] = s->tableIndices[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    s->tableKeys[hole] = 0;
+}
+
+// returns whether endpoint a belongs before endpoint b
+// minimums come before maximums of the same value so touching boxes overlap
+int sapBefore(SapEndpoint* a, SapEndpoint* b)
+{
+    return a->value < b->value ||
+           (a->value == b->value && !(a->data & 1) && (b->data & 1));
+}
+
+int sapCompare(const void* a, const void* b)
+{
+    if (sapBefore((SapEndpoint*)a, (SapEndpoint*)b))
+    {
+        return -1;
+    }
+    return sapBefore((SapEndpoint*)b, (SapEndpoint*)a);
+}
+
+// sorts the endpoints from scratch and finds every pair with a single sweep
+void sapBuild(Sap* s, Broadphase* bp, Arena* frame)
+{
+    // floors never enter the broadphase, so the sweep starts after them
+    unsigned int floors = bp->offsets[FLOOR + 1];
+    unsigned int count = bp->offsets[OBJECT_TYPES] - floors;
+    s->count = bp->offsets[OBJECT_TYPES];
+    memcpy(s->offsets, bp->offsets, sizeof(s->offsets));
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        free(s->endpoints[axis]);
+        s->endpoints[axis] = malloc(2 * (count ? count : 1) *
+                                    sizeof(SapEndpoint));
+        for (unsigned int e = 0; e < count; e++)
+        {
+            unsigned int i = floors + e;
+            s->endpoints[axis][2 * e].value = bp->boxes[i].min[axis];
+            s->endpoints[axis][2 * e].data = i << 1;
+            s->endpoints[axis][2 * e + 1].value = bp->boxes[i].max[axis];
+            s->endpoints[axis][2 * e + 1].data = (i << 1) | 1;
+        }
+        qsort(s->endpoints[axis], 2 * count, sizeof(SapEndpoint), sapCompare);
+    }
+
+    s->pairCount = 0;
+    if (s->tableCapacity)
+    {
+        memset(s->tableKeys, 0, s->tableCapacity * sizeof(unsigned long long));
+    }
+
+    // sweep along x keeping the bodies whose intervals are open
+    unsigned int* active = arenaAlloc(frame, count * sizeof(unsigned int));
+    unsigned int* slots = arenaAlloc(frame, s->count * sizeof(unsigned int));
+    unsigned int activeCount = 0;
+    for (unsigned int e = 0; e < 2 * count; e++)
+    {
+        unsigned int data = s->endpoints[0][e].data;
+        unsigned int body = data >> 1;
+        if (data & 1)
+        {
+            unsigned int slot = slots[body];
+            active[slot] = active[--activeCount];
+            slots[active[slot]] = slot;
+            continue;
+        }
+
+        for (unsigned int k = 0; k < activeCount; k++)
+        {
+            if (broadphaseOverlap(bp->boxes + active[k], bp->boxes + body))
+            {
+                sapAdd(s, active[k], body);
+            }
+        }
+        slots[body] = activeCount;
+        active[activeCount++] = body;
+    }
+}
+
+// restores the order of one axis after its values change, applying the pair
+// events of every swap
+void sapSort(Sap* s, Broadphase* bp, int axis)
+{
+    SapEndpoint* endpoints = s->endpoints[axis];
+    unsigned int count = 2 * (s->count - s->offsets[FLOOR + 1]);
+
+    for (unsigned int e = 0; e < count; e++)
+    {
+        unsigned int data = endpoints[e].data;
+        BroadphaseBox* box = bp->boxes + (data >> 1);
+        endpoints[e].value = data & 1 ? box->max[axis] : box->min[axis];
+    }
+
+    for (unsigned int e = 1; e < count; e++)
+    {
+        SapEndpoint moving = endpoints[e];
+        unsigned int body = moving.data >> 1;
+        unsigned int j = e;
+        while (j > 0 && sapBefore(&moving, endpoints + j - 1))
+        {
+            SapEndpoint passed = endpoints[j - 1];
+            unsigned int other = passed.data >> 1;
+
+            // a minimum moving below a maximum may start an overlap, while a
+            // maximum moving below a minimum always ends one
+            if (!(moving.data & 1) && (passed.data & 1))
+            {
+                if (broadphaseOverlap(bp->boxes + body, bp->boxes + other))
+                {
+                    sapAdd(s, body, other);
+                }
+            }
+            else if ((moving.data & 1) && !(passed.data & 1))
+            {
+                sapRemove(s, body, other);
+            }
+
+            endpoints[j] = passed;
+            j--;
+        }
+        endpoints[j] = moving;
+    }
+}
+
+void sapUpdate(Sap* s, Broadphase* bp, Arena* frame)
+{
+    if (s->count != bp->offsets[OBJECT_TYPES] || !s->endpoints[0] ||
+        memcmp(s->offsets, bp->offsets, sizeof(s->offsets)))
+    {
+        sapBuild(s, bp, frame);
+        return;
+    }
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        sapSort(s, bp, axis);
+    }
+}
@@ -0,0 +1,59 @@
+/*
+ * sap.h
+ *
+ * Incremental sweep and prune which keeps every pair of overlapping bounding
+ * boxes across steps
+ *
+ * The minimum and maximum of each box on each axis are kept in sorted endpoint
+ * arrays which persist between steps. Since bodies barely move from one step to
+ * the next, re-sorting with insertion sort only swaps a few neighbors, and each
+ * swap of a minimum past a maximum (or the reverse) is the only place a pair
+ * can start or stop overlapping, so the pair set is updated from those swaps
+ * instead of being rebuilt
+ */
+
+#ifndef SAP_H
+#define SAP_H
+
+#include "object.h"
+#include "utils/arena.h"
+
+typedef struct Broadphase Broadphase;
+
+// a single end of a box on one axis
+typedef struct SapEndpoint
+{
+    float value;
+    unsigned int data;  // flat index of the body shifted left once, with the
+                        // low bit set for maximums
+} SapEndpoint;
+
+typedef struct Sap
+{
+    unsigned int count;  // number of bodies the endpoints were built for
+    unsigned int offsets[OBJECT_TYPES + 1];  // type offsets at the last build
+    SapEndpoint* endpoints[3];  // sorted endpoints along each axis
+
+    /* PAIRS */
+    // overlapping pairs are stored densely for iteration and indexed by an
+    // open addressing hash table for removal
+    unsigned int pairCount;
+    unsigned int pairCapacity;
+    unsigned long long* pairs;  // flat indices of both bodies packed with the
+                                // lower index in the high bits
+    unsigned int tableCapacity;  // a power of two
+    unsigned long long* tableKeys;  // 0 for empty slots
+    unsigned int* tableIndices;     // position of each key in pairs
+} Sap;
+
+void sapInit(Sap* s);
+
+void sapFree(Sap* s);
+
+// sorts the endpoints of the current boxes and applies every pair which
+// started or stopped overlapping since the last update
+// rebuilds from scratch when bodies have been added or removed, taking the
+// sweep's scratch from the frame arena
+void sapUpdate(Sap* s, Broadphase* bp, Arena* frame);
+
+#endif
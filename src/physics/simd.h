@@ -0,0 +1,224 @@
+/*
+ * simd.h
+ *
+ * Minimal portable wrapper over the widest float vector instruction set the
+ * compiler targets (AVX2, SSE2, or NEON) so batched physics kernels can be
+ * written once
+ *
+ * Builds without any of these fall back to a single float lane
+ */
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+#define SIMD_WIDTH 8
+
+typedef __m256 simdf;
+typedef __m256 simdm;  // lane mask
+
+static inline simdf simdLoad(const float* p) { return _mm256_loadu_ps(p); }
+static inline void simdStore(float* p, simdf a) { _mm256_storeu_ps(p, a); }
+static inline simdf simdSet(float a) { return _mm256_set1_ps(a); }
+static inline simdf simdAdd(simdf a, simdf b) { return _mm256_add_ps(a, b); }
+static inline simdf simdSub(simdf a, simdf b) { return _mm256_sub_ps(a, b); }
+static inline simdf simdMul(simdf a, simdf b) { return _mm256_mul_ps(a, b); }
+static inline simdf simdDiv(simdf a, simdf b) { return _mm256_div_ps(a, b); }
+static inline simdf simdSqrt(simdf a) { return _mm256_sqrt_ps(a); }
+static inline simdf simdMin(simdf a, simdf b) { return _mm256_min_ps(a, b); }
+static inline simdf simdMax(simdf a, simdf b) { return _mm256_max_ps(a, b); }
+static inline simdf simdFloor(simdf a) { return _mm256_floor_ps(a); }
+static inline simdm simdEq(simdf a, simdf b)
+{
+    return _mm256_cmp_ps(a, b, _CMP_EQ_OQ);
+}
+static inline simdm simdGt(simdf a, simdf b)
+{
+    return _mm256_cmp_ps(a, b, _CMP_GT_OQ);
+}
+static inline simdm simdAnd(simdm a, simdm b) { return _mm256_and_ps(a, b); }
+static inline simdm simdOr(simdm a, simdm b) { return _mm256_or_ps(a, b); }
+// picks a where the mask is set and b elsewhere
+static inline simdf simdSelect(simdm mask, simdf a, simdf b)
+{
+    return _mm256_blendv_ps(b, a, mask);
+}
+// set in every lane whose integer flag is zero
+static inline simdm simdZeroFlags(const int* p)
+{
+    __m256i flags = _mm256_loadu_si256((const __m256i*)p);
+    return _mm256_castsi256_ps(
+        _mm256_cmpeq_epi32(flags, _mm256_setzero_si256()));
+}
+static inline int simdAny(simdm mask) { return _mm256_movemask_ps(mask); }
+
+#elif defined(__SSE2__)
+
+#include <emmintrin.h>
+
+#define SIMD_WIDTH 4
+
+typedef __m128 simdf;
+typedef __m128 simdm;
+
+static inline simdf simdLoad(const float* p) { return _mm_loadu_ps(p); }
+static inline void simdStore(float* p, simdf a) { _mm_storeu_ps(p, a); }
+static inline simdf simdSet(float a) { return _mm_set1_ps(a); }
+static inline simdf simdAdd(simdf a, simdf b) { return _mm_add_ps(a, b); }
+static inline simdf simdSub(simdf a, simdf b) { return _mm_sub_ps(a, b); }
+static inline simdf simdMul(simdf a, simdf b) { return _mm_mul_ps(a, b); }
+static inline simdf simdDiv(simdf a, simdf b) { return _mm_div_ps(a, b); }
+static inline simdf simdSqrt(simdf a) { return _mm_sqrt_ps(a); }
+static inline simdf simdMin(simdf a, simdf b) { return _mm_min_ps(a, b); }
+static inline simdf simdMax(simdf a, simdf b) { return _mm_max_ps(a, b); }
+static inline simdm simdEq(simdf a, simdf b) { return _mm_cmpeq_ps(a, b); }
+static inline simdm simdGt(simdf a, simdf b) { return _mm_cmpgt_ps(a, b); }
+static inline simdm simdAnd(simdm a, simdm b) { return _mm_and_ps(a, b); }
+static inline simdm simdOr(simdm a, simdm b) { return _mm_or_ps(a, b); }
+static inline simdf simdSelect(simdm mask, simdf a, simdf b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+// SSE2 has no rounding instruction so truncate and correct negative values
+static inline simdf simdFloor(simdf a)
+{
+    simdf truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+    return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, a),
+                                            _mm_set1_ps(1.0f)));
+}
+static inline simdm simdZeroFlags(const int* p)
+{
+    __m128i flags = _mm_loadu_si128((const __m128i*)p);
+    return _mm_castsi128_ps(_mm_cmpeq_epi32(flags, _mm_setzero_si128()));
+}
+static inline int simdAny(simdm mask) { return _mm_movemask_ps(mask); }
+
+#elif defined(__ARM_NEON)
+
+#include <arm_neon.h>
+
+#define SIMD_WIDTH 4
+
+typedef float32x4_t simdf;
+typedef uint32x4_t simdm;
+
+static inline simdf simdLoad(const float* p) { return vld1q_f32(p); }
+static inline void simdStore(float* p, simdf a) { vst1q_f32(p, a); }
+static inline simdf simdSet(float a) { return vdupq_n_f32(a); }
+static inline simdf simdAdd(simdf a, simdf b) { return vaddq_f32(a, b); }
+static inline simdf simdSub(simdf a, simdf b) { return vsubq_f32(a, b); }
+static inline simdf simdMul(simdf a, simdf b) { return vmulq_f32(a, b); }
+static inline simdf simdDiv(simdf a, simdf b) { return vdivq_f32(a, b); }
+static inline simdf simdSqrt(simdf a) { return vsqrtq_f32(a); }
+static inline simdf simdMin(simdf a, simdf b) { return vminq_f32(a, b); }
+static inline simdf simdMax(simdf a, simdf b) { return vmaxq_f32(a, b); }
+static inline simdf simdFloor(simdf a) { return vrndmq_f32(a); }
+static inline simdm simdEq(simdf a, simdf b) { return vceqq_f32(a, b); }
+static inline simdm simdGt(simdf a, simdf b) { return vcgtq_f32(a, b); }
+static inline simdm simdAnd(simdm a, simdm b) { return vandq_u32(a, b); }
+static inline simdm simdOr(simdm a, simdm b) { return vorrq_u32(a, b); }
+static inline simdf simdSelect(simdm mask, simdf a, simdf b)
+{
+    return vbslq_f32(mask, a, b);
+}
+static inline simdm simdZeroFlags(const int* p)
+{
+    return vceqq_s32(vld1q_s32(p), vdupq_n_s32(0));
+}
+static inline int simdAny(simdm mask) { return vmaxvq_u32(mask) != 0; }
+
+#else
+
+#include <math.h>
+
+#define SIMD_WIDTH 1
+
+typedef float simdf;
+typedef int simdm;
+
+static inline simdf simdLoad(const float* p) { return *p; }
+static inline void simdStore(float* p, simdf a) { *p = a; }
+static inline simdf simdSet(float a) { return a; }
+static inline simdf simdAdd(simdf a, simdf b) { return a + b; }
+static inline simdf simdSub(simdf a, simdf b) { return a - b; }
+static inline simdf simdMul(simdf a, simdf b) { return a * b; }
+static inline simdf simdDiv(simdf a, simdf b) { return a / b; }
+static inline simdf simdSqrt(simdf a) { return sqrtf(a); }
+static inline simdf simdMin(simdf a, simdf b) { return a < b ? a : b; }
+static inline simdf simdMax(simdf a, simdf b) { return a > b ? a : b; }
+static inline simdf simdFloor(simdf a) { return floorf(a); }
+static inline simdm simdEq(simdf a, simdf b) { return a == b; }
+static inline simdm simdGt(simdf a, simdf b) { return a > b; }
+static inline simdm simdAnd(simdm a, simdm b) { return a && b; }
+static inline simdm simdOr(simdm a, simdm b) { return a || b; }
+static inline simdf simdSelect(simdm mask, simdf a, simdf b)
+{
+    return mask ? a : b;
+}
+static inline simdm simdZeroFlags(const int* p) { return *p == 0; }
+static inline int simdAny(simdm mask) { return mask; }
+
+#endif
+
+static inline simdf simdMulAdd(simdf a, simdf b, simdf c)
+{
+    return simdAdd(simdMul(a, b), c);
+}
+
+static inline simdf simdNeg(simdf a) { return simdSub(simdSet(0.0f), a); }
+
+// dot product of a fixed direction with a vector of lanes
+static inline simdf simdDot(const float direction[3], simdf x, simdf y,
+                            simdf z)
+{
+    return simdMulAdd(simdSet(direction[0]), x,
+                      simdMulAdd(simdSet(direction[1]), y,
+                                 simdMul(simdSet(direction[2]), z)));
+}
+
+// computes sine and cosine of every lane
+// reduces to [-pi/4, pi/4] around the nearest multiple of pi/2 then evaluates
+// the Cephes minimax polynomials
+static inline void simdSinCos(simdf x, simdf* s, simdf* c)
+{
+    simdf quadrant =
+        simdFloor(simdMulAdd(x, simdSet(0.636619772f), simdSet(0.5f)));
+
+    // extended precision subtraction of quadrant * pi / 2
+    simdf r = simdSub(x, simdMul(quadrant, simdSet(1.5703125f)));
+    r = simdSub(r, simdMul(quadrant, simdSet(4.837512969970703125e-4f)));
+    r = simdSub(r, simdMul(quadrant, simdSet(7.549789948768648e-8f)));
+    simdf r2 = simdMul(r, r);
+
+    simdf sinR = simdMulAdd(r2, simdSet(-1.9515295891e-4f),
+                            simdSet(8.3321608736e-3f));
+    sinR = simdMulAdd(sinR, r2, simdSet(-1.6666654611e-1f));
+    sinR = simdMulAdd(simdMul(sinR, r2), r, r);
+
+    simdf cosR = simdMulAdd(r2, simdSet(2.443315711809948e-5f),
+                            simdSet(-1.388731625493765e-3f));
+    cosR = simdMulAdd(cosR, r2, simdSet(4.166664568298827e-2f));
+    cosR = simdMulAdd(simdMul(cosR, r2), r2,
+                      simdMulAdd(r2, simdSet(-0.5f), simdSet(1.0f)));
+
+    // rotate the reduced results into the original quadrant
+    simdf phase = simdSub(
+        quadrant, simdMul(simdFloor(simdMul(quadrant, simdSet(0.25f))),
+                          simdSet(4.0f)));
+    simdm swap = simdOr(simdEq(phase, simdSet(1.0f)),
+                        simdEq(phase, simdSet(3.0f)));
+    simdm negateSin = simdOr(simdEq(phase, simdSet(2.0f)),
+                             simdEq(phase, simdSet(3.0f)));
+    simdm negateCos = simdOr(simdEq(phase, simdSet(1.0f)),
+                             simdEq(phase, simdSet(2.0f)));
+
+    simdf sinX = simdSelect(swap, cosR, sinR);
+    simdf cosX = simdSelect(swap, sinR, cosR);
+    *s = simdSelect(negateSin, simdNeg(sinX), sinX);
+    *c = simdSelect(negateCos, simdNeg(cosX), cosX);
+}
+
+#endif
@@ -0,0 +1,320 @@
+#include "sleep.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SLEEP_COMPACT 1024  // members of woken sets kept before compacting
+
+void sleepInit(Sleep* s, float speed, float spin, unsigned int steps)
+{
+    memset(s, 0, sizeof(Sleep));
+    s->speed = speed;
+    s->spin = spin;
+    s->steps = steps;
+}
+
+void sleepFree(Sleep* s)
+{
+    free(s->sets);
+    free(s->members);
+    free(s->islandSteps);
+    free(s->islandSets);
+    memset(s, 0, sizeof(Sleep));
+}
+
+// wakes every member of a set which is still asleep in it, leaving out those
+// woken from outside which may have fallen asleep in a newer set since
+void sleepWakeSet(Sleep* s, Bodies* bodies, int id)
+{
+    SleepSet* group = s->sets + (id - 1 - s->setBase);
+    for (unsigned int k = 0; k < group->count; k++)
+    {
+        SleepMember* member = s->members + group->first + k;
+        Bodies* b = bodies + member->type;
+        if (member->index < b->count && b->sleeping[member->index] == id)
+        {
+            bodiesWake(b, member->index);
+        }
+    }
+    s->asleep -= group->count;
+    group->count = 0;
+}
+
+void sleepWakeBody(Sleep* s, Bodies* bodies, ObjectType type, unsigned int i)
+{
+    int id = bodies[type].sleeping[i];
+    if (id)
+    {
+        sleepWakeSet(s, bodies, id);
+    }
+}
+
+void sleepWake(Sleep* s, Narrowphase* np, Bodies* bodies)
+{
+    for (unsigned int index = 0; index < np->contactCount; index++)
+    {
+        Contact* c = np->contacts + index;
+        sleepWakeBody(s, bodies, c->typeA, c->a);
+        sleepWakeBody(s, bodies, c->typeB, c->b);
+    }
+
+    // once every set has woken the lists start over
+    if (!s->asleep)
+    {
+        s->setBase += s->setCount;
+        s->setCount = 0;
+        s->memberCount = 0;
+    }
+}
+
+// drops the sets which have woken and gives the rest new ids
+void sleepCompact(Sleep* s, Bodies* bodies)
+{
+    unsigned int base = s->setBase + s->setCount;
+    unsigned int sets = 0;
+    unsigned int members = 0;
+    for (unsigned int set = 0; set < s->setCount; set++)
+    {
+        SleepSet group = s->sets[set];
+        if (!group.count)
+        {
+            continue;
+        }
+
+        for (unsigned int k = 0; k < group.count; k++)
+        {
+            SleepMember member = s->members[group.first + k];
+            Bodies* b = bodies + member.type;
+            if (member.index < b->count &&
+                b->sleeping[member.index] == (int)(s->setBase + set + 1))
+            {
+                b->sleeping[member.index] = base + sets + 1;
+            }
+            s->members[members + k] = member;
+        }
+        s->sets[sets].first = members;
+        s->sets[sets].count = group.count;
+        members += group.count;
+        sets++;
+    }
+    s->setBase = base;
+    s->setCount = sets;
+    s->memberCount = members;
+}
+
+void sleepRemap(Sleep* s, Bodies* bodies, unsigned int* places[OBJECT_TYPES])
+{
+    for (unsigned int set = 0; set < s->setCount; set++)
+    {
+        SleepSet* group = s->sets + set;
+        for (unsigned int k = 0; k < group->count; k++)
+        {
+            SleepMember* member = s->members + group->first + k;
+            if (places[member->type] &&
+                member->index < bodies[member->type].count)
+            {
+                member->index = places[member->type][member->index];
+            }
+        }
+    }
+
+    // the renderer keeps the data of bodies which held the same id in both
+    // states at the same index, which no longer holds
+    sleepCompact(s, bodies);
+}
+
+// returns the island a body belongs to, ISLANDS_NONE if it touches nothing
+unsigned int sleepIsland(Islands* is, unsigned int flat)
+{
+    if (flat >= is->bodyCount)
+    {
+        return ISLANDS_NONE;
+    }
+    return is->labels[islandsFind(is, flat)];
+}
+
+// returns whether a dynamic body can move and is awake
+int sleepAwake(Bodies* b, unsigned int i)
+{
+    return b->mass[i] > 0.0f && !b->sleeping[i];
+}
+
+// starts an empty set
+unsigned int sleepSet(Sleep* s)
+{
+    if (s->setCount == s->setCapacity)
+    {
+        s->setCapacity = s->setCapacity ? 2 * s->setCapacity : 64;
+        s->sets = realloc(s->sets, s->setCapacity * sizeof(SleepSet));
+    }
+    s->sets[s->setCount].first = 0;
+    s->sets[s->setCount].count = 0;
+    return s->setCount++;
+}
+
+void sleepUpdate(Sleep* s, Islands* is, Bodies* bodies, float gravity,
+                 float dt, int carried)
+{
+    if (!s->steps)
+    {
+        return;
+    }
+
+    // every body may be an island of its own
+    unsigned int count = 0;
+    for (int type = 0; type < OBJECT_TYPES; type++)
+    {
+        count += bodies[type].count;
+    }
+    unsigned int islands = is->count + count;
+    if (islands > s->islandCapacity)
+    {
+        free(s->islandSteps);
+        free(s->islandSets);
+        s->islandCapacity =
+            islands > 2 * s->islandCapacity ? islands : 2 * s->islandCapacity;
+        s->islandSteps = malloc(s->islandCapacity * sizeof(unsigned int));
+        s->islandSets = malloc(s->islandCapacity * sizeof(unsigned int));
+    }
+    for (unsigned int island = 0; island < islands; island++)
+    {
+        s->islandSteps[island] = s->steps;
+        s->islandSets[island] = ISLANDS_NONE;
+    }
+
+    // limits on the distance moved over a step and the angular speed
+    float distance = s->speed * dt * s->speed * dt;
+    float spin = s->spin * s->spin;
+
+    // static bodies lead every store and never sleep
+    unsigned int flat = 0;
+    for (int type = 0; type < OBJECT_TYPES; type++)
+    {
+        Bodies* b = bodies + type;
+        flat += b->staticCount;
+        for (unsigned int i = b->staticCount; i < b->count; i++, flat++)
+        {
+            if (!sleepAwake(b, i))
+            {
+                continue;
+            }
+
+            float moved = 0.0f;
+            float turned = 0.0f;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                float move = b->position[axis][i] - b->lastPosition[axis][i];
+                if (carried)
+                {
+                    float acceleration = b->linearAcceleration[axis][i] +
+                                         (axis == 1 ? gravity : 0.0f);
+                    move += acceleration * dt * dt;
+                }
+                moved += move * move;
+                turned += b->angularVelocity[axis][i] *
+                          b->angularVelocity[axis][i];
+            }
+
+            if (moved >= distance || turned >= spin)
+            {
+                b->stillSteps[i] = 0;
+            }
+            else if (b->stillSteps[i] < s->steps)
+            {
+                b->stillSteps[i]++;
+            }
+
+            unsigned int island = sleepIsland(is, flat);
+            if (island != ISLANDS_NONE &&
+                b->stillSteps[i] < s->islandSteps[island])
+            {
+                s->islandSteps[island] = b->stillSteps[i];
+            }
+        }
+    }
+
+    if (s->memberCount > 2 * s->asleep + SLEEP_COMPACT)
+    {
+        sleepCompact(s, bodies);
+    }
+
+    // new sets are counted before their members are written, so each set's
+    // members stay next to each other, and bodies touching nothing take the
+    // islands after the real ones in the same order on both passes
+    unsigned int firstSet = s->setCount;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        unsigned int solo = is->count;
+        flat = 0;
+        for (int type = 0; type < OBJECT_TYPES; type++)
+        {
+            Bodies* b = bodies + type;
+            flat += b->staticCount;
+            for (unsigned int i = b->staticCount; i < b->count; i++, flat++)
+            {
+                if (!sleepAwake(b, i) || b->stillSteps[i] < s->steps)
+                {
+                    continue;
+                }
+                unsigned int island = sleepIsland(is, flat);
+                if (island == ISLANDS_NONE)
+                {
+                    island = solo++;
+                }
+                else if (s->islandSteps[island] < s->steps)
+                {
+                    continue;
+                }
+
+                unsigned int set = s->islandSets[island];
+                if (pass == 0)
+                {
+                    if (set == ISLANDS_NONE)
+                    {
+                        set = sleepSet(s);
+                        s->islandSets[island] = set;
+                    }
+                    s->sets[set].count++;
+                    continue;
+                }
+
+                SleepSet* group = s->sets + set;
+                SleepMember* member =
+                    s->members + group->first + group->count++;
+                member->type = type;
+                member->index = i;
+
+                b->sleeping[i] = s->setBase + set + 1;
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    b->lastPosition[axis][i] = b->position[axis][i];
+                    b->angularVelocity[axis][i] = 0.0f;
+                }
+            }
+        }
+
+        if (pass == 1)
+        {
+            break;
+        }
+
+        // lay the new sets out after the existing members
+        unsigned int members = s->memberCount;
+        for (unsigned int set = firstSet; set < s->setCount; set++)
+        {
+            s->sets[set].first = members;
+            members += s->sets[set].count;
+            s->asleep += s->sets[set].count;
+            s->sets[set].count = 0;
+        }
+        if (members > s->memberCapacity)
+        {
+            s->memberCapacity =
+                members > 2 * s->memberCapacity ? members
+                                                : 2 * s->memberCapacity;
+            s->members = realloc(s->members,
+                                 s->memberCapacity * sizeof(SleepMember));
+        }
+        s->memberCount = members;
+    }
+}
@@ -0,0 +1,90 @@
+/*
+ * sleep.h
+ *
+ * Puts bodies which have come to rest to sleep so physics can skip them
+ *
+ * Every step each awake body counts how many steps in a row it has moved
+ * slower than the sleep limits. Once every body of an island (see islands.h)
+ * has been still for long enough, the whole island is put to sleep together as
+ * one set, since a body resting on another must not fall asleep while the one
+ * below it still moves. A body touching nothing sleeps in a set of its own
+ *
+ * Sleeping bodies are not integrated, pairs of bodies which are static or
+ * asleep are dropped by the broadphase, and the renderer reuses their model
+ * matrices. Any contact with an awake body wakes the whole set, as does
+ * changing a body through the setters in bodies.h
+ *
+ * Set ids are never reused, so a body holding the same id in two states has
+ * stayed asleep for the whole time between them
+ */
+
+#ifndef SLEEP_H
+#define SLEEP_H
+
+#include "bodies.h"
+#include "islands.h"
+#include "narrowphase.h"
+
+#define SLEEP_SPEED 0.05f  // default speed below which a body counts as still
+#define SLEEP_SPIN 0.05f   // default angular speed below which a body is still
+#define SLEEP_STEPS 60     // default still steps before sleeping, 0 for never
+
+// bodies which fell asleep together
+typedef struct SleepSet
+{
+    unsigned int first;  // first member
+    unsigned int count;  // 0 once the set has woken
+} SleepSet;
+
+typedef struct SleepMember
+{
+    ObjectType type;
+    unsigned int index;
+} SleepMember;
+
+typedef struct Sleep
+{
+    float speed;
+    float spin;
+    unsigned int steps;
+
+    /* SETS */
+    unsigned int setBase;  // ids of sets are offset by this plus one
+    unsigned int setCount;
+    unsigned int setCapacity;
+    SleepSet* sets;
+    unsigned int memberCount;
+    unsigned int memberCapacity;
+    SleepMember* members;
+    unsigned int asleep;  // members of sets which have not woken
+
+    /* ISLANDS */
+    unsigned int islandCapacity;
+    unsigned int* islandSteps;  // fewest still steps of any body per island
+    unsigned int* islandSets;   // set each island sleeps in, if any
+} Sleep;
+
+void sleepInit(Sleep* s, float speed, float spin, unsigned int steps);
+
+void sleepFree(Sleep* s);
+
+// wakes the set of every sleeping body touched by a contact, which the
+// broadphase only keeps when the other body is awake
+void sleepWake(Sleep* s, Narrowphase* np, Bodies* bodies);
+
+// wakes the set a body sleeps in, if any
+void sleepWakeBody(Sleep* s, Bodies* bodies, ObjectType type, unsigned int i);
+
+// moves the members of every set to the new places of their bodies, and gives
+// every set a new id
+// places holds the new index of each body of a type, or NULL if none moved
+void sleepRemap(Sleep* s, Bodies* bodies, unsigned int* places[OBJECT_TYPES]);
+
+// counts how long each awake body has been still and puts islands whose
+// bodies have all been still long enough to sleep
+// carried is set when the velocity in the last positions leaves out the
+// acceleration of the next step, as the impulse solver's does
+void sleepUpdate(Sleep* s, Islands* is, Bodies* bodies, float gravity,
+                 float dt, int carried);
+
+#endif
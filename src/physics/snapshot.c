@@ -0,0 +1,281 @@
+#include "snapshot.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// position, orientation, size, color, previous position and orientation,
+// resting
+#define SNAPSHOT_STREAMS 19
+
+// grows the streams of a single type to hold at least the given number of
+// bodies, doubling so bodies spawned one at a time rarely reallocate
+void snapshotReserve(Snapshot* s, ObjectType type, unsigned int capacity)
+{
+    if (capacity <= s->capacities[type] && s->data[type])
+    {
+        return;
+    }
+
+    free(s->data[type]);
+    capacity = capacity > 2 * s->capacities[type] ? capacity
+                                                  : 2 * s->capacities[type];
+    s->capacities[type] = capacity > 0 ? capacity : 1;
+    s->data[type] =
+        malloc(SNAPSHOT_STREAMS * s->capacities[type] * sizeof(float));
+
+    float* data = s->data[type];
+    unsigned int stride = s->capacities[type];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        s->position[type][axis] = data + axis * stride;
+        s->color[type][axis] = data + (8 + axis) * stride;
+        s->previousPosition[type][axis] = data + (11 + axis) * stride;
+    }
+    for (int axis = 0; axis < 4; axis++)
+    {
+        s->orientation[type][axis] = data + (3 + axis) * stride;
+        s->previousOrientation[type][axis] = data + (14 + axis) * stride;
+    }
+    s->size[type] = data + 7 * stride;
+    s->resting[type] = (int*)(data + 18 * stride);
+
+    // nothing was kept from the old streams
+    s->statics[type] = BODIES_NONE;
+}
+
+// returns the first body of a store which must be copied into a snapshot,
+// skipping the static bodies if the snapshot already holds them
+unsigned int snapshotFirst(Snapshot* s, Bodies* b)
+{
+    if (s->statics[b->type] == b->staticCount &&
+        s->staticVersions[b->type] == b->staticVersion)
+    {
+        return b->staticCount;
+    }
+    return 0;
+}
+
+// copies the rendered streams of every body store into a snapshot
+void snapshotCapture(Snapshot* s, Bodies* bodies, unsigned long long step,
+                     double time, float dt)
+{
+    s->step = step;
+    s->time = time;
+    s->dt = dt;
+
+    for (int type = 0; type < OBJECT_TYPES; type++)
+    {
+        Bodies* b = &bodies[type];
+        snapshotReserve(s, type, b->count);
+        s->counts[type] = b->count;
+
+        unsigned int i = snapshotFirst(s, b);
+        size_t bytes = (b->count - i) * sizeof(float);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            memcpy(s->position[type][axis] + i, b->position[axis] + i, bytes);
+            memcpy(s->color[type][axis] + i, b->color[axis] + i, bytes);
+        }
+        for (int axis = 0; axis < 4; axis++)
+        {
+            memcpy(s->orientation[type][axis] + i, b->orientation[axis] + i,
+                   bytes);
+        }
+        memcpy(s->size[type] + i, b->size + i, bytes);
+
+        // only bodies which slept in the same set in both states stay resting
+        for (; i < b->count; i++)
+        {
+            if (s->resting[type][i] != b->sleeping[i])
+            {
+                s->resting[type][i] = 0;
+            }
+        }
+
+        s->statics[type] = b->staticCount;
+        s->staticVersions[type] = b->staticVersion;
+    }
+}
+
+// points the particle streams of a snapshot into its allocation
+void snapshotAssignParticles(Snapshot* s)
+{
+    float* data = s->particleData;
+    unsigned int stride = s->particleCapacity;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        s->particlePosition[axis] = data + axis * stride;
+        s->particleLastPosition[axis] = data + (3 + axis) * stride;
+    }
+    s->particleRadius = data + 6 * stride;
+    s->particleColor = (unsigned int*)(data + 7 * stride);
+}
+
+// sizes the particle streams to the capacity of the particles, so their
+// allocations can be exchanged with those of the particles
+void snapshotReserveParticles(Snapshot* s, Particles* p)
+{
+    if (p->capacity == s->particleCapacity && s->particleData)
+    {
+        return;
+    }
+
+    // the padding is stepped along with the particles, so it starts zeroed
+    size_t bytes = PARTICLES_STREAMS * p->capacity * sizeof(float);
+    free(s->particleData);
+    s->particleCapacity = p->capacity;
+    s->particleData = aligned_alloc(BODIES_ALIGNMENT, bytes);
+    memset(s->particleData, 0, bytes);
+    snapshotAssignParticles(s);
+
+    // nothing was kept from the old streams
+    s->particleVersion = BODIES_NONE;
+}
+
+// copies the streams of the particles into a snapshot
+void snapshotCaptureParticles(Snapshot* s, Particles* p)
+{
+    snapshotReserveParticles(s, p);
+    s->particleCount = p->count;
+
+    size_t bytes = p->count * sizeof(float);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        memcpy(s->particlePosition[axis], p->position[axis], bytes);
+        memcpy(s->particleLastPosition[axis], p->lastPosition[axis], bytes);
+    }
+    if (s->particleVersion != p->version)
+    {
+        memcpy(s->particleRadius, p->radius, bytes);
+        memcpy(s->particleColor, p->color, bytes);
+        s->particleVersion = p->version;
+    }
+}
+
+// hands the streams of the particles to a snapshot in exchange for its own,
+// which the next step writes into
+void snapshotExchangeParticles(Snapshot* s, Particles* p)
+{
+    snapshotReserveParticles(s, p);
+    s->particleData = particlesExchange(p, s->particleData,
+                                        s->particleVersion != p->version);
+    snapshotAssignParticles(s);
+    s->particleCount = p->count;
+    s->particleVersion = p->version;
+}
+
+// copies positions and orientations of every body store into the previous
+// state of a snapshot
+void snapshotCapturePrevious(Snapshot* s, Bodies* bodies)
+{
+    for (int type = 0; type < OBJECT_TYPES; type++)
+    {
+        Bodies* b = &bodies[type];
+        snapshotReserve(s, type, b->count);
+
+        unsigned int i = snapshotFirst(s, b);
+        size_t bytes = (b->count - i) * sizeof(float);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            memcpy(s->previousPosition[type][axis] + i, b->position[axis] + i,
+                   bytes);
+        }
+        for (int axis = 0; axis < 4; axis++)
+        {
+            memcpy(s->previousOrientation[type][axis] + i,
+                   b->orientation[axis] + i, bytes);
+        }
+        memcpy(s->resting[type] + i, b->sleeping + i, bytes);
+    }
+}
+
+void snapshotBufferInit(SnapshotBuffer* s, Bodies* bodies,
+                        Particles* particles)
+{
+    memset(s->snapshots, 0, sizeof(s->snapshots));
+    for (int i = 0; i < 3; i++)
+    {
+        // both states match so nothing moves before the first publish
+        snapshotCapturePrevious(&s->snapshots[i], bodies);
+        snapshotCapture(&s->snapshots[i], bodies, 0, 0.0, 1.0f);
+        snapshotCaptureParticles(&s->snapshots[i], particles);
+    }
+
+    s->front = 0;
+    atomic_init(&s->middle, 1);
+    s->back = 2;
+}
+
+void snapshotBufferFree(SnapshotBuffer* s)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        for (int type = 0; type < OBJECT_TYPES; type++)
+        {
+            free(s->snapshots[i].data[type]);
+        }
+        free(s->snapshots[i].particleData);
+    }
+    memset(s->snapshots, 0, sizeof(s->snapshots));
+}
+
+void snapshotPrepare(SnapshotBuffer* s, Bodies* bodies)
+{
+    snapshotCapturePrevious(&s->snapshots[s->back], bodies);
+}
+
+void snapshotPublish(SnapshotBuffer* s, Bodies* bodies, Particles* particles,
+                     unsigned long long step, double time, float dt,
+                     double interactionRate, size_t arenaPeak,
+                     double heapAllocations)
+{
+    snapshotCapture(&s->snapshots[s->back], bodies, step, time, dt);
+    snapshotExchangeParticles(&s->snapshots[s->back], particles);
+    s->snapshots[s->back].interactionRate = interactionRate;
+    s->snapshots[s->back].arenaPeak = arenaPeak;
+    s->snapshots[s->back].heapAllocations = heapAllocations;
+
+    unsigned int previous =
+        atomic_exchange(&s->middle, s->back | SNAPSHOT_FRESH);
+    s->back = previous & ~SNAPSHOT_FRESH;
+}
+
+Snapshot* snapshotAcquire(SnapshotBuffer* s)
+{
+    if (atomic_load(&s->middle) & SNAPSHOT_FRESH)
+    {
+        unsigned int previous = atomic_exchange(&s->middle, s->front);
+        s->front = previous & ~SNAPSHOT_FRESH;
+    }
+
+    return &s->snapshots[s->front];
+}
+
+float snapshotAlpha(Snapshot* s, double time)
+{
+    float alpha = (float)((time - s->time) / s->dt);
+    return glm_clamp(alpha, 0.0f, 1.0f);
+}
+
+void snapshotVertices(Snapshot* s, ObjectType type, unsigned int i,
+                      float alpha, float* vertices)
+{
+    vec3 position;
+    versor orientation;
+    versor previousOrientation;
+    vec3 color;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        position[axis] = glm_lerp(s->previousPosition[type][axis][i],
+                                  s->position[type][axis][i], alpha);
+        color[axis] = s->color[type][axis][i];
+    }
+    for (int axis = 0; axis < 4; axis++)
+    {
+        orientation[axis] = s->orientation[type][axis][i];
+        previousOrientation[axis] = s->previousOrientation[type][axis][i];
+    }
+    glm_quat_slerp(previousOrientation, orientation, alpha, orientation);
+
+    objectVertices(position, orientation, s->size[type][i], color, vertices);
+}
@@ -0,0 +1,117 @@
+/*
+ * snapshot.h
+ *
+ * Copies of the body data needed for rendering, handed from the physics
+ * thread to the render thread through a lock-free triple buffer
+ *
+ * The physics thread only ever writes the back snapshot and the render thread
+ * only ever reads the front snapshot, so neither blocks the other: publishing
+ * swaps the back snapshot with the shared middle one and acquiring swaps the
+ * front snapshot with the middle one whenever a newer state has been published
+ *
+ * Each snapshot also keeps the state from one step earlier so the renderer can
+ * interpolate between the two physics steps surrounding the current frame,
+ * along with which bodies slept through both so the renderer can reuse theirs
+ *
+ * Static bodies lead every store and rarely change, so a snapshot which already
+ * holds the current version of them only copies the dynamic bodies
+ *
+ * Particles are published along with the bodies, where the previous state is
+ * their last positions, which only differ from where they were before the
+ * final step for those which bounced. Rather than being copied, their streams
+ * are exchanged for those of the back snapshot, and only the radii and colors
+ * are copied back when the version of the particles has changed
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdatomic.h>
+
+#include "bodies.h"
+#include "particles.h"
+
+#define SNAPSHOT_FRESH 4  // set on the middle index until the reader takes it
+
+typedef struct Snapshot
+{
+    unsigned long long step;  // physics step which produced this state
+    double time;  // wall clock time which the current state corresponds to
+    float dt;     // time between the previous and current state
+    double interactionRate;  // pulls evaluated per second by gravitation
+                             // on the last step, 0 without it
+    size_t arenaPeak;        // most scratch bytes of a step, summed over the
+                             // frame arena and every worker's
+    double heapAllocations;  // heap allocations per step by those arenas
+                             // since the previous publish
+
+    unsigned int counts[OBJECT_TYPES];
+    unsigned int capacities[OBJECT_TYPES];
+    unsigned int statics[OBJECT_TYPES];  // static bodies leading each type,
+                                         // BODIES_NONE until they are copied
+    unsigned int staticVersions[OBJECT_TYPES];  // version of the static
+                                                // bodies copied
+
+    // streams copied from the body store of each type
+    float* position[OBJECT_TYPES][3];
+    float* orientation[OBJECT_TYPES][4];
+    float* size[OBJECT_TYPES];
+    float* color[OBJECT_TYPES][3];
+    float* previousPosition[OBJECT_TYPES][3];
+    float* previousOrientation[OBJECT_TYPES][4];
+    int* resting[OBJECT_TYPES];  // sleeping set id held in both states, or 0
+    float* data[OBJECT_TYPES];  // single allocation backing each type's streams
+
+    // streams exchanged with the particles
+    unsigned int particleCount;
+    unsigned int particleCapacity;  // stride between the particle streams
+    unsigned int particleVersion;   // version of the radii and colors copied,
+                                    // BODIES_NONE until they are
+    float* particlePosition[3];
+    float* particleLastPosition[3];
+    float* particleRadius;
+    unsigned int* particleColor;
+    float* particleData;  // single allocation backing the particle streams,
+                          // sized and laid out like that of the particles
+} Snapshot;
+
+typedef struct SnapshotBuffer
+{
+    Snapshot snapshots[3];
+    atomic_uint middle;  // index of the latest published snapshot
+    unsigned int back;   // owned by the physics thread
+    unsigned int front;  // owned by the render thread
+} SnapshotBuffer;
+
+// fills all three snapshots with the current state of the bodies and
+// particles
+void snapshotBufferInit(SnapshotBuffer* s, Bodies* bodies,
+                        Particles* particles);
+
+void snapshotBufferFree(SnapshotBuffer* s);
+
+// copies the current state of the bodies into the previous state of the back
+// snapshot, called just before the final step ahead of a publish
+void snapshotPrepare(SnapshotBuffer* s, Bodies* bodies);
+
+// copies the current state of the bodies into the back snapshot, exchanges the
+// streams of the particles with it, then makes it the newest published state
+// the particles must take a step before the next publish
+void snapshotPublish(SnapshotBuffer* s, Bodies* bodies, Particles* particles,
+                     unsigned long long step, double time, float dt,
+                     double interactionRate, size_t arenaPeak,
+                     double heapAllocations);
+
+// returns the newest published snapshot, which stays valid until the next call
+Snapshot* snapshotAcquire(SnapshotBuffer* s);
+
+// returns how far the given wall clock time is between the previous and
+// current state, clamped to [0, 1]
+float snapshotAlpha(Snapshot* s, double time);
+
+// generates and stores model matrix and color data for a single body
+// interpolated between its previous and current state
+void snapshotVertices(Snapshot* s, ObjectType type, unsigned int i,
+                      float alpha, float* vertices);
+
+#endif
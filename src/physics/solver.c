@@ -0,0 +1,1054 @@
+#include "solver.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "simd.h"
+
+#define SOLVER_BAUMGARTE 0.2f  // fraction of the penetration removed per step
+#define SOLVER_SLOP 0.01f      // penetration left alone so contacts persist
+#define SOLVER_BOUNCE 1.0f  // closing speed below which contacts do not bounce
+#define SOLVER_MATCH 0.1f   // distance relative to the smaller body within
+                            // which a point keeps last step's impulses
+#define SOLVER_BATCH_MIN 256   // contacts an island needs to be split into
+                               // batches
+#define SOLVER_BLOCK_GRAIN 16  // blocks handed to a worker at a time
+
+// shared state for the blocks of one batch
+typedef struct SolverTask
+{
+    Solver* s;
+    SolverBlock* blocks;
+    int warm;  // whether to hand over last step's impulses or iterate
+} SolverTask;
+
+// velocities, masses and arms of the bodies in SIMD_WIDTH lanes of a block
+typedef struct SolverLanes
+{
+    simdf linearA[3];
+    simdf angularA[3];
+    simdf linearB[3];
+    simdf angularB[3];
+    simdf inverseMassA;
+    simdf inverseInertiaA;
+    simdf inverseMassB;
+    simdf inverseInertiaB;
+    simdf offsetA[3];
+    simdf offsetB[3];
+} SolverLanes;
+
+void solverInit(Solver* s, unsigned int iterations, float friction,
+                float restitution)
+{
+    memset(s, 0, sizeof(Solver));
+    s->iterations = iterations;
+    s->friction = friction;
+    s->restitution = restitution;
+    islandsInit(&s->islands);
+}
+
+void solverFree(Solver* s)
+{
+    free(s->linear);
+    free(s->angular);
+    free(s->inverseMass);
+    free(s->inverseInertia);
+    free(s->touched);
+    free(s->touchedList);
+    free(s->contacts);
+    free(s->cacheKeys);
+    free(s->cacheManifolds);
+    free(s->blocks);
+    free(s->masks);
+    free(s->overflow);
+    islandsFree(&s->islands);
+    memset(s, 0, sizeof(Solver));
+}
+
+// packs the types and indices of a contact's bodies into a key which is never
+// 0
+unsigned long long solverKey(Contact* c)
+{
+    return (((unsigned long long)(c->typeA * OBJECT_TYPES + c->typeB) << 58) |
+            ((unsigned long long)c->a << 29) | c->b) +
+           1;
+}
+
+// returns the first cache slot to probe for a key
+unsigned int solverSlot(Solver* s, unsigned long long key)
+{
+    return (unsigned int)((key * 0x9E3779B97F4A7C15ull) >> 32) &
+           (s->cacheCapacity - 1);
+}
+
+// returns the manifold a pair ended the last step with, or NULL if it was not
+// touching
+SolverManifold* solverFind(Solver* s, unsigned long long key)
+{
+    if (!s->cacheCapacity)
+    {
+        return NULL;
+    }
+
+    unsigned int slot = solverSlot(s, key);
+    while (s->cacheKeys[slot])
+    {
+        if (s->cacheKeys[slot] == key)
+        {
+            return s->cacheManifolds + slot;
+        }
+        slot = (slot + 1) & (s->cacheCapacity - 1);
+    }
+    return NULL;
+}
+
+float solverInverseInertia(ObjectType type, float mass, float size)
+{
+    float inertia;
+    if (type == SPHERE)
+    {
+        inertia = 0.4f * mass * size * size;
+    }
+    else if (type == CUBE)
+    {
+        // half side length size / sqrt(3)
+        inertia = 2.0f / 9.0f * mass * size * size;
+    }
+    else if (type == TETRAHEDRON)
+    {
+        // squared edge length 8 / 3 size^2
+        inertia = 2.0f / 15.0f * mass * size * size;
+    }
+    else
+    {
+        // square plate of half side length size about its in-plane axes
+        inertia = mass * size * size / 3.0f;
+    }
+    return 1.0f / inertia;
+}
+
+// loads the velocity and mass of a body the first time a contact touches it
+// the velocity includes the acceleration of the next step, which integration
+// adds before contacts are found again, so resting contacts cancel it here
+void solverGather(Solver* s, Bodies* b, unsigned int i, float gravity,
+                  float dt)
+{
+    unsigned int flat = s->offsets[b->type] + i;
+    if (s->touched[flat])
+    {
+        return;
+    }
+    s->touched[flat] = 1;
+
+    // static and massless bodies never move in response to a contact
+    if (i < b->staticCount || b->mass[i] <= 0.0f)
+    {
+        glm_vec3_zero(s->linear[flat]);
+        glm_vec3_zero(s->angular[flat]);
+        s->inverseMass[flat] = 0.0f;
+        s->inverseInertia[flat] = 0.0f;
+        return;
+    }
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        s->linear[flat][axis] =
+            (b->position[axis][i] - b->lastPosition[axis][i]) / dt +
+            b->linearAcceleration[axis][i] * dt;
+        s->angular[flat][axis] = b->angularVelocity[axis][i];
+    }
+    s->linear[flat][1] += gravity * dt;
+    s->inverseMass[flat] = 1.0f / b->mass[i];
+    s->inverseInertia[flat] =
+        solverInverseInertia(b->type, b->mass[i], b->size[i]);
+    s->touchedList[s->touchedCount++] = flat;
+}
+
+// picks two friction directions perpendicular to a normal, which only depend
+// on the normal so friction impulses stay meaningful between steps
+void solverTangents(vec3 normal, vec3 tangents[2])
+{
+    if (fabsf(normal[0]) >= 0.57735027f)
+    {
+        tangents[0][0] = normal[1];
+        tangents[0][1] = -normal[0];
+        tangents[0][2] = 0.0f;
+    }
+    else
+    {
+        tangents[0][0] = 0.0f;
+        tangents[0][1] = normal[2];
+        tangents[0][2] = -normal[1];
+    }
+    glm_vec3_normalize(tangents[0]);
+    glm_vec3_cross(normal, tangents[0], tangents[1]);
+}
+
+// returns the inverse of the mass an impulse along a direction acts on
+float solverMass(Solver* s, SolverContact* c, vec3 direction)
+{
+    vec3 armA, armB;
+    glm_vec3_cross(c->offsetA, direction, armA);
+    glm_vec3_cross(c->offsetB, direction, armB);
+    float k = s->inverseMass[c->a] + s->inverseMass[c->b] +
+              s->inverseInertia[c->a] * glm_vec3_norm2(armA) +
+              s->inverseInertia[c->b] * glm_vec3_norm2(armB);
+    return k > 0.0f ? 1.0f / k : 0.0f;
+}
+
+// returns the velocity of body b relative to body a at a contact
+void solverRelative(Solver* s, SolverContact* c, vec3 velocity)
+{
+    vec3 spinA, spinB;
+    glm_vec3_cross(s->angular[c->a], c->offsetA, spinA);
+    glm_vec3_cross(s->angular[c->b], c->offsetB, spinB);
+    glm_vec3_add(s->linear[c->b], spinB, velocity);
+    glm_vec3_sub(velocity, s->linear[c->a], velocity);
+    glm_vec3_sub(velocity, spinA, velocity);
+}
+
+// pushes body b along an impulse and body a against it
+// bodies which cannot move are shared between islands, so they are never
+// written
+void solverApply(Solver* s, SolverContact* c, vec3 impulse)
+{
+    vec3 torque;
+    if (s->inverseMass[c->a] > 0.0f)
+    {
+        glm_vec3_muladds(impulse, -s->inverseMass[c->a], s->linear[c->a]);
+        glm_vec3_cross(c->offsetA, impulse, torque);
+        glm_vec3_muladds(torque, -s->inverseInertia[c->a], s->angular[c->a]);
+    }
+
+    if (s->inverseMass[c->b] > 0.0f)
+    {
+        glm_vec3_muladds(impulse, s->inverseMass[c->b], s->linear[c->b]);
+        glm_vec3_cross(c->offsetB, impulse, torque);
+        glm_vec3_muladds(torque, s->inverseInertia[c->b], s->angular[c->b]);
+    }
+}
+
+// grows the per body arrays to cover every body and the still body which
+// fills unused lanes
+void solverReserve(Solver* s, Bodies* bodies)
+{
+    s->offsets[0] = 0;
+    for (int type = 0; type < OBJECT_TYPES; type++)
+    {
+        s->offsets[type + 1] = s->offsets[type] + bodies[type].count;
+    }
+
+    unsigned int count = s->offsets[OBJECT_TYPES] + 1;
+    if (count > s->bodyCapacity)
+    {
+        free(s->linear);
+        free(s->angular);
+        free(s->inverseMass);
+        free(s->inverseInertia);
+        free(s->touched);
+        free(s->touchedList);
+        free(s->masks);
+        s->bodyCapacity =
+            count > 2 * s->bodyCapacity ? count : 2 * s->bodyCapacity;
+        s->linear = malloc(s->bodyCapacity * sizeof(vec3));
+        s->angular = malloc(s->bodyCapacity * sizeof(vec3));
+        s->inverseMass = malloc(s->bodyCapacity * sizeof(float));
+        s->inverseInertia = malloc(s->bodyCapacity * sizeof(float));
+        s->touched = calloc(s->bodyCapacity, sizeof(unsigned char));
+        s->touchedList = malloc(s->bodyCapacity * sizeof(unsigned int));
+        s->masks = calloc(s->bodyCapacity, sizeof(unsigned long long));
+    }
+
+    unsigned int still = count - 1;
+    glm_vec3_zero(s->linear[still]);
+    glm_vec3_zero(s->angular[still]);
+    s->inverseMass[still] = 0.0f;
+    s->inverseInertia[still] = 0.0f;
+}
+
+// turns contacts into solver contacts, starting each from the impulses of the
+// matching point of last step's manifold, and links the bodies each can move
+void solverPrepare(Solver* s, Narrowphase* np, Bodies* bodies, float gravity,
+                   float dt)
+{
+    if (np->contactCount > s->contactCapacity)
+    {
+        free(s->contacts);
+        free(s->overflow);
+        s->contactCapacity = np->contactCount > 2 * s->contactCapacity
+                                 ? np->contactCount
+                                 : 2 * s->contactCapacity;
+        s->contacts = malloc(s->contactCapacity * sizeof(SolverContact));
+        s->overflow = malloc(s->contactCapacity * sizeof(unsigned int));
+    }
+    s->contactCount = np->contactCount;
+    s->touchedCount = 0;
+    islandsReserve(&s->islands, s->offsets[OBJECT_TYPES], np->contactCount);
+
+    // contacts of a pair are written next to each other
+    unsigned int first = 0;
+    while (first < np->contactCount)
+    {
+        Contact* head = np->contacts + first;
+        unsigned long long key = solverKey(head);
+        unsigned int last = first + 1;
+        while (last < np->contactCount &&
+               solverKey(np->contacts + last) == key)
+        {
+            last++;
+        }
+
+        Bodies* a = bodies + head->typeA;
+        Bodies* b = bodies + head->typeB;
+        solverGather(s, a, head->a, gravity, dt);
+        solverGather(s, b, head->b, gravity, dt);
+
+        float r[3][3];
+        bodiesRotation(a, head->a, r);
+        vec3 positionA, positionB;
+        bodiesPosition(a, head->a, positionA);
+        bodiesPosition(b, head->b, positionB);
+
+        SolverManifold* manifold = solverFind(s, key);
+        int matched[NARROWPHASE_POINTS] = {0};
+        float match = SOLVER_MATCH * fminf(a->size[head->a], b->size[head->b]);
+
+        for (unsigned int index = first; index < last; index++)
+        {
+            Contact* contact = np->contacts + index;
+            SolverContact* c = s->contacts + index;
+            c->a = s->offsets[contact->typeA] + contact->a;
+            c->b = s->offsets[contact->typeB] + contact->b;
+            glm_vec3_copy(contact->normal, c->normal);
+            solverTangents(c->normal, c->tangents);
+            glm_vec3_sub(contact->point, positionA, c->offsetA);
+            glm_vec3_sub(contact->point, positionB, c->offsetB);
+            for (int axis = 0; axis < 3; axis++)
+            {
+                c->anchor[axis] = r[0][axis] * c->offsetA[0] +
+                                  r[1][axis] * c->offsetA[1] +
+                                  r[2][axis] * c->offsetA[2];
+            }
+
+            IslandsLink* link = s->islands.links + index;
+            link->a = s->inverseMass[c->a] > 0.0f ? c->a : ISLANDS_NONE;
+            link->b = s->inverseMass[c->b] > 0.0f ? c->b : ISLANDS_NONE;
+
+            c->normalMass = solverMass(s, c, c->normal);
+            c->tangentMass[0] = solverMass(s, c, c->tangents[0]);
+            c->tangentMass[1] = solverMass(s, c, c->tangents[1]);
+
+            // fast closing contacts bounce, while slow ones only push out
+            // the penetration beyond the slop, and speculative contacts of
+            // bodies still apart let them close the gap within the step and
+            // only bounce once they would reach it
+            vec3 velocity;
+            solverRelative(s, c, velocity);
+            float closing = glm_vec3_dot(velocity, c->normal);
+            c->bias = SOLVER_BAUMGARTE / dt *
+                      fmaxf(contact->depth - SOLVER_SLOP, 0.0f);
+            if (contact->depth < 0.0f)
+            {
+                c->bias = contact->depth / dt;
+            }
+            if (closing < -SOLVER_BOUNCE && closing * dt < contact->depth &&
+                s->restitution > 0.0f)
+            {
+                c->bias = fmaxf(c->bias, -s->restitution * closing);
+            }
+
+            // the nearest unused point of last step's manifold hands over its
+            // impulses
+            c->normalImpulse = 0.0f;
+            c->tangentImpulse[0] = 0.0f;
+            c->tangentImpulse[1] = 0.0f;
+            c->color = SOLVER_COLORS;
+            unsigned int nearest = NARROWPHASE_POINTS;
+            float nearestDistance = match * match;
+            for (unsigned int p = 0; manifold && p < manifold->count; p++)
+            {
+                float distance =
+                    glm_vec3_distance2(manifold->points[p].anchor, c->anchor);
+                if (!matched[p] && distance < nearestDistance)
+                {
+                    nearest = p;
+                    nearestDistance = distance;
+                }
+            }
+            if (nearest < NARROWPHASE_POINTS)
+            {
+                matched[nearest] = 1;
+                SolverPoint* point = manifold->points + nearest;
+                c->normalImpulse = point->normalImpulse;
+                c->tangentImpulse[0] = point->tangentImpulse[0];
+                c->tangentImpulse[1] = point->tangentImpulse[1];
+                c->color = point->color;
+            }
+        }
+
+        first = last;
+    }
+}
+
+// applies the impulses handed over from last step to a list of contacts
+// this runs once every closing speed has been measured, so the restitution of
+// one contact does not see another's warm start
+void solverWarm(Solver* s, unsigned int* order, unsigned int count)
+{
+    for (unsigned int k = 0; k < count; k++)
+    {
+        SolverContact* c = s->contacts + order[k];
+        vec3 impulse;
+        glm_vec3_scale(c->normal, c->normalImpulse, impulse);
+        glm_vec3_muladds(c->tangents[0], c->tangentImpulse[0], impulse);
+        glm_vec3_muladds(c->tangents[1], c->tangentImpulse[1], impulse);
+        solverApply(s, c, impulse);
+    }
+}
+
+// runs one Gauss-Seidel sweep over a list of contacts
+void solverIterate(Solver* s, unsigned int* order, unsigned int count)
+{
+    for (unsigned int k = 0; k < count; k++)
+    {
+        SolverContact* c = s->contacts + order[k];
+        vec3 velocity, impulse;
+
+        // friction is bounded by the normal impulse from the last sweep
+        float limit = s->friction * c->normalImpulse;
+        for (int t = 0; t < 2; t++)
+        {
+            solverRelative(s, c, velocity);
+            float lambda =
+                -c->tangentMass[t] * glm_vec3_dot(velocity, c->tangents[t]);
+            float total = glm_clamp(c->tangentImpulse[t] + lambda, -limit,
+                                    limit);
+            lambda = total - c->tangentImpulse[t];
+            c->tangentImpulse[t] = total;
+            glm_vec3_scale(c->tangents[t], lambda, impulse);
+            solverApply(s, c, impulse);
+        }
+
+        // the accumulated normal impulse may only push the bodies apart
+        solverRelative(s, c, velocity);
+        float lambda =
+            c->normalMass * (c->bias - glm_vec3_dot(velocity, c->normal));
+        float total = fmaxf(c->normalImpulse + lambda, 0.0f);
+        lambda = total - c->normalImpulse;
+        c->normalImpulse = total;
+        glm_vec3_scale(c->normal, lambda, impulse);
+        solverApply(s, c, impulse);
+    }
+}
+
+// solves a range of the islands left after the batched ones, which share no
+// body that can move
+void solverIsland(void* data, unsigned int first, unsigned int last,
+                  unsigned int worker)
+{
+    Solver* s = data;
+    Islands* is = &s->islands;
+    for (unsigned int island = s->batchIslands + first;
+         island < s->batchIslands + last; island++)
+    {
+        unsigned int* order = is->order + is->offsets[island];
+        unsigned int count = is->offsets[island + 1] - is->offsets[island];
+        solverWarm(s, order, count);
+        for (unsigned int iteration = 0; iteration < s->iterations; iteration++)
+        {
+            solverIterate(s, order, count);
+        }
+    }
+}
+
+// returns whether neither body of a contact that can move is in a batch yet
+int solverOpen(Solver* s, SolverContact* c, unsigned int color)
+{
+    unsigned long long bit = 1ull << color;
+    return !(s->masks[c->a] & bit) && !(s->masks[c->b] & bit);
+}
+
+// puts a contact in a batch, which only bodies that can move are marked in
+// since the rest are never written
+void solverTake(Solver* s, SolverContact* c, unsigned int color,
+                unsigned int* counts)
+{
+    c->color = color;
+    counts[color]++;
+    if (s->inverseMass[c->a] > 0.0f)
+    {
+        s->masks[c->a] |= 1ull << color;
+    }
+    if (s->inverseMass[c->b] > 0.0f)
+    {
+        s->masks[c->b] |= 1ull << color;
+    }
+}
+
+// colors the contacts of the batched islands so no body that can move
+// appears twice in a batch, then lays each batch out in blocks
+// contacts keep last step's color first so batches only change where the
+// contacts did, and the rest take the lowest color free for both bodies
+void solverColor(Solver* s)
+{
+    Islands* is = &s->islands;
+    unsigned int* order = is->order;
+    unsigned int count = is->offsets[s->batchIslands];
+    unsigned int counts[SOLVER_COLORS] = {0};
+
+    for (unsigned int k = 0; k < count; k++)
+    {
+        SolverContact* c = s->contacts + order[k];
+        if (c->color < SOLVER_COLORS && solverOpen(s, c, c->color))
+        {
+            solverTake(s, c, c->color, counts);
+        }
+        else
+        {
+            c->color = SOLVER_COLORS;
+        }
+    }
+
+    s->overflowCount = 0;
+    for (unsigned int k = 0; k < count; k++)
+    {
+        SolverContact* c = s->contacts + order[k];
+        if (c->color < SOLVER_COLORS)
+        {
+            continue;
+        }
+
+        unsigned long long used = s->masks[c->a] | s->masks[c->b];
+        unsigned int color = 0;
+        while (color < SOLVER_COLORS && (used >> color & 1))
+        {
+            color++;
+        }
+        if (color < SOLVER_COLORS)
+        {
+            solverTake(s, c, color, counts);
+        }
+        else
+        {
+            s->overflow[s->overflowCount++] = order[k];
+        }
+    }
+
+    // each batch starts a new block, and the last block of each is padded
+    s->batchCount = 0;
+    s->batchOffsets[0] = 0;
+    for (unsigned int color = 0; color < SOLVER_COLORS; color++)
+    {
+        s->batchOffsets[color + 1] =
+            s->batchOffsets[color] +
+            (counts[color] + SOLVER_LANES - 1) / SOLVER_LANES;
+        if (counts[color])
+        {
+            s->batchCount = color + 1;
+        }
+    }
+
+    unsigned int blocks = s->batchOffsets[s->batchCount];
+    if (blocks > s->blockCapacity)
+    {
+        free(s->blocks);
+        s->blockCapacity =
+            blocks > 2 * s->blockCapacity ? blocks : 2 * s->blockCapacity;
+        s->blocks = malloc(s->blockCapacity * sizeof(SolverBlock));
+    }
+    memset(s->blocks, 0, blocks * sizeof(SolverBlock));
+
+    unsigned int still = s->offsets[OBJECT_TYPES];
+    for (unsigned int block = 0; block < blocks; block++)
+    {
+        for (unsigned int lane = 0; lane < SOLVER_LANES; lane++)
+        {
+            s->blocks[block].contacts[lane] = ISLANDS_NONE;
+            s->blocks[block].a[lane] = still;
+            s->blocks[block].b[lane] = still;
+        }
+    }
+
+    unsigned int next[SOLVER_COLORS];
+    for (unsigned int color = 0; color < s->batchCount; color++)
+    {
+        next[color] = s->batchOffsets[color] * SOLVER_LANES;
+    }
+    for (unsigned int k = 0; k < count; k++)
+    {
+        unsigned int index = order[k];
+        SolverContact* c = s->contacts + index;
+
+        // the masks are only needed until every contact is placed
+        s->masks[c->a] = 0;
+        s->masks[c->b] = 0;
+        if (c->color == SOLVER_COLORS)
+        {
+            continue;
+        }
+
+        unsigned int slot = next[c->color]++;
+        SolverBlock* block = s->blocks + slot / SOLVER_LANES;
+        unsigned int lane = slot % SOLVER_LANES;
+        block->contacts[lane] = index;
+        block->a[lane] = c->a;
+        block->b[lane] = c->b;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            block->normal[axis][lane] = c->normal[axis];
+            block->tangents[0][axis][lane] = c->tangents[0][axis];
+            block->tangents[1][axis][lane] = c->tangents[1][axis];
+            block->offsetA[axis][lane] = c->offsetA[axis];
+            block->offsetB[axis][lane] = c->offsetB[axis];
+        }
+        block->normalMass[lane] = c->normalMass;
+        block->tangentMass[0][lane] = c->tangentMass[0];
+        block->tangentMass[1][lane] = c->tangentMass[1];
+        block->bias[lane] = c->bias;
+        block->normalImpulse[lane] = c->normalImpulse;
+        block->tangentImpulse[0][lane] = c->tangentImpulse[0];
+        block->tangentImpulse[1][lane] = c->tangentImpulse[1];
+    }
+}
+
+// loads one component of a vector per lane from the bodies of a block
+simdf solverLoadComponent(vec3* values, unsigned int* bodies, int axis)
+{
+    float lanes[SIMD_WIDTH];
+    for (int lane = 0; lane < SIMD_WIDTH; lane++)
+    {
+        lanes[lane] = values[bodies[lane]][axis];
+    }
+    return simdLoad(lanes);
+}
+
+// loads one float per lane from the bodies of a block
+simdf solverLoadValue(float* values, unsigned int* bodies)
+{
+    float lanes[SIMD_WIDTH];
+    for (int lane = 0; lane < SIMD_WIDTH; lane++)
+    {
+        lanes[lane] = values[bodies[lane]];
+    }
+    return simdLoad(lanes);
+}
+
+// writes one component of a vector per lane back to the bodies of a block
+// which can move
+void solverStoreComponent(Solver* s, vec3* values, unsigned int* bodies,
+                          int axis, simdf value)
+{
+    float lanes[SIMD_WIDTH];
+    simdStore(lanes, value);
+    for (int lane = 0; lane < SIMD_WIDTH; lane++)
+    {
+        if (s->inverseMass[bodies[lane]] > 0.0f)
+        {
+            values[bodies[lane]][axis] = lanes[lane];
+        }
+    }
+}
+
+// loads the bodies and arms of SIMD_WIDTH lanes of a block from a first lane
+void solverLoadLanes(Solver* s, SolverBlock* block, unsigned int first,
+                     SolverLanes* l)
+{
+    unsigned int* a = block->a + first;
+    unsigned int* b = block->b + first;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        l->linearA[axis] = solverLoadComponent(s->linear, a, axis);
+        l->angularA[axis] = solverLoadComponent(s->angular, a, axis);
+        l->linearB[axis] = solverLoadComponent(s->linear, b, axis);
+        l->angularB[axis] = solverLoadComponent(s->angular, b, axis);
+        l->offsetA[axis] = simdLoad(block->offsetA[axis] + first);
+        l->offsetB[axis] = simdLoad(block->offsetB[axis] + first);
+    }
+    l->inverseMassA = solverLoadValue(s->inverseMass, a);
+    l->inverseInertiaA = solverLoadValue(s->inverseInertia, a);
+    l->inverseMassB = solverLoadValue(s->inverseMass, b);
+    l->inverseInertiaB = solverLoadValue(s->inverseInertia, b);
+}
+
+// writes the velocities of SIMD_WIDTH lanes of a block back to their bodies
+void solverStoreLanes(Solver* s, SolverBlock* block, unsigned int first,
+                      SolverLanes* l)
+{
+    unsigned int* a = block->a + first;
+    unsigned int* b = block->b + first;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        solverStoreComponent(s, s->linear, a, axis, l->linearA[axis]);
+        solverStoreComponent(s, s->angular, a, axis, l->angularA[axis]);
+        solverStoreComponent(s, s->linear, b, axis, l->linearB[axis]);
+        solverStoreComponent(s, s->angular, b, axis, l->angularB[axis]);
+    }
+}
+
+// cross product of vectors with one register per component
+void solverCrossLanes(simdf* a, simdf* b, simdf* out)
+{
+    out[0] = simdSub(simdMul(a[1], b[2]), simdMul(a[2], b[1]));
+    out[1] = simdSub(simdMul(a[2], b[0]), simdMul(a[0], b[2]));
+    out[2] = simdSub(simdMul(a[0], b[1]), simdMul(a[1], b[0]));
+}
+
+// dot product of vectors with one register per component
+simdf solverDotLanes(simdf* a, simdf* b)
+{
+    return simdMulAdd(a[0], b[0], simdMulAdd(a[1], b[1], simdMul(a[2], b[2])));
+}
+
+// loads a direction stored with one stream per component
+void solverDirectionLanes(float direction[3][SOLVER_LANES], unsigned int first,
+                          simdf* out)
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        out[axis] = simdLoad(direction[axis] + first);
+    }
+}
+
+// returns the velocity of body b relative to body a at the contacts of lanes
+void solverRelativeLanes(SolverLanes* l, simdf* velocity)
+{
+    simdf spinA[3], spinB[3];
+    solverCrossLanes(l->angularA, l->offsetA, spinA);
+    solverCrossLanes(l->angularB, l->offsetB, spinB);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        velocity[axis] = simdSub(simdAdd(l->linearB[axis], spinB[axis]),
+                                 simdAdd(l->linearA[axis], spinA[axis]));
+    }
+}
+
+// pushes body b along a direction scaled per lane and body a against it
+void solverApplyLanes(SolverLanes* l, simdf* direction, simdf lambda)
+{
+    simdf impulse[3], torqueA[3], torqueB[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        impulse[axis] = simdMul(direction[axis], lambda);
+    }
+    solverCrossLanes(l->offsetA, impulse, torqueA);
+    solverCrossLanes(l->offsetB, impulse, torqueB);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        l->linearA[axis] =
+            simdSub(l->linearA[axis], simdMul(impulse[axis], l->inverseMassA));
+        l->angularA[axis] = simdSub(l->angularA[axis],
+                                    simdMul(torqueA[axis], l->inverseInertiaA));
+        l->linearB[axis] =
+            simdMulAdd(impulse[axis], l->inverseMassB, l->linearB[axis]);
+        l->angularB[axis] =
+            simdMulAdd(torqueB[axis], l->inverseInertiaB, l->angularB[axis]);
+    }
+}
+
+// applies the impulses handed over from last step to a block
+void solverWarmBlock(Solver* s, SolverBlock* block)
+{
+    for (unsigned int first = 0; first < SOLVER_LANES; first += SIMD_WIDTH)
+    {
+        SolverLanes l;
+        simdf direction[3];
+        solverLoadLanes(s, block, first, &l);
+
+        solverDirectionLanes(block->normal, first, direction);
+        solverApplyLanes(&l, direction,
+                         simdLoad(block->normalImpulse + first));
+        for (int t = 0; t < 2; t++)
+        {
+            solverDirectionLanes(block->tangents[t], first, direction);
+            solverApplyLanes(&l, direction,
+                             simdLoad(block->tangentImpulse[t] + first));
+        }
+
+        solverStoreLanes(s, block, first, &l);
+    }
+}
+
+// runs one sweep over a block, which is solverIterate across SIMD lanes
+void solverIterateBlock(Solver* s, SolverBlock* block)
+{
+    simdf zero = simdSet(0.0f);
+    simdf friction = simdSet(s->friction);
+    for (unsigned int first = 0; first < SOLVER_LANES; first += SIMD_WIDTH)
+    {
+        SolverLanes l;
+        simdf direction[3], velocity[3];
+        solverLoadLanes(s, block, first, &l);
+
+        simdf limit = simdMul(friction, simdLoad(block->normalImpulse + first));
+        for (int t = 0; t < 2; t++)
+        {
+            solverDirectionLanes(block->tangents[t], first, direction);
+            solverRelativeLanes(&l, velocity);
+            simdf lambda =
+                simdNeg(simdMul(simdLoad(block->tangentMass[t] + first),
+                                solverDotLanes(velocity, direction)));
+            simdf accumulated = simdLoad(block->tangentImpulse[t] + first);
+            simdf total = simdMin(
+                simdMax(simdAdd(accumulated, lambda), simdNeg(limit)), limit);
+            simdStore(block->tangentImpulse[t] + first, total);
+            solverApplyLanes(&l, direction, simdSub(total, accumulated));
+        }
+
+        solverDirectionLanes(block->normal, first, direction);
+        solverRelativeLanes(&l, velocity);
+        simdf lambda = simdMul(
+            simdLoad(block->normalMass + first),
+            simdSub(simdLoad(block->bias + first),
+                    solverDotLanes(velocity, direction)));
+        simdf accumulated = simdLoad(block->normalImpulse + first);
+        simdf total = simdMax(simdAdd(accumulated, lambda), zero);
+        simdStore(block->normalImpulse + first, total);
+        solverApplyLanes(&l, direction, simdSub(total, accumulated));
+
+        solverStoreLanes(s, block, first, &l);
+    }
+}
+
+// solves a chunk of the blocks of one batch, which share no body that can
+// move
+void solverBlocks(void* data, unsigned int first, unsigned int last,
+                  unsigned int worker)
+{
+    SolverTask* task = data;
+    for (unsigned int block = first; block < last; block++)
+    {
+        if (task->warm)
+        {
+            solverWarmBlock(task->s, task->blocks + block);
+        }
+        else
+        {
+            solverIterateBlock(task->s, task->blocks + block);
+        }
+    }
+}
+
+// runs every batch across the pool, then the contacts which did not fit in
+// one on the calling thread
+void solverSweep(Solver* s, Pool* pool, int warm)
+{
+    for (unsigned int color = 0; color < s->batchCount; color++)
+    {
+        SolverTask task = {s, s->blocks + s->batchOffsets[color], warm};
+        poolFor(pool, s->batchOffsets[color + 1] - s->batchOffsets[color],
+                SOLVER_BLOCK_GRAIN, solverBlocks, &task);
+    }
+
+    if (warm)
+    {
+        solverWarm(s, s->overflow, s->overflowCount);
+    }
+    else
+    {
+        solverIterate(s, s->overflow, s->overflowCount);
+    }
+}
+
+// solves the islands too large for a single thread in batches of contacts
+// which share no body that can move
+void solverBatch(Solver* s, Pool* pool)
+{
+    Islands* is = &s->islands;
+    s->batchIslands = 0;
+    while (s->batchIslands < is->count &&
+           is->offsets[s->batchIslands + 1] - is->offsets[s->batchIslands] >=
+               SOLVER_BATCH_MIN)
+    {
+        s->batchIslands++;
+    }
+    if (!s->batchIslands)
+    {
+        return;
+    }
+
+    solverColor(s);
+    solverSweep(s, pool, 1);
+    for (unsigned int iteration = 0; iteration < s->iterations; iteration++)
+    {
+        solverSweep(s, pool, 0);
+    }
+
+    // hand the accumulated impulses back for the manifold cache
+    for (unsigned int block = 0; block < s->batchOffsets[s->batchCount];
+         block++)
+    {
+        SolverBlock* b = s->blocks + block;
+        for (unsigned int lane = 0; lane < SOLVER_LANES; lane++)
+        {
+            if (b->contacts[lane] == ISLANDS_NONE)
+            {
+                continue;
+            }
+            SolverContact* c = s->contacts + b->contacts[lane];
+            c->normalImpulse = b->normalImpulse[lane];
+            c->tangentImpulse[0] = b->tangentImpulse[0][lane];
+            c->tangentImpulse[1] = b->tangentImpulse[1][lane];
+        }
+    }
+}
+
+// writes solved velocities back into the bodies that were touched, leaving out
+// the acceleration the next step adds again
+void solverScatter(Solver* s, Bodies* bodies, float gravity, float dt)
+{
+    for (unsigned int k = 0; k < s->touchedCount; k++)
+    {
+        unsigned int flat = s->touchedList[k];
+        int type = 0;
+        while (flat >= s->offsets[type + 1])
+        {
+            type++;
+        }
+        Bodies* b = bodies + type;
+        unsigned int i = flat - s->offsets[type];
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float velocity = s->linear[flat][axis] -
+                             b->linearAcceleration[axis][i] * dt -
+                             (axis == 1 ? gravity * dt : 0.0f);
+            b->lastPosition[axis][i] = b->position[axis][i] - velocity * dt;
+            b->angularVelocity[axis][i] = s->angular[flat][axis];
+        }
+    }
+}
+
+// replaces the manifold cache with the points and impulses of this step
+void solverRemember(Solver* s, Narrowphase* np)
+{
+    unsigned int manifolds = 0;
+    for (unsigned int index = 0; index < np->contactCount; index++)
+    {
+        manifolds += index == 0 || solverKey(np->contacts + index) !=
+                                       solverKey(np->contacts + index - 1);
+    }
+
+    // keep the table at most half full
+    unsigned int capacity = s->cacheCapacity ? s->cacheCapacity : 64;
+    while (capacity < 2 * manifolds)
+    {
+        capacity *= 2;
+    }
+    if (capacity != s->cacheCapacity)
+    {
+        free(s->cacheKeys);
+        free(s->cacheManifolds);
+        s->cacheCapacity = capacity;
+        s->cacheKeys = malloc(capacity * sizeof(unsigned long long));
+        s->cacheManifolds = malloc(capacity * sizeof(SolverManifold));
+    }
+    memset(s->cacheKeys, 0, capacity * sizeof(unsigned long long));
+
+    SolverManifold* manifold = NULL;
+    for (unsigned int index = 0; index < np->contactCount; index++)
+    {
+        unsigned long long key = solverKey(np->contacts + index);
+        if (index == 0 || key != solverKey(np->contacts + index - 1))
+        {
+            unsigned int slot = solverSlot(s, key);
+            while (s->cacheKeys[slot])
+            {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            s->cacheKeys[slot] = key;
+            manifold = s->cacheManifolds + slot;
+            manifold->count = 0;
+        }
+
+        SolverContact* c = s->contacts + index;
+        SolverPoint* point = manifold->points + manifold->count++;
+        glm_vec3_copy(c->anchor, point->anchor);
+        point->normalImpulse = c->normalImpulse;
+        point->tangentImpulse[0] = c->tangentImpulse[0];
+        point->tangentImpulse[1] = c->tangentImpulse[1];
+        point->color = c->color;
+    }
+}
+
+void solverRemap(Solver* s, unsigned int* places[OBJECT_TYPES], Arena* frame)
+{
+    unsigned int capacity = s->cacheCapacity;
+    if (!capacity)
+    {
+        return;
+    }
+
+    unsigned long long* keys =
+        arenaAlloc(frame, capacity * sizeof(unsigned long long));
+    SolverManifold* manifolds =
+        arenaAlloc(frame, capacity * sizeof(SolverManifold));
+    memcpy(keys, s->cacheKeys, capacity * sizeof(unsigned long long));
+    memcpy(manifolds, s->cacheManifolds, capacity * sizeof(SolverManifold));
+    memset(s->cacheKeys, 0, capacity * sizeof(unsigned long long));
+
+    unsigned int mask = (1u << 29) - 1;
+    for (unsigned int old = 0; old < capacity; old++)
+    {
+        if (!keys[old])
+        {
+            continue;
+        }
+
+        unsigned long long key = keys[old] - 1;
+        Contact c;
+        c.typeA = (ObjectType)((key >> 58) / OBJECT_TYPES);
+        c.typeB = (ObjectType)((key >> 58) % OBJECT_TYPES);
+        c.a = (unsigned int)(key >> 29) & mask;
+        c.b = (unsigned int)key & mask;
+        if (places[c.typeA])
+        {
+            c.a = places[c.typeA][c.a];
+        }
+        if (places[c.typeB])
+        {
+            c.b = places[c.typeB][c.b];
+        }
+
+        // impulses push along normals from a to b, so pairs whose bodies
+        // swapped order start over, and pairs with a removed body are dropped
+        if ((c.typeA == c.typeB && c.a > c.b) || c.a == BODIES_NONE ||
+            c.b == BODIES_NONE)
+        {
+            continue;
+        }
+
+        key = solverKey(&c);
+        unsigned int slot = solverSlot(s, key);
+        while (s->cacheKeys[slot])
+        {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        s->cacheKeys[slot] = key;
+        s->cacheManifolds[slot] = manifolds[old];
+    }
+}
+
+void solverUpdate(Solver* s, Narrowphase* np, Bodies* bodies, float gravity,
+                  float dt, Pool* pool)
+{
+    solverReserve(s, bodies);
+    solverPrepare(s, np, bodies, gravity, dt);
+
+    // islands too large for one thread are solved first across all of them,
+    // then the rest are claimed one at a time in order, so the largest start
+    // first and the small ones fill in around them
+    islandsUpdate(&s->islands, pool);
+    solverBatch(s, pool);
+    poolFor(pool, s->islands.count - s->batchIslands, 1, solverIsland, s);
+
+    solverScatter(s, bodies, gravity, dt);
+    solverRemember(s, np);
+
+    // clear the marks of every gathered body, including static ones
+    for (unsigned int index = 0; index < s->contactCount; index++)
+    {
+        s->touched[s->contacts[index].a] = 0;
+        s->touched[s->contacts[index].b] = 0;
+    }
+}
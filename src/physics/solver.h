@@ -0,0 +1,152 @@
+/*
+ * solver.h
+ *
+ * Sequential impulse contact solver with friction and restitution
+ *
+ * Contacts are solved with projected Gauss-Seidel on the velocities of the
+ * bodies they touch. Linear velocities come from the difference between each
+ * body's Verlet positions and are written back by moving its last position, so
+ * the next integration step carries the corrected velocity forwards
+ *
+ * Every pair's manifold is kept between steps under a key built from the type
+ * and index of both bodies, and the impulses its points accumulated on the
+ * last step are applied before iterating, which lets stacks settle with a few
+ * iterations instead of many
+ *
+ * Contacts are split into islands of bodies which touch each other (see
+ * islands.h), and each island is iterated as its own task on the pool, so
+ * separate piles are solved in parallel with the same result as in serial
+ *
+ * Islands too large for one thread are instead split into batches by coloring
+ * the contact graph, so no body that can move appears twice in a batch. Each
+ * batch is solved across the pool in blocks of SOLVER_LANES contacts laid out
+ * for SIMD, and contacts keep last step's color wherever it is still free so
+ * the batches change little while the contacts do
+ */
+
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <cglm/cglm.h>
+
+#include "bodies.h"
+#include "islands.h"
+#include "narrowphase.h"
+#include "utils/arena.h"
+#include "utils/pool.h"
+
+#define SOLVER_ITERATIONS 4       // default velocity iterations per step
+#define SOLVER_FRICTION 0.5f      // default friction coefficient
+#define SOLVER_RESTITUTION 0.2f   // default coefficient of restitution
+
+#define SOLVER_LANES 8    // contacts in each block of a batch
+#define SOLVER_COLORS 64  // most batches, one bit each in a body's mask
+
+// contact prepared for solving
+typedef struct SolverContact
+{
+    unsigned int a;  // flat index of body a
+    unsigned int b;
+    vec3 normal;       // unit normal pointing from body a towards body b
+    vec3 tangents[2];  // friction directions perpendicular to the normal
+    vec3 offsetA;      // contact point relative to the center of body a
+    vec3 offsetB;
+    vec3 anchor;  // contact point in body a's local frame, matched next step
+    float normalMass;  // inverse of the mass the normal impulse acts on
+    float tangentMass[2];
+    float bias;  // normal velocity the contact drives towards
+    float normalImpulse;  // impulses accumulated over the step
+    float tangentImpulse[2];
+    unsigned int color;  // batch on this or the last step, or SOLVER_COLORS
+} SolverContact;
+
+// contacts of a batch gathered into lanes, with the fields of each split
+// into one stream per component
+typedef struct SolverBlock
+{
+    unsigned int contacts[SOLVER_LANES];  // ISLANDS_NONE for unused lanes
+    unsigned int a[SOLVER_LANES];  // unused lanes use the still body one
+    unsigned int b[SOLVER_LANES];  // past the last
+    float normal[3][SOLVER_LANES];
+    float tangents[2][3][SOLVER_LANES];
+    float offsetA[3][SOLVER_LANES];
+    float offsetB[3][SOLVER_LANES];
+    float normalMass[SOLVER_LANES];
+    float tangentMass[2][SOLVER_LANES];
+    float bias[SOLVER_LANES];
+    float normalImpulse[SOLVER_LANES];
+    float tangentImpulse[2][SOLVER_LANES];
+} SolverBlock;
+
+// manifold point carried between steps
+typedef struct SolverPoint
+{
+    vec3 anchor;
+    float normalImpulse;
+    float tangentImpulse[2];
+    unsigned int color;
+} SolverPoint;
+
+typedef struct SolverManifold
+{
+    unsigned int count;
+    SolverPoint points[NARROWPHASE_POINTS];
+} SolverManifold;
+
+typedef struct Solver
+{
+    unsigned int iterations;  // velocity iterations per step
+    float friction;
+    float restitution;
+
+    /* BODIES */
+    unsigned int offsets[OBJECT_TYPES + 1];  // first flat index of each type
+    unsigned int bodyCapacity;
+    vec3* linear;  // velocities by flat index, valid for touched bodies
+    vec3* angular;
+    float* inverseMass;
+    float* inverseInertia;  // every shape's inertia is the same about any axis
+    unsigned char* touched;  // whether a body's velocity has been gathered
+    unsigned int touchedCount;
+    unsigned int* touchedList;  // bodies to write back after solving
+
+    /* CONTACTS */
+    unsigned int contactCount;
+    unsigned int contactCapacity;
+    SolverContact* contacts;
+    Islands islands;  // contacts grouped by the bodies they can move
+
+    /* BATCHES */
+    unsigned int batchIslands;  // leading islands solved in batches
+    unsigned int batchCount;
+    unsigned int batchOffsets[SOLVER_COLORS + 1];  // first block of each
+    unsigned int blockCapacity;
+    SolverBlock* blocks;
+    unsigned long long* masks;  // batches each body is in, by flat index
+    unsigned int overflowCount;
+    unsigned int* overflow;  // contacts no batch had room for
+
+    /* MANIFOLDS */
+    unsigned int cacheCapacity;     // slots in the table, a power of two
+    unsigned long long* cacheKeys;  // pair held by each slot, 0 when empty
+    SolverManifold* cacheManifolds;  // manifold of each pair from the last step
+} Solver;
+
+void solverInit(Solver* s, unsigned int iterations, float friction,
+                float restitution);
+
+void solverFree(Solver* s);
+
+// returns the inverse moment of inertia of a body about its center
+float solverInverseInertia(ObjectType type, float mass, float size);
+
+// applies impulses to the bodies of every contact found by the narrowphase
+void solverUpdate(Solver* s, Narrowphase* np, Bodies* bodies, float gravity,
+                  float dt, Pool* pool);
+
+// moves the manifold cached for each pair to the new places of its bodies
+// places holds the new index of each body of a type, or NULL if none moved
+// pairs with a body whose place is BODIES_NONE were removed and are dropped
+void solverRemap(Solver* s, unsigned int* places[OBJECT_TYPES], Arena* frame);
+
+#endif
@@ -0,0 +1,201 @@
+#include "speculative.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// distance from the center to the nearest face of each shape of size 1, since
+// sizes are the radii of the spheres around them
+const float SPECULATIVE_INRADII[OBJECT_TYPES] = {0.0f, 1.0f, 0.57735027f,
+                                                 1.0f / 3.0f};
+
+void speculativeInit(Speculative* s, float fraction)
+{
+    memset(s, 0, sizeof(Speculative));
+    s->fraction = fraction;
+}
+
+void speculativeFree(Speculative* s)
+{
+    free(s->bodies);
+    free(s->slots);
+    memset(s, 0, sizeof(Speculative));
+}
+
+void speculativeGrow(Speculative* s, Bodies* bodies, float gravity, float dt,
+                     int carried)
+{
+    s->count = 0;
+    if (s->fraction <= 0.0f)
+    {
+        return;
+    }
+
+    s->offsets[0] = 0;
+    for (int type = 0; type < OBJECT_TYPES; type++)
+    {
+        s->offsets[type + 1] = s->offsets[type] + bodies[type].count;
+    }
+    if (s->offsets[OBJECT_TYPES] > s->slotCapacity)
+    {
+        free(s->slots);
+        s->slotCapacity = s->offsets[OBJECT_TYPES] > 2 * s->slotCapacity
+                              ? s->offsets[OBJECT_TYPES]
+                              : 2 * s->slotCapacity;
+        s->slots = calloc(s->slotCapacity, sizeof(unsigned int));
+    }
+
+    // floors and static bodies never move
+    for (int type = FLOOR + 1; type < OBJECT_TYPES; type++)
+    {
+        Bodies* b = bodies + type;
+        for (unsigned int i = b->staticCount; i < b->count; i++)
+        {
+            if (b->mass[i] <= 0.0f || b->sleeping[i])
+            {
+                continue;
+            }
+
+            float moved = 0.0f;
+            vec3 move;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                move[axis] = b->position[axis][i] - b->lastPosition[axis][i];
+                if (carried)
+                {
+                    float acceleration = b->linearAcceleration[axis][i] +
+                                         (axis == 1 ? gravity : 0.0f);
+                    move[axis] += acceleration * dt * dt;
+                }
+                moved += move[axis] * move[axis];
+            }
+
+            // no point of the body moves further than its center does plus
+            // how far spinning carries its furthest corner
+            float spin = 0.0f;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                spin += b->angularVelocity[axis][i] *
+                        b->angularVelocity[axis][i];
+            }
+            float motion = sqrtf(moved) + sqrtf(spin) * b->size[i] * dt;
+            if (motion <= s->fraction * b->size[i])
+            {
+                continue;
+            }
+
+            if (s->count == s->capacity)
+            {
+                s->capacity = s->capacity ? 2 * s->capacity : 64;
+                s->bodies = realloc(s->bodies,
+                                    s->capacity * sizeof(SpeculativeBody));
+            }
+            SpeculativeBody* grown = s->bodies + s->count++;
+            grown->type = type;
+            grown->index = i;
+            grown->size = b->size[i];
+            s->slots[s->offsets[type] + i] = s->count;
+
+            // the faces of the grown shape move out by the whole motion, and
+            // its corners further
+            grown->growth = motion / SPECULATIVE_INRADII[type];
+            b->size[i] += grown->growth;
+
+            // a step which has already been taken is searched from where the
+            // body started it, so the contacts face the side it came from
+            glm_vec3_zero(grown->shift);
+            if (!carried)
+            {
+                glm_vec3_copy(move, grown->shift);
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    b->position[axis][i] -= move[axis];
+                }
+            }
+        }
+    }
+}
+
+// moves a point on the surface of a grown body onto its real surface, which is
+// the same shape scaled about its center, and then along with the body to
+// where it really is
+void speculativeMove(Bodies* b, SpeculativeBody* grown, vec3 point)
+{
+    float scale = grown->size / (grown->size + grown->growth);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float center = b->position[axis][grown->index] - grown->shift[axis];
+        point[axis] = center + (point[axis] - center) * scale +
+                      grown->shift[axis];
+    }
+}
+
+void speculativeShrink(Speculative* s, Narrowphase* np, Bodies* bodies)
+{
+    if (!s->count)
+    {
+        return;
+    }
+
+    for (unsigned int k = 0; k < s->count; k++)
+    {
+        SpeculativeBody* grown = s->bodies + k;
+        Bodies* b = bodies + grown->type;
+        b->size[grown->index] = grown->size;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            b->position[axis][grown->index] += grown->shift[axis];
+        }
+    }
+
+    // the points on both surfaces move back onto the real ones, keeping the
+    // contact on a grown body where that body really is
+    for (unsigned int index = 0; index < np->contactCount; index++)
+    {
+        Contact* c = np->contacts + index;
+        unsigned int slotA = s->slots[s->offsets[c->typeA] + c->a];
+        unsigned int slotB = s->slots[s->offsets[c->typeB] + c->b];
+        if (!slotA && !slotB)
+        {
+            continue;
+        }
+
+        vec3 pointA, pointB;
+        glm_vec3_copy(c->point, pointA);
+        glm_vec3_muladds(c->normal, 0.5f * c->depth, pointA);
+        glm_vec3_copy(c->point, pointB);
+        glm_vec3_muladds(c->normal, -0.5f * c->depth, pointB);
+        if (slotA)
+        {
+            speculativeMove(bodies + c->typeA, s->bodies + slotA - 1, pointA);
+        }
+        if (slotB)
+        {
+            speculativeMove(bodies + c->typeB, s->bodies + slotB - 1, pointB);
+        }
+
+        vec3 gap;
+        glm_vec3_sub(pointA, pointB, gap);
+        c->depth = glm_vec3_dot(gap, c->normal);
+        if (slotA && slotB)
+        {
+            glm_vec3_lerp(pointA, pointB, 0.5f, c->point);
+        }
+        else if (slotA)
+        {
+            glm_vec3_copy(pointA, c->point);
+            glm_vec3_muladds(c->normal, -0.5f * c->depth, c->point);
+        }
+        else
+        {
+            glm_vec3_copy(pointB, c->point);
+            glm_vec3_muladds(c->normal, 0.5f * c->depth, c->point);
+        }
+    }
+
+    for (unsigned int k = 0; k < s->count; k++)
+    {
+        SpeculativeBody* grown = s->bodies + k;
+        s->slots[s->offsets[grown->type] + grown->index] = 0;
+    }
+}
@@ -0,0 +1,75 @@
+/*
+ * speculative.h
+ *
+ * Speculative contacts for bodies moving fast enough to pass through thin
+ * bodies or floors within a single step
+ *
+ * Every step the few bodies whose motion over a step is more than a fraction
+ * of their size have their size grown just before collision, far enough that
+ * the grown shape covers everything within that motion of the real one. The
+ * broadphase, the floor sweep and every narrowphase kernel then find the
+ * bodies a fast body is about to reach without any change of their own
+ *
+ * The impulse solver searches from where bodies are for the motion of the
+ * coming step, while XPBD, whose trial step has already been taken, searches
+ * from where bodies started it so a body which passed through another still
+ * meets it from the side it came from
+ *
+ * Once contacts are found sizes and positions are put back, and the surface
+ * points of each contact of a grown body are scaled back about its center onto
+ * the real surface and carried along to where the body is. That leaves a
+ * negative depth for bodies still apart, which solvers treat as a speculative
+ * contact: the impulse solver only lets the bodies close the gap within the
+ * step, and XPBD only pushes once its substeps overlap them
+ */
+
+#ifndef SPECULATIVE_H
+#define SPECULATIVE_H
+
+#include "bodies.h"
+#include "narrowphase.h"
+
+#define SPECULATIVE_FRACTION 0.25f  // default fraction of a body's size it
+                                    // must move in a step to be grown, 0 for
+                                    // never
+
+// body whose size was grown for collision
+typedef struct SpeculativeBody
+{
+    ObjectType type;
+    unsigned int index;
+    float size;    // size before it was grown
+    float growth;  // how much the size grew
+    vec3 shift;    // how far the body was moved back for the search
+} SpeculativeBody;
+
+typedef struct Speculative
+{
+    float fraction;
+
+    /* BODIES */
+    unsigned int count;
+    unsigned int capacity;
+    SpeculativeBody* bodies;  // bodies grown on this step
+    unsigned int offsets[OBJECT_TYPES + 1];  // first flat index of each type
+    unsigned int slotCapacity;
+    unsigned int* slots;  // one past each body's place in the grown bodies,
+                          // 0 for slow ones
+} Speculative;
+
+void speculativeInit(Speculative* s, float fraction);
+
+void speculativeFree(Speculative* s);
+
+// grows the size of every awake body moving faster than the fraction allows
+// by enough to cover its motion over a step
+// carried is set when the velocity in the last positions leaves out the
+// acceleration of the next step, as the impulse solver's does
+void speculativeGrow(Speculative* s, Bodies* bodies, float gravity, float dt,
+                     int carried);
+
+// puts back the sizes of grown bodies and moves their contacts onto the real
+// surfaces
+void speculativeShrink(Speculative* s, Narrowphase* np, Bodies* bodies);
+
+#endif
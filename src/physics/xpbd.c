@@ -0,0 +1,599 @@
+#include "xpbd.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "solver.h"
+
+#define XPBD_EPSILON 1e-14f  // squared length below which a motion is ignored
+#define XPBD_BOUNCE 1.0f    // closing speed below which contacts do not bounce
+#define XPBD_SLOP 0.01f     // depth left in resting contacts so they are still
+                            // found at the end of the next trial step
+
+// shared state for the islands of a substep
+typedef struct XpbdTask
+{
+    Xpbd* x;
+    Bodies* bodies;
+    float h;
+    float alpha;  // compliance over the squared substep
+} XpbdTask;
+
+void xpbdInit(Xpbd* x, unsigned int substeps, float compliance,
+              float friction, float restitution)
+{
+    memset(x, 0, sizeof(Xpbd));
+    x->substeps = substeps;
+    x->compliance = compliance;
+    x->friction = friction;
+    x->restitution = restitution;
+    islandsInit(&x->islands);
+}
+
+void xpbdFree(Xpbd* x)
+{
+    free(x->position);
+    free(x->lastPosition);
+    free(x->orientation);
+    free(x->angular);
+    free(x->previous);
+    free(x->inverseMass);
+    free(x->inverseInertia);
+    free(x->contacts);
+    islandsFree(&x->islands);
+    memset(x, 0, sizeof(Xpbd));
+}
+
+// grows the per body arrays to cover every body
+void xpbdReserve(Xpbd* x, Bodies* bodies)
+{
+    unsigned int offsets[OBJECT_TYPES + 1];
+    memcpy(offsets, x->offsets, sizeof(offsets));
+    x->offsets[0] = 0;
+    for (int type = 0; type < OBJECT_TYPES; type++)
+    {
+        x->offsets[type + 1] = x->offsets[type] + bodies[type].count;
+    }
+
+    // static bodies are found at new flat indices once counts change
+    unsigned int count = x->offsets[OBJECT_TYPES];
+    if (count > x->bodyCapacity ||
+        memcmp(offsets, x->offsets, sizeof(offsets)))
+    {
+        for (int type = 0; type < OBJECT_TYPES; type++)
+        {
+            x->statics[type] = BODIES_NONE;
+        }
+    }
+    if (count > x->bodyCapacity)
+    {
+        free(x->position);
+        free(x->lastPosition);
+        free(x->orientation);
+        free(x->angular);
+        free(x->previous);
+        free(x->inverseMass);
+        free(x->inverseInertia);
+        x->bodyCapacity =
+            count > 2 * x->bodyCapacity ? count : 2 * x->bodyCapacity;
+        x->position = malloc(x->bodyCapacity * sizeof(vec3));
+        x->lastPosition = malloc(x->bodyCapacity * sizeof(vec3));
+        x->orientation = malloc(x->bodyCapacity * sizeof(versor));
+        x->angular = malloc(x->bodyCapacity * sizeof(vec3));
+        x->previous = malloc(x->bodyCapacity * sizeof(versor));
+        x->inverseMass = malloc(x->bodyCapacity * sizeof(float));
+        x->inverseInertia = malloc(x->bodyCapacity * sizeof(float));
+    }
+}
+
+void xpbdOrientation(Bodies* b, unsigned int i, versor q)
+{
+    for (int axis = 0; axis < 4; axis++)
+    {
+        q[axis] = b->orientation[axis][i];
+    }
+}
+
+// rotates a body by a small angle given as an axis scaled by the angle
+void xpbdTurn(Bodies* b, unsigned int i, vec3 angle)
+{
+    float qx = b->orientation[0][i];
+    float qy = b->orientation[1][i];
+    float qz = b->orientation[2][i];
+    float qw = b->orientation[3][i];
+
+    // first order update q += (angle, 0) * q / 2
+    float x = qx + 0.5f * (angle[0] * qw + angle[1] * qz - angle[2] * qy);
+    float y = qy + 0.5f * (-angle[0] * qz + angle[1] * qw + angle[2] * qx);
+    float z = qz + 0.5f * (angle[0] * qy - angle[1] * qx + angle[2] * qw);
+    float w = qw + 0.5f * (-angle[0] * qx - angle[1] * qy - angle[2] * qz);
+
+    float norm = sqrtf(x * x + y * y + z * z + w * w);
+    b->orientation[0][i] = x / norm;
+    b->orientation[1][i] = y / norm;
+    b->orientation[2][i] = z / norm;
+    b->orientation[3][i] = w / norm;
+}
+
+// finds where the anchors of a contact are relative to the current centers
+void xpbdOffsets(XpbdContact* c, Bodies* bodies)
+{
+    versor q;
+    xpbdOrientation(bodies + c->typeA, c->indexA, q);
+    glm_quat_rotatev(q, c->anchorA, c->offsetA);
+    xpbdOrientation(bodies + c->typeB, c->indexB, q);
+    glm_quat_rotatev(q, c->anchorB, c->offsetB);
+}
+
+// returns the inverse of the mass a correction along a direction acts on
+float xpbdWeight(Xpbd* x, XpbdContact* c, vec3 direction)
+{
+    vec3 armA, armB;
+    glm_vec3_cross(c->offsetA, direction, armA);
+    glm_vec3_cross(c->offsetB, direction, armB);
+    return x->inverseMass[c->a] + x->inverseMass[c->b] +
+           x->inverseInertia[c->a] * glm_vec3_norm2(armA) +
+           x->inverseInertia[c->b] * glm_vec3_norm2(armB);
+}
+
+// moves body b along a positional impulse and body a against it
+// carried moves shift the last positions too, so they leave velocities alone
+// bodies which cannot move are shared between islands, so they are never
+// written
+void xpbdMove(Xpbd* x, Bodies* bodies, XpbdContact* c, vec3 impulse,
+              int carry)
+{
+    Bodies* a = bodies + c->typeA;
+    Bodies* b = bodies + c->typeB;
+    vec3 angle;
+    for (int axis = 0; x->inverseMass[c->a] > 0.0f && axis < 3; axis++)
+    {
+        float move = impulse[axis] * x->inverseMass[c->a];
+        a->position[axis][c->indexA] -= move;
+        if (carry)
+        {
+            a->lastPosition[axis][c->indexA] -= move;
+        }
+    }
+    for (int axis = 0; x->inverseMass[c->b] > 0.0f && axis < 3; axis++)
+    {
+        float move = impulse[axis] * x->inverseMass[c->b];
+        b->position[axis][c->indexB] += move;
+        if (carry)
+        {
+            b->lastPosition[axis][c->indexB] += move;
+        }
+    }
+
+    if (x->inverseInertia[c->a] > 0.0f)
+    {
+        glm_vec3_cross(c->offsetA, impulse, angle);
+        glm_vec3_scale(angle, -x->inverseInertia[c->a], angle);
+        xpbdTurn(a, c->indexA, angle);
+    }
+    if (x->inverseInertia[c->b] > 0.0f)
+    {
+        glm_vec3_cross(c->offsetB, impulse, angle);
+        glm_vec3_scale(angle, x->inverseInertia[c->b], angle);
+        xpbdTurn(b, c->indexB, angle);
+    }
+}
+
+// changes the velocity of body b along an impulse and body a against it
+// linear velocity lives in the last position, which is one substep behind
+void xpbdPush(Xpbd* x, Bodies* bodies, XpbdContact* c, vec3 impulse, float h)
+{
+    Bodies* a = bodies + c->typeA;
+    Bodies* b = bodies + c->typeB;
+    vec3 torque;
+    if (x->inverseMass[c->a] > 0.0f)
+    {
+        glm_vec3_cross(c->offsetA, impulse, torque);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            a->lastPosition[axis][c->indexA] +=
+                impulse[axis] * x->inverseMass[c->a] * h;
+            a->angularVelocity[axis][c->indexA] -=
+                x->inverseInertia[c->a] * torque[axis];
+        }
+    }
+    if (x->inverseMass[c->b] > 0.0f)
+    {
+        glm_vec3_cross(c->offsetB, impulse, torque);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            b->lastPosition[axis][c->indexB] -=
+                impulse[axis] * x->inverseMass[c->b] * h;
+            b->angularVelocity[axis][c->indexB] +=
+                x->inverseInertia[c->b] * torque[axis];
+        }
+    }
+}
+
+// returns the velocity of body b relative to body a at a contact
+void xpbdRelative(XpbdContact* c, Bodies* bodies, float h, vec3 velocity)
+{
+    Bodies* a = bodies + c->typeA;
+    Bodies* b = bodies + c->typeB;
+    vec3 spinA, spinB, angularA, angularB;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        angularA[axis] = a->angularVelocity[axis][c->indexA];
+        angularB[axis] = b->angularVelocity[axis][c->indexB];
+    }
+    glm_vec3_cross(angularA, c->offsetA, spinA);
+    glm_vec3_cross(angularB, c->offsetB, spinB);
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float linearA = (a->position[axis][c->indexA] -
+                         a->lastPosition[axis][c->indexA]) /
+                        h;
+        float linearB = (b->position[axis][c->indexB] -
+                         b->lastPosition[axis][c->indexB]) /
+                        h;
+        velocity[axis] = linearB + spinB[axis] - linearA - spinA[axis];
+    }
+}
+
+// returns how far the anchor of body a sits past the anchor of body b along
+// the normal, which is positive while they overlap
+float xpbdDepth(XpbdContact* c, Bodies* bodies)
+{
+    Bodies* a = bodies + c->typeA;
+    Bodies* b = bodies + c->typeB;
+    float depth = 0.0f;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float pointA = a->position[axis][c->indexA] + c->offsetA[axis];
+        float pointB = b->position[axis][c->indexB] + c->offsetB[axis];
+        depth += (pointA - pointB) * c->normal[axis];
+    }
+    return depth;
+}
+
+// pushes apart contacts which already overlap past the slop when the step
+// starts, carrying the last positions along so the overlap left over from
+// earlier steps does not turn into velocity
+void xpbdStabilize(Xpbd* x, Bodies* bodies)
+{
+    for (unsigned int index = 0; index < x->contactCount; index++)
+    {
+        XpbdContact* c = x->contacts + index;
+        xpbdOffsets(c, bodies);
+        float depth = xpbdDepth(c, bodies) - XPBD_SLOP;
+        float weight = xpbdWeight(x, c, c->normal);
+        if (depth > 0.0f && weight > 0.0f)
+        {
+            vec3 impulse;
+            glm_vec3_scale(c->normal, depth / weight, impulse);
+            xpbdMove(x, bodies, c, impulse, 1);
+        }
+    }
+}
+
+void xpbdSave(Xpbd* x, Bodies* bodies)
+{
+    xpbdReserve(x, bodies);
+    for (int type = 0; type < OBJECT_TYPES; type++)
+    {
+        // static bodies never move, so only their masses are needed and those
+        // only change along with the static bodies
+        Bodies* b = bodies + type;
+        if (x->statics[type] != b->staticCount)
+        {
+            x->statics[type] = b->staticCount;
+            memset(x->inverseMass + x->offsets[type], 0,
+                   b->staticCount * sizeof(float));
+            memset(x->inverseInertia + x->offsets[type], 0,
+                   b->staticCount * sizeof(float));
+        }
+
+        for (unsigned int i = b->staticCount; i < b->count; i++)
+        {
+            unsigned int flat = x->offsets[type] + i;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                x->position[flat][axis] = b->position[axis][i];
+                x->lastPosition[flat][axis] = b->lastPosition[axis][i];
+                x->angular[flat][axis] = b->angularVelocity[axis][i];
+            }
+            xpbdOrientation(b, i, x->orientation[flat]);
+
+            // massless bodies never move in response to a contact
+            if (b->mass[i] <= 0.0f)
+            {
+                x->inverseMass[flat] = 0.0f;
+                x->inverseInertia[flat] = 0.0f;
+            }
+            else
+            {
+                x->inverseMass[flat] = 1.0f / b->mass[i];
+                x->inverseInertia[flat] =
+                    solverInverseInertia(type, b->mass[i], b->size[i]);
+            }
+        }
+    }
+}
+
+void xpbdPrepare(Xpbd* x, Narrowphase* np, Bodies* bodies, Pool* pool)
+{
+    if (np->contactCount > x->contactCapacity)
+    {
+        free(x->contacts);
+        x->contactCapacity = np->contactCount > 2 * x->contactCapacity
+                                 ? np->contactCount
+                                 : 2 * x->contactCapacity;
+        x->contacts = malloc(x->contactCapacity * sizeof(XpbdContact));
+    }
+    x->contactCount = np->contactCount;
+    islandsReserve(&x->islands, x->offsets[OBJECT_TYPES], np->contactCount);
+
+    // contact points lie midway between the deepest points of both bodies
+    for (unsigned int index = 0; index < np->contactCount; index++)
+    {
+        Contact* contact = np->contacts + index;
+        XpbdContact* c = x->contacts + index;
+        c->typeA = contact->typeA;
+        c->typeB = contact->typeB;
+        c->indexA = contact->a;
+        c->indexB = contact->b;
+        c->a = x->offsets[c->typeA] + c->indexA;
+        c->b = x->offsets[c->typeB] + c->indexB;
+        glm_vec3_copy(contact->normal, c->normal);
+
+        IslandsLink* link = x->islands.links + index;
+        link->a = x->inverseMass[c->a] > 0.0f ? c->a : ISLANDS_NONE;
+        link->b = x->inverseMass[c->b] > 0.0f ? c->b : ISLANDS_NONE;
+
+        vec3 pointA, pointB, center;
+        glm_vec3_copy(contact->point, pointA);
+        glm_vec3_muladds(contact->normal, 0.5f * contact->depth, pointA);
+        glm_vec3_copy(contact->point, pointB);
+        glm_vec3_muladds(contact->normal, -0.5f * contact->depth, pointB);
+
+        versor q;
+        xpbdOrientation(bodies + c->typeA, c->indexA, q);
+        glm_quat_conjugate(q, q);
+        bodiesPosition(bodies + c->typeA, c->indexA, center);
+        glm_vec3_sub(pointA, center, pointA);
+        glm_quat_rotatev(q, pointA, c->anchorA);
+
+        xpbdOrientation(bodies + c->typeB, c->indexB, q);
+        glm_quat_conjugate(q, q);
+        bodiesPosition(bodies + c->typeB, c->indexB, center);
+        glm_vec3_sub(pointB, center, pointB);
+        glm_quat_rotatev(q, pointB, c->anchorB);
+    }
+
+    // rewind, keeping the velocity each body started the step with
+    for (int type = 0; type < OBJECT_TYPES; type++)
+    {
+        Bodies* b = bodies + type;
+        for (unsigned int i = b->staticCount; i < b->count; i++)
+        {
+            unsigned int flat = x->offsets[type] + i;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                float position = x->position[flat][axis];
+                b->position[axis][i] = position;
+                b->lastPosition[axis][i] =
+                    position -
+                    (position - x->lastPosition[flat][axis]) / x->substeps;
+                b->angularVelocity[axis][i] = x->angular[flat][axis];
+            }
+            for (int axis = 0; axis < 4; axis++)
+            {
+                b->orientation[axis][i] = x->orientation[flat][axis];
+            }
+        }
+    }
+
+    xpbdStabilize(x, bodies);
+
+    // contacts are held for the whole step, so their islands are too
+    islandsUpdate(&x->islands, pool);
+}
+
+void xpbdPredict(Xpbd* x, Bodies* bodies, float h)
+{
+    for (unsigned int index = 0; index < x->contactCount; index++)
+    {
+        XpbdContact* c = x->contacts + index;
+        xpbdOrientation(bodies + c->typeA, c->indexA, x->previous[c->a]);
+        xpbdOrientation(bodies + c->typeB, c->indexB, x->previous[c->b]);
+
+        xpbdOffsets(c, bodies);
+        vec3 velocity;
+        xpbdRelative(c, bodies, h, velocity);
+        c->approach = glm_vec3_dot(velocity, c->normal);
+        c->lambda = 0.0f;
+        c->tangentLambda = 0.0f;
+    }
+}
+
+// recovers the angular velocity of a body from how far it turned
+void xpbdSpin(Xpbd* x, Bodies* b, unsigned int i, unsigned int flat, float h)
+{
+    versor q, turn;
+    xpbdOrientation(b, i, q);
+    glm_quat_conjugate(x->previous[flat], turn);
+    glm_quat_mul(q, turn, turn);
+
+    // the shorter of the two rotations a quaternion and its negation describe
+    float sign = turn[3] < 0.0f ? -2.0f : 2.0f;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        b->angularVelocity[axis][i] = sign * turn[axis] / h;
+    }
+}
+
+// pushes the anchors of a contact apart, then holds them in place against
+// each other while friction allows
+void xpbdPosition(Xpbd* x, Bodies* bodies, XpbdContact* c, float alpha)
+{
+    xpbdOffsets(c, bodies);
+    float depth = xpbdDepth(c, bodies);
+    float weight = xpbdWeight(x, c, c->normal);
+    if (depth <= 0.0f || weight <= 0.0f)
+    {
+        return;
+    }
+
+    float lambda = (depth - XPBD_SLOP - alpha * c->lambda) /
+                   (weight + alpha);
+    if (lambda <= 0.0f)
+    {
+        return;
+    }
+    c->lambda += lambda;
+    vec3 impulse;
+    glm_vec3_scale(c->normal, lambda, impulse);
+    xpbdMove(x, bodies, c, impulse, 0);
+
+    // relative motion of the anchors over the substep, where they started
+    // from the last positions and orientations
+    Bodies* a = bodies + c->typeA;
+    Bodies* b = bodies + c->typeB;
+    vec3 startA, startB, motion;
+    xpbdOffsets(c, bodies);
+    glm_quat_rotatev(x->previous[c->a], c->anchorA, startA);
+    glm_quat_rotatev(x->previous[c->b], c->anchorB, startB);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        motion[axis] =
+            (a->position[axis][c->indexA] + c->offsetA[axis] -
+             a->lastPosition[axis][c->indexA] - startA[axis]) -
+            (b->position[axis][c->indexB] + c->offsetB[axis] -
+             b->lastPosition[axis][c->indexB] - startB[axis]);
+    }
+    glm_vec3_muladds(c->normal, -glm_vec3_dot(motion, c->normal), motion);
+
+    float slide = glm_vec3_norm2(motion);
+    if (slide < XPBD_EPSILON)
+    {
+        return;
+    }
+    slide = sqrtf(slide);
+    glm_vec3_scale(motion, 1.0f / slide, motion);
+    float tangentLambda = slide / (xpbdWeight(x, c, motion) + alpha);
+    if (c->tangentLambda + tangentLambda < x->friction * c->lambda)
+    {
+        c->tangentLambda += tangentLambda;
+        glm_vec3_scale(motion, tangentLambda, impulse);
+        xpbdMove(x, bodies, c, impulse, 0);
+    }
+}
+
+// removes the sliding velocity friction allows and replaces the normal
+// velocity the position correction left with a bounce
+void xpbdVelocity(Xpbd* x, Bodies* bodies, XpbdContact* c, float h)
+{
+    xpbdOffsets(c, bodies);
+    float weight = xpbdWeight(x, c, c->normal);
+    if (weight <= 0.0f)
+    {
+        return;
+    }
+    vec3 velocity, tangent, impulse;
+    xpbdRelative(c, bodies, h, velocity);
+    float normal = glm_vec3_dot(velocity, c->normal);
+    glm_vec3_copy(velocity, tangent);
+    glm_vec3_muladds(c->normal, -normal, tangent);
+
+    // the friction impulse is bounded by the normal impulse the position
+    // correction implies
+    float slide = glm_vec3_norm2(tangent);
+    if (slide > XPBD_EPSILON)
+    {
+        slide = sqrtf(slide);
+        glm_vec3_scale(tangent, 1.0f / slide, tangent);
+        float stop = slide / xpbdWeight(x, c, tangent);
+        float limit = x->friction * c->lambda / h;
+        glm_vec3_scale(tangent, -fminf(stop, limit), impulse);
+        xpbdPush(x, bodies, c, impulse, h);
+    }
+
+    // slow contacts only stop, since a bounce would keep resting bodies
+    // hopping and carry impacts up through stacks
+    xpbdRelative(c, bodies, h, velocity);
+    normal = glm_vec3_dot(velocity, c->normal);
+    float restitution = c->approach < -XPBD_BOUNCE ? x->restitution : 0.0f;
+    float target = fmaxf(-restitution * c->approach, 0.0f);
+    glm_vec3_scale(c->normal, (target - normal) / weight, impulse);
+    xpbdPush(x, bodies, c, impulse, h);
+}
+
+// runs a substep's corrections over a range of islands, which share no body
+// that can move
+void xpbdIsland(void* data, unsigned int first, unsigned int last,
+                unsigned int worker)
+{
+    XpbdTask* task = data;
+    Xpbd* x = task->x;
+    Bodies* bodies = task->bodies;
+    float h = task->h;
+    Islands* is = &x->islands;
+    for (unsigned int island = first; island < last; island++)
+    {
+        unsigned int* order = is->order + is->offsets[island];
+        unsigned int count = is->offsets[island + 1] - is->offsets[island];
+        for (unsigned int k = 0; k < count; k++)
+        {
+            xpbdPosition(x, bodies, x->contacts + order[k], task->alpha);
+        }
+
+        // bodies a correction turned spin at the rate they turned over the
+        // substep
+        for (unsigned int k = 0; k < count; k++)
+        {
+            XpbdContact* c = x->contacts + order[k];
+            if (c->lambda <= 0.0f)
+            {
+                continue;
+            }
+            if (x->inverseInertia[c->a] > 0.0f)
+            {
+                xpbdSpin(x, bodies + c->typeA, c->indexA, c->a, h);
+            }
+            if (x->inverseInertia[c->b] > 0.0f)
+            {
+                xpbdSpin(x, bodies + c->typeB, c->indexB, c->b, h);
+            }
+        }
+
+        for (unsigned int k = 0; k < count; k++)
+        {
+            XpbdContact* c = x->contacts + order[k];
+            if (c->lambda > 0.0f)
+            {
+                xpbdVelocity(x, bodies, c, h);
+            }
+        }
+    }
+}
+
+void xpbdSolve(Xpbd* x, Bodies* bodies, float h, Pool* pool)
+{
+    XpbdTask task = {x, bodies, h, x->compliance / (h * h)};
+    poolFor(pool, x->islands.count, 1, xpbdIsland, &task);
+}
+
+void xpbdFinish(Xpbd* x, Bodies* bodies)
+{
+    for (int type = 0; type < OBJECT_TYPES; type++)
+    {
+        Bodies* b = bodies + type;
+        for (unsigned int i = b->staticCount; i < b->count; i++)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                float position = b->position[axis][i];
+                b->lastPosition[axis][i] =
+                    position -
+                    (position - b->lastPosition[axis][i]) * x->substeps;
+            }
+        }
+    }
+}
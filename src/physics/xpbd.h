@@ -0,0 +1,99 @@
+/*
+ * xpbd.h
+ *
+ * Extended position based dynamics for contacts, an alternative to the
+ * sequential impulse solver
+ *
+ * Contacts are found once per step at the end of a trial step, and the deepest
+ * point of each body is pinned to that body. The step is then taken again as
+ * several substeps which each integrate, push the pinned points apart on
+ * positions with a compliance, and derive velocities from how far the bodies
+ * moved, so small substeps replace velocity iterations
+ *
+ * Each substep solves the islands of the contacts (see islands.h) as separate
+ * tasks on the pool
+ */
+
+#ifndef XPBD_H
+#define XPBD_H
+
+#include <cglm/cglm.h>
+
+#include "bodies.h"
+#include "islands.h"
+#include "narrowphase.h"
+#include "utils/pool.h"
+
+#define XPBD_SUBSTEPS 8         // default substeps per physics step
+#define XPBD_COMPLIANCE 0.0f    // default inverse stiffness of contacts
+
+// contact pinned to both bodies for the whole step
+typedef struct XpbdContact
+{
+    unsigned int a;  // flat index of body a
+    unsigned int b;
+    ObjectType typeA;
+    ObjectType typeB;
+    unsigned int indexA;  // index of body a in the store of its type
+    unsigned int indexB;
+    vec3 normal;   // unit normal pointing from body a towards body b
+    vec3 anchorA;  // deepest point of body a in its local frame
+    vec3 anchorB;
+    vec3 offsetA;  // anchors relative to the centers in world space
+    vec3 offsetB;
+    float lambda;          // normal correction of the current substep
+    float tangentLambda;   // friction correction of the current substep
+    float approach;  // normal velocity of b relative to a before the substep
+} XpbdContact;
+
+typedef struct Xpbd
+{
+    unsigned int substeps;
+    float compliance;  // inverse stiffness of contacts, 0 for rigid contacts
+    float friction;
+    float restitution;
+
+    /* BODIES */
+    unsigned int offsets[OBJECT_TYPES + 1];  // first flat index of each type
+    unsigned int bodyCapacity;
+    vec3* position;  // state at the start of the step, by flat index
+    vec3* lastPosition;
+    versor* orientation;
+    vec3* angular;
+    versor* previous;  // orientations at the start of the current substep
+    float* inverseMass;
+    float* inverseInertia;
+    unsigned int statics[OBJECT_TYPES];  // static bodies of each type whose
+                                         // inverse masses are zeroed
+
+    /* CONTACTS */
+    unsigned int contactCount;
+    unsigned int contactCapacity;
+    XpbdContact* contacts;
+    Islands islands;  // contacts grouped by the bodies they can move
+} Xpbd;
+
+void xpbdInit(Xpbd* x, unsigned int substeps, float compliance,
+              float friction, float restitution);
+
+void xpbdFree(Xpbd* x);
+
+// keeps the state of every dynamic body before the trial step
+void xpbdSave(Xpbd* x, Bodies* bodies);
+
+// pins the contacts found at the end of the trial step to both bodies, then
+// rewinds to the saved state with last positions one substep behind
+void xpbdPrepare(Xpbd* x, Narrowphase* np, Bodies* bodies, Pool* pool);
+
+// records what the next substep's corrections are measured against
+// must run before the substep is integrated
+void xpbdPredict(Xpbd* x, Bodies* bodies, float h);
+
+// corrects positions after a substep is integrated, then the velocities the
+// corrections imply
+void xpbdSolve(Xpbd* x, Bodies* bodies, float h, Pool* pool);
+
+// puts last positions back one full step behind
+void xpbdFinish(Xpbd* x, Bodies* bodies);
+
+#endif
@@ -3,6 +3,8 @@
 #include <string.h>
 
 #include "../simulation.h"
+#include "physics/particles.h"
+#include "physics/snapshot.h"
 #include "physics/objects/cube.h"
 #include "physics/objects/floor.h"
 #include "physics/objects/sphere.h"
@@ -61,9 +63,77 @@ unsigned int openglInit(Simulation* sim)
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glEnable(GL_CULL_FACE);
 
+    // particles size their own point sprites
+    glEnable(GL_PROGRAM_POINT_SIZE);
+
     return 0;
 }
 
+// grows the object data and VBO of a type to hold at least the given number of
+// objects, doubling so bodies spawned one at a time rarely reallocate
+// expects the type's VBO to be bound
+void objectsReserve(Simulation* sim, ObjectType type, unsigned int count)
+{
+    unsigned int capacity = sim->objectCapacities[type];
+    if (count <= capacity && sim->objectData[type])
+    {
+        return;
+    }
+    capacity = count > 2 * capacity ? count : 2 * capacity;
+    capacity = capacity > 0 ? capacity : 1;
+
+    sim->objectData[type] =
+        realloc(sim->objectData[type],
+                capacity * objectVerticesSize() * sizeof(float));
+    sim->objectResting[type] =
+        realloc(sim->objectResting[type], capacity * sizeof(int));
+    memset(sim->objectResting[type] + sim->objectCapacities[type], 0,
+           (capacity - sim->objectCapacities[type]) * sizeof(int));
+    sim->objectCapacities[type] = capacity;
+    sim->objectStatics[type] = BODIES_NONE;
+
+    glBufferData(GL_ARRAY_BUFFER,
+                 capacity * objectVerticesSize() * sizeof(float), NULL,
+                 GL_DYNAMIC_DRAW);
+}
+
+// grows the particle VBO to hold at least the given number of particles, with
+// each of their streams in its own range
+void pointsReserve(Simulation* sim, unsigned int count)
+{
+    unsigned int capacity = sim->particleCapacity;
+    if (count <= capacity && capacity > 0)
+    {
+        return;
+    }
+    capacity = count > 2 * capacity ? count : 2 * capacity;
+    capacity = capacity > 0 ? capacity : 1;
+    sim->particleCapacity = capacity;
+    sim->particleVersion = BODIES_NONE;
+
+    glBindVertexArray(sim->particleVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, sim->particleVBO);
+    glBufferData(GL_ARRAY_BUFFER,
+                 PARTICLES_STREAMS * capacity * sizeof(float), NULL,
+                 GL_DYNAMIC_DRAW);
+
+    // positions, last positions, and radii
+    for (unsigned int stream = 0; stream < 7; stream++)
+    {
+        glEnableVertexAttribArray(stream);
+        glVertexAttribPointer(stream, 1, GL_FLOAT, GL_FALSE, sizeof(float),
+                              (void*)(stream * capacity * sizeof(float)));
+    }
+    // packed color
+    glEnableVertexAttribArray(7);
+    glVertexAttribPointer(7, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                          sizeof(unsigned int),
+                          (void*)(7 * capacity * sizeof(float)));
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
 // generate and bind all object data (model matrices, color, and meshes) to
 // OpenGL
 void buffersInit(Simulation* sim)
@@ -90,9 +160,12 @@ void buffersInit(Simulation* sim)
         sim->meshes[type] = malloc(sim->meshSizes[type] * sizeof(float));
         generateMesh[type](sim->meshes[type]);
 
-        // allocate object data
-        sim->objectSizes[type] = sim->objectCounts[type] * objectVerticesSize();
-        sim->objectData[type] = malloc(sim->objectSizes[type] * sizeof(float));
+        // object data from a prior run is sized again for the new bodies
+        free(sim->objectData[type]);
+        free(sim->objectResting[type]);
+        sim->objectData[type] = NULL;
+        sim->objectResting[type] = NULL;
+        sim->objectCapacities[type] = 0;
 
         glBindVertexArray(sim->VAOs[type]);
 
@@ -113,8 +186,7 @@ void buffersInit(Simulation* sim)
 
         // object vertex buffer
         glBindBuffer(GL_ARRAY_BUFFER, sim->objectVBOs[type]);
-        glBufferData(GL_ARRAY_BUFFER, sim->objectSizes[type] * sizeof(float),
-                     sim->objectData[type], GL_STATIC_DRAW);
+        objectsReserve(sim, type, sim->bodies[type].count);
 
         // model matrix
         for (unsigned int i = 0; i < 4; i++)
@@ -134,6 +206,16 @@ void buffersInit(Simulation* sim)
 
         glBindVertexArray(0);
     }
+
+    // the particle buffers outlive restarts, but particles from a prior run
+    // are uploaded again
+    if (sim->initialized != 1)
+    {
+        glGenVertexArrays(1, &sim->particleVAO);
+        glGenBuffers(1, &sim->particleVBO);
+    }
+    sim->particleCapacity = 0;
+    pointsReserve(sim, sim->particles.count);
 }
 
 unsigned int renderInit(Simulation* sim)
@@ -154,6 +236,12 @@ unsigned int renderInit(Simulation* sim)
     {
         shaderInit(&sim->shader, "../src/render/shaders/default-vs.glsl",
                    "../src/render/shaders/default-fs.glsl");
+        shaderInit(&sim->particleShader,
+                   "../src/render/shaders/particle-vs.glsl",
+                   "../src/render/shaders/particle-fs.glsl");
+        shaderInit(&sim->particleShadowShader,
+                   "../src/render/shaders/particle-vs.glsl",
+                   "../src/render/shaders/particle-shadow-fs.glsl");
         if (shadowInit(&sim->shadow, &sim->camera, sim->lightDir))
         {
             return 1;
@@ -178,36 +266,96 @@ void renderUpdate(Simulation* sim)
     shadowUpdate(&sim->shadow, &sim->camera);
 }
 
-// iterate through objects and render with instancing
-void objectsRender(Simulation* sim)
+// uploads model matrices and color for every body in the snapshot
+// done once per frame since both passes draw the same state
+void objectsUpdate(Simulation* sim, Snapshot* snapshot, float alpha)
 {
     for (unsigned int type = 0; type < OBJECT_TYPES; type++)
     {
-        // floor should not be culled
-        if (type == FLOOR)
+        glBindBuffer(GL_ARRAY_BUFFER, sim->objectVBOs[type]);
+        objectsReserve(sim, type, snapshot->counts[type]);
+
+        // static objects are uploaded once and again only when they change
+        unsigned int first = 0;
+        if (sim->objectStatics[type] == snapshot->statics[type] &&
+            sim->objectStaticVersions[type] == snapshot->staticVersions[type])
         {
-            glDisable(GL_CULL_FACE);
+            first = snapshot->statics[type];
         }
+        sim->objectStatics[type] = snapshot->statics[type];
+        sim->objectStaticVersions[type] = snapshot->staticVersions[type];
 
-        glBindVertexArray(sim->VAOs[type]);
-        for (unsigned int i = 0, idx = 0; i < sim->objectCounts[type];
-             i++, idx += objectVerticesSize())
+        for (unsigned int i = first, idx = first * objectVerticesSize();
+             i < snapshot->counts[type]; i++, idx += objectVerticesSize())
         {
+            // bodies asleep since their data was generated have not moved
+            int resting = snapshot->resting[type][i];
+            if (resting && resting == sim->objectResting[type][i])
+            {
+                continue;
+            }
+
             // update object model matrices and color
-            objectVertices(&sim->objects[type][i], sim->objectData[type] + idx);
+            snapshotVertices(snapshot, type, i, alpha,
+                             sim->objectData[type] + idx);
+            sim->objectResting[type][i] = resting;
         }
 
-        // reattach new object data
-        glBindBuffer(GL_ARRAY_BUFFER, sim->objectVBOs[type]);
-        glBufferData(GL_ARRAY_BUFFER, sim->objectSizes[type] * sizeof(float),
-                     sim->objectData[type], GL_STATIC_DRAW);
+        // upload only the objects in use which may have changed, into the
+        // buffer's existing storage
+        unsigned int offset = first * objectVerticesSize();
+        glBufferSubData(GL_ARRAY_BUFFER, offset * sizeof(float),
+                        (snapshot->counts[type] - first) *
+                            objectVerticesSize() * sizeof(float),
+                        sim->objectData[type] + offset);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// uploads the streams of every particle in the snapshot as they are, since
+// the vertex shader interpolates between their positions
+void pointsUpdate(Simulation* sim, Snapshot* snapshot)
+{
+    unsigned int count = snapshot->particleCount;
+    pointsReserve(sim, count);
+    glBindBuffer(GL_ARRAY_BUFFER, sim->particleVBO);
+
+    // radii and colors are uploaded again only when particles were added
+    unsigned int streams = 6;
+    if (sim->particleVersion != snapshot->particleVersion)
+    {
+        streams = PARTICLES_STREAMS;
+        sim->particleVersion = snapshot->particleVersion;
+    }
+    for (unsigned int stream = 0; stream < streams; stream++)
+    {
+        glBufferSubData(GL_ARRAY_BUFFER,
+                        stream * sim->particleCapacity * sizeof(float),
+                        count * sizeof(float),
+                        snapshot->particleData +
+                            stream * snapshot->particleCapacity);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// iterate through objects and render with instancing
+void objectsRender(Simulation* sim, Snapshot* snapshot)
+{
+    for (unsigned int type = 0; type < OBJECT_TYPES; type++)
+    {
+        // floor should not be culled
+        if (type == FLOOR)
+        {
+            glDisable(GL_CULL_FACE);
+        }
 
         // draw objects with instancing
+        glBindVertexArray(sim->VAOs[type]);
         glDrawArraysInstanced(GL_TRIANGLES, 0, sim->meshSizes[type] / 6,
-                              sim->objectCounts[type]);
-
+                              snapshot->counts[type]);
         glBindVertexArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
 
         if (type == FLOOR)
         {
@@ -216,8 +364,36 @@ void objectsRender(Simulation* sim)
     }
 }
 
+// draws every particle in the snapshot as a point sprite with a shader whose
+// other uniforms are already set
+// point scale is how many pixels a unit length spans at unit depth
+void pointsRender(Simulation* sim, Snapshot* snapshot, Shader* shader,
+                  mat4 vp, float pointScale, float alpha)
+{
+    if (!snapshot->particleCount)
+    {
+        return;
+    }
+
+    shaderUse(shader);
+    shaderSetMatrix(shader, "vp", vp);
+    shaderSetFloat(shader, "pointScale", pointScale);
+    shaderSetFloat(shader, "alpha", alpha);
+    glBindVertexArray(sim->particleVAO);
+    glDrawArrays(GL_POINTS, 0, snapshot->particleCount);
+    glBindVertexArray(0);
+}
+
 void render(Simulation* sim)
 {
+    // newest state published by the physics thread, read without locking
+    Snapshot* snapshot = snapshotAcquire(&sim->physics.snapshots);
+
+    // fraction of a physics step between the two states in the snapshot
+    float alpha = snapshotAlpha(snapshot, glfwGetTime());
+    objectsUpdate(sim, snapshot, alpha);
+    pointsUpdate(sim, snapshot);
+
     /* SHADOW PASS */
     GLint viewport[4];
     glGetIntegerv(GL_VIEWPORT, viewport);
@@ -227,7 +403,11 @@ void render(Simulation* sim)
     glClear(GL_DEPTH_BUFFER_BIT);
     shaderUse(&sim->shadow.shader);
     shaderSetMatrix(&sim->shadow.shader, "vp", sim->shadow.vp);
-    objectsRender(sim);
+    objectsRender(sim, snapshot);
+    pointsRender(sim, snapshot, &sim->particleShadowShader, sim->shadow.vp,
+                 0.5f * sim->shadow.projection[1][1] *
+                     sim->shadow.SHADOW_HEIGHT,
+                 alpha);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
     glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
@@ -247,10 +427,23 @@ void render(Simulation* sim)
     shaderSetVector(&sim->shader, "lightDir", sim->lightDir);
     shaderSetVector(&sim->shader, "viewPos", sim->camera.cameraPos);
     glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-    objectsRender(sim);
+    objectsRender(sim, snapshot);
+
+    // particles read the same shadow map through the same texture unit
+    shaderUse(&sim->particleShader);
+    shaderSetMatrix(&sim->particleShader, "view", sim->camera.view);
+    shaderSetMatrix(&sim->particleShader, "shadowVP", sim->shadow.vp);
+    shaderSetInt(&sim->particleShader, "depthMap", 1);
+    shaderSetVector(&sim->particleShader, "lightDir", sim->lightDir);
+    shaderSetVector(&sim->particleShader, "viewPos", sim->camera.cameraPos);
+    pointsRender(sim, snapshot, &sim->particleShader, sim->camera.vp,
+                 0.5f * sim->camera.projection[1][1] * viewport[3], alpha);
 
     /* METRICS */
-    unsigned int lines = OBJECT_TYPES + 6;
+    // throughput of gravitation is only shown while it runs, and particles
+    // while there are any
+    unsigned int lines = OBJECT_TYPES + 9 + (snapshot->interactionRate > 0.0) +
+                         (snapshot->particleCount > 0);
     char buffers[lines][20];
     char* text[lines];
 
@@ -262,15 +455,15 @@ void render(Simulation* sim)
         strncpy(name, OBJECT_NAMES[i], 19);
         name[19] = '\0';
         name[0] = (char)(name[0] - 'a' + 'A');
-        if (sim->objectCounts[i] != 1)
+        if (snapshot->counts[i] != 1)
         {
-            snprintf(buffers[i + 1], 20, "%d %ss", sim->objectCounts[i], name);
+            snprintf(buffers[i + 1], 20, "%d %ss", snapshot->counts[i], name);
         }
         else
         {
-            snprintf(buffers[i + 1], 20, "%d %s", sim->objectCounts[i], name);
+            snprintf(buffers[i + 1], 20, "%d %s", snapshot->counts[i], name);
         }
-        totalObjects += sim->objectCounts[i];
+        totalObjects += snapshot->counts[i];
     }
 
     if (totalObjects != 1)
@@ -300,6 +493,31 @@ void render(Simulation* sim)
     // frames
     snprintf(buffers[OBJECT_TYPES + 5], 20, "%llu frames", sim->frames);
 
+    // physics steps, which advance independently of frames
+    snprintf(buffers[OBJECT_TYPES + 6], 20, "%llu steps", snapshot->step);
+
+    // scratch memory of physics, which should stop reaching the heap once
+    // the arenas have grown to fit a step
+    snprintf(buffers[OBJECT_TYPES + 7], 20, "%.0f KB arena peak",
+             snapshot->arenaPeak / 1024.0);
+    snprintf(buffers[OBJECT_TYPES + 8], 20, "%.2f allocs/step",
+             snapshot->heapAllocations);
+
+    // millions of pulls between bodies evaluated per second
+    unsigned int line = OBJECT_TYPES + 9;
+    if (snapshot->interactionRate > 0.0)
+    {
+        snprintf(buffers[line++], 20, "%.1fM pulls/s",
+                 snapshot->interactionRate * 1e-6);
+    }
+
+    // millions of particles
+    if (snapshot->particleCount > 0)
+    {
+        snprintf(buffers[line++], 20, "%.2fM Particles",
+                 snapshot->particleCount * 1e-6);
+    }
+
     for (int i = 0; i < lines; i++)
     {
         text[i] = buffers[i];
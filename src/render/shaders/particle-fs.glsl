@@ -0,0 +1,58 @@
+#version 330 core
+
+uniform mat4 view;
+uniform mat4 shadowVP;
+uniform vec3 lightDir;
+uniform vec3 viewPos;
+uniform sampler2DShadow depthMap;
+
+in vec3 color;
+in vec3 center;
+in float radius;
+
+out vec4 FragColor;
+
+void main()
+{
+    // each sprite is shaded as the half of its sphere facing the camera, and
+    // its corners outside of the sphere are dropped
+    vec2 offset =
+        vec2(2.0 * gl_PointCoord.x - 1.0, 1.0 - 2.0 * gl_PointCoord.y);
+    float across = dot(offset, offset);
+    if(across > 1.0)
+    {
+        discard;
+    }
+
+    vec3 right = vec3(view[0][0], view[1][0], view[2][0]);
+    vec3 up = vec3(view[0][1], view[1][1], view[2][1]);
+    vec3 back = vec3(view[0][2], view[1][2], view[2][2]);
+    vec3 norm = normalize(offset.x * right + offset.y * up +
+                          sqrt(1.0 - across) * back);
+    vec3 FragPos = center + radius * norm;
+
+    // Phong lighting parameters
+    float ambientStrength = 0.8;
+    float normalStrength = 0.4;
+    float specularStrength = 0.2;
+
+    vec3 ambient = vec3(ambientStrength);
+
+    float diff = max(dot(norm, -lightDir), 0.0);
+    vec3 diffuse = vec3(diff * normalStrength);
+
+    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 reflectDir = reflect(lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+    vec3 specular = vec3(specularStrength * spec);
+
+    // particles are too small for soft shadow edges to show, so a single
+    // sample is taken
+    vec4 shadowCoord4 = shadowVP * vec4(FragPos, 1.0);
+    vec3 ShadowCoord = (shadowCoord4.xyz / shadowCoord4.w) * 0.5 + 0.5;
+    ShadowCoord.z -= 0.001;
+    float shadow = texture(depthMap, ShadowCoord);
+
+    vec3 result = (ambient + shadow * (diffuse + specular)) * color;
+    FragColor = vec4(result, 1.0);
+}
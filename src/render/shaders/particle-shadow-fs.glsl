@@ -0,0 +1,12 @@
+#version 330 core
+out vec4 FragColor;
+
+void main()
+{
+    // only the disc of each sprite casts a shadow
+    vec2 offset = 2.0 * gl_PointCoord - 1.0;
+    if(dot(offset, offset) > 1.0)
+    {
+        discard;
+    }
+}
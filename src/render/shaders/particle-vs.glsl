@@ -0,0 +1,30 @@
+#version 330 core
+// each stream of the particles is its own attribute
+layout (location = 0) in float x;
+layout (location = 1) in float y;
+layout (location = 2) in float z;
+layout (location = 3) in float lastX;
+layout (location = 4) in float lastY;
+layout (location = 5) in float lastZ;
+layout (location = 6) in float aRadius;
+layout (location = 7) in vec4 aColor;
+
+uniform mat4 vp;
+uniform float alpha;       // fraction of a physics step between the positions
+uniform float pointScale;  // pixels spanned by a unit length at unit depth
+
+out vec3 color;
+out vec3 center;
+out float radius;
+
+void main()
+{
+    center = mix(vec3(lastX, lastY, lastZ), vec3(x, y, z), alpha);
+    gl_Position = vp * vec4(center, 1.0);
+
+    // distant particles stay a pixel across rather than vanishing
+    gl_PointSize = max(2.0 * aRadius * pointScale / gl_Position.w, 1.0);
+
+    color = aColor.rgb;
+    radius = aRadius;
+}
@@ -8,6 +8,7 @@
 #include <unistd.h>
 
 #include "cJSON.h"
+#include "physics/bodies.h"
 #include "physics/object.h"
 #include "physics/physics.h"
 #include "render/camera.h"
@@ -22,17 +23,85 @@ unsigned int simulationInit(Simulation* sim, const char* configPath)
     sim->frames = 0;
     sim->lastTime = 0.0f;
 
-    // initialize objects from config
+    // the physics thread must not touch bodies while they are reloaded
+    int restart = sim->physics.started;
+    physicsStop(sim);
+    sim->thrownCount = 0;
+
+    // release bodies from the prior run when restarting
+    if (sim->initialized == 1)
+    {
+        for (int type = 0; type < OBJECT_TYPES; type++)
+        {
+            bodiesFree(&sim->bodies[type]);
+        }
+        particlesFree(&sim->particles);
+        snapshotBufferFree(&sim->physics.snapshots);
+        broadphaseFree(&sim->broadphase);
+        planesFree(&sim->planes);
+        narrowphaseFree(&sim->narrowphase);
+        solverFree(&sim->solver);
+        xpbdFree(&sim->xpbd);
+        demFree(&sim->dem);
+        sleepFree(&sim->sleep);
+        speculativeFree(&sim->speculative);
+        forcesFree(&sim->forces);
+    }
+    else
+    {
+        pthread_mutex_init(&sim->physics.mutex, NULL);
+        arenaInit(&sim->frame);
+    }
+
+    // initialize objects and forces from config
+    forcesInit(&sim->forces);
     if (parseConfig(sim, configPath))
     {
         return 1;
     }
 
+    // command line takes priority over the config, which takes priority over
+    // the hardware
+    unsigned int threads = sim->threadOverride ? sim->threadOverride
+                           : sim->threads      ? sim->threads
+                                               : poolHardwareThreads();
+    if (sim->initialized != 1 || sim->pool.threads != threads)
+    {
+        if (sim->initialized == 1)
+        {
+            poolFree(&sim->pool);
+        }
+        poolInit(&sim->pool, threads);
+    }
+
+    broadphaseInit(&sim->broadphase, sim->broadphaseMode, sim->cellSize,
+                   sim->staticSah);
+    planesInit(&sim->planes, sim->infiniteFloors);
+    narrowphaseInit(&sim->narrowphase);
+    narrowphaseTable(sim->collisionTable);
+    solverInit(&sim->solver, sim->solverIterations, sim->friction,
+               sim->restitution);
+    xpbdInit(&sim->xpbd, sim->substeps, sim->compliance, sim->friction,
+             sim->restitution);
+    demInit(&sim->dem, sim->demSkin, sim->demStiffness, sim->demDamping,
+            sim->friction, sim->infiniteFloors);
+    sleepInit(&sim->sleep, sim->sleepSpeed, sim->sleepSpin, sim->sleepSteps);
+    speculativeInit(&sim->speculative, sim->speculativeFraction);
+    reorderInit(&sim->reorder, sim->reorderInterval);
+
+    sim->physics.steps = 0;
+    snapshotBufferInit(&sim->physics.snapshots, sim->bodies, &sim->particles);
+
     renderInit(sim);
     callbacksInit(sim);
 
     sim->initialized = 1;
 
+    if (restart)
+    {
+        return physicsStart(sim);
+    }
+
     return 0;
 }
 
@@ -58,26 +127,56 @@ void simulationUpdate(Simulation* sim)
 
     renderUpdate(sim);
     sim->frames++;
-    physicsUpdate(sim);
 }
 
 void simulationFree(Simulation* sim)
 {
+    physicsStop(sim);
+    snapshotBufferFree(&sim->physics.snapshots);
+    broadphaseFree(&sim->broadphase);
+    planesFree(&sim->planes);
+    narrowphaseFree(&sim->narrowphase);
+    solverFree(&sim->solver);
+    xpbdFree(&sim->xpbd);
+    demFree(&sim->dem);
+    sleepFree(&sim->sleep);
+    speculativeFree(&sim->speculative);
+    forcesFree(&sim->forces);
+    pthread_mutex_destroy(&sim->physics.mutex);
+
     for (int type = 0; type < OBJECT_TYPES; type++)
     {
-        free(sim->objects[type]);
+        bodiesFree(&sim->bodies[type]);
         free(sim->meshes[type]);
         free(sim->objectData[type]);
+        free(sim->objectResting[type]);
     }
+    particlesFree(&sim->particles);
+    free(sim->thrown);
+
+    poolFree(&sim->pool);
+    arenaFree(&sim->frame);
 
     glDeleteFramebuffers(1, &sim->shadow.FBO);
     glDeleteBuffers(3, sim->meshVBOs);
     glDeleteVertexArrays(3, sim->VAOs);
+    glDeleteBuffers(1, &sim->particleVBO);
+    glDeleteVertexArrays(1, &sim->particleVAO);
     glDeleteProgram(sim->shader.ID);
+    glDeleteProgram(sim->particleShader.ID);
+    glDeleteProgram(sim->particleShadowShader.ID);
 }
 
 void simulationStart(Simulation* sim)
 {
+    // physics runs at its own rate while this thread only renders
+    if (physicsStart(sim))
+    {
+        glfwTerminate();
+        simulationFree(sim);
+        return;
+    }
+
     while (!glfwWindowShouldClose(sim->window))
     {
         simulationUpdate(sim);
@@ -97,6 +196,34 @@ void simulationSave(Simulation* sim)
 
     // save simulation configuration
     cJSON_AddNumberToObject(config, "gravity", sim->gravity);
+    cJSON_AddStringToObject(config, "broadphase",
+                            BROADPHASE_NAMES[sim->broadphaseMode]);
+    cJSON_AddNumberToObject(config, "physicsRate", sim->physicsRate);
+    if (sim->cellSize > 0.0f)
+    {
+        cJSON_AddNumberToObject(config, "cellSize", sim->cellSize);
+    }
+    cJSON_AddBoolToObject(config, "staticSah", sim->staticSah);
+    cJSON_AddBoolToObject(config, "infiniteFloors", sim->infiniteFloors);
+    if (sim->threads)
+    {
+        cJSON_AddNumberToObject(config, "threads", sim->threads);
+    }
+    cJSON_AddNumberToObject(config, "solverIterations", sim->solverIterations);
+    cJSON_AddNumberToObject(config, "friction", sim->friction);
+    cJSON_AddNumberToObject(config, "restitution", sim->restitution);
+    cJSON_AddStringToObject(config, "dynamics", DYNAMICS_NAMES[sim->dynamics]);
+    cJSON_AddNumberToObject(config, "substeps", sim->substeps);
+    cJSON_AddNumberToObject(config, "compliance", sim->compliance);
+    cJSON_AddNumberToObject(config, "demSkin", sim->demSkin);
+    cJSON_AddNumberToObject(config, "demStiffness", sim->demStiffness);
+    cJSON_AddNumberToObject(config, "demDamping", sim->demDamping);
+    cJSON_AddNumberToObject(config, "sleepSpeed", sim->sleepSpeed);
+    cJSON_AddNumberToObject(config, "sleepSpin", sim->sleepSpin);
+    cJSON_AddNumberToObject(config, "sleepSteps", sim->sleepSteps);
+    cJSON_AddNumberToObject(config, "speculativeFraction",
+                            sim->speculativeFraction);
+    cJSON_AddNumberToObject(config, "reorderInterval", sim->reorderInterval);
 
     cJSON* configLightDir = cJSON_CreateFloatArray(sim->lightDir, 3);
     cJSON_AddItemReferenceToObject(config, "lightDir", configLightDir);
@@ -108,17 +235,63 @@ void simulationSave(Simulation* sim)
     cJSON_AddItemReferenceToObject(config, "cameraPos", configCameraPos);
 
     // save simulation objects
+    // bodies are only consistent between physics steps
+    pthread_mutex_lock(&sim->physics.mutex);
     cJSON* configObjects = cJSON_CreateArray();
     for (int type = 0; type < OBJECT_TYPES; type++)
     {
-        for (int i = 0; i < sim->objectCounts[type]; i++)
+        for (int i = 0; i < sim->bodies[type].count; i++)
         {
-            cJSON* configObject = objectToJSON(sim->objects[type] + i);
+            Object object;
+            bodiesGet(&sim->bodies[type], i, &object);
+            cJSON* configObject = objectToJSON(&object, sim->physicsDT);
             cJSON_AddItemToArray(configObjects, configObject);
         }
     }
 
+    // springs name their bodies by their place in the saved objects, and are
+    // dropped once either body has been removed
+    unsigned int offsets[OBJECT_TYPES + 1] = {0};
+    for (int type = 0; type < OBJECT_TYPES; type++)
+    {
+        offsets[type + 1] = offsets[type] + sim->bodies[type].count;
+    }
+    cJSON* configForces = cJSON_CreateArray();
+    for (unsigned int k = 0; k < sim->forces.count; k++)
+    {
+        Force* force = sim->forces.forces + k;
+        unsigned int a = 0;
+        unsigned int b = 0;
+        if (force->type == FORCE_SPRING)
+        {
+            BodiesHandle handleA = force->spring.a;
+            BodiesHandle handleB = force->spring.b;
+            a = bodiesFind(&sim->bodies[handleA.type], handleA);
+            b = bodiesFind(&sim->bodies[handleB.type], handleB);
+            if (a == BODIES_NONE || b == BODIES_NONE)
+            {
+                continue;
+            }
+            a += offsets[handleA.type];
+            b += offsets[handleB.type];
+        }
+        cJSON_AddItemToArray(configForces, forcesToJSON(force, a, b));
+    }
+
+    pthread_mutex_unlock(&sim->physics.mutex);
+
+    // particles are saved as the boxes they were scattered over, which only
+    // change when the config is loaded, so they restart where they began
+    cJSON* configParticles = cJSON_CreateArray();
+    for (unsigned int k = 0; k < sim->particles.emitterCount; k++)
+    {
+        cJSON_AddItemToArray(configParticles,
+                             particlesToJSON(sim->particles.emitters + k));
+    }
+
     cJSON_AddItemReferenceToObject(config, "objects", configObjects);
+    cJSON_AddItemReferenceToObject(config, "forces", configForces);
+    cJSON_AddItemReferenceToObject(config, "particles", configParticles);
 
     char* configString = cJSON_Print(config);
 
@@ -128,3 +301,46 @@ void simulationSave(Simulation* sim)
     free(configString);
 }
 
+void simulationThrow(Simulation* sim)
+{
+    Camera* c = &sim->camera;
+    Object o;
+    memset(&o, 0, sizeof(Object));
+    vec3 color = {1.0f, 0.5f, 0.0f};
+    objectInit(&o, SPHERE, SIMULATION_THROW_SIZE, 1.0f, c->cameraPos, color);
+    glm_quat_identity(o.orientation);
+
+    // the velocity is given by the step from the prior position
+    vec3 step;
+    glm_vec3_scale(c->cameraFront, SIMULATION_THROW_SPEED * sim->physicsDT,
+                   step);
+    glm_vec3_sub(o.position, step, o.lastPosition);
+
+    // bodies only change between physics steps
+    pthread_mutex_lock(&sim->physics.mutex);
+    BodiesHandle handle = physicsSpawn(sim, &o);
+    pthread_mutex_unlock(&sim->physics.mutex);
+
+    if (sim->thrownCount == sim->thrownCapacity)
+    {
+        sim->thrownCapacity = sim->thrownCapacity ? 2 * sim->thrownCapacity
+                                                  : 16;
+        sim->thrown = realloc(sim->thrown,
+                              sim->thrownCapacity * sizeof(BodiesHandle));
+    }
+    sim->thrown[sim->thrownCount++] = handle;
+}
+
+void simulationUnthrow(Simulation* sim)
+{
+    // handles of spheres removed some other way are stale and skipped
+    pthread_mutex_lock(&sim->physics.mutex);
+    while (sim->thrownCount)
+    {
+        if (!physicsDespawn(sim, sim->thrown[--sim->thrownCount]))
+        {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sim->physics.mutex);
+}
@@ -12,11 +12,29 @@
 #include <GLFW/glfw3.h>
 #include <cglm/cglm.h>
 
+#include "physics/bodies.h"
+#include "physics/broadphase.h"
+#include "physics/dem.h"
+#include "physics/forces.h"
+#include "physics/narrowphase.h"
+#include "physics/planes.h"
+#include "physics/reorder.h"
 #include "physics/object.h"
+#include "physics/particles.h"
+#include "physics/physics.h"
+#include "physics/sleep.h"
+#include "physics/solver.h"
+#include "physics/speculative.h"
+#include "physics/xpbd.h"
 #include "render/camera.h"
 #include "render/shader.h"
 #include "render/shadow.h"
 #include "render/text.h"
+#include "utils/arena.h"
+#include "utils/pool.h"
+
+#define SIMULATION_THROW_SIZE 0.5f    // radius of spheres thrown by the user
+#define SIMULATION_THROW_SPEED 20.0f  // speed they leave the camera at
 
 typedef struct Simulation
 {
@@ -25,15 +43,58 @@ typedef struct Simulation
     GLFWwindow* window;
     int initialized;  // whether the simulation has already been initialized for
                       // restarting purposes
-    unsigned int
-        objectCounts[OBJECT_TYPES];  // the number of each type of object
+    unsigned int threadOverride;  // thread count from the command line, 0 if
+                                  // the config should decide
 
     /* PHYSICS VARIABLES */
     float gravity;
-    void (*collisionTable[OBJECT_TYPES][OBJECT_TYPES])(
-        float*);  // table of function pointers for collision resolution
-    Object* objects[OBJECT_TYPES];  // holds object rigid body data for physics
-                                    // calculations
+    Forces forces;  // generators of every force other than gravity
+    float physicsRate;  // physics steps per simulated second
+    float physicsDT;    // simulated seconds per physics step
+    unsigned int threads;  // thread count from the config, 0 to use every core
+    Pool pool;             // workers which split each physics phase into chunks
+    Arena frame;  // scratch shared by the serial parts of a physics step
+    BroadphaseMode broadphaseMode;  // broadphase algorithm from the config
+    float cellSize;  // broadphase cell size from the config, 0 to derive it
+    int staticSah;   // whether the static tree is split by surface area
+    Broadphase broadphase;  // finds candidate pairs of overlapping bodies
+    int infiniteFloors;  // whether floors extend past their edges
+    Planes planes;       // finds the bodies touching each floor
+    // table of narrowphase kernels which turn a batch of candidate pairs
+    // between two object types into contacts, indexed with the lower type
+    // first
+    NarrowphaseKernel collisionTable[OBJECT_TYPES][OBJECT_TYPES];
+    Narrowphase narrowphase;  // contacts found on the last step
+    unsigned int solverIterations;  // contact solver iterations from the config
+    float friction;     // friction coefficient of every contact
+    float restitution;  // coefficient of restitution of every contact
+    Solver solver;      // resolves contacts and keeps manifolds between steps
+    DynamicsMode dynamics;  // how contacts are resolved, from the config
+    unsigned int substeps;  // XPBD substeps per physics step from the config
+    float compliance;       // XPBD inverse stiffness of every contact
+    Xpbd xpbd;              // resolves contacts on positions over substeps
+    float demSkin;       // distance spheres may close before lists rebuild
+    float demStiffness;  // effective elastic modulus of soft contacts
+    float demDamping;    // damping of the closing speed of soft contacts
+    Dem dem;             // pushes spheres apart with soft contacts
+    float sleepSpeed;  // speed below which a body counts as still
+    float sleepSpin;   // angular speed below which a body counts as still
+    unsigned int sleepSteps;  // still steps before sleeping, 0 for never
+    Sleep sleep;  // sets of bodies at rest which physics skips
+    float speculativeFraction;  // fraction of its size a body moves in a step
+                                // before it gets speculative contacts
+    Speculative speculative;    // grows fast bodies for collision
+    unsigned int reorderInterval;  // steps between sorting bodies in space, 0
+                                   // for never
+    Reorder reorder;  // keeps bodies close in space close in memory
+    Bodies bodies[OBJECT_TYPES];  // structure-of-arrays rigid body data for
+                                  // each object type, owned by the physics
+                                  // thread while it runs
+    Particles particles;  // point masses which only collide with floors
+    BodiesHandle* thrown;  // spheres thrown from the camera, latest last
+    unsigned int thrownCount;
+    unsigned int thrownCapacity;
+    PhysicsThread physics;  // steps bodies and publishes snapshots to render
 
     /* METRICS */
     float avgFPS;               // average FPS of simulation
@@ -50,11 +111,17 @@ typedef struct Simulation
     // object data (model matrix and color)
     unsigned int objectVBOs[OBJECT_TYPES];  // VBOs for object data
     unsigned int VAOs[OBJECT_TYPES];        // VAOs for each type of object
-    unsigned int
-        objectSizes[OBJECT_TYPES];  // the number of floats in all of the object
-                                    // data for each object type
+    unsigned int objectCapacities[OBJECT_TYPES];  // objects the data and VBO
+                                                 // of each type have room for
     float* objectData[OBJECT_TYPES];  // buffer with per object rendering data
                                       // (model matrix and color)
+    int* objectResting[OBJECT_TYPES];  // sleeping set id each object's data
+                                       // was generated in, 0 if awake
+    unsigned int objectStatics[OBJECT_TYPES];  // static objects leading each
+                                               // VBO, BODIES_NONE until they
+                                               // are uploaded
+    unsigned int objectStaticVersions[OBJECT_TYPES];  // version of the static
+                                                      // objects uploaded
 
     // meshes
     unsigned int meshVBOs[OBJECT_TYPES];   // VBOs for each of the object meshes
@@ -62,6 +129,15 @@ typedef struct Simulation
                                            // mesh of each object
     float* meshes[OBJECT_TYPES];  // default meshes for each object type
 
+    // particles, drawn as point sprites from copies of their streams
+    Shader particleShader;
+    Shader particleShadowShader;
+    unsigned int particleVAO;
+    unsigned int particleVBO;
+    unsigned int particleCapacity;  // stride between the streams in the VBO
+    unsigned int particleVersion;   // version of the radii and colors
+                                    // uploaded, BODIES_NONE until they are
+
 } Simulation;
 
 // initialize the simulation
@@ -76,5 +152,11 @@ void simulationStart(Simulation* sim);
 // save the current state of the simulation into JSON format
 void simulationSave(Simulation* sim);
 
+// throws a sphere from the camera along the direction it faces
+void simulationThrow(Simulation* sim);
+
+// removes the latest thrown sphere which is still around
+void simulationUnthrow(Simulation* sim);
+
 #endif
 
@@ -0,0 +1,107 @@
+#include "arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// rounds a size up to the alignment of every allocation
+size_t arenaRound(size_t size)
+{
+    return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+void arenaInit(Arena* a)
+{
+    memset(a, 0, sizeof(Arena));
+}
+
+// returns overflows of the current frame to the heap
+void arenaRelease(Arena* a)
+{
+    while (a->overflows)
+    {
+        ArenaOverflow* next = a->overflows->next;
+        free(a->overflows);
+        a->overflows = next;
+    }
+}
+
+void arenaFree(Arena* a)
+{
+    arenaRelease(a);
+    free(a->block);
+    memset(a, 0, sizeof(Arena));
+}
+
+void* arenaAlloc(Arena* a, size_t size)
+{
+    size = arenaRound(size ? size : 1);
+    a->total += size;
+    if (a->total > a->peak)
+    {
+        a->peak = a->total;
+    }
+
+    if (a->used + size <= a->capacity)
+    {
+        a->last = a->used;
+        a->used += size;
+        return a->block + a->last;
+    }
+
+    // the header is padded so the data after it stays aligned
+    size_t header = arenaRound(sizeof(ArenaOverflow));
+    ArenaOverflow* overflow = malloc(header + size);
+    overflow->next = a->overflows;
+    a->overflows = overflow;
+    a->allocations++;
+    return (unsigned char*)overflow + header;
+}
+
+void* arenaResize(Arena* a, void* p, size_t old, size_t size)
+{
+    if (!p)
+    {
+        return arenaAlloc(a, size);
+    }
+
+    old = arenaRound(old);
+    size = arenaRound(size);
+    if (size <= old)
+    {
+        return p;
+    }
+
+    // the latest allocation in the block can grow into the space after it
+    if (a->block && (unsigned char*)p == a->block + a->last &&
+        a->last + old == a->used && a->last + size <= a->capacity)
+    {
+        a->used = a->last + size;
+        a->total += size - old;
+        if (a->total > a->peak)
+        {
+            a->peak = a->total;
+        }
+        return p;
+    }
+
+    void* grown = arenaAlloc(a, size);
+    memcpy(grown, p, old);
+    return grown;
+}
+
+void arenaReset(Arena* a)
+{
+    if (a->overflows)
+    {
+        arenaRelease(a);
+        free(a->block);
+        a->capacity =
+            a->peak > 2 * a->capacity ? a->peak : 2 * a->capacity;
+        a->block = malloc(a->capacity);
+        a->allocations++;
+    }
+
+    a->used = 0;
+    a->last = 0;
+    a->total = 0;
+}
@@ -0,0 +1,60 @@
+/*
+ * arena.h
+ *
+ * Linear allocator for data which only lives for a single frame or physics
+ * step
+ *
+ * Allocations bump a pointer through one block and are all released together
+ * by a reset, so a phase can build its scratch buffers from exact counts every
+ * step without going through malloc. A frame which runs past the end of the
+ * block takes the rest from the heap, and the next reset regrows the block to
+ * the most any frame has used so far. Once that high water mark settles every
+ * frame is served from the block alone
+ *
+ * An arena is not thread safe, so the pool keeps one for each thread alongside
+ * the one shared by the serial parts of a step
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_ALIGN 16  // every allocation starts on a multiple of this
+
+// heap allocation made once a frame outgrew the block
+typedef struct ArenaOverflow
+{
+    struct ArenaOverflow* next;
+} ArenaOverflow;
+
+typedef struct Arena
+{
+    unsigned char* block;
+    size_t capacity;  // bytes in the block
+    size_t used;      // bytes of the block handed out this frame
+    size_t last;      // offset of the latest allocation in the block
+    size_t total;     // bytes handed out this frame including overflows
+    ArenaOverflow* overflows;
+
+    /* REPORTING */
+    size_t peak;                     // most bytes handed out in any frame
+    unsigned long long allocations;  // heap allocations since init
+} Arena;
+
+void arenaInit(Arena* a);
+
+void arenaFree(Arena* a);
+
+// returns size bytes which stay valid until the next reset
+void* arenaAlloc(Arena* a, size_t size);
+
+// grows an allocation, in place when it is the latest one in the block
+// a NULL pointer with an old size of 0 allocates like arenaAlloc
+void* arenaResize(Arena* a, void* p, size_t old, size_t size);
+
+// releases every allocation, growing the block to the high water mark if the
+// frame overflowed it
+void arenaReset(Arena* a);
+
+#endif
@@ -140,6 +140,16 @@ void simulationKeyCallback(GLFWwindow* window, int key, int scancode,
         cameraDisableNavigation(&sim->camera, window);
         simulationInit(sim, sim->configPath);
     }
+
+    if (key == GLFW_KEY_F && action == GLFW_PRESS)
+    {
+        simulationThrow(glfwGetWindowUserPointer(window));
+    }
+
+    if (key == GLFW_KEY_X && action == GLFW_PRESS)
+    {
+        simulationUnthrow(glfwGetWindowUserPointer(window));
+    }
 }
 
 void callbacksInit(Simulation* sim)
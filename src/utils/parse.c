@@ -3,8 +3,17 @@
 #include <cglm/cglm.h>
 #include <string.h>
 
+#include "../physics/bodies.h"
+#include "../physics/dem.h"
+#include "../physics/forces.h"
 #include "../physics/object.h"
+#include "../physics/particles.h"
 #include "../physics/physics.h"
+#include "../physics/reorder.h"
+#include "../physics/solver.h"
+#include "../physics/sleep.h"
+#include "../physics/speculative.h"
+#include "../physics/xpbd.h"
 #include "cJSON.h"
 #include "utils/quat.h"
 
@@ -31,10 +40,53 @@ unsigned int parseVec3(vec3 vec, const cJSON* configVec, const char* message)
     return 0;
 }
 
+// parses a color with non-negative components into the 0-1 range
+// accepts color from 0-1 range or 0-255 range
+// assumes color is on 0-1 range if all values are between 0 and 1
+unsigned int parseColor(vec3 color, const cJSON* configColor)
+{
+    const char* colorErrorMessage =
+        "ERROR::CONFIG::INVALID_COLOR: expected float array for color of "
+        "object with format [<red_color>, <blue_color>, <green_color>] with "
+        "non-negative values\n";
+    if (parseVec3(color, configColor, colorErrorMessage))
+    {
+        return 1;
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        if (color[i] < 0.0f)
+        {
+            printf("%s", colorErrorMessage);
+            return 1;
+        }
+    }
+
+    unsigned int scale = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        if (color[i] > 1)
+        {
+            scale = 1;
+            break;
+        }
+    }
+    if (scale)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            color[i] /= 255.0f;
+        }
+    }
+    return 0;
+}
+
 // parses a single JSON object into a simulation object
 // expects type, size, mass, position, euler (default 0), color, static (default false), velocity
 // (default 0), spin (default 0)
-unsigned int parseConfigObject(int type, cJSON* configObject, Object* object)
+// velocity is converted to a previous position using the physics time step
+unsigned int parseConfigObject(int type, cJSON* configObject, float dt,
+                               Object* object)
 {
     /* TYPE */
     object->type = type;
@@ -106,41 +158,10 @@ unsigned int parseConfigObject(int type, cJSON* configObject, Object* object)
     /* COLOR */
     cJSON* configColor =
         cJSON_GetObjectItemCaseSensitive(configObject, "color");
-    const char* colorErrorMessage =
-        "ERROR::CONFIG::INVALID_COLOR: expected float array for color of "
-        "object with format [<red_color>, <blue_color>, <green_color>] with "
-        "non-negative values\n";
-    if (parseVec3(object->color, configColor, colorErrorMessage))
+    if (parseColor(object->color, configColor))
     {
         return 1;
     }
-    for (int i = 0; i < 3; i++)
-    {
-        if (object->color[i] < 0.0f)
-        {
-            printf("%s", colorErrorMessage);
-            return 1;
-        }
-    }
-
-    // accepts color from 0-1 range or 0-255 range
-    // assumes color is on 0-1 range if all values are between 0 and 1
-    unsigned int scale = 0;
-    for (int i = 0; i < 3; i++)
-    {
-        if (object->color[i] > 1)
-        {
-            scale = 1;
-            break;
-        }
-    }
-    if (scale)
-    {
-        for (int i = 0; i < 3; i++)
-        {
-            object->color[i] /= 255.0f;
-        }
-    }
 
     /* STATIC */
     cJSON* configStatic =
@@ -165,7 +186,7 @@ unsigned int parseConfigObject(int type, cJSON* configObject, Object* object)
     {
         return 1;
     }
-    glm_vec3_scale(velocity, PHYSICS_DT, velocity);
+    glm_vec3_scale(velocity, dt, velocity);
     glm_vec3_sub(object->position, velocity, object->lastPosition);
 
     /* SPIN */
@@ -185,9 +206,10 @@ unsigned int parseConfigObject(int type, cJSON* configObject, Object* object)
     return 0;
 }
 
-// parses cJSON array into array of objects
-unsigned int parseConfigObjects(cJSON* configObjects,
-                                unsigned int* objectCounts, Object** objects)
+// parses cJSON array into the body store of each object type
+// handles receives a handle to the body of each object in the order listed
+unsigned int parseConfigObjects(cJSON* configObjects, float dt,
+                                Bodies* bodies, BodiesHandle* handles)
 {
     // determines number of each type of object to properly allocate object
     // array then parses each object individually
@@ -234,16 +256,17 @@ unsigned int parseConfigObjects(cJSON* configObjects,
     strcat(typeErrorMessage, " for type of object\n");
 
     // initialize each count to 0
+    unsigned int objectCounts[OBJECT_TYPES];
     for (int i = 0; i < OBJECT_TYPES; i++)
     {
         objectCounts[i] = 0;
     }
 
-    // get object counts
-    for (int i = 0; i < numObjects; i++)
+    // get object counts, walking the list directly since looking up each
+    // item by index starts from the front every time
+    cJSON* configObject;
+    cJSON_ArrayForEach(configObject, configObjects)
     {
-        cJSON* configObject = cJSON_GetArrayItem(configObjects, i);
-
         // parse the type of the object (i.e., cube, sphere, tetrahedron, etc.)
         const cJSON* configType =
             cJSON_GetObjectItemCaseSensitive(configObject, "type");
@@ -274,26 +297,26 @@ unsigned int parseConfigObjects(cJSON* configObjects,
 
     for (int type = 0; type < OBJECT_TYPES; type++)
     {
-        objects[type] = malloc(objectCounts[type] * sizeof(Object));
+        bodiesInit(&bodies[type], type, objectCounts[type]);
     }
 
-    unsigned int indices[OBJECT_TYPES];
-    memset(indices, 0, OBJECT_TYPES * sizeof(unsigned int));
-    for (int i = 0; i < numObjects; i++)
+    unsigned int index = 0;
+    cJSON_ArrayForEach(configObject, configObjects)
     {
-        cJSON* configObject = cJSON_GetArrayItem(configObjects, i);
         const cJSON* configType =
             cJSON_GetObjectItemCaseSensitive(configObject, "type");
         for (int type = 0; type < OBJECT_TYPES; type++)
         {
             if (!strcmp(configType->valuestring, OBJECT_NAMES[type]))
             {
-                if (parseConfigObject(type, configObject,
-                                      objects[type] + indices[type]))
+                Object object;
+                memset(&object, 0, sizeof(Object));
+                if (parseConfigObject(type, configObject, dt, &object))
                 {
                     return 1;
                 }
-                indices[type]++;
+                handles[index++] = bodiesHandle(
+                    &bodies[type], bodiesAdd(&bodies[type], &object));
                 break;
             }
         }
@@ -302,6 +325,305 @@ unsigned int parseConfigObjects(cJSON* configObjects,
     return 0;
 }
 
+// parses a non-negative float of a force, falling back to a default when it is
+// optional and missing
+unsigned int parseForceNumber(const cJSON* configForce, const char* name,
+                              int optional, float fallback, float* value,
+                              const char* message)
+{
+    const cJSON* configNumber =
+        cJSON_GetObjectItemCaseSensitive(configForce, name);
+    if (!configNumber && optional)
+    {
+        *value = fallback;
+        return 0;
+    }
+    if (!cJSON_IsNumber(configNumber) || configNumber->valuedouble < 0.0)
+    {
+        printf("%s", message);
+        return 1;
+    }
+    *value = configNumber->valuedouble;
+    return 0;
+}
+
+// parses the air velocities of a wind field
+// expects low and high corners of the box, resolution with at least two
+// samples on each axis, samples listed with x varying fastest and then y, and
+// drag
+unsigned int parseConfigWind(const cJSON* configForce, ForceWind* w)
+{
+    const char* windErrorMessage =
+        "ERROR::CONFIG::INVALID_WIND: expected float arrays low and high with "
+        "high above low, integer array resolution of at least 2 on each axis, "
+        "an array of [<x>, <y>, <z>] samples for every point of the grid, and "
+        "non-negative float drag\n";
+    const cJSON* configLow =
+        cJSON_GetObjectItemCaseSensitive(configForce, "low");
+    const cJSON* configHigh =
+        cJSON_GetObjectItemCaseSensitive(configForce, "high");
+    if (parseVec3(w->low, configLow, windErrorMessage) ||
+        parseVec3(w->high, configHigh, windErrorMessage) ||
+        parseForceNumber(configForce, "drag", 0, 0.0f, &w->drag,
+                         windErrorMessage))
+    {
+        return 1;
+    }
+
+    vec3 resolution;
+    const cJSON* configResolution =
+        cJSON_GetObjectItemCaseSensitive(configForce, "resolution");
+    if (parseVec3(resolution, configResolution, windErrorMessage))
+    {
+        return 1;
+    }
+    unsigned int samples = 1;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (w->high[axis] <= w->low[axis] || resolution[axis] < 2.0f)
+        {
+            printf("%s", windErrorMessage);
+            return 1;
+        }
+        w->resolution[axis] = resolution[axis];
+        samples *= w->resolution[axis];
+    }
+
+    const cJSON* configSamples =
+        cJSON_GetObjectItemCaseSensitive(configForce, "samples");
+    if (!cJSON_IsArray(configSamples) ||
+        cJSON_GetArraySize(configSamples) != samples)
+    {
+        printf("%s", windErrorMessage);
+        return 1;
+    }
+    w->samples = malloc(3 * samples * sizeof(float));
+    unsigned int sample = 0;
+    const cJSON* configSample;
+    cJSON_ArrayForEach(configSample, configSamples)
+    {
+        if (parseVec3(w->samples + 3 * sample++, configSample,
+                      windErrorMessage))
+        {
+            free(w->samples);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// parses a single JSON object into a force generator
+// springs name their bodies by their place in the objects array
+unsigned int parseConfigForce(const cJSON* configForce, Bodies* bodies,
+                              BodiesHandle* handles, unsigned int count,
+                              Force* force)
+{
+    /* TYPE */
+    const cJSON* configType =
+        cJSON_GetObjectItemCaseSensitive(configForce, "type");
+    int type = cJSON_IsString(configType) ? 0 : FORCE_TYPES;
+    while (type < FORCE_TYPES &&
+           strcmp(configType->valuestring, FORCE_NAMES[type]))
+    {
+        type++;
+    }
+    if (type == FORCE_TYPES)
+    {
+        printf(
+            "ERROR::CONFIG::INVALID_FORCE_TYPE: expected \"drag\", "
+            "\"attractor\", \"spring\", \"wind\", or \"gravitation\" for "
+            "type of force\n");
+        return 1;
+    }
+    force->type = type;
+
+    if (type == FORCE_DRAG)
+    {
+        const char* dragErrorMessage =
+            "ERROR::CONFIG::INVALID_DRAG: expected non-negative floats for "
+            "linear and quadratic drag\n";
+        ForceDrag* d = &force->drag;
+        return parseForceNumber(configForce, "linear", 1, 0.0f, &d->linear,
+                                dragErrorMessage) ||
+               parseForceNumber(configForce, "quadratic", 1, 0.0f,
+                                &d->quadratic, dragErrorMessage);
+    }
+
+    if (type == FORCE_ATTRACTOR)
+    {
+        const char* attractorErrorMessage =
+            "ERROR::CONFIG::INVALID_ATTRACTOR: expected float array for "
+            "position with format [<x>, <y>, <z>], float strength, and "
+            "positive float radius\n";
+        ForceAttractor* a = &force->attractor;
+        const cJSON* configPosition =
+            cJSON_GetObjectItemCaseSensitive(configForce, "position");
+        const cJSON* configStrength =
+            cJSON_GetObjectItemCaseSensitive(configForce, "strength");
+        if (parseVec3(a->position, configPosition, attractorErrorMessage) ||
+            parseForceNumber(configForce, "radius", 1, FORCES_RADIUS,
+                             &a->radius, attractorErrorMessage))
+        {
+            return 1;
+        }
+        if (!cJSON_IsNumber(configStrength) || a->radius <= 0.0f)
+        {
+            printf("%s", attractorErrorMessage);
+            return 1;
+        }
+        a->strength = configStrength->valuedouble;
+        return 0;
+    }
+
+    if (type == FORCE_WIND)
+    {
+        return parseConfigWind(configForce, &force->wind);
+    }
+
+    if (type == FORCE_GRAVITATION)
+    {
+        const char* gravitationErrorMessage =
+            "ERROR::CONFIG::INVALID_GRAVITATION: expected non-negative floats "
+            "constant and theta, and positive float radius\n";
+        ForceGravitation* g = &force->gravitation;
+        if (parseForceNumber(configForce, "constant", 0, 0.0f, &g->constant,
+                             gravitationErrorMessage) ||
+            parseForceNumber(configForce, "theta", 1, NBODY_THETA, &g->theta,
+                             gravitationErrorMessage) ||
+            parseForceNumber(configForce, "radius", 1, FORCES_RADIUS,
+                             &g->radius, gravitationErrorMessage))
+        {
+            return 1;
+        }
+        if (g->radius <= 0.0f)
+        {
+            printf("%s", gravitationErrorMessage);
+            return 1;
+        }
+        return 0;
+    }
+
+    /* SPRING */
+    const char* springErrorMessage =
+        "ERROR::CONFIG::INVALID_SPRING: expected indices a and b of two "
+        "different objects, non-negative float stiffness, and optional "
+        "non-negative floats damping and length\n";
+    ForceSpring* spring = &force->spring;
+    const cJSON* configA = cJSON_GetObjectItemCaseSensitive(configForce, "a");
+    const cJSON* configB = cJSON_GetObjectItemCaseSensitive(configForce, "b");
+    if (!cJSON_IsNumber(configA) || !cJSON_IsNumber(configB) ||
+        configA->valueint < 0 || configA->valueint >= count ||
+        configB->valueint < 0 || configB->valueint >= count ||
+        configA->valueint == configB->valueint)
+    {
+        printf("%s", springErrorMessage);
+        return 1;
+    }
+    spring->a = handles[configA->valueint];
+    spring->b = handles[configB->valueint];
+
+    // springs without a length rest where their bodies start
+    vec3 a, b;
+    bodiesPosition(&bodies[spring->a.type],
+                   bodiesFind(&bodies[spring->a.type], spring->a), a);
+    bodiesPosition(&bodies[spring->b.type],
+                   bodiesFind(&bodies[spring->b.type], spring->b), b);
+    return parseForceNumber(configForce, "stiffness", 0, 0.0f,
+                            &spring->stiffness, springErrorMessage) ||
+           parseForceNumber(configForce, "damping", 1, 0.0f, &spring->damping,
+                            springErrorMessage) ||
+           parseForceNumber(configForce, "length", 1, glm_vec3_distance(a, b),
+                            &spring->length, springErrorMessage);
+}
+
+// parses the optional array of particles into their store, where each entry
+// scatters count particles (default 1) over a box of half extents spread
+// (default 0) around its position
+// expects size, position, color, count, spread, and velocity (default 0)
+unsigned int parseConfigParticles(const cJSON* configParticles, float dt,
+                                  Particles* p)
+{
+    particlesInit(p, 0);
+    if (!configParticles)
+    {
+        return 0;
+    }
+    if (!cJSON_IsArray(configParticles))
+    {
+        printf(
+            "ERROR::CONFIG::INVALID_PARTICLES: expected array of particles\n");
+        return 1;
+    }
+
+    const char* particleErrorMessage =
+        "ERROR::CONFIG::INVALID_PARTICLE: expected positive float size, float "
+        "arrays position and color, and optional positive integer count, "
+        "non-negative float array spread, and float array velocity\n";
+
+    // every particle is counted first so the streams only grow once
+    unsigned int total = 0;
+    const cJSON* configParticle;
+    cJSON_ArrayForEach(configParticle, configParticles)
+    {
+        const cJSON* configCount =
+            cJSON_GetObjectItemCaseSensitive(configParticle, "count");
+        if (configCount &&
+            (!cJSON_IsNumber(configCount) || configCount->valueint < 1))
+        {
+            printf("%s", particleErrorMessage);
+            return 1;
+        }
+        total += configCount ? configCount->valueint : 1;
+    }
+    particlesReserve(p, total);
+
+    cJSON_ArrayForEach(configParticle, configParticles)
+    {
+        const cJSON* configCount =
+            cJSON_GetObjectItemCaseSensitive(configParticle, "count");
+        const cJSON* configSize =
+            cJSON_GetObjectItemCaseSensitive(configParticle, "size");
+        const cJSON* configSpread =
+            cJSON_GetObjectItemCaseSensitive(configParticle, "spread");
+        const cJSON* configVelocity =
+            cJSON_GetObjectItemCaseSensitive(configParticle, "velocity");
+        if (!cJSON_IsNumber(configSize) || configSize->valuedouble <= 0.0)
+        {
+            printf("%s", particleErrorMessage);
+            return 1;
+        }
+
+        vec3 position, color;
+        vec3 spread = GLM_VEC3_ZERO;
+        vec3 velocity = GLM_VEC3_ZERO;
+        if (parseVec3(position,
+                      cJSON_GetObjectItemCaseSensitive(configParticle,
+                                                       "position"),
+                      particleErrorMessage) ||
+            (configSpread &&
+             parseVec3(spread, configSpread, particleErrorMessage)) ||
+            (configVelocity &&
+             parseVec3(velocity, configVelocity, particleErrorMessage)) ||
+            parseColor(color,
+                       cJSON_GetObjectItemCaseSensitive(configParticle,
+                                                        "color")))
+        {
+            return 1;
+        }
+        if (spread[0] < 0.0f || spread[1] < 0.0f || spread[2] < 0.0f)
+        {
+            printf("%s", particleErrorMessage);
+            return 1;
+        }
+
+        particlesScatter(p, configCount ? configCount->valueint : 1, position,
+                         spread, velocity, configSize->valuedouble, color,
+                         dt);
+    }
+
+    return 0;
+}
+
 unsigned int parseConfig(Simulation* sim, const char* configPath)
 {
     // parse config file
@@ -320,6 +642,256 @@ unsigned int parseConfig(Simulation* sim, const char* configPath)
     }
     sim->gravity = gravity->valuedouble;
 
+    // optional broadphase algorithm
+    const cJSON* broadphase =
+        cJSON_GetObjectItemCaseSensitive(config, "broadphase");
+    sim->broadphaseMode = BROADPHASE_GRID;
+    if (broadphase)
+    {
+        int mode = cJSON_IsString(broadphase) ? 0 : BROADPHASE_MODES;
+        while (mode < BROADPHASE_MODES &&
+               strcmp(broadphase->valuestring, BROADPHASE_NAMES[mode]))
+        {
+            mode++;
+        }
+        if (mode == BROADPHASE_MODES)
+        {
+            printf(
+                "ERROR::CONFIG::INVALID_BROADPHASE: expected \"grid\", "
+                "\"sap\", or \"bvh\"\n");
+            return 1;
+        }
+        sim->broadphaseMode = mode;
+    }
+
+    // optional number of threads for physics
+    const cJSON* threads = cJSON_GetObjectItemCaseSensitive(config, "threads");
+    if (threads && (!cJSON_IsNumber(threads) || threads->valueint < 1))
+    {
+        printf("ERROR::CONFIG::INVALID_THREADS: expected positive integer\n");
+        return 1;
+    }
+    sim->threads = threads ? threads->valueint : 0;
+
+    // optional number of physics steps per second
+    const cJSON* physicsRate =
+        cJSON_GetObjectItemCaseSensitive(config, "physicsRate");
+    if (physicsRate &&
+        (!cJSON_IsNumber(physicsRate) || physicsRate->valuedouble <= 0.0))
+    {
+        printf(
+            "ERROR::CONFIG::INVALID_PHYSICS_RATE: expected positive float\n");
+        return 1;
+    }
+    sim->physicsRate = physicsRate ? physicsRate->valuedouble : PHYSICS_RATE;
+    sim->physicsDT = 1.0f / sim->physicsRate;
+
+    // optional broadphase cell size
+    const cJSON* cellSize =
+        cJSON_GetObjectItemCaseSensitive(config, "cellSize");
+    if (cellSize && (!cJSON_IsNumber(cellSize) || cellSize->valuedouble <= 0.0))
+    {
+        printf("ERROR::CONFIG::INVALID_CELL_SIZE: expected positive float\n");
+        return 1;
+    }
+    sim->cellSize = cellSize ? cellSize->valuedouble : 0.0f;
+
+    // optional choice of how the static tree is split
+    const cJSON* staticSah =
+        cJSON_GetObjectItemCaseSensitive(config, "staticSah");
+    if (staticSah && !cJSON_IsBool(staticSah))
+    {
+        printf("ERROR::CONFIG::INVALID_STATIC_SAH: expected boolean\n");
+        return 1;
+    }
+    sim->staticSah = staticSah ? cJSON_IsTrue(staticSah) : BROADPHASE_SAH;
+
+    // optional floors without edges
+    const cJSON* infiniteFloors =
+        cJSON_GetObjectItemCaseSensitive(config, "infiniteFloors");
+    if (infiniteFloors && !cJSON_IsBool(infiniteFloors))
+    {
+        printf("ERROR::CONFIG::INVALID_INFINITE_FLOORS: expected boolean\n");
+        return 1;
+    }
+    sim->infiniteFloors = infiniteFloors ? cJSON_IsTrue(infiniteFloors) : 0;
+
+    // optional contact solver settings
+    const cJSON* solverIterations =
+        cJSON_GetObjectItemCaseSensitive(config, "solverIterations");
+    if (solverIterations && (!cJSON_IsNumber(solverIterations) ||
+                             solverIterations->valueint < 1))
+    {
+        printf(
+            "ERROR::CONFIG::INVALID_SOLVER_ITERATIONS: expected positive "
+            "integer\n");
+        return 1;
+    }
+    sim->solverIterations =
+        solverIterations ? solverIterations->valueint : SOLVER_ITERATIONS;
+
+    const cJSON* friction =
+        cJSON_GetObjectItemCaseSensitive(config, "friction");
+    if (friction && (!cJSON_IsNumber(friction) || friction->valuedouble < 0.0))
+    {
+        printf(
+            "ERROR::CONFIG::INVALID_FRICTION: expected non-negative float\n");
+        return 1;
+    }
+    sim->friction = friction ? friction->valuedouble : SOLVER_FRICTION;
+
+    const cJSON* restitution =
+        cJSON_GetObjectItemCaseSensitive(config, "restitution");
+    if (restitution &&
+        (!cJSON_IsNumber(restitution) || restitution->valuedouble < 0.0 ||
+         restitution->valuedouble > 1.0))
+    {
+        printf(
+            "ERROR::CONFIG::INVALID_RESTITUTION: expected float between 0 and "
+            "1\n");
+        return 1;
+    }
+    sim->restitution =
+        restitution ? restitution->valuedouble : SOLVER_RESTITUTION;
+
+    // optional way of resolving contacts
+    const cJSON* dynamics =
+        cJSON_GetObjectItemCaseSensitive(config, "dynamics");
+    sim->dynamics = DYNAMICS_IMPULSE;
+    if (dynamics)
+    {
+        int mode = cJSON_IsString(dynamics) ? 0 : DYNAMICS_MODES;
+        while (mode < DYNAMICS_MODES &&
+               strcmp(dynamics->valuestring, DYNAMICS_NAMES[mode]))
+        {
+            mode++;
+        }
+        if (mode == DYNAMICS_MODES)
+        {
+            printf(
+                "ERROR::CONFIG::INVALID_DYNAMICS: expected \"impulse\", "
+                "\"xpbd\", or \"dem\"\n");
+            return 1;
+        }
+        sim->dynamics = mode;
+    }
+
+    const cJSON* substeps =
+        cJSON_GetObjectItemCaseSensitive(config, "substeps");
+    if (substeps && (!cJSON_IsNumber(substeps) || substeps->valueint < 1))
+    {
+        printf("ERROR::CONFIG::INVALID_SUBSTEPS: expected positive integer\n");
+        return 1;
+    }
+    sim->substeps = substeps ? substeps->valueint : XPBD_SUBSTEPS;
+
+    const cJSON* compliance =
+        cJSON_GetObjectItemCaseSensitive(config, "compliance");
+    if (compliance &&
+        (!cJSON_IsNumber(compliance) || compliance->valuedouble < 0.0))
+    {
+        printf(
+            "ERROR::CONFIG::INVALID_COMPLIANCE: expected non-negative float\n");
+        return 1;
+    }
+    sim->compliance = compliance ? compliance->valuedouble : XPBD_COMPLIANCE;
+
+    const cJSON* demSkin = cJSON_GetObjectItemCaseSensitive(config, "demSkin");
+    if (demSkin && (!cJSON_IsNumber(demSkin) || demSkin->valuedouble <= 0.0))
+    {
+        printf("ERROR::CONFIG::INVALID_DEM_SKIN: expected positive float\n");
+        return 1;
+    }
+    sim->demSkin = demSkin ? demSkin->valuedouble : DEM_SKIN;
+
+    const cJSON* demStiffness =
+        cJSON_GetObjectItemCaseSensitive(config, "demStiffness");
+    if (demStiffness &&
+        (!cJSON_IsNumber(demStiffness) || demStiffness->valuedouble <= 0.0))
+    {
+        printf(
+            "ERROR::CONFIG::INVALID_DEM_STIFFNESS: expected positive float\n");
+        return 1;
+    }
+    sim->demStiffness =
+        demStiffness ? demStiffness->valuedouble : DEM_STIFFNESS;
+
+    const cJSON* demDamping =
+        cJSON_GetObjectItemCaseSensitive(config, "demDamping");
+    if (demDamping &&
+        (!cJSON_IsNumber(demDamping) || demDamping->valuedouble < 0.0))
+    {
+        printf(
+            "ERROR::CONFIG::INVALID_DEM_DAMPING: expected non-negative "
+            "float\n");
+        return 1;
+    }
+    sim->demDamping = demDamping ? demDamping->valuedouble : DEM_DAMPING;
+
+    // optional limits below which bodies fall asleep
+    const cJSON* sleepSpeed =
+        cJSON_GetObjectItemCaseSensitive(config, "sleepSpeed");
+    if (sleepSpeed &&
+        (!cJSON_IsNumber(sleepSpeed) || sleepSpeed->valuedouble < 0.0))
+    {
+        printf(
+            "ERROR::CONFIG::INVALID_SLEEP_SPEED: expected non-negative "
+            "float\n");
+        return 1;
+    }
+    sim->sleepSpeed = sleepSpeed ? sleepSpeed->valuedouble : SLEEP_SPEED;
+
+    const cJSON* sleepSpin =
+        cJSON_GetObjectItemCaseSensitive(config, "sleepSpin");
+    if (sleepSpin &&
+        (!cJSON_IsNumber(sleepSpin) || sleepSpin->valuedouble < 0.0))
+    {
+        printf(
+            "ERROR::CONFIG::INVALID_SLEEP_SPIN: expected non-negative float\n");
+        return 1;
+    }
+    sim->sleepSpin = sleepSpin ? sleepSpin->valuedouble : SLEEP_SPIN;
+
+    const cJSON* sleepSteps =
+        cJSON_GetObjectItemCaseSensitive(config, "sleepSteps");
+    if (sleepSteps && (!cJSON_IsNumber(sleepSteps) || sleepSteps->valueint < 0))
+    {
+        printf(
+            "ERROR::CONFIG::INVALID_SLEEP_STEPS: expected non-negative "
+            "integer\n");
+        return 1;
+    }
+    sim->sleepSteps = sleepSteps ? sleepSteps->valueint : SLEEP_STEPS;
+
+    // optional motion over a step past which bodies get speculative contacts
+    const cJSON* speculativeFraction =
+        cJSON_GetObjectItemCaseSensitive(config, "speculativeFraction");
+    if (speculativeFraction && (!cJSON_IsNumber(speculativeFraction) ||
+                                speculativeFraction->valuedouble < 0.0))
+    {
+        printf(
+            "ERROR::CONFIG::INVALID_SPECULATIVE_FRACTION: expected "
+            "non-negative float\n");
+        return 1;
+    }
+    sim->speculativeFraction = speculativeFraction
+                                   ? speculativeFraction->valuedouble
+                                   : SPECULATIVE_FRACTION;
+
+    // optional steps between sorting bodies along a space filling curve
+    const cJSON* reorderInterval =
+        cJSON_GetObjectItemCaseSensitive(config, "reorderInterval");
+    if (reorderInterval &&
+        (!cJSON_IsNumber(reorderInterval) || reorderInterval->valueint < 0))
+    {
+        printf(
+            "ERROR::CONFIG::INVALID_REORDER_INTERVAL: expected non-negative "
+            "integer\n");
+        return 1;
+    }
+    sim->reorderInterval =
+        reorderInterval ? reorderInterval->valueint : REORDER_INTERVAL;
+
     const cJSON* light = cJSON_GetObjectItemCaseSensitive(config, "lightDir");
     const char* lightMessage =
         "ERROR::CONFIG::INVALID_LIGHT_DIR: expected float array with format "
@@ -354,13 +926,41 @@ unsigned int parseConfig(Simulation* sim, const char* configPath)
     sim->gravity = gravity->valuedouble;
 
     cJSON* configObjects = cJSON_GetObjectItemCaseSensitive(config, "objects");
+    unsigned int count = cJSON_GetArraySize(configObjects);
+    BodiesHandle* handles = malloc(count * sizeof(BodiesHandle));
+    if (parseConfigObjects(configObjects, sim->physicsDT, sim->bodies,
+                           handles))
+    {
+        free(handles);
+        return 1;
+    }
 
-    if (parseConfigObjects(configObjects, sim->objectCounts, sim->objects))
+    // optional generators of forces other than gravity
+    const cJSON* configForces =
+        cJSON_GetObjectItemCaseSensitive(config, "forces");
+    if (configForces && !cJSON_IsArray(configForces))
     {
+        printf("ERROR::CONFIG::INVALID_FORCES: expected array of forces\n");
+        free(handles);
         return 1;
     }
+    const cJSON* configForce;
+    cJSON_ArrayForEach(configForce, configForces)
+    {
+        Force force;
+        memset(&force, 0, sizeof(Force));
+        if (parseConfigForce(configForce, sim->bodies, handles, count, &force))
+        {
+            free(handles);
+            return 1;
+        }
+        forcesAdd(&sim->forces, &force);
+    }
+    free(handles);
 
-    return 0;
+    return parseConfigParticles(
+        cJSON_GetObjectItemCaseSensitive(config, "particles"), sim->physicsDT,
+        &sim->particles);
 }
 
 char* parseFile(const char* filePath, const char* errorMessage)
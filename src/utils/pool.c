@@ -0,0 +1,197 @@
+#include "pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// claims and runs chunks of the current job until none remain
+void poolRun(Pool* p, unsigned int worker)
+{
+    while (1)
+    {
+        unsigned int first = atomic_fetch_add(&p->next, p->grain);
+        if (first >= p->count)
+        {
+            return;
+        }
+
+        unsigned int last = first + p->grain;
+        if (last > p->count)
+        {
+            last = p->count;
+        }
+        p->task(p->data, first, last, worker);
+    }
+}
+
+// main loop for each background worker
+void* poolWorker(void* arg)
+{
+    PoolWorker* w = arg;
+    Pool* p = w->pool;
+    unsigned long long seen = 0;
+
+    pthread_mutex_lock(&p->mutex);
+    while (1)
+    {
+        while (p->generation == seen && !p->shutdown)
+        {
+            pthread_cond_wait(&p->start, &p->mutex);
+        }
+        if (p->shutdown)
+        {
+            break;
+        }
+        seen = p->generation;
+        pthread_mutex_unlock(&p->mutex);
+
+        poolRun(p, w->index);
+
+        pthread_mutex_lock(&p->mutex);
+        if (--p->active == 0)
+        {
+            pthread_cond_signal(&p->done);
+        }
+    }
+    pthread_mutex_unlock(&p->mutex);
+
+    return NULL;
+}
+
+unsigned int poolInit(Pool* p, unsigned int threads)
+{
+    p->threads = threads > 0 ? threads : 1;
+    p->generation = 0;
+    p->active = 0;
+    p->shutdown = 0;
+    atomic_init(&p->next, 0);
+
+    pthread_mutex_init(&p->mutex, NULL);
+    pthread_cond_init(&p->start, NULL);
+    pthread_cond_init(&p->done, NULL);
+
+    p->arenas = malloc(p->threads * sizeof(Arena));
+    for (unsigned int i = 0; i < p->threads; i++)
+    {
+        arenaInit(p->arenas + i);
+    }
+
+    p->workers = malloc((p->threads - 1) * sizeof(PoolWorker));
+    for (unsigned int i = 0; i < p->threads - 1; i++)
+    {
+        p->workers[i].pool = p;
+        p->workers[i].index = i + 1;
+        if (pthread_create(&p->workers[i].thread, NULL, poolWorker,
+                           p->workers + i))
+        {
+            printf(
+                "ERROR::POOL::THREAD_CREATION_FAILED: could only start %u of "
+                "%u threads\n",
+                i + 1, p->threads);
+
+            // keep the workers which did start
+            pthread_mutex_lock(&p->mutex);
+            p->threads = i + 1;
+            pthread_mutex_unlock(&p->mutex);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+void poolFree(Pool* p)
+{
+    pthread_mutex_lock(&p->mutex);
+    p->shutdown = 1;
+    pthread_cond_broadcast(&p->start);
+    pthread_mutex_unlock(&p->mutex);
+
+    for (unsigned int i = 0; i < p->threads - 1; i++)
+    {
+        pthread_join(p->workers[i].thread, NULL);
+    }
+    free(p->workers);
+
+    // arenas of threads which failed to start were never used
+    for (unsigned int i = 0; i < p->threads; i++)
+    {
+        arenaFree(p->arenas + i);
+    }
+    free(p->arenas);
+
+    pthread_mutex_destroy(&p->mutex);
+    pthread_cond_destroy(&p->start);
+    pthread_cond_destroy(&p->done);
+}
+
+void poolReset(Pool* p)
+{
+    for (unsigned int i = 0; i < p->threads; i++)
+    {
+        arenaReset(p->arenas + i);
+    }
+}
+
+size_t poolPeak(Pool* p)
+{
+    size_t peak = 0;
+    for (unsigned int i = 0; i < p->threads; i++)
+    {
+        peak += p->arenas[i].peak;
+    }
+    return peak;
+}
+
+unsigned long long poolAllocations(Pool* p)
+{
+    unsigned long long allocations = 0;
+    for (unsigned int i = 0; i < p->threads; i++)
+    {
+        allocations += p->arenas[i].allocations;
+    }
+    return allocations;
+}
+
+void poolFor(Pool* p, unsigned int count, unsigned int grain, PoolTask task,
+             void* data)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    // not worth waking the workers for a single chunk
+    if (p->threads <= 1 || count <= grain)
+    {
+        task(data, 0, count, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&p->mutex);
+    p->task = task;
+    p->data = data;
+    p->count = count;
+    p->grain = grain;
+    atomic_store(&p->next, 0);
+    p->active = p->threads - 1;
+    p->generation++;
+    pthread_cond_broadcast(&p->start);
+    pthread_mutex_unlock(&p->mutex);
+
+    // the calling thread works alongside the pool
+    poolRun(p, 0);
+
+    pthread_mutex_lock(&p->mutex);
+    while (p->active > 0)
+    {
+        pthread_cond_wait(&p->done, &p->mutex);
+    }
+    pthread_mutex_unlock(&p->mutex);
+}
+
+unsigned int poolHardwareThreads()
+{
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    return processors > 0 ? (unsigned int)processors : 1;
+}
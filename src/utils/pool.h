@@ -0,0 +1,82 @@
+/*
+ * pool.h
+ *
+ * Persistent pthread worker pool used to split physics phases across cores
+ *
+ * Work is handed out in fixed-size chunks of an index range, so the same
+ * indices always land in the same chunk no matter which thread claims it, and
+ * every call to poolFor is a barrier which returns only once all chunks have
+ * finished
+ *
+ * Each thread also owns an arena for scratch its chunks need within a step,
+ * which is only released by poolReset
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "arena.h"
+
+// processes indices [first, last) of a job on the given worker (0 is the
+// calling thread)
+typedef void (*PoolTask)(void* data, unsigned int first, unsigned int last,
+                         unsigned int worker);
+
+typedef struct Pool Pool;
+
+typedef struct PoolWorker
+{
+    Pool* pool;
+    unsigned int index;
+    pthread_t thread;
+} PoolWorker;
+
+typedef struct Pool
+{
+    unsigned int threads;  // number of threads including the caller
+    PoolWorker* workers;   // the threads - 1 background workers
+    Arena* arenas;         // scratch of each thread, indexed by worker
+
+    pthread_mutex_t mutex;
+    pthread_cond_t start;  // wakes workers when a job is posted
+    pthread_cond_t done;   // wakes the caller when all workers have finished
+    unsigned long long generation;  // incremented for every posted job
+    unsigned int active;            // workers still running the current job
+    int shutdown;
+
+    /* CURRENT JOB */
+    PoolTask task;
+    void* data;
+    unsigned int count;  // number of indices in the job
+    unsigned int grain;  // number of indices per chunk
+    atomic_uint next;    // first index of the next unclaimed chunk
+} Pool;
+
+// starts threads - 1 background workers
+unsigned int poolInit(Pool* p, unsigned int threads);
+
+// stops and joins all workers
+void poolFree(Pool* p);
+
+// runs a task over [0, count) in chunks of grain indices across every thread
+// and blocks until all chunks are complete
+void poolFor(Pool* p, unsigned int count, unsigned int grain, PoolTask task,
+             void* data);
+
+// releases the scratch every thread allocated from its arena
+void poolReset(Pool* p);
+
+// returns the high water marks of every thread's arena added together
+size_t poolPeak(Pool* p);
+
+// returns the heap allocations of every thread's arena since init added
+// together
+unsigned long long poolAllocations(Pool* p);
+
+// returns the number of online processors
+unsigned int poolHardwareThreads();
+
+#endif
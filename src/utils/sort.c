@@ -0,0 +1,116 @@
+#include "sort.h"
+
+#include <string.h>
+
+// shared state for the per-chunk phases of a radix pass
+typedef struct SortTask
+{
+    unsigned int* keys[2];
+    unsigned int* values[2];
+    unsigned int* histograms;  // digit counts of each chunk
+    unsigned int source;  // buffer holding the pairs before a pass
+    unsigned int shift;   // lowest bit of the key sorted by a pass
+    unsigned int width;   // number of bits sorted by a pass
+} SortTask;
+
+// counts the digits of a chunk of keys for a pass
+void sortHistogram(void* data, unsigned int first, unsigned int last,
+                   unsigned int worker)
+{
+    SortTask* task = data;
+    unsigned int digits = 1u << task->width;
+    unsigned int* keys = task->keys[task->source];
+
+    unsigned int* histogram = NULL;
+    for (unsigned int k = first; k < last; k++)
+    {
+        // ranges may span several chunks when the pool runs them inline
+        if (k % SORT_CHUNK == 0)
+        {
+            histogram = task->histograms + k / SORT_CHUNK * digits;
+            memset(histogram, 0, digits * sizeof(unsigned int));
+        }
+
+        histogram[(keys[k] >> task->shift) & (digits - 1)]++;
+    }
+}
+
+// moves a chunk of pairs to their sorted places for a pass
+void sortScatter(void* data, unsigned int first, unsigned int last,
+                 unsigned int worker)
+{
+    SortTask* task = data;
+    unsigned int digits = 1u << task->width;
+    unsigned int* keys = task->keys[task->source];
+    unsigned int* values = task->values[task->source];
+    unsigned int* sortedKeys = task->keys[!task->source];
+    unsigned int* sortedValues = task->values[!task->source];
+
+    unsigned int* histogram = NULL;
+    for (unsigned int k = first; k < last; k++)
+    {
+        if (k % SORT_CHUNK == 0)
+        {
+            histogram = task->histograms + k / SORT_CHUNK * digits;
+        }
+
+        unsigned int place =
+            histogram[(keys[k] >> task->shift) & (digits - 1)]++;
+        sortedKeys[place] = keys[k];
+        sortedValues[place] = values[k];
+    }
+}
+
+unsigned int sortPrefix(unsigned int* histograms, unsigned int chunks,
+                        unsigned int digits, unsigned int place,
+                        unsigned int* starts)
+{
+    for (unsigned int digit = 0; digit < digits; digit++)
+    {
+        if (starts)
+        {
+            starts[digit] = place;
+        }
+        for (unsigned int chunk = 0; chunk < chunks; chunk++)
+        {
+            unsigned int* histogram = histograms + chunk * digits;
+            unsigned int count = histogram[digit];
+            histogram[digit] = place;
+            place += count;
+        }
+    }
+    if (starts)
+    {
+        starts[digits] = place;
+    }
+    return place;
+}
+
+unsigned int sortPairs(unsigned int* keys[2], unsigned int* values[2],
+                       unsigned int count, unsigned int bits, Pool* pool,
+                       Arena* frame)
+{
+    if (!count || !bits)
+    {
+        return 0;
+    }
+
+    // the bits are split evenly between the fewest passes which cover them
+    unsigned int passes = (bits + SORT_DIGIT - 1) / SORT_DIGIT;
+    SortTask task = {{keys[0], keys[1]}, {values[0], values[1]}};
+    task.width = (bits + passes - 1) / passes;
+    unsigned int digits = 1u << task.width;
+    unsigned int chunks = (count + SORT_CHUNK - 1) / SORT_CHUNK;
+    task.histograms =
+        arenaAlloc(frame, chunks * digits * sizeof(unsigned int));
+
+    for (unsigned int pass = 0; pass < passes; pass++)
+    {
+        task.shift = pass * task.width;
+        poolFor(pool, count, SORT_CHUNK, sortHistogram, &task);
+        sortPrefix(task.histograms, chunks, digits, 0, NULL);
+        poolFor(pool, count, SORT_CHUNK, sortScatter, &task);
+        task.source = !task.source;
+    }
+    return task.source;
+}
@@ -0,0 +1,40 @@
+/*
+ * sort.h
+ *
+ * Parallel least significant digit radix sort of unsigned keys paired with
+ * unsigned values
+ *
+ * Each pass counts the digits of every chunk of pairs across the pool, lays
+ * the digits out one after another with the share of each chunk after those
+ * of the chunks before it, then moves every chunk to its places, so pairs with
+ * equal digits keep their order and the sort is stable. Pairs move back and
+ * forth between two buffers, and the sort reports which one holds the result
+ *
+ * Payloads larger than a value are sorted by index and gathered afterwards
+ */
+
+#ifndef SORT_H
+#define SORT_H
+
+#include "arena.h"
+#include "pool.h"
+
+#define SORT_CHUNK 16384  // pairs handed to a worker at a time
+#define SORT_DIGIT 11     // most bits sorted by each pass
+
+// turns the digit counts of each chunk into the first place of each of its
+// digits, placing every digit after all smaller digits, and within a digit
+// each chunk after the chunks before it, starting from place
+// starts receives the first place of each digit and one past the last, unless
+// it is NULL, and the place after every counted item is returned
+unsigned int sortPrefix(unsigned int* histograms, unsigned int chunks,
+                        unsigned int digits, unsigned int place,
+                        unsigned int* starts);
+
+// sorts count pairs starting in keys[0] and values[0] by the lowest bits of
+// their keys, and returns the buffer which holds them sorted
+unsigned int sortPairs(unsigned int* keys[2], unsigned int* values[2],
+                       unsigned int count, unsigned int bits, Pool* pool,
+                       Arena* frame);
+
+#endif